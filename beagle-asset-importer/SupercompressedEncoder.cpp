@@ -0,0 +1,563 @@
+#include "SupercompressedEncoder.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <queue>
+#include <array>
+
+namespace
+{
+	// Has to match the model loader
+	const int MaxCodeLength = 12;
+	const std::size_t MaxRecentSelectors = 255;
+
+	// How much worse than the best endpoints / selectors we found a block may get, in exchange for reusing those
+	// Of the previous block, or a recently used selector pattern. Errors are sums of squared differences over a block.
+	// This is what makes the file small: reused endpoints are stored as zeros, and reused selectors as a single byte,
+	// Both of which the Huffman stage then squeezes down to a bit or two.
+	const float RelativeTolerance = 0.35f;
+	const float AbsoluteTolerance = 16 * 3 * 12.0f;
+
+	struct Pixel
+	{
+		int channels[4];
+	};
+
+	struct Palette
+	{
+		int colors[4][3];
+	};
+
+	bool Acceptable(float candidateError, float bestError)
+	{
+		return candidateError <= bestError * (1.0f + RelativeTolerance) + AbsoluteTolerance;
+	}
+
+	Palette ColorPalette(std::uint16_t color0, std::uint16_t color1)
+	{
+		Palette palette{};
+		const auto expand = [](std::uint16_t color, int rgb[3])
+		{
+			const auto red = (color >> 11) & 31;
+			const auto green = (color >> 5) & 63;
+			const auto blue = color & 31;
+			rgb[0] = (red << 3) | (red >> 2);
+			rgb[1] = (green << 2) | (green >> 4);
+			rgb[2] = (blue << 3) | (blue >> 2);
+		};
+
+		expand(color0, palette.colors[0]);
+		expand(color1, palette.colors[1]);
+		for (int channel = 0; channel < 3; channel++)
+		{
+			palette.colors[2][channel] = (2 * palette.colors[0][channel] + palette.colors[1][channel]) / 3;
+			palette.colors[3][channel] = (palette.colors[0][channel] + 2 * palette.colors[1][channel]) / 3;
+		}
+
+		return palette;
+	}
+
+	int ColorError(const Pixel& pixel, const int color[3])
+	{
+		int error = 0;
+		for (int channel = 0; channel < 3; channel++)
+		{
+			const auto difference = pixel.channels[channel] - color[channel];
+			error += difference * difference;
+		}
+		return error;
+	}
+
+	float BestColorSelectors(const Pixel pixels[16], const Palette& palette, std::uint32_t& selectors)
+	{
+		float error = 0;
+		selectors = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestError = ColorError(pixels[i], palette.colors[0]);
+			for (int index = 1; index < 4; index++)
+			{
+				const auto candidate = ColorError(pixels[i], palette.colors[index]);
+				if (candidate < bestError)
+				{
+					bestError = candidate;
+					best = index;
+				}
+			}
+			selectors |= static_cast<std::uint32_t>(best) << (i * 2);
+			error += static_cast<float>(bestError);
+		}
+		return error;
+	}
+
+	float ColorSelectorsError(const Pixel pixels[16], const Palette& palette, std::uint32_t selectors)
+	{
+		float error = 0;
+		for (int i = 0; i < 16; i++)
+			error += static_cast<float>(ColorError(pixels[i], palette.colors[(selectors >> (i * 2)) & 3]));
+		return error;
+	}
+
+	std::uint16_t ToRgb565(const float color[3])
+	{
+		const auto quantize = [](float value, int maximum)
+		{
+			return static_cast<int>(std::lround(std::min(255.0f, std::max(0.0f, value)) * maximum / 255.0f));
+		};
+		return static_cast<std::uint16_t>((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+	}
+
+	// Picks endpoints along the principal axis of the block's colors, spanning all of them
+	void FitColorEndpoints(const Pixel pixels[16], std::uint16_t& color0, std::uint16_t& color1)
+	{
+		float mean[3] = {};
+		for (int i = 0; i < 16; i++)
+			for (int channel = 0; channel < 3; channel++)
+				mean[channel] += pixels[i].channels[channel] / 16.0f;
+
+		float covariance[3][3] = {};
+		for (int i = 0; i < 16; i++)
+			for (int a = 0; a < 3; a++)
+				for (int b = 0; b < 3; b++)
+					covariance[a][b] += (pixels[i].channels[a] - mean[a]) * (pixels[i].channels[b] - mean[b]);
+
+		// A few rounds of power iteration are plenty to find the dominant direction
+		float axis[3] = { 1.0f, 1.0f, 1.0f };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[3] = {};
+			for (int a = 0; a < 3; a++)
+				for (int b = 0; b < 3; b++)
+					next[a] += covariance[a][b] * axis[b];
+
+			const auto length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+			if (length < 1e-6f)
+				break;
+
+			for (int a = 0; a < 3; a++)
+				axis[a] = next[a] / length;
+		}
+
+		float lowest = 0, highest = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			float projection = 0;
+			for (int channel = 0; channel < 3; channel++)
+				projection += (pixels[i].channels[channel] - mean[channel]) * axis[channel];
+			lowest = std::min(lowest, projection);
+			highest = std::max(highest, projection);
+		}
+
+		float first[3], second[3];
+		for (int channel = 0; channel < 3; channel++)
+		{
+			first[channel] = mean[channel] + axis[channel] * highest;
+			second[channel] = mean[channel] + axis[channel] * lowest;
+		}
+
+		color0 = ToRgb565(first);
+		color1 = ToRgb565(second);
+
+		// Only blocks with color0 > color1 interpolate four colors. Equal endpoints are nudged apart by one step of blue.
+		if (color0 < color1)
+			std::swap(color0, color1);
+		if (color0 == color1)
+		{
+			if (color0 < 0xFFFF)
+				color0++;
+			else
+				color1--;
+		}
+	}
+
+	void AlphaPalette(int alpha0, int alpha1, int palette[8])
+	{
+		palette[0] = alpha0;
+		palette[1] = alpha1;
+		for (int i = 2; i < 8; i++)
+			palette[i] = ((8 - i) * alpha0 + (i - 1) * alpha1) / 7;
+	}
+
+	float BestAlphaSelectors(const Pixel pixels[16], const int palette[8], std::uint64_t& selectors)
+	{
+		float error = 0;
+		selectors = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestError = 256 * 256;
+			for (int index = 0; index < 8; index++)
+			{
+				const auto difference = pixels[i].channels[3] - palette[index];
+				if (difference * difference < bestError)
+				{
+					bestError = difference * difference;
+					best = index;
+				}
+			}
+			selectors |= static_cast<std::uint64_t>(best) << (i * 3);
+			error += static_cast<float>(bestError);
+		}
+		return error;
+	}
+
+	float AlphaSelectorsError(const Pixel pixels[16], const int palette[8], std::uint64_t selectors)
+	{
+		float error = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			const auto difference = pixels[i].channels[3] - palette[(selectors >> (i * 3)) & 7];
+			error += static_cast<float>(difference * difference);
+		}
+		return error;
+	}
+
+	// Keeps the most recently used selector patterns, and writes either a reference to one of them, or a new pattern
+	template <typename Selectors>
+	class SelectorCoder
+	{
+	public:
+		SelectorCoder(int literalBytes, std::vector<unsigned char>& references, std::vector<unsigned char>& literals)
+			: literalBytes{ literalBytes }, references{ references }, literals{ literals }
+		{
+		}
+
+		const std::vector<Selectors>& GetRecent() const
+		{
+			return recent;
+		}
+
+		void Reuse(std::size_t position)
+		{
+			const auto pattern = recent[position];
+			recent.erase(recent.begin() + position);
+			recent.insert(recent.begin(), pattern);
+			references.push_back(static_cast<unsigned char>(position + 1));
+		}
+
+		void Add(Selectors pattern)
+		{
+			references.push_back(0);
+			for (int byte = 0; byte < literalBytes; byte++)
+				literals.push_back(static_cast<unsigned char>(pattern >> (byte * 8)));
+
+			recent.insert(recent.begin(), pattern);
+			if (recent.size() > MaxRecentSelectors)
+				recent.pop_back();
+		}
+	private:
+		int literalBytes;
+		std::vector<unsigned char>& references;
+		std::vector<unsigned char>& literals;
+		std::vector<Selectors> recent;
+	};
+
+	// Finds the recently used pattern with the lowest error, as long as it is close enough to the best possible one
+	template <typename Selectors, typename ErrorFunction>
+	bool FindReusablePattern(const std::vector<Selectors>& recent, float bestError, ErrorFunction error, std::size_t& position)
+	{
+		auto found = false;
+		auto lowestError = 0.0f;
+		for (std::size_t i = 0; i < recent.size(); i++)
+		{
+			const auto candidateError = error(recent[i]);
+			if (Acceptable(candidateError, bestError) && (!found || candidateError < lowestError))
+			{
+				found = true;
+				lowestError = candidateError;
+				position = i;
+
+				if (candidateError <= bestError)
+					break;
+			}
+		}
+		return found;
+	}
+
+	void WriteUint32(std::vector<unsigned char>& output, std::uint32_t value)
+	{
+		for (int byte = 0; byte < 4; byte++)
+			output.push_back(static_cast<unsigned char>(value >> (byte * 8)));
+	}
+
+	// Huffman code lengths, limited to MaxCodeLength. If the tree comes out too deep, the rarest symbols
+	// Are made a little less rare and the tree is built again, which gets there in a round or two.
+	std::array<int, 256> CodeLengths(std::array<std::uint64_t, 256> frequencies)
+	{
+		for (;;)
+		{
+			struct Node
+			{
+				std::uint64_t frequency;
+				int left;
+				int right;
+			};
+
+			std::vector<Node> nodes{};
+			using Entry = std::pair<std::uint64_t, int>;
+			std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue{};
+			for (int symbol = 0; symbol < 256; symbol++)
+			{
+				if (frequencies[symbol] == 0)
+					continue;
+				nodes.push_back(Node{ frequencies[symbol], -1, symbol });
+				queue.push(Entry{ frequencies[symbol], static_cast<int>(nodes.size()) - 1 });
+			}
+
+			std::array<int, 256> lengths{};
+			if (nodes.size() == 1)
+			{
+				lengths[nodes[0].right] = 1;
+				return lengths;
+			}
+
+			while (queue.size() > 1)
+			{
+				const auto first = queue.top(); queue.pop();
+				const auto second = queue.top(); queue.pop();
+				nodes.push_back(Node{ first.first + second.first, first.second, second.second });
+				queue.push(Entry{ first.first + second.first, static_cast<int>(nodes.size()) - 1 });
+			}
+
+			// Leaves have no left child, and keep their symbol in right
+			auto tooLong = false;
+			std::vector<std::pair<int, int>> stack{ { queue.top().second, 0 } };
+			while (!stack.empty())
+			{
+				const auto current = stack.back();
+				stack.pop_back();
+				const auto& node = nodes[current.first];
+				if (node.left < 0)
+				{
+					lengths[node.right] = current.second;
+					tooLong = tooLong || current.second > MaxCodeLength;
+				}
+				else
+				{
+					stack.push_back({ node.left, current.second + 1 });
+					stack.push_back({ node.right, current.second + 1 });
+				}
+			}
+
+			if (!tooLong)
+				return lengths;
+
+			for (auto& frequency : frequencies)
+				if (frequency != 0)
+					frequency = frequency / 2 + 1;
+		}
+	}
+
+	// A stream is its symbol count and mode, followed by either the raw bytes, or the code lengths and the Huffman coded bits.
+	// Whichever is smaller is written, which for tiny mip levels is usually the raw bytes.
+	void WriteStream(std::vector<unsigned char>& output, const std::vector<unsigned char>& symbols)
+	{
+		std::array<std::uint64_t, 256> frequencies{};
+		for (const auto symbol : symbols)
+			frequencies[symbol]++;
+
+		std::vector<unsigned char> coded{};
+		if (!symbols.empty())
+		{
+			const auto lengths = CodeLengths(frequencies);
+
+			// Canonical codes: shorter codes first, and in symbol order within a length
+			std::array<int, MaxCodeLength + 2> lengthCounts{};
+			for (const auto length : lengths)
+				lengthCounts[length]++;
+			lengthCounts[0] = 0;
+
+			std::array<int, MaxCodeLength + 2> nextCode{};
+			int code = 0;
+			for (int length = 1; length <= MaxCodeLength; length++)
+			{
+				code = (code + lengthCounts[length - 1]) << 1;
+				nextCode[length] = code;
+			}
+
+			std::array<std::uint32_t, 256> codes{};
+			for (int symbol = 0; symbol < 256; symbol++)
+			{
+				const auto length = lengths[symbol];
+				if (length == 0)
+					continue;
+
+				// Written least significant bit first, so the code is stored reversed
+				const auto canonical = nextCode[length]++;
+				for (int bit = 0; bit < length; bit++)
+					codes[symbol] |= ((canonical >> bit) & 1) << (length - 1 - bit);
+			}
+
+			for (int symbol = 0; symbol < 256; symbol += 2)
+				coded.push_back(static_cast<unsigned char>(lengths[symbol] | (lengths[symbol + 1] << 4)));
+
+			std::vector<unsigned char> bits{};
+			std::uint64_t buffer = 0;
+			int bufferedBits = 0;
+			for (const auto symbol : symbols)
+			{
+				buffer |= static_cast<std::uint64_t>(codes[symbol]) << bufferedBits;
+				bufferedBits += lengths[symbol];
+				while (bufferedBits >= 8)
+				{
+					bits.push_back(static_cast<unsigned char>(buffer));
+					buffer >>= 8;
+					bufferedBits -= 8;
+				}
+			}
+			if (bufferedBits > 0)
+				bits.push_back(static_cast<unsigned char>(buffer));
+
+			WriteUint32(coded, static_cast<std::uint32_t>(bits.size()));
+			coded.insert(coded.end(), bits.begin(), bits.end());
+		}
+
+		WriteUint32(output, static_cast<std::uint32_t>(symbols.size()));
+
+		if (symbols.empty() || coded.size() >= symbols.size())
+		{
+			output.push_back(0);
+			output.insert(output.end(), symbols.begin(), symbols.end());
+		}
+		else
+		{
+			output.push_back(1);
+			output.insert(output.end(), coded.begin(), coded.end());
+		}
+	}
+}
+
+std::vector<unsigned char> EncodeSupercompressedImage(const unsigned char* rgba, int width, int height, bool hasAlpha)
+{
+	const auto blocksWide = (width + 3) / 4;
+	const auto blocksHigh = (height + 3) / 4;
+
+	std::vector<unsigned char> colorEndpoints{}, colorReferences{}, colorLiterals{};
+	std::vector<unsigned char> alphaEndpoints{}, alphaReferences{}, alphaLiterals{};
+	SelectorCoder<std::uint32_t> colorSelectors{ 4, colorReferences, colorLiterals };
+	SelectorCoder<std::uint64_t> alphaSelectors{ 6, alphaReferences, alphaLiterals };
+
+	std::uint16_t previousColor0 = 0, previousColor1 = 0;
+	int previousAlpha0 = 0, previousAlpha1 = 0;
+	auto isFirstBlock = true;
+
+	for (int blockY = 0; blockY < blocksHigh; blockY++)
+	{
+		for (int blockX = 0; blockX < blocksWide; blockX++)
+		{
+			// Blocks hanging over the edge of the image repeat its last row / column
+			Pixel pixels[16];
+			for (int i = 0; i < 16; i++)
+			{
+				const auto x = std::min(blockX * 4 + i % 4, width - 1);
+				const auto y = std::min(blockY * 4 + i / 4, height - 1);
+				const auto source = rgba + (static_cast<std::size_t>(y) * width + x) * 4;
+				for (int channel = 0; channel < 4; channel++)
+					pixels[i].channels[channel] = source[channel];
+			}
+
+			// Color endpoints: our own fit, unless the previous block's are nearly as good
+			std::uint16_t color0, color1;
+			FitColorEndpoints(pixels, color0, color1);
+			auto palette = ColorPalette(color0, color1);
+			std::uint32_t selectors;
+			auto bestError = BestColorSelectors(pixels, palette, selectors);
+
+			if (!isFirstBlock)
+			{
+				const auto previousPalette = ColorPalette(previousColor0, previousColor1);
+				std::uint32_t previousSelectors;
+				const auto previousError = BestColorSelectors(pixels, previousPalette, previousSelectors);
+				if (Acceptable(previousError, bestError))
+				{
+					color0 = previousColor0;
+					color1 = previousColor1;
+					palette = previousPalette;
+					selectors = previousSelectors;
+					bestError = previousError;
+				}
+			}
+
+			const int channels[6] = { color0 >> 11, (color0 >> 5) & 63, color0 & 31, color1 >> 11, (color1 >> 5) & 63, color1 & 31 };
+			const int previousChannels[6] = { previousColor0 >> 11, (previousColor0 >> 5) & 63, previousColor0 & 31, previousColor1 >> 11, (previousColor1 >> 5) & 63, previousColor1 & 31 };
+			const int channelMasks[6] = { 31, 63, 31, 31, 63, 31 };
+			for (int channel = 0; channel < 6; channel++)
+				colorEndpoints.push_back(static_cast<unsigned char>((channels[channel] - previousChannels[channel]) & channelMasks[channel]));
+			previousColor0 = color0;
+			previousColor1 = color1;
+
+			std::size_t position = 0;
+			if (FindReusablePattern(colorSelectors.GetRecent(), bestError, [&](std::uint32_t pattern) { return ColorSelectorsError(pixels, palette, pattern); }, position))
+				colorSelectors.Reuse(position);
+			else
+				colorSelectors.Add(selectors);
+
+			if (hasAlpha)
+			{
+				int lowest = 255, highest = 0;
+				for (const auto& pixel : pixels)
+				{
+					lowest = std::min(lowest, pixel.channels[3]);
+					highest = std::max(highest, pixel.channels[3]);
+				}
+
+				// Like color, only alpha0 > alpha1 gives eight levels
+				if (lowest == highest)
+				{
+					if (highest < 255)
+						highest++;
+					else
+						lowest--;
+				}
+
+				int alpha0 = highest, alpha1 = lowest;
+				int alphaPalette[8];
+				AlphaPalette(alpha0, alpha1, alphaPalette);
+				std::uint64_t alphaPattern;
+				auto bestAlphaError = BestAlphaSelectors(pixels, alphaPalette, alphaPattern);
+
+				if (!isFirstBlock)
+				{
+					int previousPalette[8];
+					AlphaPalette(previousAlpha0, previousAlpha1, previousPalette);
+					std::uint64_t previousPattern;
+					const auto previousError = BestAlphaSelectors(pixels, previousPalette, previousPattern);
+					if (Acceptable(previousError, bestAlphaError))
+					{
+						alpha0 = previousAlpha0;
+						alpha1 = previousAlpha1;
+						std::copy(previousPalette, previousPalette + 8, alphaPalette);
+						alphaPattern = previousPattern;
+						bestAlphaError = previousError;
+					}
+				}
+
+				alphaEndpoints.push_back(static_cast<unsigned char>((alpha0 - previousAlpha0) & 255));
+				alphaEndpoints.push_back(static_cast<unsigned char>((alpha1 - previousAlpha1) & 255));
+				previousAlpha0 = alpha0;
+				previousAlpha1 = alpha1;
+
+				if (FindReusablePattern(alphaSelectors.GetRecent(), bestAlphaError, [&](std::uint64_t pattern) { return AlphaSelectorsError(pixels, alphaPalette, pattern); }, position))
+					alphaSelectors.Reuse(position);
+				else
+					alphaSelectors.Add(alphaPattern);
+			}
+
+			isFirstBlock = false;
+		}
+	}
+
+	std::vector<unsigned char> image{};
+	image.push_back(static_cast<unsigned char>(hasAlpha ? 6 : 3));
+	WriteStream(image, colorEndpoints);
+	WriteStream(image, colorReferences);
+	WriteStream(image, colorLiterals);
+	if (hasAlpha)
+	{
+		WriteStream(image, alphaEndpoints);
+		WriteStream(image, alphaReferences);
+		WriteStream(image, alphaLiterals);
+	}
+
+	return image;
+}
@@ -1,12 +1,31 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <future>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "SupercompressedEncoder.hpp"
+#include "MipLevels.hpp"
+#include "PixelChannels.hpp"
 
 #include <assimp/Importer.hpp> // C++ Importer Interface
 #include <assimp/scene.h> // Output data structure
 #include <assimp/postprocess.h> // Post processing flags
 
-void ExportModel(const aiNode* node, const aiScene* scene);
+void ExportModel(const aiNode* node, const aiScene* scene, std::ofstream& exportedFile);
+void ExportEmbeddedTexture(const aiTexture* texture, std::ofstream& exportedFile);
+void ExportMipChain(const unsigned char* pixels, int width, int height, int nrChannels, const std::string& mipFileName, std::ofstream& exportedFile);
+void ExportSupercompressed(const unsigned char* pixels, int width, int height, int nrChannels, const std::string& textureFileName, std::ofstream& exportedFile);
+void ExportVirtualTexture(const unsigned char* pixels, int width, int height, int nrChannels, const std::string& textureFileName, std::ofstream& exportedFile);
+std::vector<std::vector<unsigned char>> BuildMipLevels(std::vector<unsigned char> pixels, int width, int height, int nrChannels);
+std::vector<unsigned char> ExpandToRgba(const unsigned char* pixels, size_t pixelCount, int nrChannels);
+
+// The directory of the model file being imported. Texture paths in the model are relative to it.
+std::string sourceDirectory;
 
 int main(int argc, char* argv[])
 {
@@ -17,6 +36,9 @@ int main(int argc, char* argv[])
 		const std::string providedFile{ argv[1] };
 		std::cout << "Provided file: " << providedFile << std::endl;
 
+		const auto lastSeparator = providedFile.find_last_of("/\\");
+		sourceDirectory = lastSeparator == std::string::npos ? "" : providedFile.substr(0, lastSeparator + 1);
+
 		// By default all 3D data is provided in right-handed coordinate system (OpenGL also uses a right-hand coordinate system).
 		// The nodes in the returned hierarchy do not directly store meshes. The meshes are found in the "aiMesh" property of the scene.
 		// Each node simply refers to an index of this array.
@@ -39,7 +61,16 @@ int main(int argc, char* argv[])
 			return -1;
 		}
 
-		ExportModel(scene->mRootNode, scene);
+		// The asset is opened in binary mode, as embedded textures are written as raw bytes
+		// Right after their header line. In text mode Windows would translate any 0x0A byte in the
+		// Image data into 0x0D 0x0A, corrupting it.
+		// The stream is shared by the whole node hierarchy, so every node appends to the same file.
+		std::ofstream exportedFile;
+		exportedFile.open("export.beagleasset", std::ios::out | std::ios::binary);
+
+		ExportModel(scene->mRootNode, scene, exportedFile);
+
+		exportedFile.close();
 	}
 	else
 	{
@@ -51,11 +82,8 @@ int main(int argc, char* argv[])
 
 unsigned int globalIndiceCount = 0;
 
-void ExportModel(const aiNode* node, const aiScene* scene)
+void ExportModel(const aiNode* node, const aiScene* scene, std::ofstream& exportedFile)
 {
-	std::ofstream exportedFile;
-	exportedFile.open("export.beagleasset");
-	
 	const auto numberOfMeshes = node->mNumMeshes;
 
 	for (unsigned int i = 0; i < numberOfMeshes; i++)
@@ -108,7 +136,43 @@ void ExportModel(const aiNode* node, const aiScene* scene)
 			{
 				auto textureName = std::string{ path.C_Str() };
 
-				exportedFile << "t:" << textureName << "\n";
+				// Embedded textures are referenced by an asterisk followed by their index
+				// In the aiScene::mTextures array, e.g. "*0".
+				if (textureName.length() > 1 && textureName.front() == '*')
+				{
+					const auto embeddedIndex = static_cast<unsigned int>(std::stoul(textureName.substr(1)));
+
+					if (embeddedIndex < scene->mNumTextures)
+					{
+						const auto embeddedTexture = scene->mTextures[embeddedIndex];
+						ExportEmbeddedTexture(embeddedTexture, exportedFile);
+
+						if (embeddedTexture->mHeight == 0)
+						{
+							int width, height, nrChannels;
+							const auto pixels = stbi_load_from_memory(reinterpret_cast<const unsigned char*>(embeddedTexture->pcData), embeddedTexture->mWidth, &width, &height, &nrChannels, 0);
+							ExportMipChain(pixels, width, height, nrChannels, "embedded" + std::to_string(embeddedIndex) + ".beaglemips", exportedFile);
+							ExportSupercompressed(pixels, width, height, nrChannels, "embedded" + std::to_string(embeddedIndex) + ".beagletex", exportedFile);
+							ExportVirtualTexture(pixels, width, height, nrChannels, "embedded" + std::to_string(embeddedIndex) + ".beaglevt", exportedFile);
+							stbi_image_free(pixels);
+						}
+					}
+					else
+						std::cout << "Embedded texture " << textureName << " does not exist in the scene." << std::endl;
+				}
+				else
+				{
+					exportedFile << "t:" << textureName << "\n";
+
+					int width, height, nrChannels;
+					const auto pixels = stbi_load((sourceDirectory + textureName).c_str(), &width, &height, &nrChannels, 0);
+					const auto fileNameStart = textureName.find_last_of("/\\");
+					const auto fileName = fileNameStart == std::string::npos ? textureName : textureName.substr(fileNameStart + 1);
+					ExportMipChain(pixels, width, height, nrChannels, fileName + ".beaglemips", exportedFile);
+					ExportSupercompressed(pixels, width, height, nrChannels, fileName + ".beagletex", exportedFile);
+					ExportVirtualTexture(pixels, width, height, nrChannels, fileName + ".beaglevt", exportedFile);
+					stbi_image_free(pixels);
+				}
 			}
 		}
 	}
@@ -122,8 +186,265 @@ void ExportModel(const aiNode* node, const aiScene* scene)
 	for (unsigned int i = 0; i < numberOfChildren; i++)
 	{
 		const auto currentChild = node->mChildren[i];
-		ExportModel(currentChild, scene);
+		ExportModel(currentChild, scene, exportedFile);
+	}
+}
+
+void ExportEmbeddedTexture(const aiTexture* texture, std::ofstream& exportedFile)
+{
+	// If mHeight is zero, pcData is not an array of texels, but the raw bytes of a compressed
+	// Image file (png, jpg, ...) of mWidth bytes. We copy those bytes straight into the asset,
+	// So the runtime can decode them from memory without ever decoding and re-encoding them here.
+	if (texture->mHeight != 0)
+	{
+		std::cout << "Uncompressed embedded textures are not supported. Skipping texture." << std::endl;
+		return;
+	}
+
+	// e:<format hint>,<byte count> followed by a newline and then exactly <byte count> raw bytes.
+	const auto byteCount = texture->mWidth;
+	exportedFile << "e:" << texture->achFormatHint << "," << byteCount << "\n";
+	exportedFile.write(reinterpret_cast<const char*>(texture->pcData), byteCount);
+	exportedFile << "\n";
+}
+
+void ExportMipChain(const unsigned char* pixels, int width, int height, int nrChannels, const std::string& mipFileName, std::ofstream& exportedFile)
+{
+	// The runtime streams textures one mip level at a time, starting with the coarsest ones, and only loads
+	// The finer levels once an object covers enough of the screen to need them.
+	// To be able to read a single level without decoding the whole image, we store every level
+	// Uncompressed in a separate .beaglemips file next to the asset:
+	// -- "BMIP", version, width, height, channel count and level count, all as 32-bit unsigned integers
+	// -- For each level (level 0 first): a 64-bit byte offset into the file, and a 64-bit byte size
+	// -- The pixel data of all levels, coarsest first, so the levels loaded up front sit at the start of the file
+	if (pixels == nullptr)
+	{
+		std::cout << "Failed to load texture for mip chain " << mipFileName << ": " << stbi_failure_reason() << std::endl;
+		return;
+	}
+
+	// Opaque textures are stored without alpha, and grey textures with a single color channel, as the runtime does.
+	// The channel count in the header tells the runtime which layout the levels use.
+	const auto sourceChannels = nrChannels;
+	const auto pixelCount = static_cast<size_t>(width) * height;
+	nrChannels = MinimalChannelCount(pixels, pixelCount, sourceChannels);
+	std::vector<unsigned char> reduced(pixelCount * nrChannels);
+	ConvertChannels(pixels, pixelCount, sourceChannels, nrChannels, reduced.data());
+
+	if (nrChannels != sourceChannels)
+		std::cout << mipFileName << ": stored with " << nrChannels << " instead of " << sourceChannels << " channel(s)" << std::endl;
+
+	const auto levels = BuildMipLevels(std::move(reduced), width, height, nrChannels);
+
+	const auto levelCount = static_cast<std::uint32_t>(levels.size());
+	const std::uint32_t header[] = { 1, static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height), static_cast<std::uint32_t>(nrChannels), levelCount };
+
+	std::vector<std::uint64_t> offsets(levelCount);
+	std::vector<std::uint64_t> sizes(levelCount);
+	auto offset = static_cast<std::uint64_t>(4 + sizeof(header) + levelCount * 2 * sizeof(std::uint64_t));
+	for (auto level = static_cast<int>(levelCount) - 1; level >= 0; level--)
+	{
+		offsets[level] = offset;
+		sizes[level] = levels[level].size();
+		offset += sizes[level];
+	}
+
+	std::ofstream mipFile{ mipFileName, std::ios::out | std::ios::binary };
+	mipFile.write("BMIP", 4);
+	mipFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+	for (std::uint32_t level = 0; level < levelCount; level++)
+	{
+		mipFile.write(reinterpret_cast<const char*>(&offsets[level]), sizeof(std::uint64_t));
+		mipFile.write(reinterpret_cast<const char*>(&sizes[level]), sizeof(std::uint64_t));
+	}
+	for (auto level = static_cast<int>(levelCount) - 1; level >= 0; level--)
+		mipFile.write(reinterpret_cast<const char*>(levels[level].data()), levels[level].size());
+
+	exportedFile << "m:" << mipFileName << "\n";
+}
+
+void ExportSupercompressed(const unsigned char* pixels, int width, int height, int nrChannels, const std::string& textureFileName, std::ofstream& exportedFile)
+{
+	// Every texture is also written as a supercompressed .beagletex file, which is a fraction of the size of the
+	// Mip file. The runtime prefers it, and streams it level by level like the mip file, transcoding each level
+	// Straight to a block compressed GPU format. The mip file is only used if it can't be read.
+	// See SupercompressedTexture.hpp in the model loader for the layout.
+	if (pixels == nullptr)
+	{
+		std::cout << "Failed to load texture for " << textureFileName << ": " << stbi_failure_reason() << std::endl;
+		return;
+	}
+
+	// The encoder works on RGBA
+	const auto pixelCount = static_cast<size_t>(width) * height;
+	auto rgba = ExpandToRgba(pixels, pixelCount, nrChannels);
+
+	auto hasAlpha = false;
+	for (size_t i = 0; i < pixelCount; i++)
+		hasAlpha = hasAlpha || rgba[i * 4 + 3] != 255;
+
+	const auto levels = BuildMipLevels(std::move(rgba), width, height, 4);
+
+	// Every level is coded on its own, so they are all encoded at the same time
+	std::vector<std::future<std::vector<unsigned char>>> encodings{};
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		encodings.push_back(std::async(std::launch::async, [&levels, level, width, height, hasAlpha]()
+		{
+			const auto levelWidth = MipLevelSize(width, static_cast<int>(level));
+			const auto levelHeight = MipLevelSize(height, static_cast<int>(level));
+			return EncodeSupercompressedImage(levels[level].data(), levelWidth, levelHeight, hasAlpha);
+		}));
+	}
+
+	std::vector<std::vector<unsigned char>> images{};
+	for (auto& encoding : encodings)
+		images.push_back(encoding.get());
+
+	// A single slice, as the runtime only uses plain 2D textures
+	const auto levelCount = static_cast<std::uint32_t>(images.size());
+	const std::uint32_t header[] = { 1, static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height), levelCount, 1, hasAlpha ? 1u : 0u };
+
+	std::vector<std::uint64_t> offsets(levelCount);
+	std::vector<std::uint64_t> sizes(levelCount);
+	auto offset = static_cast<std::uint64_t>(4 + sizeof(header) + levelCount * 2 * sizeof(std::uint64_t));
+	for (std::uint32_t level = 0; level < levelCount; level++)
+	{
+		offsets[level] = offset;
+		sizes[level] = images[level].size();
+		offset += sizes[level];
+	}
+
+	std::ofstream textureFile{ textureFileName, std::ios::out | std::ios::binary };
+	textureFile.write("BTEX", 4);
+	textureFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+	for (std::uint32_t level = 0; level < levelCount; level++)
+	{
+		textureFile.write(reinterpret_cast<const char*>(&offsets[level]), sizeof(std::uint64_t));
+		textureFile.write(reinterpret_cast<const char*>(&sizes[level]), sizeof(std::uint64_t));
+	}
+	for (const auto& image : images)
+		textureFile.write(reinterpret_cast<const char*>(image.data()), image.size());
+
+	std::cout << textureFileName << ": " << offset << " bytes, " << (hasAlpha ? "with" : "without") << " alpha" << std::endl;
+
+	exportedFile << "s:" << textureFileName << "\n";
+}
+
+void ExportVirtualTexture(const unsigned char* pixels, int width, int height, int nrChannels, const std::string& textureFileName, std::ofstream& exportedFile)
+{
+	// Textures this large are also cut into pages for virtual texturing, so the runtime only has to load
+	// The parts of them that are on screen. See VirtualTextureFile.hpp in the model loader for the layout,
+	// Which has to match the page sizes below.
+	const int VirtualTextureMinimumSize = 4096;
+	const int PageContentSize = 120;
+	const int PageBorderSize = 4;
+	const int PageSize = PageContentSize + 2 * PageBorderSize;
+
+	if (pixels == nullptr || std::max(width, height) < VirtualTextureMinimumSize)
+		return;
+
+	const auto pagesAcross = [PageContentSize](int size) { return (size + PageContentSize - 1) / PageContentSize; };
+
+	// Levels go down to the first one which fits in a single page. The image is padded so its size divides
+	// Evenly through all of those levels, which means a page always covers exactly four pages of the level below.
+	// Padding can add a level, so we repeat until the padded size needs no further padding.
+	auto paddedWidth = width;
+	auto paddedHeight = height;
+	auto levelCount = 1;
+	while (true)
+	{
+		levelCount = 1;
+		while (pagesAcross(paddedWidth >> (levelCount - 1)) > 1 || pagesAcross(paddedHeight >> (levelCount - 1)) > 1)
+			levelCount++;
+
+		const auto divisor = 1 << (levelCount - 1);
+		const auto alignedWidth = (width + divisor - 1) / divisor * divisor;
+		const auto alignedHeight = (height + divisor - 1) / divisor * divisor;
+		if (alignedWidth == paddedWidth && alignedHeight == paddedHeight)
+			break;
+
+		paddedWidth = alignedWidth;
+		paddedHeight = alignedHeight;
+	}
+
+	// The padding repeats the last row and column. It is never sampled, but it keeps the borders of the edge pages sensible.
+	const auto rgba = ExpandToRgba(pixels, static_cast<size_t>(width) * height, nrChannels);
+	std::vector<unsigned char> padded(static_cast<size_t>(paddedWidth) * paddedHeight * 4);
+	for (int y = 0; y < paddedHeight; y++)
+	{
+		for (int x = 0; x < paddedWidth; x++)
+		{
+			const auto source = rgba.data() + (static_cast<size_t>(std::min(y, height - 1)) * width + std::min(x, width - 1)) * 4;
+			std::copy(source, source + 4, padded.data() + (static_cast<size_t>(y) * paddedWidth + x) * 4);
+		}
+	}
+
+	const auto levels = BuildMipLevels(std::move(padded), paddedWidth, paddedHeight, 4);
+
+	std::ofstream textureFile{ textureFileName, std::ios::out | std::ios::binary };
+	const std::uint32_t header[] = { 1, static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height), static_cast<std::uint32_t>(paddedWidth),
+		static_cast<std::uint32_t>(paddedHeight), static_cast<std::uint32_t>(levelCount), PageContentSize, PageBorderSize };
+	textureFile.write("BVTX", 4);
+	textureFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	// Every page, finest level first, and each level row by row. The border is copied from the neighbouring
+	// Pages, and clamped at the edges of the level.
+	size_t pageCount = 0;
+	std::vector<unsigned char> page(static_cast<size_t>(PageSize) * PageSize * 4);
+	for (int level = 0; level < levelCount; level++)
+	{
+		const auto levelWidth = paddedWidth >> level;
+		const auto levelHeight = paddedHeight >> level;
+		const auto& texels = levels[level];
+
+		for (int pageY = 0; pageY < pagesAcross(levelHeight); pageY++)
+		{
+			for (int pageX = 0; pageX < pagesAcross(levelWidth); pageX++)
+			{
+				for (int y = 0; y < PageSize; y++)
+				{
+					const auto sourceY = std::max(0, std::min(pageY * PageContentSize - PageBorderSize + y, levelHeight - 1));
+					for (int x = 0; x < PageSize; x++)
+					{
+						const auto sourceX = std::max(0, std::min(pageX * PageContentSize - PageBorderSize + x, levelWidth - 1));
+						const auto source = texels.data() + (static_cast<size_t>(sourceY) * levelWidth + sourceX) * 4;
+						std::copy(source, source + 4, page.data() + (static_cast<size_t>(y) * PageSize + x) * 4);
+					}
+				}
+
+				textureFile.write(reinterpret_cast<const char*>(page.data()), page.size());
+				pageCount++;
+			}
+		}
+	}
+
+	std::cout << textureFileName << ": " << pageCount << " pages in " << levelCount << " levels, padded to " << paddedWidth << "x" << paddedHeight << std::endl;
+
+	exportedFile << "p:" << textureFileName << "\n";
+}
+
+std::vector<unsigned char> ExpandToRgba(const unsigned char* pixels, size_t pixelCount, int nrChannels)
+{
+	// Grey is spread to all three color channels, and images without alpha are opaque
+	std::vector<unsigned char> rgba(pixelCount * 4);
+	ConvertChannels(pixels, pixelCount, nrChannels, 4, rgba.data());
+	return rgba;
+}
+
+std::vector<std::vector<unsigned char>> BuildMipLevels(std::vector<unsigned char> pixels, int width, int height, int nrChannels)
+{
+	// The same levels MipChain::Build makes at runtime, down to a single texel
+	std::vector<std::vector<unsigned char>> levels{};
+	levels.push_back(std::move(pixels));
+
+	const auto levelCount = MipLevelCount(width, height);
+	for (int level = 1; level < levelCount; level++)
+	{
+		std::vector<unsigned char> current(static_cast<size_t>(MipLevelSize(width, level)) * MipLevelSize(height, level) * nrChannels);
+		Downsample(levels.back().data(), MipLevelSize(width, level - 1), MipLevelSize(height, level - 1), nrChannels, current.data());
+		levels.push_back(std::move(current));
 	}
 
-	exportedFile.close();
-}
\ No newline at end of file
+	return levels;
+}
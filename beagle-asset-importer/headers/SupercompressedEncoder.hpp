@@ -0,0 +1,8 @@
+#pragma once
+
+#include <vector>
+
+// Encodes one RGBA image (a single mip level of a single slice) for a .beagletex file.
+// See SupercompressedTexture.hpp in the model loader for the format, which the encoder has to stay in sync with.
+// Textures without alpha only store color blocks; their alpha channel is ignored.
+std::vector<unsigned char> EncodeSupercompressedImage(const unsigned char* rgba, int width, int height, bool hasAlpha);
@@ -211,6 +211,11 @@ RECENT REVISION HISTORY:
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
 //
+// The PNG decoder uses SSE2 kernels for PNG scanline unfiltering on x86,
+// and AVX2 for the "up" filter when the CPU and OS support it; both are
+// picked with the same run-time test. Define STBI_NO_AVX2 to leave out
+// only the AVX2 code.
+//
 // ===========================================================================
 //
 // HDR image support   (disable by defining STBI_NO_HDR)
@@ -657,7 +662,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
 	int info3 = stbi__cpuid3();
@@ -668,7 +673,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
 	// If we're even attempting to compile this on GCC/Clang, that means
@@ -681,6 +686,54 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 is only used by the PNG unfilter. Unlike SSE2 it can't be assumed on x64,
+// so the kernels are compiled for it explicitly and only called after checking
+// that both the CPU and the OS (which has to save the YMM registers) support it.
+#if defined(STBI_SSE2) && !defined(STBI_NO_PNG) && !defined(STBI_NO_AVX2) && ((defined(_MSC_VER) && _MSC_VER >= 1700) || defined(__GNUC__) || defined(__clang__))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define STBI__TARGET_AVX2
+static void stbi__cpuidex(int info[4], int leaf, int subleaf)
+{
+	__cpuidex(info, leaf, subleaf);
+}
+static unsigned int stbi__xgetbv0(void)
+{
+	return (unsigned int)_xgetbv(0);
+}
+#else
+#include <cpuid.h>
+#define STBI__TARGET_AVX2 __attribute__((target("avx2")))
+static void stbi__cpuidex(int info[4], int leaf, int subleaf)
+{
+	unsigned int a, b, c, d;
+	__cpuid_count(leaf, subleaf, a, b, c, d);
+	info[0] = (int)a; info[1] = (int)b; info[2] = (int)c; info[3] = (int)d;
+}
+static unsigned int stbi__xgetbv0(void)
+{
+	unsigned int eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return eax;
+}
+#endif
+
+static int stbi__avx2_available(void)
+{
+	int info[4];
+	stbi__cpuidex(info, 0, 0);
+	if (info[0] < 7) return 0;
+	stbi__cpuidex(info, 1, 0);
+	if (((info[2] >> 27) & 1) == 0 || ((info[2] >> 28) & 1) == 0) return 0; // OSXSAVE and AVX
+	if ((stbi__xgetbv0() & 6) != 6) return 0; // OS saves XMM and YMM state
+	stbi__cpuidex(info, 7, 0);
+	return ((info[1] >> 5) & 1) != 0;
+}
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -3865,7 +3918,7 @@ static int stbi__jpeg_info(stbi__context* s, int* x, int* y, int* comp)
 #ifndef STBI_NO_ZLIB
 
 // fast-way is faster to check than jpeg huffman, but slow way is slower
-#define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
+#define STBI__ZFAST_BITS  10 // accelerate all cases in default tables, and most codes in dynamic ones
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 
 // zlib-style huffman encoding
@@ -3972,6 +4025,20 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf* z)
 
 static void stbi__fill_bits(stbi__zbuf* z)
 {
+	// fast path: with at least 4 bytes left, take as many whole bytes as fit in one go
+	// instead of one at a time. this ends in exactly the same state as the loop below.
+	if (z->num_bits <= 24 && z->zbuffer_end - z->zbuffer >= 4) {
+		stbi__uint32 word;
+		int bytes = (32 - z->num_bits) >> 3;
+		int bits = z->num_bits + bytes * 8;
+		STBI_ASSERT(z->code_buffer < (1U << z->num_bits));
+		word = (stbi__uint32)z->zbuffer[0] | ((stbi__uint32)z->zbuffer[1] << 8) | ((stbi__uint32)z->zbuffer[2] << 16) | ((stbi__uint32)z->zbuffer[3] << 24);
+		if (bits < 32) word &= (1U << (bits - z->num_bits)) - 1;
+		z->code_buffer |= word << z->num_bits;
+		z->zbuffer += bytes;
+		z->num_bits = bits;
+		return;
+	}
 	do {
 		STBI_ASSERT(z->code_buffer < (1U << z->num_bits));
 		z->code_buffer |= (unsigned int)stbi__zget8(z) << z->num_bits;
@@ -4088,8 +4155,12 @@ static int stbi__parse_huffman_block(stbi__zbuf* a)
 			}
 			p = (stbi_uc*)(zout - dist);
 			if (dist == 1) { // run of one byte; common in images.
-				stbi_uc v = *p;
-				if (len) { do *zout++ = v; while (--len); }
+				memset(zout, *p, len);
+				zout += len;
+			}
+			else if (dist >= len) { // source and destination don't overlap
+				memcpy(zout, p, len);
+				zout += len;
 			}
 			else {
 				if (len) { do *zout++ = *p++; while (--len); }
@@ -4413,6 +4484,141 @@ static int stbi__paeth(int a, int b, int c)
 
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
+#ifdef STBI_SSE2
+// SIMD scanline unfiltering. each kernel reconstructs a prefix of a scanline's
+// bytes after the first pixel, and returns how many bytes it did; the scalar
+// loops in stbi__create_png_image_raw finish off the rest. the results are
+// identical to the scalar code.
+//
+// sub, avg and paeth depend on the pixel to the left, so they go one pixel at
+// a time with all channels in one register. this handles 3 and 4 byte pixels.
+// 3 byte pixels are loaded and stored 4 bytes at a time, so those stop one
+// pixel early, so as not to touch memory past the end of the scanline.
+static int stbi__png_simd_level(void)
+{
+	if (!stbi__sse2_available()) return 0;
+#ifdef STBI_AVX2
+	if (stbi__avx2_available()) return 2;
+#endif
+	return 1;
+}
+
+static __m128i stbi__png_load_pixel(const stbi_uc* p)
+{
+	int v;
+	memcpy(&v, p, 4);
+	return _mm_cvtsi32_si128(v);
+}
+
+static void stbi__png_store_pixel(stbi_uc* p, __m128i v)
+{
+	int x = _mm_cvtsi128_si32(v);
+	memcpy(p, &x, 4);
+}
+
+static int stbi__png_unfilter_up_sse2(stbi_uc* cur, const stbi_uc* raw, const stbi_uc* prior, int n)
+{
+	int k;
+	for (k = 0; k + 16 <= n; k += 16) {
+		__m128i r = _mm_loadu_si128((const __m128i*) (raw + k));
+		__m128i b = _mm_loadu_si128((const __m128i*) (prior + k));
+		_mm_storeu_si128((__m128i*) (cur + k), _mm_add_epi8(r, b));
+	}
+	return k;
+}
+
+#ifdef STBI_AVX2
+STBI__TARGET_AVX2 static int stbi__png_unfilter_up_avx2(stbi_uc* cur, const stbi_uc* raw, const stbi_uc* prior, int n)
+{
+	int k;
+	for (k = 0; k + 32 <= n; k += 32) {
+		__m256i r = _mm256_loadu_si256((const __m256i*) (raw + k));
+		__m256i b = _mm256_loadu_si256((const __m256i*) (prior + k));
+		_mm256_storeu_si256((__m256i*) (cur + k), _mm256_add_epi8(r, b));
+	}
+	return k;
+}
+#endif
+
+static int stbi__png_unfilter_sub_sse2(stbi_uc* cur, const stbi_uc* raw, int pixels, int bpp)
+{
+	int i;
+	__m128i a = stbi__png_load_pixel(cur - bpp);
+	for (i = 0; i < pixels; ++i, cur += bpp, raw += bpp) {
+		a = _mm_add_epi8(a, stbi__png_load_pixel(raw));
+		stbi__png_store_pixel(cur, a);
+	}
+	return pixels * bpp;
+}
+
+static int stbi__png_unfilter_avg_sse2(stbi_uc* cur, const stbi_uc* raw, const stbi_uc* prior, int pixels, int bpp)
+{
+	int i;
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i a = stbi__png_load_pixel(cur - bpp);
+	for (i = 0; i < pixels; ++i, cur += bpp, raw += bpp, prior += bpp) {
+		__m128i b = stbi__png_load_pixel(prior);
+		// pavgb rounds up, but png's average rounds down
+		__m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+		a = _mm_add_epi8(stbi__png_load_pixel(raw), avg);
+		stbi__png_store_pixel(cur, a);
+	}
+	return pixels * bpp;
+}
+
+static int stbi__png_unfilter_paeth_sse2(stbi_uc* cur, const stbi_uc* raw, const stbi_uc* prior, int pixels, int bpp)
+{
+	int i;
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_unpacklo_epi8(stbi__png_load_pixel(cur - bpp), zero);
+	__m128i c = _mm_unpacklo_epi8(stbi__png_load_pixel(prior - bpp), zero);
+	for (i = 0; i < pixels; ++i, cur += bpp, raw += bpp, prior += bpp) {
+		__m128i b = _mm_unpacklo_epi8(stbi__png_load_pixel(prior), zero);
+		__m128i bc = _mm_sub_epi16(b, c), ac = _mm_sub_epi16(a, c), abc = _mm_add_epi16(bc, ac);
+		// same distances as stbi__paeth: pa = |b-c|, pb = |a-c|, pc = |a+b-2c|
+		__m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+		__m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+		__m128i pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+		// b unless pc < pb, then a unless the b/c winner is strictly closer; ties go to a, then b
+		__m128i use_c = _mm_cmplt_epi16(pc, pb);
+		__m128i nearest_bc = _mm_or_si128(_mm_and_si128(use_c, c), _mm_andnot_si128(use_c, b));
+		__m128i use_bc = _mm_cmplt_epi16(_mm_min_epi16(pb, pc), pa);
+		__m128i pred = _mm_or_si128(_mm_and_si128(use_bc, nearest_bc), _mm_andnot_si128(use_bc, a));
+		__m128i x = _mm_add_epi8(stbi__png_load_pixel(raw), _mm_packus_epi16(pred, pred));
+		stbi__png_store_pixel(cur, x);
+		a = _mm_unpacklo_epi8(x, zero);
+		c = b;
+	}
+	return pixels * bpp;
+}
+
+static int stbi__png_unfilter_simd(int simd, int filter, stbi_uc* cur, const stbi_uc* raw, const stbi_uc* prior, int n, int bpp)
+{
+	int pixels;
+	if (simd == 0) return 0;
+
+	if (filter == STBI__F_up) {
+#ifdef STBI_AVX2
+		if (simd >= 2) return stbi__png_unfilter_up_avx2(cur, raw, prior, n);
+#endif
+		return stbi__png_unfilter_up_sse2(cur, raw, prior, n);
+	}
+
+	if (bpp != 3 && bpp != 4) return 0;
+	pixels = n / bpp;
+	if (bpp == 3) --pixels;
+	if (pixels <= 0) return 0;
+
+	switch (filter) {
+	case STBI__F_sub: case STBI__F_paeth_first: // paeth with an all-zero row above is always the left pixel
+		return stbi__png_unfilter_sub_sse2(cur, raw, pixels, bpp);
+	case STBI__F_avg: return stbi__png_unfilter_avg_sse2(cur, raw, prior, pixels, bpp);
+	case STBI__F_paeth: return stbi__png_unfilter_paeth_sse2(cur, raw, prior, pixels, bpp);
+	}
+	return 0;
+}
+#endif // STBI_SSE2
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
@@ -4426,6 +4632,9 @@ static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 r
 	int output_bytes = out_n * bytes;
 	int filter_bytes = img_n * bytes;
 	int width = x;
+#ifdef STBI_SSE2
+	int simd = stbi__png_simd_level();
+#endif
 
 	STBI_ASSERT(out_n == s->img_n || out_n == s->img_n + 1);
 	a->out = (stbi_uc*)stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -4497,9 +4706,14 @@ static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 r
 		// this is a little gross, so that we don't switch per-pixel or per-component
 		if (depth < 8 || img_n == out_n) {
 			int nk = (width - 1) * filter_bytes;
+			int done = 0;
+#ifdef STBI_SSE2
+			if (filter != STBI__F_none)
+				done = stbi__png_unfilter_simd(simd, filter, cur, raw, prior, nk, filter_bytes);
+#endif
 #define STBI__CASE(f) \
              case f:     \
-                for (k=0; k < nk; ++k)
+                for (k=done; k < nk; ++k)
 			switch (filter) {
 				// "none" filter turns into a memcpy here; make that explicit.
 			case STBI__F_none:         memcpy(cur, raw, nk); break;
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct DecodeMemoryStats
+{
+	// Bytes of blocks currently handed out
+	std::size_t liveBytes = 0;
+	// The most liveBytes has ever been
+	std::size_t peakLiveBytes = 0;
+	// Bytes of freed blocks kept around for reuse
+	std::size_t pooledBytes = 0;
+	std::size_t allocations = 0;
+	// Allocations served from a pooled block instead of malloc
+	std::size_t poolHits = 0;
+};
+
+// All memory stb_image allocates goes through this pool (see STBI_MALLOC in main.cpp).
+// Decoding an image allocates a few multi-megabyte buffers, and we decode a lot of images in a row,
+// So instead of going back to malloc every time we keep freed blocks around for the next image.
+// Blocks are rounded up to power of two size classes, so a freed block can be reused for any
+// Request of the same class. Requests smaller than the smallest class go straight to malloc.
+// Trim hands all pooled blocks back to the operating system, which should be done once loading is over.
+// The pool is thread safe, as stb_image runs on the decode worker threads.
+class DecodeBufferPool
+{
+public:
+	static DecodeBufferPool& Global();
+	DecodeBufferPool() = default;
+	DecodeBufferPool(const DecodeBufferPool&) = delete;
+	DecodeBufferPool& operator=(const DecodeBufferPool&) = delete;
+	void* Allocate(std::size_t size);
+	void* Reallocate(void* pointer, std::size_t newSize);
+	void Free(void* pointer);
+	void Trim();
+	DecodeMemoryStats GetStats();
+	static const std::size_t SmallestClassBytes = 4 * 1024;
+	static const std::size_t ClassCount = 17; // 4 KB up to 256 MB
+	// Freed blocks beyond this are handed back to malloc right away
+	static const std::size_t MaxPooledBytes = 64 * 1024 * 1024;
+private:
+	// Every block starts with this header, which keeps the 16 byte alignment malloc gives us
+	struct alignas(16) BlockHeader
+	{
+		std::size_t sizeClass;
+		std::size_t capacity;
+	};
+	static const std::size_t Unpooled = static_cast<std::size_t>(-1);
+	static std::size_t SizeClass(std::size_t size);
+	std::mutex mutex;
+	std::array<std::vector<BlockHeader*>, ClassCount> freeBlocks;
+	DecodeMemoryStats stats;
+};
+
+struct DecodeBufferDeleter
+{
+	void operator()(unsigned char* pixels) const;
+};
+
+// Owns a block of pixels allocated from the DecodeBufferPool, and hands it back when destroyed.
+// Images decoded by stb_image can be adopted directly, since stb_image allocates from the same pool.
+class DecodeBuffer
+{
+public:
+	DecodeBuffer() = default;
+	DecodeBuffer(unsigned char* pixels, std::size_t size);
+	static DecodeBuffer Allocate(std::size_t size);
+	unsigned char* data();
+	const unsigned char* data() const;
+	std::size_t size() const;
+private:
+	std::unique_ptr<unsigned char, DecodeBufferDeleter> pixels;
+	std::size_t byteCount = 0;
+};
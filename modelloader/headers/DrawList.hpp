@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "RenderDevice.hpp"
+#include "RenderQueue.hpp"
+
+class VirtualTexture;
+
+// The same layout as the DrawElementsIndirectCommand OpenGL reads from an indirect buffer
+struct DrawCommand
+{
+	std::uint32_t indexCount;
+	std::uint32_t instanceCount;
+	std::uint32_t firstIndex;
+	std::int32_t baseVertex;
+	// Where the draw's transforms start in the transform array
+	std::uint32_t baseInstance;
+};
+
+// Everything a draw needs bound which can't change within one multi-draw call
+struct DrawState
+{
+	std::uint32_t vertexArray = 0;
+	std::uint32_t texture = 0;
+	const VirtualTexture* virtualTexture = nullptr;
+	// Tells virtual textures apart in sort keys
+	std::uint32_t virtualTextureId = 0;
+};
+
+// A run of commands with the same state, which can be drawn with one multi-draw call
+struct DrawBatch
+{
+	DrawState state;
+	std::uint32_t firstCommand;
+	std::uint32_t commandCount;
+};
+
+// Where the commands and transforms of a DrawList were uploaded to
+struct DrawListBuffers
+{
+	std::uint32_t commandBuffer = 0;
+	std::size_t commandOffset = 0;
+	std::uint32_t transformBuffer = 0;
+	std::size_t transformOffset = 0;
+	// The first of the four vertex attribute locations the transform matrix is read through
+	std::uint32_t transformLocation = 0;
+};
+
+struct DrawListStats
+{
+	std::size_t draws = 0;
+	std::size_t batches = 0;
+	std::size_t stateChanges = 0;
+	std::size_t stateChangesAvoided = 0;
+	double buildMilliseconds = 0.0;
+};
+
+// Collects the draws of a frame on the CPU, and turns them into the arrays an indirect multi-draw reads:
+// One command per draw, and one transform per instance. Build sorts the draws through a RenderQueue, by texture,
+// Then vertex array, then front to back, and cuts them into batches of the same state.
+// Nothing here touches OpenGL. The IndirectRenderer uploads the result, and Submit draws it through a RenderDevice.
+class DrawList
+{
+public:
+	void Clear();
+	// Used for the depth of the draws added afterwards
+	void SetView(const glm::mat4& view, float nearPlane, float farPlane);
+	void Add(const DrawState& state, std::uint32_t indexCount, std::uint32_t firstIndex, std::int32_t baseVertex, const glm::mat4& transform);
+	void Build();
+	// Draws the batches, with one multi-draw call each if the device supports it. bindState is called before each
+	// Batch to bind whatever its state needs besides the vertex array. Without it, the batch's texture is bound to unit 0.
+	// Returns the number of draw calls.
+	std::size_t Submit(RenderDevice& device, const DrawListBuffers& buffers, const std::function<void(const DrawState&)>& bindState) const;
+	// The same for batchCount batches starting at firstBatch, so several threads can each record a share of the list
+	std::size_t Submit(RenderDevice& device, const DrawListBuffers& buffers, const std::function<void(const DrawState&)>& bindState,
+		std::size_t firstBatch, std::size_t batchCount) const;
+	const std::vector<DrawCommand>& GetCommands() const;
+	const std::vector<glm::mat4>& GetTransforms() const;
+	const std::vector<DrawBatch>& GetBatches() const;
+	DrawListStats GetStats() const;
+private:
+	struct DrawItem
+	{
+		DrawState state;
+		DrawCommand command;
+		glm::mat4 transform;
+	};
+	std::uint32_t TextureSlot(const DrawState& state);
+	std::vector<DrawItem> items;
+	RenderQueue queue;
+	// Textures, virtual ones apart from regular ones, numbered in the order the list first sees them. Their names
+	// Could be too large for the key's texture field, but a frame never uses more textures than fit in it.
+	std::unordered_map<std::uint64_t, std::uint32_t> textureSlots;
+	glm::mat4 view{ 1.0f };
+	float nearPlane = 0.1f;
+	float farPlane = 1000.0f;
+	std::vector<DrawCommand> commands;
+	std::vector<glm::mat4> transforms;
+	std::vector<DrawBatch> batches;
+	DrawListStats stats;
+};
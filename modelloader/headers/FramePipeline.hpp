@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "RenderDevice.hpp"
+#include "RecordingRenderDevice.hpp"
+#include "ThreadPool.hpp"
+
+struct FramePipelineStats
+{
+	// The frames each stage worked on. A stage with nothing to do yet is at -1.
+	std::int64_t updateFrame = -1;
+	std::int64_t recordFrame = -1;
+	std::int64_t submitFrame = -1;
+	// The time spent in each stage, summed over every thread that worked on it. With the stages running at the same
+	// Time, they add up to more than frameMilliseconds.
+	double updateMilliseconds = 0.0;
+	double recordMilliseconds = 0.0;
+	double submitMilliseconds = 0.0;
+	// From the first record job starting to the last one finishing. How much smaller than recordMilliseconds this is
+	// Shows how well recording spreads over the workers.
+	double recordWallMilliseconds = 0.0;
+	double frameMilliseconds = 0.0;
+	std::size_t recordJobs = 0;
+	// How many different threads the record jobs ran on
+	std::size_t recordThreads = 0;
+	std::size_t commands = 0;
+	std::size_t streamBytes = 0;
+};
+
+// Splits the work of a frame into three stages, which run at the same time on three different frames:
+// - Update, on a worker: moves things around, culls, picks levels of detail, for frame n. It can spread its own work
+//   Over the same pool with ThreadPool::Run.
+// - Record, on the workers: turns what the update of frame n - 1 left behind into draws. Each job gets its own
+//   RecordingRenderDevice, a command list, to record into, so the jobs never wait on each other.
+// - Submit, on the thread owning the OpenGL context: replays the command lists of frame n - 2 on the real device,
+//   One after the other in job order. A submit stage can do more around that, and replay the lists more than once.
+//   It runs while the workers update and record, so it mustn't touch anything they do.
+// Frame n is on screen two frames after its update. Anything the update of a frame writes for its record stage has to
+// Be kept apart from the next frame's, by indexing it with frame % (Latency + 1) for example.
+// Record jobs must not create objects on the device, as their handles would be made up, and should only upload data
+// Whose size they know. The lists keep the data uploaded into them. Whatever the lists refer to has to stay alive
+// Until they're submitted.
+// Each list starts without any state, so every job binds what it needs. The device filters whatever turns out to be
+// Bound already when the lists are replayed.
+class FramePipeline
+{
+public:
+	using UpdateStage = std::function<void(std::uint64_t frame)>;
+	using RecordStage = std::function<void(std::uint64_t frame, std::size_t job, std::size_t jobCount, RenderDevice& commands)>;
+	// replay issues the frame's command lists on the device
+	using SubmitStage = std::function<void(std::uint64_t frame, const std::function<void()>& replay)>;
+	// Has to be made on the thread owning the OpenGL context, the one calling RunFrame.
+	// Without a submit stage, the lists are replayed as they are. recordJobCount of 0 has one record job per worker.
+	FramePipeline(RenderDevice& device, UpdateStage update, RecordStage record, SubmitStage submit = nullptr,
+		ThreadPool& workers = ThreadPool::Global(), std::size_t recordJobCount = 0);
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+	// Updates the next frame, records the one before and submits the one before that, and returns once all three are
+	// Done. This thread submits first, then takes whatever update and record jobs the workers haven't started. Without
+	// Workers, the stages run one after the other on this thread.
+	void RunFrame();
+	// Records and submits the frames that have been updated but not submitted yet, without updating new ones
+	void Flush();
+	// The times of the last call to RunFrame
+	FramePipelineStats GetStats() const;
+	// How many frames after its update a frame is submitted
+	static const int Latency = 2;
+private:
+	void Step(bool updating);
+	RenderDevice& device;
+	UpdateStage update;
+	RecordStage record;
+	SubmitStage submit;
+	// One set of command lists is recorded while the other is submitted
+	std::vector<std::unique_ptr<RecordingRenderDevice>> commandLists[2];
+	std::vector<double> recordJobMilliseconds;
+	std::uint64_t updatedFrames;
+	std::uint64_t recordedFrames;
+	std::uint64_t submittedFrames;
+	FramePipelineStats stats;
+	ThreadPool& workers;
+};
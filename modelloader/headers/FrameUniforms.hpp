@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+
+struct FrameUniformStats
+{
+	// Calls to glUniform*, and the uniform sets skipped because the value didn't change
+	std::size_t uniformUploads = 0;
+	std::size_t uniformUploadsSkipped = 0;
+};
+
+// Matches the Camera block in instancedvertex.glsl, laid out by the std140 rules
+struct CameraUniforms
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 position;
+};
+
+// Holds the uniforms that change once per frame in a uniform buffer, instead of setting them on every shader
+// Before every draw. The camera is uploaded once per frame into the Camera block, which is the same no matter
+// Which shader is active. Model matrices don't go through here, draws read them per instance, see DrawList.
+// Everything here has to be called on the OpenGL thread.
+class FrameUniforms
+{
+public:
+	static FrameUniforms& Global();
+	FrameUniforms();
+	FrameUniforms(const FrameUniforms&) = delete;
+	FrameUniforms& operator=(const FrameUniforms&) = delete;
+	// Uploads the camera
+	void BeginFrame(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition);
+	// The counts of the last finished frame
+	FrameUniformStats GetStats() const;
+private:
+	void CreateBuffer();
+	GLuint cameraBuffer;
+	FrameUniformStats stats;
+	FrameUniformStats lastFrameStats;
+};
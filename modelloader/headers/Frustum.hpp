@@ -0,0 +1,16 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// The six planes of a camera's view volume, pointing inwards.
+// Planes are stored as (normal, distance), normalized so the distance of a point to a plane is
+// dot(normal, point) + distance.
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	// Takes projection * view, the same matrix vertices are transformed by
+	static Frustum FromMatrix(const glm::mat4& viewProjection);
+	// Conservative: spheres close to a corner of the frustum may be reported as intersecting it when they don't
+	bool IntersectsSphere(const glm::vec3& center, float radius) const;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Frustum.hpp"
+#include "ThreadPool.hpp"
+
+// A bounding sphere and box around an object, in world space
+struct BoundingVolume
+{
+	glm::vec3 center;
+	float radius;
+	glm::vec3 min;
+	glm::vec3 max;
+
+	// The box is the smallest one around the transformed corners of the local box, the sphere is the one around that box
+	static BoundingVolume FromBox(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& transform);
+};
+
+struct FrustumCullerStats
+{
+	std::size_t objects = 0;
+	std::size_t visible = 0;
+	// How many pieces the objects were split into, each tested on its own thread
+	std::size_t jobs = 0;
+	// How many objects are tested at once: 8 with AVX, 4 with SSE, 1 without either
+	int lanes = 1;
+	double milliseconds = 0.0;
+};
+
+// Tests many bounding volumes against a frustum at once.
+// The volumes are kept in structure-of-arrays form, one array per coordinate, so SSE tests 4 objects per instruction
+// And AVX 8. Which one is used is decided when compiling: AVX if the build allows it (/arch:AVX), SSE otherwise.
+// An object is visible if its sphere and its box both intersect the frustum. The sphere test is cheaper, the box test
+// Rejects more. Like Frustum::IntersectsSphere, both are conservative near the corners of the frustum.
+// Each object comes with a payload, which is what Cull writes into its visible list, in the order they were added.
+// Above ParallelThreshold objects, Cull splits the work over a ThreadPool, and the calling thread takes a share too.
+class FrustumCuller
+{
+public:
+	explicit FrustumCuller(ThreadPool& workers = ThreadPool::Global());
+	FrustumCuller(const FrustumCuller&) = delete;
+	FrustumCuller& operator=(const FrustumCuller&) = delete;
+	void Clear();
+	void Reserve(std::size_t objectCount);
+	// Returns the index of the object, for Set
+	std::size_t Add(const BoundingVolume& bounds, std::uint32_t payload);
+	void Set(std::size_t index, const BoundingVolume& bounds);
+	std::size_t GetCount() const;
+	// Replaces the contents of visible with the payloads of the objects intersecting the frustum
+	void Cull(const Frustum& frustum, std::vector<std::uint32_t>& visible);
+	// The counts of the last call to Cull
+	FrustumCullerStats GetStats() const;
+	static const std::size_t ParallelThreshold = 32 * 1024;
+	// The arrays are always a multiple of this long, so the SIMD loops never need a scalar tail
+	static const std::size_t Padding = 8;
+private:
+	void CullRange(const Frustum& frustum, std::size_t first, std::size_t last, std::vector<std::uint32_t>& visible) const;
+	std::size_t count;
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+	std::vector<float> minX;
+	std::vector<float> minY;
+	std::vector<float> minZ;
+	std::vector<float> maxX;
+	std::vector<float> maxY;
+	std::vector<float> maxZ;
+	std::vector<std::uint32_t> payloads;
+	std::vector<std::vector<std::uint32_t>> jobVisible;
+	FrustumCullerStats stats;
+	ThreadPool& workers;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "RenderDevice.hpp"
+
+// The RenderDevice drawing through OpenGL. Handles are OpenGL names.
+// Bindings go through GLState, so calls which wouldn't change anything are dropped there, and counted as filtered.
+// Our context is OpenGL 3.3, which has neither multi-draw indirect nor base instances, so glMultiDrawElementsIndirect
+// Is loaded by hand when the driver has GL_ARB_multi_draw_indirect and GL_ARB_base_instance.
+// Everything here has to be called on the OpenGL thread.
+class GLRenderDevice : public RenderDevice
+{
+public:
+	GLRenderDevice();
+	GLRenderDevice(const GLRenderDevice&) = delete;
+	GLRenderDevice& operator=(const GLRenderDevice&) = delete;
+	void BeginFrame() override;
+	std::uint32_t CreateBuffer(BufferTarget target, std::size_t bytes, const void* data, BufferUsage usage) override;
+	void UpdateBuffer(std::uint32_t buffer, std::size_t offset, std::size_t bytes, const void* data) override;
+	void DeleteBuffer(std::uint32_t buffer) override;
+	std::uint32_t CreateTexture(int width, int height, int levelCount) override;
+	void UpdateTexture(std::uint32_t texture, int level, int x, int y, int width, int height, const void* pixels) override;
+	void DeleteTexture(std::uint32_t texture) override;
+	std::uint32_t CreateProgram(const std::string& vertexSource, const std::string& fragmentSource) override;
+	void DeleteProgram(std::uint32_t program) override;
+	void UseProgram(std::uint32_t program) override;
+	void BindVertexArray(std::uint32_t vertexArray) override;
+	void BindBuffer(BufferTarget target, std::uint32_t buffer) override;
+	void BindUniformBuffer(std::uint32_t index, std::uint32_t buffer, std::size_t offset, std::size_t bytes) override;
+	void BindTexture(std::uint32_t unit, std::uint32_t texture) override;
+	void SetVertexAttribute(std::uint32_t location, int components, std::size_t stride, std::uint32_t buffer, std::size_t offset) override;
+	void SetViewport(int x, int y, int width, int height) override;
+	void SetDepthTest(bool enabled) override;
+	void Clear(const glm::vec4& color) override;
+	void DrawIndexed(std::uint32_t indexCount, std::uint32_t firstIndex, std::int32_t baseVertex, std::uint32_t instanceCount) override;
+	void MultiDrawIndexedIndirect(std::uint32_t buffer, std::size_t offset, std::uint32_t drawCount) override;
+	bool SupportsMultiDrawIndirect() override;
+	RenderDeviceStats GetStats() const override;
+private:
+	typedef void (APIENTRYP MultiDrawElementsIndirectFunction)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+	static GLenum Target(BufferTarget target);
+	static GLuint CompileShader(GLenum type, const std::string& source);
+	void LoadFunctions();
+	bool functionsLoaded;
+	MultiDrawElementsIndirectFunction multiDrawElementsIndirect;
+	int depthTest;
+	glm::ivec4 viewport;
+	glm::vec4 clearColor;
+	RenderDeviceStats stats;
+	RenderDeviceStats lastFrameStats;
+};
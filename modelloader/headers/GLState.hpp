@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+struct GLStateStats
+{
+	// Calls passed on to OpenGL, and calls dropped because they wouldn't have changed anything
+	std::size_t issued = 0;
+	std::size_t filtered = 0;
+};
+
+// Remembers what is bound to OpenGL, and skips binding calls which wouldn't change it.
+// Every binding in the program has to go through here, or what we remember stops matching what's actually bound.
+// Deleting objects has to go through here as well, since OpenGL unbinds deleted objects, and may hand out their
+// Names again right after. If something binds behind our back anyway, call Invalidate.
+// The element array buffer binding belongs to the bound vertex array, so it is forgotten whenever that changes.
+// Only 2D textures are remembered, binds to other targets are always passed on.
+// Everything here has to be called on the OpenGL thread.
+class GLState
+{
+public:
+	static GLState& Global();
+	GLState();
+	GLState(const GLState&) = delete;
+	GLState& operator=(const GLState&) = delete;
+	// Starts counting calls for a new frame
+	void BeginFrame();
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vertexArray);
+	void BindBuffer(GLenum target, GLuint buffer);
+	void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	// Always leaves the unit active, but only calls glActiveTexture if it has to
+	void BindTexture(GLuint unit, GLenum target, GLuint texture);
+	void BindFramebuffer(GLenum target, GLuint framebuffer);
+	void BindRenderbuffer(GLenum target, GLuint renderbuffer);
+	void DeleteProgram(GLuint program);
+	void DeleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+	void DeleteBuffers(GLsizei count, const GLuint* buffers);
+	void DeleteTextures(GLsizei count, const GLuint* textures);
+	void DeleteFramebuffers(GLsizei count, const GLuint* framebuffers);
+	void DeleteRenderbuffers(GLsizei count, const GLuint* renderbuffers);
+	void Invalidate();
+	// The counts of the last finished frame
+	GLStateStats GetStats() const;
+	static const int TextureUnitCount = 16;
+	static const int UniformBufferBindingCount = 36;
+private:
+	// What we remember for bindings we know nothing about, which never matches a real name
+	static const GLuint Unknown = 0xffffffff;
+	struct BufferRange
+	{
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+	GLuint* BufferBinding(GLenum target);
+	bool Filter(GLuint& current, GLuint value);
+	GLuint program;
+	GLuint vertexArray;
+	GLuint arrayBuffer;
+	GLuint elementArrayBuffer;
+	GLuint copyReadBuffer;
+	GLuint copyWriteBuffer;
+	GLuint pixelPackBuffer;
+	GLuint pixelUnpackBuffer;
+	GLuint uniformBuffer;
+	GLuint drawIndirectBuffer;
+	BufferRange uniformBufferRanges[UniformBufferBindingCount];
+	GLuint activeTextureUnit;
+	GLuint textures[TextureUnitCount];
+	GLuint drawFramebuffer;
+	GLuint readFramebuffer;
+	GLuint renderbuffer;
+	GLStateStats stats;
+	GLStateStats lastFrameStats;
+};
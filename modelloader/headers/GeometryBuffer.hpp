@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+
+#include "OffsetAllocator.hpp"
+
+// The layouts of vertex data our meshes come in
+enum class VertexFormat
+{
+	// Position (3 floats) followed by texture coordinates (2 floats)
+	PositionTexCoord,
+	Count
+};
+
+// Where a mesh's vertices and indices are in the shared buffers of its vertex format.
+// Indices are relative to the mesh's first vertex, so they are drawn with baseVertex.
+struct GeometryAllocation
+{
+	VertexFormat format = VertexFormat::PositionTexCoord;
+	OffsetAllocation vertices;
+	OffsetAllocation indices;
+	GLint baseVertex = 0;
+	std::size_t firstIndex = 0;
+	GLsizei indexCount = 0;
+
+	bool IsValid() const { return vertices.IsValid() && indices.IsValid(); }
+	// The byte offset of the first index in the index buffer, as glDrawElements* wants it
+	const void* IndexOffset() const { return reinterpret_cast<const void*>(firstIndex * sizeof(unsigned int)); }
+};
+
+struct GeometryBufferStats
+{
+	OffsetAllocatorStats vertices;
+	OffsetAllocatorStats indices;
+};
+
+// Holds the vertices and indices of every mesh. Instead of a vertex array and two buffers per mesh, there is one of
+// Each per vertex format, which meshes get ranges of. Drawing a different mesh of the same format then needs no
+// Rebinding at all, only a different offset, which is what lets many meshes be drawn with one multi-draw call.
+// Ranges are handed out by an OffsetAllocator, counting vertices and indices. When a format's buffers are full
+// They grow, keeping their contents and their buffer objects, so ranges and pending uploads stay valid.
+// Everything here has to be called on the OpenGL thread.
+class GeometryBuffer
+{
+public:
+	static GeometryBuffer& Global();
+	GeometryBuffer();
+	~GeometryBuffer();
+	GeometryBuffer(const GeometryBuffer&) = delete;
+	GeometryBuffer& operator=(const GeometryBuffer&) = delete;
+	GeometryAllocation Allocate(VertexFormat format, std::uint32_t vertexCount, std::uint32_t indexCount);
+	void Free(const GeometryAllocation& allocation);
+	// The vertex array has the format's vertex attributes and index buffer set up already
+	GLuint GetVertexArray(VertexFormat format);
+	GLuint GetVertexBuffer(VertexFormat format);
+	GLuint GetIndexBuffer(VertexFormat format);
+	GeometryBufferStats GetStats(VertexFormat format) const;
+	static std::size_t VertexStride(VertexFormat format);
+	// Per-instance transforms for instanced draws, see Mesh::DrawInstanced. A mat4 takes up four locations.
+	static const GLuint InstanceAttributeLocation = 2;
+	static const std::uint32_t InitialVertexCount = 256 * 1024;
+	static const std::uint32_t InitialIndexCount = 1024 * 1024;
+private:
+	struct Pool
+	{
+		GLuint vertexArray = 0;
+		GLuint vertexBuffer = 0;
+		GLuint indexBuffer = 0;
+		std::unique_ptr<OffsetAllocator> vertices;
+		std::unique_ptr<OffsetAllocator> indices;
+	};
+	Pool& GetPool(VertexFormat format);
+	void CreatePool(VertexFormat format, Pool& pool);
+	static void GrowBuffer(GLuint buffer, std::size_t oldBytes, std::size_t newBytes);
+	static OffsetAllocation AllocateGrowing(OffsetAllocator& allocator, std::uint32_t count, GLuint buffer, std::size_t elementBytes);
+	Pool pools[static_cast<int>(VertexFormat::Count)];
+};
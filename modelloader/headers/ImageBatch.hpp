@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "ThreadPool.hpp"
+#include "DecodeBufferPool.hpp"
+
+// One image to decode. Either a file on disk, or encoded bytes (PNG, JPEG, ...) already in memory.
+struct ImageSource
+{
+	std::string name;
+	std::string filepath;
+	std::shared_ptr<const std::vector<unsigned char>> bytes;
+	// The size of the encoded image, which is what decode time is estimated from
+	std::size_t encodedBytes = 0;
+
+	static ImageSource FromFile(const std::string& filepath);
+	static ImageSource FromMemory(const std::string& name, std::vector<unsigned char> bytes);
+};
+
+struct DecodedImageResult
+{
+	std::string name;
+	// Empty if the image failed to decode
+	DecodeBuffer pixels;
+	int width = 0;
+	int height = 0;
+	int nrChannels = 0;
+	std::size_t encodedBytes = 0;
+	double decodeMilliseconds = 0.0;
+};
+
+struct ImageBatchStats
+{
+	std::size_t imageCount = 0;
+	std::size_t failedCount = 0;
+	std::size_t encodedBytes = 0;
+	std::size_t decodedBytes = 0;
+	// Time from the first job being submitted until the last image finished
+	double wallMilliseconds = 0.0;
+	// Time spent decoding, summed over all images. Divided by the wall time this gives the effective parallelism.
+	double decodeMilliseconds = 0.0;
+	double longestDecodeMilliseconds = 0.0;
+};
+
+// Decodes many images at once on a ThreadPool.
+// A single PNG can't be decoded in parallel, but a whole scene's worth of them can.
+// The images are submitted largest first: the longest jobs start right away, and the small ones
+// Fill in the gaps at the end, so all workers finish at about the same time.
+// Encoded size is only an estimate of decode time, but a good enough one for images of the same kind.
+class ImageBatch
+{
+public:
+	// Called on a worker thread as soon as an image is done. The index is the one returned by Add.
+	using DecodedCallback = std::function<void(std::size_t index, DecodedImageResult& result)>;
+	// Called on the worker thread that decoded the last image of the batch
+	using FinishedCallback = std::function<void(const ImageBatchStats& stats)>;
+
+	std::size_t Add(ImageSource source);
+	std::size_t GetImageCount() const;
+	bool IsEmpty() const;
+	// Decodes every image, and waits for all of them. Results are in the order the images were added.
+	// Must not be called from one of the pool's own workers, as it would end up waiting for itself.
+	std::vector<DecodedImageResult> DecodeAll(ThreadPool& pool, ImageBatchStats* stats = nullptr);
+	// Submits every image and returns right away. The batch can be reused or destroyed afterwards.
+	void DecodeAsync(ThreadPool& pool, DecodedCallback onDecoded, FinishedCallback onFinished = nullptr);
+private:
+	static DecodedImageResult Decode(const ImageSource& source);
+	std::vector<ImageSource> sources;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "DrawList.hpp"
+#include "FramePipeline.hpp"
+#include "RenderDevice.hpp"
+
+struct IndirectRendererStats
+{
+	bool multiDraw = false;
+	// Multi-draw calls, or single draws without multi-draw, per pass
+	std::size_t drawCalls = 0;
+	std::size_t draws = 0;
+	std::size_t bytesUploaded = 0;
+};
+
+// Draws DrawLists with one multi-draw indirect call per batch. The commands of a list go into an indirect buffer,
+// And its transforms into a buffer read through the same per-instance attribute as instanced draws
+// (see instancedvertex.glsl). Each command's baseInstance points at its own transform.
+// If the device doesn't support multi-draw indirect, every command is drawn on its own, pointing the transform
+// Attribute at it first.
+// The draws of a frame are recorded on the workers of a FramePipeline while earlier frames are still being
+// Submitted, so every frame in flight has buffers of its own, picked by frame % FrameCount.
+// For each frame: Reserve, then Record, from any number of threads, and Upload before the recorded draws are replayed.
+class IndirectRenderer
+{
+public:
+	static IndirectRenderer& Global();
+	IndirectRenderer() = default;
+	IndirectRenderer(const IndirectRenderer&) = delete;
+	IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+	// Makes sure the frame's buffers can hold the list. Growing replaces the buffers, which is why this has to
+	// Happen before anything is recorded for the frame. Has to be called on the OpenGL thread.
+	void Reserve(std::uint64_t frame, const DrawList& list);
+	// Records the draws of batchCount batches of the list, starting at firstBatch, and returns the number of draw calls.
+	// Doesn't touch OpenGL, so any thread can record its own share of the batches.
+	std::size_t Record(std::uint64_t frame, const DrawList& list, RenderDevice& commands, std::size_t firstBatch, std::size_t batchCount) const;
+	// Uploads the commands and transforms of the list. Has to be called on the OpenGL thread, before the recorded
+	// Draws are replayed.
+	void Upload(std::uint64_t frame, const DrawList& list);
+	bool IsMultiDrawSupported();
+	// The counts of the last frame uploaded before the current one
+	IndirectRendererStats GetStats() const;
+	static const int FrameCount = FramePipeline::Latency + 1;
+private:
+	struct FrameBuffers
+	{
+		std::uint32_t commandBuffer = 0;
+		std::size_t commandCapacity = 0;
+		std::uint32_t transformBuffer = 0;
+		std::size_t transformCapacity = 0;
+	};
+	FrameBuffers frames[FrameCount];
+	IndirectRendererStats stats;
+	IndirectRendererStats lastFrameStats;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "FrustumCuller.hpp"
+
+struct LodSelectorStats
+{
+	std::size_t objects = 0;
+	// Objects which got a different level than they had last frame
+	std::size_t changes = 0;
+	// How many objects of the batch ended up at each level
+	std::size_t levelCounts[8] = {};
+	double milliseconds = 0.0;
+};
+
+// Picks which level of detail each visible object is drawn with.
+// Every level of an object comes with a geometric error: how far, in world units, its surface may be from the finest
+// Level's. Projected onto the screen, that error is how many pixels the level is off by. The coarsest level whose
+// Error stays below PixelThreshold pixels is picked.
+// To keep objects near a threshold from switching back and forth each frame, an object only goes coarser once the
+// Coarser level is clearly below the threshold, and only goes finer once its current level is clearly above it.
+// The visible objects of a frame are added to a batch, which Select goes through 4 objects at a time with SSE.
+// The quality bias scales the threshold: above 1 trades detail for speed, below 1 the other way around.
+class LodSelector
+{
+public:
+	LodSelector();
+	// levelErrors has one entry per level, finest first, and has to be increasing. Returns the object's id.
+	std::uint32_t Register(const float* levelErrors, int levelCount);
+	void Unregister(std::uint32_t object);
+	void SetCamera(const glm::vec3& position, float fieldOfViewY, float viewportHeight);
+	void SetQualityBias(float bias);
+	float GetQualityBias() const;
+	// Starts a new batch
+	void Clear();
+	void Add(std::uint32_t object, const BoundingVolume& bounds);
+	// Picks the level of every object in the batch
+	void Select();
+	int GetLevel(std::uint32_t object) const;
+	// The counts of the last call to Select
+	LodSelectorStats GetStats() const;
+	static const int MaxLevels = 8;
+	static const float PixelThreshold;
+	// How far past the threshold the error has to be before an object switches levels, relative to the threshold
+	static const float Hysteresis;
+private:
+	void PadBatch();
+	glm::vec3 cameraPosition;
+	// Pixels per world unit, at a distance of one world unit
+	float projectionScale;
+	float qualityBias;
+	// Per object, levelErrors holds MaxLevels entries, the ones past the object's last level being unreachable
+	std::vector<float> levelErrors;
+	std::vector<int> levels;
+	std::vector<std::uint32_t> freeObjects;
+	// The batch, in structure-of-arrays form
+	std::vector<std::uint32_t> batchObjects;
+	std::vector<float> batchX;
+	std::vector<float> batchY;
+	std::vector<float> batchZ;
+	std::vector<float> batchRadius;
+	std::vector<std::int32_t> batchLevels;
+	std::vector<float> batchErrors[MaxLevels];
+	std::size_t batchCount;
+	LodSelectorStats stats;
+};
@@ -15,6 +15,9 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <algorithm>
+#include <limits>
 #include <fstream>
 #include <cassert> // For assert
 #include <sstream> // For stringstream
@@ -28,29 +31,98 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Shader.h"
+#include "Texture.hpp"
+#include "TextureCache.hpp"
+#include "UploadScheduler.hpp"
+#include "TextureStreamer.hpp"
+#include "VirtualTextureSystem.hpp"
+#include "FrameUniforms.hpp"
+#include "StreamingBuffer.hpp"
+#include "Frustum.hpp"
+#include "FrustumCuller.hpp"
+#include "SpatialIndex.hpp"
+#include "OcclusionCuller.hpp"
+#include "LodSelector.hpp"
+#include "TransformStore.hpp"
+#include "GeometryBuffer.hpp"
+#include "DrawList.hpp"
+#include "RenderDevice.hpp"
+
+// A level of detail of a mesh: a range of its indices, drawn with the same vertices as every other level.
+// The error is how far, in world units, the level's surface may be from the finest level's.
+struct MeshLod
+{
+	std::size_t firstIndex;
+	std::size_t indexCount;
+	float error;
+};
 
 class Mesh
 {
 public:
 	explicit Mesh(std::string filepath);
+	~Mesh();
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	// Loads several meshes at once. Their textures are decoded together as one batch.
+	static std::vector<std::unique_ptr<Mesh>> LoadScene(const std::vector<std::string>& filepaths);
 	std::string GetTexturePath() const;
 	std::vector<float> GetVertices() const;
 	std::vector<unsigned> GetIndices() const;
 	unsigned GetTextureObject() const;
-	void Draw(Shader shader);
+	// Adds a draw of this mesh to the list instead of drawing it right away, see IndirectRenderer
+	void Submit(DrawList& list);
+	// For drawing the same mesh many times in one draw call. Writes the transforms of the instances inside the
+	// Frustum into StreamingBuffer::Instances(), and returns how many that were.
+	// Has to be called once per frame, before DrawInstanced. The mesh's own position is not used.
+	std::size_t SubmitInstances(const std::vector<glm::mat4>& transforms, const Frustum& frustum);
+	// Draws the instances submitted this frame with the active shader. It takes their transforms from the
+	// Vertex attributes at GeometryBuffer::InstanceAttributeLocation, like instancedvertex.glsl.
+	void DrawInstanced();
 	void SetPosition(float x, float y, float z);
+	// Where the mesh is right now, for culling
+	BoundingVolume GetWorldBounds() const;
+	// Puts the mesh into index, which SetPosition keeps up to date from then on. The index has to outlive the mesh.
+	void AddToIndex(SpatialIndex& index, std::uint32_t payload);
+	// Rasterizes the mesh into the culler's depth buffer, hiding what's behind it. Best kept to large, simple meshes.
+	void SubmitOccluder(OcclusionCuller& culler);
+	// Lets selector pick which level of detail the mesh is drawn with. The selector has to outlive the mesh.
+	void AddToLodSelector(LodSelector& selector);
+	// Adds the mesh to the selector's batch of this frame. Has to be called before LodSelector::Select.
+	void RequestLod(const BoundingVolume& bounds);
 private:
-	glm::mat4 modelMatrix;
+	// Our position lives in TransformStore::Global(), which composes the model matrix only when it changes
+	std::uint32_t transform;
 	void LoadMesh(std::string filepath);
+	glm::mat4 GetModelMatrix() const;
+	void CalculateBounds();
+	const MeshLod& GetCurrentLod() const;
 	void GenerateTexture();
 	void UploadVertexData();
 	std::vector<float> vertices;
 	std::vector<unsigned> indices;
 	std::string texturePath;
-	unsigned textureObject;
-	unsigned int vao;
-	unsigned int ebo;
-	unsigned int vbo;
+	std::string mipPath;
+	std::string supercompressedPath;
+	std::string virtualTexturePath;
+	std::vector<unsigned char> embeddedTexture;
+	float boundsRadius;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	std::shared_ptr<Texture> texture;
+	std::shared_ptr<VirtualTexture> virtualTexture;
+	GeometryAllocation geometry;
+	bool vertexDataResident;
+	bool indexDataResident;
+	SpatialIndex* spatialIndex;
+	std::uint32_t spatialHandle;
+	// Finest first. Assets without levels of detail have a single one, covering every index.
+	std::vector<MeshLod> lods;
+	LodSelector* lodSelector;
+	std::uint32_t lodObject;
+	std::vector<glm::mat4> visibleInstances;
+	std::size_t instanceOffset;
+	std::size_t instanceCount;
 	float pos_x;
 	float pos_y;
 	float pos_z;
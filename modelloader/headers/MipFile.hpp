@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reader for the .beaglemips files written by the asset importer.
+// They store every mip level of a texture uncompressed, along with a table of where each level starts,
+// So a single level can be read without touching the rest of the file:
+// -- "BMIP", version, width, height, channel count and level count, all as 32-bit unsigned integers
+// -- For each level (level 0 first): a 64-bit byte offset into the file, and a 64-bit byte size
+// -- The pixel data of all levels
+// Open rejects files whose levels aren't where, or as large as, the header says.
+// ReadLevel opens its own stream, so levels can be read from several threads at once. It returns nothing if the level
+// Doesn't exist or can't be read.
+class MipFile
+{
+public:
+	bool Open(const std::string& filepath);
+	std::vector<unsigned char> ReadLevel(int level) const;
+	const std::string& GetPath() const;
+	int GetWidth() const;
+	int GetHeight() const;
+	int GetChannelCount() const;
+	int GetLevelCount() const;
+private:
+	std::string path;
+	int width = 0;
+	int height = 0;
+	int nrChannels = 0;
+	std::vector<std::uint64_t> offsets;
+	std::vector<std::uint64_t> sizes;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+// Building mip levels on the CPU, shared with the asset importer, so the levels it writes to .beaglemips and
+// .beagletex files are made exactly like the ones MipChain::Build makes at runtime. Nothing here touches OpenGL.
+
+// Each level is half the size of the previous one (rounded down, but never less than 1), down to a single texel
+int MipLevelSize(int size, int level);
+int MipLevelCount(int width, int height);
+
+// Writes the level after the one given into next, which must have room for
+// MipLevelSize(width, 1) * MipLevelSize(height, 1) * nrChannels bytes.
+// Every texel is the average of a 2x2 block of the previous level. For odd sizes the last row / column is clamped.
+void Downsample(const unsigned char* pixels, int width, int height, int nrChannels, unsigned char* next);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+// Lock-free, unbounded, multiple producer / single consumer queue.
+// Any number of threads can Push concurrently, but only a single thread may call TryPop.
+// It is a linked list where producers atomically swap themselves in as the newest node,
+// And the consumer walks from the oldest node. The consumer always holds on to one already
+// Consumed "stub" node, which is what allows Push and TryPop to never touch the same node pointer.
+// (Dmitry Vyukov's intrusive MPSC queue)
+template <typename T>
+class MpscQueue
+{
+public:
+	MpscQueue()
+	{
+		const auto stub = new Node{};
+		newest.store(stub, std::memory_order_relaxed);
+		oldest = stub;
+	}
+
+	~MpscQueue()
+	{
+		T discarded;
+		while (TryPop(discarded)) {}
+		delete oldest;
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	void Push(T value)
+	{
+		const auto node = new Node{};
+		node->value = std::move(value);
+
+		// After the exchange our node is the newest one, but it isn't linked into the list until
+		// We set the next pointer of the previous newest node. Until then the consumer simply sees
+		// The queue as ending at the previous node.
+		const auto previous = newest.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	bool TryPop(T& value)
+	{
+		const auto stub = oldest;
+		const auto next = stub->next.load(std::memory_order_acquire);
+
+		if (next == nullptr)
+			return false;
+
+		// The popped node becomes the new stub
+		value = std::move(next->value);
+		oldest = next;
+		delete stub;
+
+		return true;
+	}
+
+private:
+	struct Node
+	{
+		std::atomic<Node*> next{ nullptr };
+		T value{};
+	};
+
+	std::atomic<Node*> newest;
+	Node* oldest;
+};
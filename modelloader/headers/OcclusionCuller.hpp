@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "FrustumCuller.hpp"
+#include "ThreadPool.hpp"
+
+struct OcclusionCullerStats
+{
+	std::size_t occluders = 0;
+	std::size_t triangles = 0;
+	std::size_t trianglesRasterized = 0;
+	// Triangles crossing the near plane. They would have to be clipped, and are left out instead.
+	std::size_t trianglesSkipped = 0;
+	std::size_t tested = 0;
+	std::size_t occluded = 0;
+	// How many pieces the rasterization was split into, each done on its own thread
+	std::size_t jobs = 0;
+	double rasterizeMilliseconds = 0.0;
+	double testMilliseconds = 0.0;
+};
+
+// Hides objects behind large meshes like walls, entirely on the CPU.
+// The occluders of a frame are rasterized into a small depth buffer, which is split into tiles. The triangles are
+// Sorted into the tiles they touch first, then each tile is rasterized on its own, spread over a ThreadPool. Within a
+// Tile, SSE fills 4 pixels at once. Each tile also keeps the nearest and furthest depth in it, so most tests of an
+// Object are decided by those alone.
+// An object is tested with its bounding box: the nearest corner of the box is compared against the depth buffer
+// In the rectangle the box covers on screen. Only if every pixel there is nearer than that corner is it hidden.
+// Everything here errs on the side of visible. Triangles crossing the near plane aren't drawn, and boxes crossing it
+// Always pass.
+// Per frame: BeginFrame, AddOccluder for each occluder, Rasterize, then test.
+class OcclusionCuller
+{
+public:
+	explicit OcclusionCuller(ThreadPool& workers = ThreadPool::Global());
+	OcclusionCuller(const OcclusionCuller&) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+	// Clears the depth buffer. Takes projection * view, the same matrix vertices are transformed by.
+	void BeginFrame(const glm::mat4& viewProjection);
+	// Positions are the first 3 floats of each vertex, and stride is the number of floats per vertex.
+	// The data is read during Rasterize, so it has to stay around until then.
+	void AddOccluder(const float* vertices, std::size_t stride, const unsigned* indices, std::size_t indexCount, const glm::mat4& transform);
+	void Rasterize();
+	bool IsVisible(const BoundingVolume& bounds) const;
+	// Removes the payloads of hidden objects from visible, keeping the order of the rest. The bounds of an object are
+	// Looked up by its payload.
+	void Cull(std::vector<std::uint32_t>& visible, const std::vector<BoundingVolume>& bounds);
+	// The counts of the last finished frame
+	OcclusionCullerStats GetStats() const;
+	static const int Width = 256;
+	static const int Height = 128;
+	static const int TileWidth = 32;
+	static const int TileHeight = 16;
+	// Below this many objects, Cull doesn't split the tests over the workers
+	static const std::size_t ParallelThreshold = 1024;
+private:
+	struct Occluder
+	{
+		const float* vertices;
+		std::size_t stride;
+		const unsigned* indices;
+		std::size_t indexCount;
+		glm::mat4 transform;
+	};
+	// A triangle in pixels, with depth from 0 (near) to 1 (far)
+	struct ScreenTriangle
+	{
+		glm::vec3 vertices[3];
+	};
+	static const int TilesX = Width / TileWidth;
+	static const int TilesY = Height / TileHeight;
+	void BinTriangles();
+	void RasterizeTile(int tile);
+	void RasterizeTriangle(const ScreenTriangle& triangle, int tile);
+	glm::mat4 viewProjection;
+	std::vector<Occluder> occluders;
+	std::vector<ScreenTriangle> triangles;
+	std::vector<std::vector<std::uint32_t>> tileTriangles;
+	// Stored tile by tile, each tile row by row
+	std::vector<float> depth;
+	std::vector<float> tileNearest;
+	std::vector<float> tileFurthest;
+	std::vector<std::uint8_t> testResults;
+	OcclusionCullerStats stats;
+	OcclusionCullerStats lastFrameStats;
+	ThreadPool& workers;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct OffsetAllocation
+{
+	static const std::uint32_t NoSpace = 0xffffffff;
+
+	std::uint32_t offset = NoSpace;
+	// Identifies the allocation to the allocator, so it can be freed without searching for it
+	std::uint32_t node = NoSpace;
+
+	bool IsValid() const { return offset != NoSpace; }
+};
+
+struct OffsetAllocatorStats
+{
+	std::uint32_t size = 0;
+	std::uint32_t allocations = 0;
+	std::uint32_t freeSpace = 0;
+	std::uint32_t largestFreeRegion = 0;
+	std::uint32_t freeRegions = 0;
+	// 0 when all free space is one region, close to 1 when it is scattered over many small ones
+	float fragmentation = 0.0f;
+};
+
+// Hands out ranges of a linear space of a given size, like a buffer of vertices, in units chosen by the caller.
+// It only does bookkeeping and never touches the memory itself, so it works for GPU buffers as well as anything else.
+// Two level segregated fit (TLSF): free ranges are kept in bins by size, each bin covering a range of sizes
+// An eighth of a power of two wide. A bitmask of non-empty bins finds a free range large enough in a couple of
+// Bit scans, so both Allocate and Free take constant time, no matter how many ranges there are.
+// Freed ranges are merged with free neighbours right away.
+// Allocate only takes ranges from bins whose smallest size is large enough, so a free range that would just fit
+// Can be passed over if it shares a bin with larger ones. That's the price of never searching through a bin.
+class OffsetAllocator
+{
+public:
+	explicit OffsetAllocator(std::uint32_t size);
+	// Returns an invalid allocation if there is no free range large enough
+	OffsetAllocation Allocate(std::uint32_t size);
+	void Free(OffsetAllocation allocation);
+	// Makes the space larger. Existing allocations stay where they are.
+	void Grow(std::uint32_t newSize);
+	std::uint32_t GetSize() const;
+	std::uint32_t AllocationSize(OffsetAllocation allocation) const;
+	OffsetAllocatorStats GetStats() const;
+
+	static const std::uint32_t SecondLevelBits = 3;
+	static const std::uint32_t BinsPerLevel = 1 << SecondLevelBits;
+	static const std::uint32_t LevelCount = 32;
+	static const std::uint32_t BinCount = LevelCount * BinsPerLevel;
+private:
+	static const std::uint32_t None = 0xffffffff;
+
+	struct Node
+	{
+		std::uint32_t offset;
+		std::uint32_t size;
+		// The other free nodes in the same bin
+		std::uint32_t binPrevious;
+		std::uint32_t binNext;
+		// The nodes right before and after this one in the space, free or not
+		std::uint32_t neighbourPrevious;
+		std::uint32_t neighbourNext;
+		bool used;
+	};
+
+	static std::uint32_t BinRoundedDown(std::uint32_t size);
+	static std::uint32_t BinRoundedUp(std::uint32_t size);
+	std::uint32_t FindBin(std::uint32_t minimumBin) const;
+	void AddToBin(std::uint32_t node);
+	void RemoveFromBin(std::uint32_t node);
+	std::uint32_t NewNode(std::uint32_t offset, std::uint32_t size);
+	void ReleaseNode(std::uint32_t node);
+
+	std::uint32_t size;
+	std::uint32_t allocations;
+	std::uint32_t freeSpace;
+	// Bit n is set if level n has a non-empty bin
+	std::uint32_t usedLevels;
+	// Bit n of level l is set if bin n of level l is non-empty
+	std::uint8_t usedBins[LevelCount];
+	std::uint32_t binHeads[BinCount];
+	std::vector<Node> nodes;
+	std::vector<std::uint32_t> unusedNodes;
+	// The node at the end of the space
+	std::uint32_t lastNode;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <vector>
+#include <unordered_map>
+
+// Identifies one page of a virtual texture: which virtual texture, which mip level, and which page of that level.
+// It packs into 32 bits, so it makes a cheap key, and the feedback pass can write it into a single RGBA8 pixel.
+struct PageId
+{
+	int textureId;
+	int level;
+	int x;
+	int y;
+
+	std::uint32_t Pack() const;
+	static PageId Unpack(std::uint32_t packed);
+	// The page one level coarser which covers this one
+	PageId Parent() const;
+	bool operator==(const PageId& other) const;
+	bool operator!=(const PageId& other) const;
+	static const int MaxTextureId = 15;
+	static const int MaxLevel = 15;
+	static const int MaxCoordinate = 4095;
+};
+
+// The physical page cache decides which page lives in which slot of the page atlas on the GPU.
+// It doesn't touch OpenGL itself, so all of its decisions can be checked without a GPU.
+// Slots are handed out free ones first, and then by evicting the least recently used page.
+// Pages used during the current frame are never evicted, as they would only be requested again right away,
+// And pinned pages (the single page of each virtual texture's coarsest level, which every other page
+// Falls back on) are never evicted at all.
+class PageCache
+{
+public:
+	struct Insertion
+	{
+		// The slot the page was given, or -1 if every slot is pinned or in use this frame
+		int slot = -1;
+		bool evicted = false;
+		PageId evictedPage{};
+	};
+	explicit PageCache(int slotCount);
+	void BeginFrame(std::uint64_t frame);
+	// The slot holding the page, or -1 if it isn't resident
+	int Find(PageId page) const;
+	// Marks a resident page as used this frame
+	void Touch(PageId page);
+	Insertion Insert(PageId page, bool pinned);
+	// Frees the slots of every page of a virtual texture, pinned or not
+	void RemoveTexture(int textureId);
+	int GetSlotCount() const;
+	int GetResidentCount() const;
+private:
+	struct Slot
+	{
+		PageId page{};
+		bool occupied = false;
+		bool pinned = false;
+		std::uint64_t lastUsedFrame = 0;
+		// Where the slot is in the recency list. Only meaningful for occupied slots which aren't pinned.
+		std::list<int>::iterator recencyPosition;
+	};
+	void Free(int slot);
+	std::vector<Slot> slots;
+	// Slots holding pages which can be evicted, least recently used first
+	std::list<int> recency;
+	std::vector<int> freeSlots;
+	std::unordered_map<std::uint32_t, int> slotOfPage;
+	std::uint64_t frame;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "PageCache.hpp"
+#include "VirtualTextureFile.hpp"
+
+// A page the feedback pass saw being sampled, and on how many of its pixels
+struct PageRequest
+{
+	PageId page;
+	std::size_t pixelCount;
+};
+
+// The feedback pass renders the scene at a low resolution with feedback.glsl, which writes the page each
+// Pixel would sample instead of a color. This reads those pixels back into page requests.
+// Each pixel packs a PageId: red and the low half of green hold x, the high half of green and blue hold y,
+// And alpha holds the virtual texture id times 16 plus the level. Pixels without a virtual texture have an alpha of 0.
+class PageFeedback
+{
+public:
+	static bool DecodePixel(const unsigned char* rgba, PageId& page);
+	// Every page requested by at least one pixel, along with how many pixels asked for it
+	static std::vector<PageRequest> Analyze(const unsigned char* rgba, std::size_t pixelCount);
+};
+
+// Turns the pages the feedback pass asked for into the order they should be loaded in.
+// Until a page is resident, the page table falls back to coarser pages. So instead of a requested page itself,
+// We queue its coarsest ancestor that isn't resident yet: the texture sharpens one level at a time, and
+// Every load improves what is on screen right away. Coarser pages go first, and among pages of the same level
+// The ones covering the most pixels. The coarsest page of every virtual texture is always asked for, since
+// Everything else falls back on it.
+// Resident pages along the way are touched in the cache, so the pages on screen are the last to be evicted.
+// Requests are replaced every frame, so pages which went off screen before they were loaded are dropped.
+class PageRequestQueue
+{
+public:
+	void AddTexture(int textureId, const VirtualTextureLayout& layout);
+	void RemoveTexture(int textureId);
+	void Submit(const std::vector<PageRequest>& requests, PageCache& cache);
+	// The most important page not yet resident or being loaded. Returns false if there is none.
+	// The page counts as being loaded until Complete is called for it.
+	bool Pop(PageId& page);
+	void Complete(PageId page);
+	bool IsCoarsestLevel(PageId page) const;
+	std::size_t GetQueuedCount() const;
+	std::size_t GetLoadingCount() const;
+private:
+	bool IsValid(PageId page) const;
+	std::unordered_map<int, VirtualTextureLayout> layouts;
+	std::vector<PageRequest> queue;
+	std::size_t nextRequest = 0;
+	std::unordered_set<std::uint32_t> loading;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include "VirtualTextureFile.hpp"
+
+// The page table of one virtual texture maps every page, at every level, to the atlas slot it is sampled from.
+// Pages which aren't resident fall back to the nearest resident page covering them at a coarser level,
+// So the table always points at something valid once the coarsest page is in, just blurrier.
+// Map and Unmap only record which pages are resident. Update then resolves the fallbacks again, for the
+// Coarsest level that changed and every level below it, as those are the only ones that can be affected.
+// Like the PageCache, the page table doesn't touch OpenGL, so it can be checked without a GPU.
+class PageTable
+{
+public:
+	struct Entry
+	{
+		// -1 if not even the coarsest page is resident yet
+		int slot;
+		// The level of the page the slot holds
+		int level;
+	};
+	explicit PageTable(const VirtualTextureLayout& layout);
+	void Map(int level, int x, int y, int slot);
+	void Unmap(int level, int x, int y);
+	bool IsMapped(int level, int x, int y) const;
+	// Returns the coarsest level whose entries changed, or -1 if none did.
+	// The levels from there down to level 0 have to be uploaded again.
+	int Update();
+	const Entry& Resolve(int level, int x, int y) const;
+	// The table is uploaded as a mipmapped texture. Its level 0 is as many texels across as the next power of
+	// Two above the number of pages, so each following level is exactly half the size, like the page grid.
+	int GetTableWidth(int level) const;
+	int GetTableHeight(int level) const;
+	// Writes a level as RGBA8 texels: the slot's column and row in the atlas, and the level the slot holds.
+	// Alpha is 0 for entries with nothing resident.
+	void WriteTexels(int level, int atlasSlotsPerRow, std::vector<unsigned char>& texels) const;
+	int GetLevelCount() const;
+private:
+	VirtualTextureLayout layout;
+	// Per level, row by row. The slot of each page which is itself resident, or -1.
+	std::vector<std::vector<int>> mappedSlots;
+	std::vector<std::vector<Entry>> resolved;
+	int tableWidth;
+	int tableHeight;
+	// The coarsest level changed since the last update, or -1
+	int dirtyLevel;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+// Inspecting and converting decoded pixels, shared with the asset importer, so the .beaglemips files it writes
+// Keep the same channels the runtime keeps for the source images it decodes itself. Nothing here touches OpenGL.
+// Channel counts follow stb_image: 1 = grey, 2 = grey + alpha, 3 = RGB, 4 = RGBA.
+
+// Returns the fewest channels the pixels can be stored in without losing anything:
+// -- Alpha which is 255 everywhere is dropped
+// -- Color where red, green and blue are equal everywhere is stored as a single grey channel
+int MinimalChannelCount(const unsigned char* pixels, std::size_t pixelCount, int nrChannels);
+
+// Converts pixels between the channel layouts. Grey is taken from the red channel when
+// Dropping color, which is only lossless if MinimalChannelCount said so.
+// The destination must have room for pixelCount * toChannels bytes.
+void ConvertChannels(const unsigned char* pixels, std::size_t pixelCount, int fromChannels, int toChannels, unsigned char* converted);
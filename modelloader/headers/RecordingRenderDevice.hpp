@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderDevice.hpp"
+
+// What a RecordingRenderDevice writes into its stream, one per call which reached the device
+enum class RecordedCommand : std::uint8_t
+{
+	CreateBuffer,
+	UpdateBuffer,
+	DeleteBuffer,
+	CreateTexture,
+	UpdateTexture,
+	DeleteTexture,
+	CreateProgram,
+	DeleteProgram,
+	UseProgram,
+	BindVertexArray,
+	BindBuffer,
+	BindUniformBuffer,
+	BindTexture,
+	SetVertexAttribute,
+	SetViewport,
+	SetDepthTest,
+	Clear,
+	DrawIndexed,
+	MultiDrawIndexedIndirect,
+	Count
+};
+
+struct RecordingStats
+{
+	std::size_t commands = 0;
+	std::size_t streamBytes = 0;
+	std::size_t commandCounts[static_cast<int>(RecordedCommand::Count)] = {};
+};
+
+// A RenderDevice without a GPU. Every call is written into a stream of 32-bit words in memory, so the code
+// Submitting draws can run, and be measured, anywhere. Nothing here touches OpenGL.
+// State calls which wouldn't change anything are filtered the same way GLState filters them for OpenGL, so the
+// Stream holds what the GL device would actually issue.
+// Each command is a header word, with the RecordedCommand in the low 8 bits and the number of argument words
+// Following it in the rest. Sizes and offsets take two words, low half first. Data uploaded with a command is only
+// Kept if asked for, padded to a whole number of words after the other arguments. Otherwise only its size is.
+// The stream is started over every frame. The one of the last finished frame stays around to be inspected.
+class RecordingRenderDevice : public RenderDevice
+{
+public:
+	explicit RecordingRenderDevice(bool multiDrawIndirect = true, bool keepData = false);
+	RecordingRenderDevice(const RecordingRenderDevice&) = delete;
+	RecordingRenderDevice& operator=(const RecordingRenderDevice&) = delete;
+	void BeginFrame() override;
+	std::uint32_t CreateBuffer(BufferTarget target, std::size_t bytes, const void* data, BufferUsage usage) override;
+	void UpdateBuffer(std::uint32_t buffer, std::size_t offset, std::size_t bytes, const void* data) override;
+	void DeleteBuffer(std::uint32_t buffer) override;
+	std::uint32_t CreateTexture(int width, int height, int levelCount) override;
+	void UpdateTexture(std::uint32_t texture, int level, int x, int y, int width, int height, const void* pixels) override;
+	void DeleteTexture(std::uint32_t texture) override;
+	std::uint32_t CreateProgram(const std::string& vertexSource, const std::string& fragmentSource) override;
+	void DeleteProgram(std::uint32_t program) override;
+	void UseProgram(std::uint32_t program) override;
+	void BindVertexArray(std::uint32_t vertexArray) override;
+	void BindBuffer(BufferTarget target, std::uint32_t buffer) override;
+	void BindUniformBuffer(std::uint32_t index, std::uint32_t buffer, std::size_t offset, std::size_t bytes) override;
+	void BindTexture(std::uint32_t unit, std::uint32_t texture) override;
+	void SetVertexAttribute(std::uint32_t location, int components, std::size_t stride, std::uint32_t buffer, std::size_t offset) override;
+	void SetViewport(int x, int y, int width, int height) override;
+	void SetDepthTest(bool enabled) override;
+	void Clear(const glm::vec4& color) override;
+	void DrawIndexed(std::uint32_t indexCount, std::uint32_t firstIndex, std::int32_t baseVertex, std::uint32_t instanceCount) override;
+	void MultiDrawIndexedIndirect(std::uint32_t buffer, std::size_t offset, std::uint32_t drawCount) override;
+	bool SupportsMultiDrawIndirect() override;
+	RenderDeviceStats GetStats() const override;
+	// The commands and stream size of the last finished frame
+	RecordingStats GetRecordingStats() const;
+	const std::vector<std::uint32_t>& GetLastFrame() const;
+	// Forgets every binding, so the next state calls are recorded whether they change anything or not.
+	// For streams which are replayed after other ones, whose state this device knows nothing about.
+	void ResetState();
+	// Reads the command starting at position in a stream, and returns where the next one starts
+	static std::size_t ReadCommand(const std::vector<std::uint32_t>& stream, std::size_t position, RecordedCommand& command,
+		const std::uint32_t*& arguments, std::uint32_t& argumentCount);
+	// Issues the commands of a stream on another device. Only streams without Create* commands can be replayed, as the
+	// Handles those return are made up. Uploads are skipped unless the stream was recorded with keepData.
+	static void Replay(const std::vector<std::uint32_t>& stream, RenderDevice& device);
+private:
+	// What we remember for bindings we know nothing about, which never matches a real handle
+	static const std::uint32_t Unknown = 0xffffffff;
+	struct BufferRange
+	{
+		std::uint32_t buffer;
+		std::size_t offset;
+		std::size_t bytes;
+	};
+	struct VertexAttribute
+	{
+		int components;
+		std::size_t stride;
+		std::uint32_t buffer;
+		std::size_t offset;
+	};
+	// Starts a command, the arguments are pushed right after
+	void Begin(RecordedCommand command);
+	void End();
+	void Push(std::uint32_t word);
+	void PushSize(std::size_t value);
+	void PushData(const void* data, std::size_t bytes);
+	bool Filter(std::uint32_t& current, std::uint32_t value);
+	bool multiDrawIndirect;
+	bool keepData;
+	std::vector<std::uint32_t> stream;
+	std::vector<std::uint32_t> lastFrameStream;
+	std::size_t commandStart;
+	std::uint32_t nextHandle;
+	std::unordered_map<std::uint32_t, std::size_t> bufferSizes;
+	std::unordered_map<std::uint32_t, glm::ivec2> textureSizes;
+	std::uint32_t program;
+	std::uint32_t vertexArray;
+	std::uint32_t buffers[static_cast<int>(BufferTarget::Count)];
+	std::vector<BufferRange> uniformBuffers;
+	std::vector<std::uint32_t> textures;
+	std::vector<VertexAttribute> attributes;
+	glm::ivec4 viewport;
+	int depthTest;
+	RenderDeviceStats stats;
+	RenderDeviceStats lastFrameStats;
+	RecordingStats recordingStats;
+	RecordingStats lastFrameRecordingStats;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <glm/glm.hpp>
+
+enum class BufferTarget
+{
+	Vertex,
+	Index,
+	Uniform,
+	Indirect,
+	Count
+};
+
+enum class BufferUsage
+{
+	// Written once, drawn many times
+	Static,
+	// Written now and then
+	Dynamic,
+	// Written every frame
+	Stream
+};
+
+struct RenderDeviceStats
+{
+	std::size_t drawCalls = 0;
+	// Draws issued through the draw calls, more than one per multi-draw call
+	std::size_t draws = 0;
+	// Triangles of multi-draws aren't counted, as their index counts are in a buffer
+	std::size_t triangles = 0;
+	// State calls which reached the device, and those dropped because they wouldn't have changed anything
+	std::size_t stateChanges = 0;
+	std::size_t stateChangesFiltered = 0;
+	std::size_t bufferBytesUploaded = 0;
+	std::size_t textureBytesUploaded = 0;
+};
+
+// Everything the renderer asks of the graphics API, so the code deciding what to draw doesn't have to know which
+// API it is talking to. GLRenderDevice talks to OpenGL, and RecordingRenderDevice writes every call into a stream
+// In memory instead, so draw submission can run and be measured on machines without a GPU.
+// Objects are referred to by handles, which are only meaningful to the device which created them. 0 is never a
+// Valid handle, and binding 0 unbinds. Textures are 2D RGBA8, which is all the renderer uses.
+// Vertex arrays are still created by the GeometryBuffer, so their handles are OpenGL names for now.
+class RenderDevice
+{
+public:
+	// The device the renderer draws through. Has to be set before anything is drawn.
+	static RenderDevice& Global();
+	static void SetGlobal(RenderDevice* device);
+	virtual ~RenderDevice() = default;
+	// Starts counting for a new frame
+	virtual void BeginFrame() = 0;
+	virtual std::uint32_t CreateBuffer(BufferTarget target, std::size_t bytes, const void* data, BufferUsage usage) = 0;
+	virtual void UpdateBuffer(std::uint32_t buffer, std::size_t offset, std::size_t bytes, const void* data) = 0;
+	virtual void DeleteBuffer(std::uint32_t buffer) = 0;
+	virtual std::uint32_t CreateTexture(int width, int height, int levelCount) = 0;
+	virtual void UpdateTexture(std::uint32_t texture, int level, int x, int y, int width, int height, const void* pixels) = 0;
+	virtual void DeleteTexture(std::uint32_t texture) = 0;
+	// Returns 0 if the program failed to compile or link
+	virtual std::uint32_t CreateProgram(const std::string& vertexSource, const std::string& fragmentSource) = 0;
+	virtual void DeleteProgram(std::uint32_t program) = 0;
+	virtual void UseProgram(std::uint32_t program) = 0;
+	virtual void BindVertexArray(std::uint32_t vertexArray) = 0;
+	virtual void BindBuffer(BufferTarget target, std::uint32_t buffer) = 0;
+	virtual void BindUniformBuffer(std::uint32_t index, std::uint32_t buffer, std::size_t offset, std::size_t bytes) = 0;
+	virtual void BindTexture(std::uint32_t unit, std::uint32_t texture) = 0;
+	// Points a float vertex attribute of the bound vertex array at a buffer
+	virtual void SetVertexAttribute(std::uint32_t location, int components, std::size_t stride, std::uint32_t buffer, std::size_t offset) = 0;
+	virtual void SetViewport(int x, int y, int width, int height) = 0;
+	virtual void SetDepthTest(bool enabled) = 0;
+	// Clears color and depth
+	virtual void Clear(const glm::vec4& color) = 0;
+	// Draws triangles from the bound vertex array. Indices are 32-bit, firstIndex counts indices, not bytes.
+	virtual void DrawIndexed(std::uint32_t indexCount, std::uint32_t firstIndex, std::int32_t baseVertex, std::uint32_t instanceCount) = 0;
+	// Draws drawCount DrawCommands (see DrawList.hpp) read from a buffer, starting at offset bytes into it.
+	// Only available if SupportsMultiDrawIndirect returns true.
+	virtual void MultiDrawIndexedIndirect(std::uint32_t buffer, std::size_t offset, std::uint32_t drawCount) = 0;
+	virtual bool SupportsMultiDrawIndirect() = 0;
+	// The counts of the last finished frame
+	virtual RenderDeviceStats GetStats() const = 0;
+};
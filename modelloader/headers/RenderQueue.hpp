@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Packs the state a draw needs into 64 bits, most expensive state to change in the highest bits. Sorting draws by
+// Their keys groups draws sharing a pass, then a shader, then a texture and so on, so the state only changes when
+// It has to. Within the same state, draws are ordered by depth, front to back.
+// From the highest bits down:
+// -- Pass (4 bits)
+// -- Shader (10 bits)
+// -- Texture (16 bits)
+// -- Vertex array (12 bits)
+// -- Depth bucket (22 bits)
+// OpenGL names are small numbers handed out in order, so they are packed as they are. Pack asserts they fit.
+struct RenderKey
+{
+	enum Field : std::uint32_t
+	{
+		Pass = 1 << 0,
+		Shader = 1 << 1,
+		Texture = 1 << 2,
+		VertexArray = 1 << 3,
+		Depth = 1 << 4,
+	};
+
+	static const int PassBits = 4;
+	static const int ShaderBits = 10;
+	static const int TextureBits = 16;
+	static const int VertexArrayBits = 12;
+	static const int DepthBits = 22;
+
+	static const int DepthShift = 0;
+	static const int VertexArrayShift = DepthShift + DepthBits;
+	static const int TextureShift = VertexArrayShift + VertexArrayBits;
+	static const int ShaderShift = TextureShift + TextureBits;
+	static const int PassShift = ShaderShift + ShaderBits;
+
+	static std::uint64_t Pack(std::uint32_t pass, std::uint32_t shader, std::uint32_t texture, std::uint32_t vertexArray, std::uint32_t depth);
+	static std::uint32_t Get(std::uint64_t key, Field field);
+	// The fields which differ between the two keys, as a mask of Field bits
+	static std::uint32_t ChangedFields(std::uint64_t a, std::uint64_t b);
+	// Quantizes a distance along the view direction between near and far into DepthBits bits.
+	// The buckets are spaced logarithmically, so nearby draws are told apart as well as far away ones.
+	static std::uint32_t DepthBucket(float viewDepth, float nearPlane, float farPlane);
+};
+
+struct RenderQueueEntry
+{
+	std::uint64_t key;
+	// Identifies the draw to whoever submitted it, usually an index into their own array of draws
+	std::uint32_t payload;
+};
+
+struct RenderQueueStats
+{
+	std::size_t entries = 0;
+	// Changes of pass, shader, texture or vertex array between consecutive entries, each field counted separately
+	std::size_t stateChanges = 0;
+	// How many more there would have been, drawing in the order things were submitted
+	std::size_t stateChangesAvoided = 0;
+	double sortMilliseconds = 0.0;
+};
+
+// Draws are submitted with a RenderKey and a payload, sorted by key, then read back in order.
+// Sorting is a least significant digit radix sort, 8 bits per pass. It takes linear time, and skips the passes
+// For bytes which are the same in every key, which is common as most frames only use a few passes and shaders.
+// Doesn't touch OpenGL.
+class RenderQueue
+{
+public:
+	void Clear();
+	void Reserve(std::size_t count);
+	void Submit(std::uint64_t key, std::uint32_t payload);
+	void Sort();
+	const std::vector<RenderQueueEntry>& GetEntries() const;
+	RenderQueueStats GetStats() const;
+private:
+	std::vector<RenderQueueEntry> entries;
+	std::vector<RenderQueueEntry> scratch;
+	std::size_t submittedStateChanges = 0;
+	RenderQueueStats stats;
+};
@@ -11,18 +11,130 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
 
+// The name of a uniform, along with a hash of it. Shader looks uniforms up by the hash.
+// The constructor is constexpr, so names declared as constexpr UniformNames (like the ones in the Uniforms
+// Namespace below) are hashed at compile time. A plain string literal converts as well, but is then hashed
+// At runtime, on every call.
+class UniformName
+{
+public:
+	constexpr UniformName(const char* name)
+		: hash{ Hash(name) }, name{ name }
+	{
+	}
+
+	std::uint32_t GetHash() const { return hash; }
+	const char* GetName() const { return name; }
+
+	// 32-bit FNV-1a
+	static constexpr std::uint32_t Hash(const char* text)
+	{
+		std::uint32_t hash = 2166136261u;
+		for (; *text != '\0'; text++)
+		{
+			hash ^= static_cast<unsigned char>(*text);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+private:
+	std::uint32_t hash;
+	const char* name;
+};
+
+// The uniforms used by our shaders, hashed at compile time
+namespace Uniforms
+{
+	constexpr UniformName OurTexture{ "ourTexture" };
+	constexpr UniformName PageTable{ "pageTable" };
+	constexpr UniformName PageContentSize{ "pageContentSize" };
+	constexpr UniformName PageBorderSize{ "pageBorderSize" };
+	constexpr UniformName AtlasSize{ "atlasSize" };
+	constexpr UniformName FeedbackLevelBias{ "feedbackLevelBias" };
+}
+
+// The binding points of the uniform blocks our shaders use. See FrameUniforms and VirtualTextureSystem.
+// Shaders connect blocks with these names to these binding points when they are linked.
+namespace UniformBlocks
+{
+	const GLuint CameraBinding = 0;
+	const GLuint VirtualTextureBinding = 1;
+}
+
+// How many uniform values were sent to OpenGL, and how many weren't because they hadn't changed
+struct UniformCounts
+{
+	std::size_t uploads = 0;
+	std::size_t skipped = 0;
+};
+
+// An index into a shader's uniform table. It stays valid for as long as the shader does,
+// So code setting the same uniform over and over can look it up once, and skip even the hash lookup.
+struct UniformHandle
+{
+	int index = -1;
+	bool IsValid() const { return index != -1; }
+};
+
+// A linked shader program.
+// Right after linking, every active uniform is read from the program (glGetActiveUniform) into a table,
+// Along with its location and type, so setting a uniform is a lookup in that table instead of a call to
+// glGetUniformLocation with a string. The table also keeps a copy of the last value sent for each uniform,
+// And values which haven't changed aren't sent again.
+// Uniforms the program doesn't have (or which the GLSL compiler optimized away) are silently ignored,
+// So the same code can set uniforms on several different shaders.
+// The setters upload to the program, so it has to be the active one when they are called.
+// A shader owns its program object, so it can't be copied. Pass it by reference.
+// The program is created and used through RenderDevice::Global(), reading and setting its uniforms still talks to OpenGL.
 class Shader
 {
 public:
 	unsigned int programId;
 
 	Shader(std::string vertexPath, std::string fragmentPath);
+	~Shader();
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
 
 	void activate();
 
-	void setBool(const std::string& name, bool value) const;
-	void setInt(const std::string& name, int value) const;
-	void setFloat(const std::string& name, float value) const;
-	void setMatrix(const std::string& name, glm::mat4 matrix) const;
+	UniformHandle findUniform(UniformName name) const;
+
+	void setBool(UniformName name, bool value);
+	void setInt(UniformName name, int value);
+	void setFloat(UniformName name, float value);
+	void setVector(UniformName name, const glm::vec2& value);
+	void setMatrix(UniformName name, const glm::mat4& matrix);
+
+	void setBool(UniformHandle handle, bool value);
+	void setInt(UniformHandle handle, int value);
+	void setFloat(UniformHandle handle, float value);
+	void setVector(UniformHandle handle, const glm::vec2& value);
+	void setMatrix(UniformHandle handle, const glm::mat4& matrix);
+
+	// Returns the counts of every shader since the last call, and starts counting from zero again
+	static UniformCounts TakeUniformCounts();
+private:
+	struct Uniform
+	{
+		std::uint32_t hash;
+		std::string name;
+		GLint location;
+		GLenum type;
+		// The last value sent, as raw bytes. A mat4 is the largest value we send.
+		unsigned char value[sizeof(glm::mat4)];
+		bool hasValue;
+	};
+	void reflectUniforms();
+	void bindUniformBlocks();
+	// Returns the uniform if the value differs from the last one sent, and records the new value.
+	// Returns nullptr if the uniform doesn't exist, or already has this value.
+	Uniform* changedUniform(UniformHandle handle, const void* value, std::size_t size);
+	// Sorted by hash
+	std::vector<Uniform> uniforms;
+	static UniformCounts uniformCounts;
 };
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Frustum.hpp"
+#include "FrustumCuller.hpp"
+
+struct SpatialIndexStats
+{
+	std::size_t objects = 0;
+	std::size_t nodes = 0;
+	// Moves which still fit the enlarged box of their object, and cost nothing
+	std::size_t movesAbsorbed = 0;
+	std::size_t moves = 0;
+	std::size_t refits = 0;
+	std::size_t rebuilds = 0;
+	// The summed surface area of the internal nodes, relative to the root. Lower means cheaper queries.
+	float cost = 0.0f;
+	std::size_t queries = 0;
+	// Nodes whose box was tested by the queries
+	std::size_t nodesVisited = 0;
+	double updateMilliseconds = 0.0;
+	double queryMilliseconds = 0.0;
+};
+
+struct SpatialRayHit
+{
+	std::uint32_t payload;
+	// Along the ray, where it enters the object's box
+	float distance;
+};
+
+// A bounding volume hierarchy over the objects of a scene, so queries only have to look at the parts of the scene
+// Near what they're looking for. Each object is a leaf, and every internal node has two children and the box around
+// Both. A frustum query skips a whole subtree as soon as its box is outside, and takes it whole without further tests
+// Once its box is inside.
+// Objects are stored with a box a bit larger than they are, so small moves don't change the tree at all.
+// Moves which don't fit are collected, and Update deals with them once per frame: if only a few objects moved,
+// The boxes above them are refit, which is cheap but makes the boxes overlap more over time. Once they overlap
+// Too much (cost grew by RebuildCostGrowth since the last rebuild) or too many objects moved at once, the tree is
+// Rebuilt from scratch instead.
+// New objects are inserted next to the node which grows the least by taking them in.
+// Handles stay the same for the lifetime of an object, rebuilds included.
+class SpatialIndex
+{
+public:
+	SpatialIndex();
+	std::uint32_t Insert(const BoundingVolume& bounds, std::uint32_t payload);
+	void Move(std::uint32_t handle, const BoundingVolume& bounds);
+	void Remove(std::uint32_t handle);
+	// Has to be called once per frame, before the queries
+	void Update();
+	void Rebuild();
+	// Appends the payloads of the objects whose boxes intersect the frustum
+	void QueryFrustum(const Frustum& frustum, std::vector<std::uint32_t>& visible);
+	// Replaces the contents of hits with the objects whose boxes the ray passes through, closest first
+	void Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<SpatialRayHit>& hits);
+	std::size_t GetCount() const;
+	// The counts of the last finished frame
+	SpatialIndexStats GetStats() const;
+	// How much larger than the object its box in the tree is, relative to the object's size
+	static const float FatFraction;
+	static const float RebuildCostGrowth;
+	// Moving more than this share of the objects in one frame rebuilds the tree
+	static const float RebuildMoveFraction;
+private:
+	static const std::int32_t None = -1;
+	struct Node
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+		std::int32_t parent;
+		std::int32_t children[2];
+		std::uint32_t payload;
+		bool moved;
+
+		bool IsLeaf() const { return children[0] == None; }
+	};
+	static float Area(const glm::vec3& min, const glm::vec3& max);
+	std::int32_t AllocateNode();
+	void FreeNode(std::int32_t node);
+	void SetBox(std::int32_t node, const glm::vec3& min, const glm::vec3& max);
+	void InsertLeaf(std::int32_t leaf);
+	void RemoveLeaf(std::int32_t leaf);
+	void Refit(std::int32_t node);
+	std::int32_t Build(std::int32_t* leaves, std::size_t count);
+	void CollectLeaves(std::int32_t node, std::vector<std::uint32_t>& payloads);
+	std::vector<Node> nodes;
+	std::int32_t root;
+	std::int32_t freeList;
+	std::size_t objectCount;
+	// Summed surface area of the internal nodes, kept up to date as boxes change
+	double internalArea;
+	float costAtRebuild;
+	std::vector<std::int32_t> movedLeaves;
+	std::vector<std::int32_t> stack;
+	std::vector<std::int32_t> collectStack;
+	std::vector<std::int32_t> buildLeaves;
+	SpatialIndexStats stats;
+	SpatialIndexStats lastFrameStats;
+};
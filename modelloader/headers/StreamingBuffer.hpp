@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+struct StreamingBufferStats
+{
+	std::size_t bytesWritten = 0;
+	std::size_t capacity = 0;
+	// How often we had to wait for the GPU to finish with a part of the buffer before writing to it again
+	std::size_t stalls = 0;
+};
+
+// A buffer for data which is written by the CPU every frame and read by the GPU once, like per-instance data.
+// The buffer is split into FramesInFlight segments, and each frame writes into the next one. A fence is placed
+// After each frame's draws, so a segment is only written again once the GPU is done with the frame that read it.
+// Writes map their range unsynchronized, so the driver never has to wait for or copy the rest of the buffer.
+// Offsets returned by Write are relative to the start of this frame's segment, as the buffer grows (and moves
+// Its segments) if a frame writes more than fits. Add GetFrameOffset to get an offset into the buffer object,
+// After all of this frame's writes are done.
+// Everything here has to be called on the OpenGL thread.
+class StreamingBuffer
+{
+public:
+	// The stream holding the per-instance data of instanced draws
+	static StreamingBuffer& Instances();
+	explicit StreamingBuffer(std::size_t segmentBytes);
+	~StreamingBuffer();
+	StreamingBuffer(const StreamingBuffer&) = delete;
+	StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+	// Has to be called once per frame, before any writes
+	void BeginFrame();
+	std::size_t Write(const void* data, std::size_t bytes);
+	GLuint GetBufferObject() const;
+	std::size_t GetFrameOffset() const;
+	// The counts of the last finished frame
+	StreamingBufferStats GetStats() const;
+	static const int FramesInFlight = 3;
+	// Every write starts on a multiple of this, which is enough for any vertex attribute
+	static const std::size_t Alignment = 16;
+private:
+	void Grow(std::size_t minimumSegmentBytes);
+	GLuint buffer;
+	std::size_t segmentBytes;
+	int segment;
+	std::size_t segmentUsed;
+	GLsync fences[FramesInFlight];
+	StreamingBufferStats stats;
+	StreamingBufferStats lastFrameStats;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DecodeBufferPool.hpp"
+
+// The GPU formats a supercompressed texture can be transcoded to.
+// -- Bc1: 8 bytes per 4x4 block, opaque color. A straight copy of the stored blocks.
+// -- Bc3: 16 bytes per block, Bc1 color plus a separately interpolated alpha block. Also a straight copy.
+// -- Bc7: 16 bytes per block. The blocks are re-packed as Bc7 mode 5, which has the same four color levels
+//    As Bc1, but only four alpha levels instead of eight.
+// -- Rgba8: plain pixels, for GPUs without any of the block formats.
+enum class TranscodeTarget
+{
+	Bc1,
+	Bc3,
+	Bc7,
+	Rgba8
+};
+
+const char* TranscodeTargetName(TranscodeTarget target);
+std::size_t TranscodedSize(int width, int height, TranscodeTarget target);
+
+// Reader for the .beagletex files written by the asset importer.
+// The texture is stored as Bc1-style blocks (two RGB565 endpoints and 2-bit selectors, plus two alpha
+// Endpoints and 3-bit selectors for textures with alpha). On top of that the blocks are "supercompressed":
+// -- Endpoints are stored as differences to the block before, which are mostly zero
+// -- Selectors are stored as references into a list of the 255 most recently used selector patterns,
+//    With only patterns not in the list stored in full
+// -- Each of those streams is then Huffman coded
+// The importer trades a little quality for blocks that reuse their neighbours' endpoints and selectors,
+// Which is what brings the size down towards JPEG, while the result still transcodes to GPU block formats
+// Without ever re-encoding.
+// File layout:
+// -- "BTEX", version, width, height, level count, slice count and flags (bit 0: has alpha), all as 32-bit unsigned integers
+// -- For each image (levels in order, and for each level every slice): a 64-bit byte offset and a 64-bit byte size
+// -- The image data. Every image is coded on its own, so they can be transcoded in parallel.
+// ReadImage opens its own stream, so images can be read from several threads at once.
+class SupercompressedFile
+{
+public:
+	bool Open(const std::string& filepath);
+	std::vector<unsigned char> ReadImage(int level, int slice) const;
+	const std::string& GetPath() const;
+	int GetWidth() const;
+	int GetHeight() const;
+	int GetLevelCount() const;
+	int GetSliceCount() const;
+	bool HasAlpha() const;
+	int GetLevelWidth(int level) const;
+	int GetLevelHeight(int level) const;
+private:
+	std::string path;
+	int width = 0;
+	int height = 0;
+	int levelCount = 0;
+	int sliceCount = 0;
+	bool hasAlpha = false;
+	std::vector<std::uint64_t> offsets;
+	std::vector<std::uint64_t> sizes;
+};
+
+// Transcodes one image read by SupercompressedFile::ReadImage into the target format.
+// Returns an empty buffer if the image data is corrupt.
+// Doesn't touch any shared state, so any number of images can be transcoded at once.
+DecodeBuffer TranscodeImage(const std::vector<unsigned char>& image, int width, int height, bool hasAlpha, TranscodeTarget target);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include <glad/glad.h>
+
+#include "UploadScheduler.hpp"
+#include "TextureFormat.hpp"
+#include "DecodeBufferPool.hpp"
+
+// A decoded image along with all of its mip levels, level 0 being the full resolution image.
+// The mip levels are built on the CPU, so they can be uploaded one at a time.
+// All levels live in DecodeBuffers, which go back to the pool once the last upload chunk using them is done.
+// The levels are laid out the way format describes, which for transcoded textures is a block compressed format.
+struct MipChain
+{
+	int width = 0;
+	int height = 0;
+	int nrChannels = 0;
+	TextureFormat format = TextureFormat::ForChannelCount(4);
+	std::vector<DecodeBuffer> levels;
+
+	// Takes ownership of the full resolution pixels, which become level 0
+	static MipChain Build(DecodeBuffer pixels, int width, int height, int nrChannels);
+	static int LevelWidth(int width, int level);
+	static int LevelHeight(int height, int level);
+};
+
+// A Texture owns a single OpenGL texture object.
+// It is not copyable, since two copies would end up deleting the same texture object.
+// Textures are shared between meshes through std::shared_ptr handles handed out by the TextureCache,
+// And the texture object is deleted when the last handle goes away.
+// A texture starts out as a 1x1 white placeholder, so it can be bound right away while the real
+// Image is still being decoded. Upload later replaces the contents of the same texture object.
+class Texture
+{
+public:
+	Texture();
+	~Texture();
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+	void Upload(std::shared_ptr<const MipChain> image);
+	// Streamed textures only have some of their mip levels resident at any time.
+	// Levels have to be uploaded from coarse to fine, and evicted from fine to coarse.
+	void SetImageSize(int width, int height, const TextureFormat& format, int levelCount);
+	// owner keeps pixels alive until the level has been uploaded
+	void UploadLevel(int level, std::shared_ptr<const void> owner, const unsigned char* pixels, std::function<void()> onResident);
+	void EvictLevel(int level);
+	unsigned GetTextureObject() const;
+	int GetWidth() const;
+	int GetHeight() const;
+	bool IsLoaded() const;
+	int GetLevelCount() const;
+	int GetBaseLevel() const;
+	// What the levels take up in GPU memory, which the TextureStreamer budgets with
+	std::size_t GetLevelBytes(int level) const;
+	std::size_t GetBytes() const;
+	const TextureFormat& GetFormat() const;
+private:
+	void AppendLevelChunks(std::vector<UploadChunk>& chunks, int level, std::shared_ptr<const void> owner, const unsigned char* pixels, std::function<void()> onResident);
+	void AllocateLevel(int level);
+	unsigned textureObject;
+	int width;
+	int height;
+	TextureFormat format;
+	int levelCount;
+	int baseLevel;
+	bool placeholder;
+	bool loaded;
+};
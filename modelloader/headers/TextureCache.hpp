@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+
+#include "Texture.hpp"
+#include "ThreadPool.hpp"
+#include "MpscQueue.hpp"
+#include "ImageBatch.hpp"
+#include "SupercompressedTexture.hpp"
+
+// The TextureCache makes sure every texture is only decoded and uploaded once, no matter
+// How many meshes refer to it.
+// Textures loaded from files are keyed by their canonical (absolute, lower-case) path.
+// Embedded textures are keyed by a hash of their content.
+// The cache only holds weak references. The meshes own the textures through shared handles,
+// So a texture is freed as soon as the last mesh using it goes away.
+//
+// Decoding (and building the mip chain) happens on a pool of worker threads.
+// Acquire returns a placeholder texture right away, and finished images are handed back to the
+// OpenGL thread through a lock-free queue. ProcessUploads has to be called on the OpenGL thread
+// (once per frame) to pass them on to the UploadScheduler.
+// Between BeginBatch and EndBatch, decoding is held back, and everything acquired in the meantime
+// Is decoded as one ImageBatch, largest image first. Loading a whole scene this way finishes sooner
+// Than decoding its textures in whatever order the meshes happened to ask for them.
+// Textures with a .beaglemips file are instead handed to the TextureStreamer, which loads their
+// Mip levels individually based on how large they appear on screen.
+// Textures with a .beagletex file are streamed the same way, each level transcoded to the most compact block format
+// The GPU supports as it is read, so they are never fully decoded to pixels, nor fully resident.
+class TextureCache
+{
+public:
+	static TextureCache& Global();
+	TextureCache();
+	~TextureCache();
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+	std::shared_ptr<Texture> AcquireFromFile(const std::string& filepath);
+	std::shared_ptr<Texture> AcquireFromMemory(std::vector<unsigned char> bytes);
+	std::shared_ptr<Texture> AcquireStreamed(const std::string& mipFilepath);
+	// Returns nullptr if the file can't be read, so the caller can fall back to the source image
+	std::shared_ptr<Texture> AcquireSupercompressed(const std::string& filepath);
+	// Batches nest, the textures are only submitted for decoding by the outermost EndBatch
+	void BeginBatch();
+	void EndBatch();
+	void ProcessUploads();
+	std::size_t GetLiveTextureCount();
+	std::size_t GetPendingTextureCount() const;
+	// Bytes of GPU memory saved by storing textures in fewer channels than RGBA8, or block compressed, across all textures
+	// Acquired so far. Streamed textures count as if all their levels were resident.
+	std::size_t GetBytesSaved() const;
+private:
+	struct DecodedImage
+	{
+		std::weak_ptr<Texture> texture;
+		std::string name;
+		std::shared_ptr<const MipChain> image;
+		int sourceChannels = 0;
+	};
+	std::shared_ptr<Texture> Acquire(const std::string& key, ImageSource source);
+	std::shared_ptr<Texture> FindLiveTexture(const std::string& key);
+	// Must be called with the mutex held
+	void SubmitBatch();
+	// Must be called on the OpenGL thread, once the texture knows its size and format
+	void ReportBytesSaved(const std::string& name, const std::string& source, const Texture& texture);
+	static DecodedImage PrepareUpload(std::weak_ptr<Texture> texture, DecodedImageResult& result);
+	static TranscodeTarget ChooseTranscodeTarget(bool hasAlpha);
+	static std::string CanonicalPath(const std::string& filepath);
+	static std::string ContentHash(const std::vector<unsigned char>& bytes);
+	std::mutex mutex;
+	std::unordered_map<std::string, std::weak_ptr<Texture>> textures;
+	MpscQueue<DecodedImage> decodedImages;
+	std::atomic<std::size_t> pendingTextureCount;
+	std::size_t bytesSaved;
+	// Set once a decoded image is handed on, until the decode buffers are trimmed
+	bool decodeBuffersToTrim;
+	int batchDepth;
+	ImageBatch batch;
+	// The texture each image in the batch is decoded for, in the order they were added to the batch
+	std::vector<std::weak_ptr<Texture>> batchTextures;
+	// The decode jobs still push into decodedImages after the textures they were for are gone. The destructor waits
+	// For them, so whatever they decoded is freed along with the queue.
+	ThreadPool& decoders;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+// glad only loads the OpenGL 3.3 core profile, which doesn't include the block compressed formats.
+// S3TC (BC1 - BC3) is an extension on every desktop GPU, and BPTC (BC7) is core since OpenGL 4.2.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+// Describes how a texture is stored on the GPU, based on how many channels its pixels have.
+// Channel counts follow stb_image: 1 = grey, 2 = grey + alpha, 3 = RGB, 4 = RGBA.
+// Grey textures are stored in fewer channels (R8 / RG8), and a swizzle mask makes them sample
+// As (grey, grey, grey, alpha), so shaders see the same thing they would for an RGBA texture.
+// Block compressed formats store 4x4 texel blocks of blockBytes bytes each. For those pixelFormat is unused,
+// As the data is handed to glCompressedTexSubImage2D exactly as the GPU stores it.
+struct TextureFormat
+{
+	int nrChannels;
+	GLint internalFormat;
+	GLenum pixelFormat;
+	GLint swizzle[4];
+	int blockBytes;
+
+	static TextureFormat ForChannelCount(int nrChannels);
+	static TextureFormat Bc1();
+	static TextureFormat Bc3();
+	static TextureFormat Bc7();
+	bool IsCompressed() const;
+	// Whether the GPU we're running on can sample this format. Must be called on the OpenGL thread.
+	bool IsSupported() const;
+	// The bytes of a level as uploaded
+	std::size_t LevelBytes(int width, int height) const;
+	// The bytes of a level in GPU memory. Drivers pad RGB8 texels to four bytes, so it takes as much as RGBA8.
+	std::size_t StoredLevelBytes(int width, int height) const;
+	const char* Name() const;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "Texture.hpp"
+#include "MipFile.hpp"
+#include "MpscQueue.hpp"
+#include "SupercompressedTexture.hpp"
+#include "ThreadPool.hpp"
+
+struct StreamingStats
+{
+	std::size_t streamedTextures = 0;
+	std::size_t residentBytes = 0;
+	std::size_t budgetBytes = 0;
+	std::size_t pendingLoads = 0;
+	std::size_t loadsStartedThisFrame = 0;
+	std::size_t levelsEvictedThisFrame = 0;
+};
+
+// The TextureStreamer keeps only the mip levels of a texture resident which are actually needed
+// For how large the objects using it appear on screen.
+// When a texture is registered, its coarse levels (up to CoarseLevelSize texels across) are loaded
+// Right away and stay resident for as long as the texture lives.
+// Every frame, meshes report the world space bounding sphere they are drawn with. From that we estimate
+// How many pixels the object covers, and thereby which mip level would be sampled at that size.
+// If that level is finer than what is resident, the next finer level is read from the .beaglemips file, or read and
+// Transcoded from the .beagletex file, on a worker thread, and uploaded through the UploadScheduler. Levels are loaded one at a time, from coarse to fine.
+// When resident levels exceed the memory budget, the finest levels of the least recently used
+// Textures are evicted first. Textures nobody has drawn for a while drop back to their coarse levels.
+// Update must be called once per frame on the OpenGL thread.
+class TextureStreamer
+{
+public:
+	static TextureStreamer& Global();
+	TextureStreamer();
+	~TextureStreamer();
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+	void SetMemoryBudget(std::size_t bytes);
+	void SetCamera(const glm::vec3& position, float fieldOfViewY, float viewportHeight);
+	void Register(const std::shared_ptr<Texture>& texture, MipFile mipFile);
+	// The levels are transcoded to target as they are read, so the texture stays block compressed on the GPU
+	void Register(const std::shared_ptr<Texture>& texture, SupercompressedFile file, TranscodeTarget target);
+	void RequestFootprint(const Texture* texture, const glm::vec3& center, float radius);
+	void Update();
+	StreamingStats GetStats() const;
+	// Levels at most this many texels across are always resident
+	static const int CoarseLevelSize = 64;
+	// Textures not drawn for this many frames drop back to their coarse levels
+	static const std::uint64_t IdleFramesBeforeEviction = 300;
+private:
+	struct LoadedLevel
+	{
+		const Texture* key = nullptr;
+		std::weak_ptr<Texture> texture;
+		int level = 0;
+		// Laid out the way the texture's format describes, and kept alive by owner. Null if the level couldn't be read.
+		std::shared_ptr<const void> owner;
+		const unsigned char* pixels = nullptr;
+	};
+	// Fills in the owner and the pixels of a level. Runs on the workers.
+	using LevelReader = std::function<void(int level, LoadedLevel& loaded)>;
+	struct StreamedTexture
+	{
+		std::weak_ptr<Texture> texture;
+		LevelReader readLevel;
+		std::string path;
+		int width;
+		int height;
+		int levelCount;
+		// The finest of the coarse levels which are always resident
+		int coarseLevel;
+		// The finest level that has been uploaded, or the level count if none has
+		int residentLevel;
+		// The finest level requested since the last update
+		int desiredLevel;
+		// The finest level currently being loaded, or -1
+		int loadingLevel;
+		std::uint64_t lastUsedFrame;
+		std::size_t residentBytes;
+	};
+	void Register(const std::shared_ptr<Texture>& texture, const std::string& path, int width, int height, const TextureFormat& format,
+		int levelCount, LevelReader readLevel);
+	void LoadLevels(const Texture* key, StreamedTexture& streamed, int finestLevel);
+	void EvictLevel(StreamedTexture& streamed, Texture& texture);
+	void OnLevelResident(const Texture* key, int level);
+	bool EvictLeastRecentlyUsed(std::uint64_t usedBefore);
+	int DesiredLevel(const StreamedTexture& streamed, const glm::vec3& center, float radius) const;
+	std::unordered_map<const Texture*, StreamedTexture> textures;
+	MpscQueue<LoadedLevel> loadedLevels;
+	glm::vec3 cameraPosition;
+	float fieldOfViewY;
+	float viewportHeight;
+	std::size_t budgetBytes;
+	std::size_t residentBytes;
+	std::uint64_t frame;
+	StreamingStats lastFrameStats;
+	// Levels are read on the shared pool. The destructor waits for the reads in flight, which push into loadedLevels.
+	ThreadPool& readers;
+};
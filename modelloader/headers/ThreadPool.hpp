@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// A fixed set of worker threads pulling jobs from a shared queue.
+// Jobs must not touch OpenGL, since the context is only current on the main thread.
+// The systems of the renderer all share the Global pool, so together they never start more threads than there are
+// Cores. Pools of their own are for tests and benchmarks.
+class ThreadPool
+{
+public:
+	static ThreadPool& Global();
+	explicit ThreadPool(unsigned workerCount = DefaultWorkerCount());
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	void Submit(std::function<void()> job);
+	// Runs job(0) to job(jobCount - 1), on the workers and the calling thread, and returns once all are done.
+	// job(0) always runs on the calling thread. The calling thread also takes whatever jobs no worker has started,
+	// So Run never waits on a queue, and can be called from a job itself, even with every worker busy.
+	void Run(std::size_t jobCount, const std::function<void(std::size_t)>& job);
+	// Returns once the queue is empty and no worker is running a job. For owners of jobs which refer to them, before
+	// They go away. Must not be called from one of the pool's own workers.
+	void Wait();
+	unsigned GetWorkerCount() const;
+	static unsigned DefaultWorkerCount();
+private:
+	void WorkerLoop();
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable idle;
+	unsigned busyWorkers;
+	bool stopping;
+};
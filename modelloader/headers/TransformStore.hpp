@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "ThreadPool.hpp"
+
+struct TransformStoreStats
+{
+	std::size_t transforms = 0;
+	// Transforms whose matrices were recomputed, because they or one of their parents changed
+	std::size_t updated = 0;
+	// How many levels deep the hierarchy is
+	std::size_t depth = 0;
+	std::size_t jobs = 0;
+	double milliseconds = 0.0;
+};
+
+// Holds the position, rotation and scale of every object, and the world matrices made from them.
+// The values are kept in structure-of-arrays form, one array per component, so SSE composes the matrices of 4
+// Transforms at once. Only transforms which changed since the last Update are composed again, along with everything
+// Below them in the hierarchy. A transform's world matrix is its parent's times its own.
+// Update goes through the hierarchy one level at a time, as a child needs its parent's matrix. Within a level, the
+// Transforms are split over a ThreadPool once there are enough of them.
+// The world matrices are kept next to each other, indexed by transform, so they can be uploaded as they are.
+class TransformStore
+{
+public:
+	static TransformStore& Global();
+	explicit TransformStore(ThreadPool& workers = ThreadPool::Global());
+	TransformStore(const TransformStore&) = delete;
+	TransformStore& operator=(const TransformStore&) = delete;
+	// The parent has to exist for as long as the transform does
+	std::uint32_t Create(std::uint32_t parent = None);
+	void Destroy(std::uint32_t transform);
+	void SetPosition(std::uint32_t transform, const glm::vec3& position);
+	void SetRotation(std::uint32_t transform, const glm::quat& rotation);
+	void SetScale(std::uint32_t transform, const glm::vec3& scale);
+	glm::vec3 GetPosition(std::uint32_t transform) const;
+	// Recomputes the world matrices of every transform that changed. Has to be called once per frame.
+	void Update();
+	// Up to date even if the transform changed since the last Update, composing the matrix on the spot if needed
+	glm::mat4 GetWorldMatrix(std::uint32_t transform) const;
+	// Every world matrix as of the last Update, indexed by transform
+	const std::vector<glm::mat4>& GetWorldMatrices() const;
+	// The counts of the last call to Update
+	TransformStoreStats GetStats() const;
+	static const std::uint32_t None = 0xffffffff;
+	// Below this many transforms in a level, Update doesn't split them over the workers
+	static const std::size_t ParallelThreshold = 4096;
+private:
+	glm::mat4 ComposeLocal(std::uint32_t transform) const;
+	// Composes the world matrices of the given transforms, whose parents are up to date
+	void ComposeRange(const std::uint32_t* transforms, std::size_t count);
+	void SortByDepth();
+	std::vector<float> positionX;
+	std::vector<float> positionY;
+	std::vector<float> positionZ;
+	std::vector<float> rotationX;
+	std::vector<float> rotationY;
+	std::vector<float> rotationZ;
+	std::vector<float> rotationW;
+	std::vector<float> scaleX;
+	std::vector<float> scaleY;
+	std::vector<float> scaleZ;
+	std::vector<std::uint32_t> parents;
+	std::vector<std::uint32_t> depths;
+	std::vector<std::uint8_t> dirty;
+	std::vector<std::uint8_t> alive;
+	std::vector<std::uint32_t> freeTransforms;
+	std::vector<glm::mat4> worldMatrices;
+	// Every live transform, parents before children, and where each level of the hierarchy starts in it
+	std::vector<std::uint32_t> order;
+	std::vector<std::size_t> levelStarts;
+	bool orderChanged;
+	std::vector<std::uint32_t> updated;
+	std::vector<std::size_t> updatedLevelStarts;
+	TransformStoreStats stats;
+	ThreadPool& workers;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+// A single piece of an upload, small enough to fit within one frame's budget.
+// For buffers that is a sub-range, for textures a mip level (or a band of rows of a large mip level).
+struct UploadChunk
+{
+	std::size_t bytes;
+	std::function<void()> upload;
+};
+
+struct UploadStats
+{
+	std::size_t pendingUploads = 0;
+	std::size_t pendingChunks = 0;
+	std::size_t pendingBytes = 0;
+	std::size_t bytesUploadedThisFrame = 0;
+	std::size_t chunksUploadedThisFrame = 0;
+	double millisecondsThisFrame = 0.0;
+	std::size_t byteBudget = 0;
+	double millisecondBudget = 0.0;
+	// The larger of the byte and time fractions of the budget used this frame
+	float budgetUsed = 0.0f;
+};
+
+// Uploading a lot of data to the GPU in a single frame makes that frame take much longer
+// Than the others, which shows up as a visible hitch.
+// The UploadScheduler queues uploads and spreads them over several frames, only spending a
+// Configurable number of bytes and milliseconds on them each frame.
+// Uploads belong to a resource (a mesh, a texture) and are prioritized by the distance between
+// The camera and the closest user of that resource, so things near the camera show up first.
+// All functions must be called on the OpenGL thread.
+class UploadScheduler
+{
+public:
+	static UploadScheduler& Global();
+	UploadScheduler();
+	void SetBudget(std::size_t bytesPerFrame, double millisecondsPerFrame);
+	void SetCameraPosition(const glm::vec3& position);
+	void Track(const void* resource, const void* user, const glm::vec3& position);
+	void Untrack(const void* user);
+	void Schedule(const void* resource, std::vector<UploadChunk> chunks, std::function<void()> onComplete);
+	void ScheduleBufferUpload(const void* resource, GLuint buffer, std::size_t bufferOffset, const void* data, std::size_t size, std::function<void()> onComplete);
+	void Cancel(const void* resource);
+	void ProcessFrame();
+	UploadStats GetStats() const;
+	// Uploads bigger than this are split into several chunks
+	static const std::size_t MaxChunkBytes = 1024 * 1024;
+private:
+	struct UploadJob
+	{
+		const void* resource;
+		std::deque<UploadChunk> chunks;
+		std::function<void()> onComplete;
+		float distance;
+	};
+	float DistanceToCamera(const void* resource) const;
+	std::deque<UploadJob> jobs;
+	std::unordered_map<const void*, std::unordered_map<const void*, glm::vec3>> userPositions;
+	glm::vec3 cameraPosition;
+	std::size_t byteBudget;
+	double millisecondBudget;
+	UploadStats lastFrameStats;
+};
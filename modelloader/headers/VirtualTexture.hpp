@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+
+#include "VirtualTextureFile.hpp"
+#include "PageTable.hpp"
+
+// One virtual texture: the file its pages are read from, its page table, and the texture the page table is
+// Uploaded to, so the fragment shader can look up where each page sits in the page atlas.
+// The pages themselves live in the atlas shared by all virtual textures, which the VirtualTextureSystem owns.
+// Like Texture, it owns an OpenGL texture object, so it can't be copied, and has to be created and
+// Destroyed on the OpenGL thread. Meshes share it through std::shared_ptr handles.
+class VirtualTexture
+{
+public:
+	VirtualTexture(int id, VirtualTextureFile file);
+	~VirtualTexture();
+	VirtualTexture(const VirtualTexture&) = delete;
+	VirtualTexture& operator=(const VirtualTexture&) = delete;
+	int GetId() const;
+	const std::shared_ptr<const VirtualTextureFile>& GetFile() const;
+	const VirtualTextureLayout& GetLayout() const;
+	PageTable& GetPageTable();
+	unsigned GetPageTableObject() const;
+	// Resolves the page table, and uploads whichever of its levels changed
+	void UpdatePageTable(int atlasSlotsPerRow);
+private:
+	int id;
+	std::shared_ptr<const VirtualTextureFile> file;
+	PageTable pageTable;
+	unsigned pageTableObject;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// How a virtual texture is cut into pages. The importer and the runtime have to agree on this.
+// Every page holds PageContentSize x PageContentSize texels of the texture, surrounded by a border of
+// PageBorderSize texels copied from the neighbouring pages, so bilinear filtering at the edge of a page
+// Never samples whatever page happens to sit next to it in the atlas. Including the border a page is
+// PageSize texels across, which keeps the atlas a power of two.
+// Each mip level is cut into pages as well, down to the first level which fits in a single page.
+// The importer pads the image so its size divides evenly through every level. That way a page at one level
+// Always covers exactly four pages of the level below, which the page table relies on.
+// The padding is never sampled, as texture coordinates are scaled by the image size, not the padded size.
+struct VirtualTextureLayout
+{
+	static const int PageContentSize = 120;
+	static const int PageBorderSize = 4;
+	static const int PageSize = PageContentSize + 2 * PageBorderSize;
+
+	// The size of the image itself, and of the padded level 0
+	int width = 0;
+	int height = 0;
+	int paddedWidth = 0;
+	int paddedHeight = 0;
+	int levelCount = 0;
+
+	int LevelWidth(int level) const;
+	int LevelHeight(int level) const;
+	int PagesWide(int level) const;
+	int PagesHigh(int level) const;
+	// The index of a page in the file. Levels are stored finest first, and each level row by row.
+	std::size_t PageIndex(int level, int x, int y) const;
+	std::size_t PageCount() const;
+};
+
+// Reader for the .beaglevt files written by the asset importer:
+// -- "BVTX", version, width, height, padded width, padded height, level count, page content size and
+//    Page border size, all as 32-bit unsigned integers
+// -- Every page as PageSize x PageSize RGBA8 texels, in the order given by VirtualTextureLayout::PageIndex
+// Pages are all the same size, so a page can be found without a table of offsets.
+// ReadPage opens its own stream, so pages can be read from several threads at once.
+class VirtualTextureFile
+{
+public:
+	bool Open(const std::string& filepath);
+	std::vector<unsigned char> ReadPage(int level, int x, int y) const;
+	const std::string& GetPath() const;
+	const VirtualTextureLayout& GetLayout() const;
+	static const std::size_t PageBytes = static_cast<std::size_t>(VirtualTextureLayout::PageSize) * VirtualTextureLayout::PageSize * 4;
+	static const std::size_t HeaderBytes = 4 + 8 * sizeof(std::uint32_t);
+private:
+	std::string path;
+	VirtualTextureLayout layout;
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "RenderDevice.hpp"
+#include "VirtualTexture.hpp"
+#include "PageCache.hpp"
+#include "PageFeedback.hpp"
+#include "MpscQueue.hpp"
+#include "ThreadPool.hpp"
+
+struct VirtualTextureStats
+{
+	std::size_t virtualTextures = 0;
+	std::size_t residentPages = 0;
+	std::size_t atlasSlots = 0;
+	std::size_t requestedPages = 0;
+	std::size_t queuedPages = 0;
+	std::size_t loadingPages = 0;
+	std::size_t pagesUploadedThisFrame = 0;
+	std::size_t pagesEvictedThisFrame = 0;
+};
+
+// Matches the VirtualTexture block in fragment.glsl and feedback.glsl, laid out by the std140 rules
+struct VirtualTextureUniforms
+{
+	glm::vec2 size;
+	float levelCount;
+	std::int32_t id;
+	// 0 for meshes without a virtual texture, which are drawn with the parameters at id 0
+	std::uint32_t virtualTextured;
+};
+
+// Virtual textures are for textures far larger than what fits in GPU memory. They are cut into pages by the
+// Importer, and only the pages something on screen actually samples are loaded, into a fixed size atlas of
+// Page slots shared by every virtual texture. Each virtual texture's page table tells the fragment shader
+// Which slot holds each of its pages, falling back to coarser pages for those which aren't loaded (yet).
+// Which pages are needed is found out by a feedback pass: the scene is drawn at a fraction of the screen
+// Resolution with feedback.glsl, which writes the page each pixel would sample instead of its color.
+// The pixels are read back through a pair of pixel buffers, so we never wait on the GPU. The page id is
+// Read back two frames later, which is plenty recent for deciding what to load.
+// From there on everything is decided on the CPU, by the PageRequestQueue, PageCache and PageTable,
+// None of which touch OpenGL. Pages are read from disk on worker threads, and a few of them are copied
+// Into the atlas every frame.
+// Up to PageId::MaxTextureId virtual textures can be alive at once.
+// The parameters of every virtual texture are kept in a uniform buffer, one range per id, so binding one is only
+// A matter of binding textures and a buffer range, which can be recorded like any other draw state.
+// Everything here has to be called on the OpenGL thread, except Bind.
+class VirtualTextureSystem
+{
+public:
+	static VirtualTextureSystem& Global();
+	VirtualTextureSystem();
+	~VirtualTextureSystem();
+	VirtualTextureSystem(const VirtualTextureSystem&) = delete;
+	VirtualTextureSystem& operator=(const VirtualTextureSystem&) = delete;
+	// Returns nullptr if the file can't be read, or if there are too many virtual textures already,
+	// So the caller can fall back to a regular texture
+	std::shared_ptr<VirtualTexture> Acquire(const std::string& filepath);
+	// Sets the uniforms which are the same for every virtual texture. Has to be called once for every shader drawing
+	// Meshes, while it is active, before anything is bound.
+	void PrepareShader(Shader& shader);
+	// Binds the atlas and the page table of the texture, and its parameters to the VirtualTexture block.
+	// With nullptr, tells the shader the mesh doesn't use a virtual texture.
+	// Thread safe, and meant to be recorded: it only reads the handles of the atlas, the uniform buffer and the page
+	// Table, which never change once created, and every call goes through the device. Any number of threads can
+	// Record it at once, each into their own device, as long as the OpenGL thread doesn't acquire a texture (or
+	// Prepare the first shader) meanwhile. Update and the feedback pass only change what those objects hold.
+	void Bind(const VirtualTexture* texture, RenderDevice& device) const;
+	// Draws between BeginFeedback and EndFeedback go to the feedback buffer. Returns false if there
+	// Are no virtual textures, in which case there's no need for a feedback pass at all.
+	bool BeginFeedback(int viewportWidth, int viewportHeight);
+	void EndFeedback();
+	void Update();
+	VirtualTextureStats GetStats() const;
+	// The atlas is AtlasSlotsPerRow x AtlasSlotsPerRow pages
+	static const int AtlasSlotsPerRow = 16;
+	// The feedback buffer is this many times smaller than the viewport in each direction
+	static const int FeedbackDivisor = 8;
+	static const int MaxPageUploadsPerFrame = 8;
+	static const std::size_t MaxPagesLoading = 16;
+private:
+	struct LoadedPage
+	{
+		PageId page{};
+		std::weak_ptr<VirtualTexture> texture;
+		std::vector<unsigned char> texels;
+	};
+	void CreateAtlas();
+	void CreateUniformBuffer();
+	void WriteUniforms(int id, const VirtualTexture* texture);
+	void CreateFeedbackBuffer(int width, int height);
+	void DeleteFeedbackBuffer();
+	bool ReadFeedback(std::vector<PageRequest>& requests);
+	void UploadPage(const LoadedPage& loaded, VirtualTexture& texture, VirtualTextureStats& stats);
+	void RemoveTexture(int id);
+	// Indexed by id. Id 0 is never used, so a feedback pixel of all zeroes means "no virtual texture".
+	std::vector<std::weak_ptr<VirtualTexture>> textures;
+	std::unordered_map<std::string, std::weak_ptr<VirtualTexture>> texturesByPath;
+	PageCache cache;
+	PageRequestQueue requests;
+	MpscQueue<LoadedPage> loadedPages;
+	unsigned atlasObject;
+	std::uint32_t uniformBuffer;
+	std::size_t uniformStride;
+	unsigned feedbackFramebuffer;
+	unsigned feedbackColor;
+	unsigned feedbackDepth;
+	unsigned feedbackPixelBuffers[2];
+	bool feedbackPixelBufferWritten[2];
+	int feedbackWriteIndex;
+	int feedbackWidth;
+	int feedbackHeight;
+	int viewportWidth;
+	int viewportHeight;
+	std::uint64_t frame;
+	VirtualTextureStats lastFrameStats;
+	// Pages are read on the shared pool. The destructor waits for the reads in flight, which still use the system.
+	ThreadPool& readers;
+};
@@ -0,0 +1,38 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 texCoord;
+
+// Used for the virtual texture feedback pass. Instead of a color, every pixel gets the page of the virtual
+// Texture it would sample, packed into the four channels. See PageFeedback.hpp for the layout.
+// The page is picked exactly like sampleVirtualTexture in fragment.glsl does it.
+uniform float pageContentSize;
+uniform float feedbackLevelBias;
+
+// Bound to the parameters of the mesh's virtual texture before every draw, see VirtualTextureSystem::Bind
+layout (std140) uniform VirtualTexture
+{
+    vec2 virtualSize;
+    float virtualLevelCount;
+    int virtualTextureId;
+    bool virtualTextured;
+};
+
+void main()
+{
+	// Meshes without a virtual texture still write depth, so they hide the pages behind them
+	if (!virtualTextured)
+	{
+		FragColor = vec4(0.0);
+		return;
+	}
+
+	vec2 texel = texCoord * virtualSize;
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float level = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + feedbackLevelBias), 0.0, virtualLevelCount - 1.0);
+
+	ivec2 page = ivec2(fract(texCoord) * virtualSize / exp2(level) / pageContentSize);
+	int packedLevel = virtualTextureId * 16 + int(level);
+	FragColor = vec4(page.x & 255, (page.x >> 8) | ((page.y & 15) << 4), page.y >> 4, packedLevel) / 255.0;
+}
\ No newline at end of file
@@ -7,8 +7,52 @@ in vec2 texCoord;
 // Each texture object, for convenience, will already contain a built-in sampler object.
 uniform sampler2D ourTexture;
 
+// Virtual textures are sampled through a page table. ourTexture is then the atlas of resident pages,
+// And the page table says which slot of the atlas holds each page. See VirtualTextureSystem.hpp.
+uniform sampler2D pageTable;
+uniform float pageContentSize;
+uniform float pageBorderSize;
+uniform float atlasSize;
+
+// Bound to the parameters of the mesh's virtual texture before every draw, see VirtualTextureSystem::Bind
+layout (std140) uniform VirtualTexture
+{
+    vec2 virtualSize;
+    float virtualLevelCount;
+    int virtualTextureId;
+    bool virtualTextured;
+};
+
+vec4 sampleVirtualTexture()
+{
+	// The mip level is picked the way OpenGL would: from how many texels one pixel step covers.
+	// The derivatives are taken before wrapping, so there's no seam where the coordinates wrap around.
+	vec2 texel = texCoord * virtualSize;
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float level = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy)))), 0.0, virtualLevelCount - 1.0);
+
+	// Which page the texel is in at that level. The entry holds the page's slot in the atlas, or the slot of
+	// A coarser page covering it if the page itself isn't resident, along with the level of the page it holds.
+	vec2 wrapped = fract(texCoord);
+	vec4 entry = texelFetch(pageTable, ivec2(wrapped * virtualSize / exp2(level) / pageContentSize), int(level)) * 255.0;
+	if (entry.a < 0.5)
+		return vec4(1.0);
+
+	vec2 residentTexel = wrapped * virtualSize / exp2(floor(entry.b + 0.5));
+	vec2 slot = floor(entry.rg + 0.5);
+	vec2 atlasTexel = slot * (pageContentSize + 2.0 * pageBorderSize) + pageBorderSize + mod(residentTexel, pageContentSize);
+	return texture(ourTexture, atlasTexel / atlasSize);
+}
+
 void main()
 {
+	if (virtualTextured)
+	{
+		FragColor = sampleVirtualTexture();
+		return;
+	}
+
 	// Texture function will sample a texel from a sampler given a texture coordinate.
 	// The return value is a vector containing the sampled texture data.
     FragColor = texture(ourTexture, texCoord);
@@ -0,0 +1,23 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+// One transform per instance, see Mesh::DrawInstanced
+layout (location = 2) in mat4 instanceModel;
+
+out vec2 texCoord;
+
+// Set once per frame, see FrameUniforms
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
+
+void main()
+{
+    gl_Position = viewProjection * instanceModel * vec4(aPos, 1.0f);
+	texCoord = aTexCoord;
+}
\ No newline at end of file
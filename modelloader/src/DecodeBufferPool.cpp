@@ -0,0 +1,164 @@
+#include "DecodeBufferPool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+const std::size_t DecodeBufferPool::SmallestClassBytes;
+const std::size_t DecodeBufferPool::ClassCount;
+const std::size_t DecodeBufferPool::MaxPooledBytes;
+const std::size_t DecodeBufferPool::Unpooled;
+
+DecodeBufferPool& DecodeBufferPool::Global()
+{
+	// The pool is intentionally never destroyed. Other statics (the texture cache, the upload scheduler)
+	// May still hand blocks back to it while the program shuts down, and the order static objects
+	// Are destroyed in is hard to control across translation units.
+	static const auto pool = new DecodeBufferPool{};
+	return *pool;
+}
+
+void* DecodeBufferPool::Allocate(std::size_t size)
+{
+	const auto sizeClass = SizeClass(size);
+	BlockHeader* block = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (sizeClass != Unpooled && !freeBlocks[sizeClass].empty())
+		{
+			block = freeBlocks[sizeClass].back();
+			freeBlocks[sizeClass].pop_back();
+			stats.pooledBytes -= block->capacity;
+			stats.poolHits++;
+		}
+	}
+
+	if (block == nullptr)
+	{
+		const auto capacity = sizeClass == Unpooled ? size : SmallestClassBytes << sizeClass;
+		block = static_cast<BlockHeader*>(std::malloc(sizeof(BlockHeader) + capacity));
+
+		if (block == nullptr)
+			return nullptr;
+
+		block->sizeClass = sizeClass;
+		block->capacity = capacity;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		stats.allocations++;
+		stats.liveBytes += block->capacity;
+		stats.peakLiveBytes = std::max(stats.peakLiveBytes, stats.liveBytes);
+	}
+
+	return block + 1;
+}
+
+void* DecodeBufferPool::Reallocate(void* pointer, std::size_t newSize)
+{
+	if (pointer == nullptr)
+		return Allocate(newSize);
+
+	// Power of two classes leave some room at the end of most blocks, so growing often fits in place
+	const auto block = static_cast<BlockHeader*>(pointer) - 1;
+	if (newSize <= block->capacity)
+		return pointer;
+
+	const auto grown = Allocate(newSize);
+	if (grown == nullptr)
+		return nullptr;
+
+	std::memcpy(grown, pointer, block->capacity);
+	Free(pointer);
+
+	return grown;
+}
+
+void DecodeBufferPool::Free(void* pointer)
+{
+	if (pointer == nullptr)
+		return;
+
+	const auto block = static_cast<BlockHeader*>(pointer) - 1;
+
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		stats.liveBytes -= block->capacity;
+
+		if (block->sizeClass != Unpooled && stats.pooledBytes + block->capacity <= MaxPooledBytes)
+		{
+			freeBlocks[block->sizeClass].push_back(block);
+			stats.pooledBytes += block->capacity;
+			return;
+		}
+	}
+
+	std::free(block);
+}
+
+void DecodeBufferPool::Trim()
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+
+	for (auto& blocks : freeBlocks)
+	{
+		for (const auto block : blocks)
+			std::free(block);
+
+		blocks.clear();
+		blocks.shrink_to_fit();
+	}
+
+	stats.pooledBytes = 0;
+}
+
+DecodeMemoryStats DecodeBufferPool::GetStats()
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+	return stats;
+}
+
+std::size_t DecodeBufferPool::SizeClass(std::size_t size)
+{
+	if (size < SmallestClassBytes)
+		return Unpooled;
+
+	std::size_t sizeClass = 0;
+	while (sizeClass < ClassCount && (SmallestClassBytes << sizeClass) < size)
+		sizeClass++;
+
+	return sizeClass < ClassCount ? sizeClass : Unpooled;
+}
+
+void DecodeBufferDeleter::operator()(unsigned char* pixels) const
+{
+	DecodeBufferPool::Global().Free(pixels);
+}
+
+DecodeBuffer::DecodeBuffer(unsigned char* pixels, std::size_t size)
+	: pixels{ pixels }, byteCount{ size }
+{
+}
+
+DecodeBuffer DecodeBuffer::Allocate(std::size_t size)
+{
+	return DecodeBuffer{ static_cast<unsigned char*>(DecodeBufferPool::Global().Allocate(size)), size };
+}
+
+unsigned char* DecodeBuffer::data()
+{
+	return pixels.get();
+}
+
+const unsigned char* DecodeBuffer::data() const
+{
+	return pixels.get();
+}
+
+std::size_t DecodeBuffer::size() const
+{
+	return byteCount;
+}
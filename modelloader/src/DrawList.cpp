@@ -0,0 +1,156 @@
+#include "DrawList.hpp"
+
+#include <cassert>
+#include <chrono>
+
+void DrawList::Clear()
+{
+	items.clear();
+	queue.Clear();
+	commands.clear();
+	transforms.clear();
+	batches.clear();
+	textureSlots.clear();
+}
+
+void DrawList::Add(const DrawState& state, std::uint32_t indexCount, std::uint32_t firstIndex, std::int32_t baseVertex, const glm::mat4& transform)
+{
+	DrawItem item{};
+	item.state = state;
+	item.command = DrawCommand{ indexCount, 1, firstIndex, baseVertex, 0 };
+	item.transform = transform;
+
+	const auto texture = TextureSlot(state);
+	const auto viewDepth = -(view * transform[3]).z;
+	const auto key = RenderKey::Pack(0, 0, texture, state.vertexArray, RenderKey::DepthBucket(viewDepth, nearPlane, farPlane));
+	queue.Submit(key, static_cast<std::uint32_t>(items.size()));
+
+	items.push_back(item);
+}
+
+std::uint32_t DrawList::TextureSlot(const DrawState& state)
+{
+	// Virtual texture ids go above the 32 bits of a texture name, so the two never share a slot
+	const auto texture = state.virtualTexture ? std::uint64_t{ 1 } << 32 | state.virtualTextureId : std::uint64_t{ state.texture };
+	const auto slot = textureSlots.emplace(texture, static_cast<std::uint32_t>(textureSlots.size())).first->second;
+	assert(slot < (1u << RenderKey::TextureBits));
+	return slot;
+}
+
+void DrawList::SetView(const glm::mat4& view, float nearPlane, float farPlane)
+{
+	this->view = view;
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+}
+
+void DrawList::Build()
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+
+	// Only the keys and indices are sorted, the items themselves stay where they are
+	queue.Sort();
+
+	commands.clear();
+	transforms.clear();
+	batches.clear();
+	commands.reserve(items.size());
+	transforms.reserve(items.size());
+
+	const auto stateFields = RenderKey::Pass | RenderKey::Shader | RenderKey::Texture | RenderKey::VertexArray;
+	const auto& entries = queue.GetEntries();
+	for (std::size_t i = 0; i < entries.size(); i++)
+	{
+		const auto& item = items[entries[i].payload];
+
+		// A new batch starts only where the state changes, not where the depth does
+		if (i == 0 || (RenderKey::ChangedFields(entries[i - 1].key, entries[i].key) & stateFields) != 0)
+			batches.push_back(DrawBatch{ item.state, static_cast<std::uint32_t>(commands.size()), 0 });
+		batches.back().commandCount++;
+
+		auto command = item.command;
+		command.baseInstance = static_cast<std::uint32_t>(transforms.size());
+		commands.push_back(command);
+		transforms.push_back(item.transform);
+	}
+
+	stats.draws = commands.size();
+	stats.batches = batches.size();
+	stats.stateChanges = queue.GetStats().stateChanges;
+	stats.stateChangesAvoided = queue.GetStats().stateChangesAvoided;
+	stats.buildMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+std::size_t DrawList::Submit(RenderDevice& device, const DrawListBuffers& buffers, const std::function<void(const DrawState&)>& bindState) const
+{
+	return Submit(device, buffers, bindState, 0, batches.size());
+}
+
+std::size_t DrawList::Submit(RenderDevice& device, const DrawListBuffers& buffers, const std::function<void(const DrawState&)>& bindState,
+	std::size_t firstBatch, std::size_t batchCount) const
+{
+	assert(firstBatch + batchCount <= batches.size());
+
+	const auto multiDraw = device.SupportsMultiDrawIndirect();
+	std::size_t drawCalls = 0;
+
+	// Points the transform attribute at a transform. It advances once per instance, set up by the vertex array.
+	const auto bindTransforms = [&](std::size_t firstTransform)
+	{
+		const auto offset = buffers.transformOffset + firstTransform * sizeof(glm::mat4);
+		for (std::uint32_t column = 0; column < 4; column++)
+			device.SetVertexAttribute(buffers.transformLocation + column, 4, sizeof(glm::mat4), buffers.transformBuffer, offset + column * sizeof(glm::vec4));
+	};
+
+	for (auto index = firstBatch; index < firstBatch + batchCount; index++)
+	{
+		const auto& batch = batches[index];
+		if (bindState)
+			bindState(batch.state);
+		else
+			device.BindTexture(0, batch.state.texture);
+
+		device.BindVertexArray(batch.state.vertexArray);
+
+		if (multiDraw)
+		{
+			// The attribute points at the first transform of the frame, each command's baseInstance picks its own
+			bindTransforms(0);
+			device.MultiDrawIndexedIndirect(buffers.commandBuffer, buffers.commandOffset + batch.firstCommand * sizeof(DrawCommand), batch.commandCount);
+			drawCalls++;
+			continue;
+		}
+
+		// Without base instances, the attribute is pointed at each command's transform before drawing it
+		for (auto i = batch.firstCommand; i < batch.firstCommand + batch.commandCount; i++)
+		{
+			const auto& command = commands[i];
+			bindTransforms(command.baseInstance);
+			device.DrawIndexed(command.indexCount, command.firstIndex, command.baseVertex, command.instanceCount);
+			drawCalls++;
+		}
+	}
+
+	return drawCalls;
+}
+
+const std::vector<DrawCommand>& DrawList::GetCommands() const
+{
+	return commands;
+}
+
+const std::vector<glm::mat4>& DrawList::GetTransforms() const
+{
+	return transforms;
+}
+
+const std::vector<DrawBatch>& DrawList::GetBatches() const
+{
+	return batches;
+}
+
+DrawListStats DrawList::GetStats() const
+{
+	return stats;
+}
@@ -0,0 +1,150 @@
+#include "FramePipeline.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+const int FramePipeline::Latency;
+
+FramePipeline::FramePipeline(RenderDevice& device, UpdateStage update, RecordStage record, SubmitStage submit, ThreadPool& workers,
+	std::size_t recordJobCount)
+	: device{ device }, update{ std::move(update) }, record{ std::move(record) }, submit{ std::move(submit) }, updatedFrames{ 0 }, recordedFrames{ 0 }, submittedFrames{ 0 },
+	workers{ workers }
+{
+	if (recordJobCount == 0)
+		recordJobCount = std::max(1u, workers.GetWorkerCount());
+
+	// The lists take after the device they're replayed on, so the record jobs draw the same way they would on it
+	const auto multiDrawIndirect = device.SupportsMultiDrawIndirect();
+	for (auto& lists : commandLists)
+	{
+		for (std::size_t job = 0; job < recordJobCount; job++)
+			lists.push_back(std::unique_ptr<RecordingRenderDevice>{ new RecordingRenderDevice{ multiDrawIndirect, true } });
+	}
+	recordJobMilliseconds.resize(recordJobCount);
+}
+
+void FramePipeline::RunFrame()
+{
+	Step(true);
+}
+
+void FramePipeline::Flush()
+{
+	while (submittedFrames < updatedFrames)
+		Step(false);
+}
+
+void FramePipeline::Step(bool updating)
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+
+	const auto recording = recordedFrames < updatedFrames;
+	const auto submitting = submittedFrames < recordedFrames;
+	const auto updateFrame = updatedFrames;
+	const auto recordFrame = recordedFrames;
+	const auto submitFrame = submittedFrames;
+
+	// Frame n is recorded into one set of lists while frame n - 1 is submitted from the other
+	auto& recordLists = commandLists[recordFrame % 2];
+	const auto& submitLists = commandLists[submitFrame % 2];
+	const auto jobCount = recordLists.size();
+
+	FramePipelineStats frameStats{};
+	std::vector<Clock::time_point> recordStarts(jobCount, start);
+	std::vector<Clock::time_point> recordEnds(jobCount, start);
+	std::vector<std::thread::id> recordThreads(jobCount);
+
+	const auto updateJob = [&]()
+	{
+		const auto jobStart = Clock::now();
+		update(updateFrame);
+		frameStats.updateMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - jobStart).count();
+	};
+
+	const auto recordJob = [&](std::size_t job)
+	{
+		recordStarts[job] = Clock::now();
+		recordThreads[job] = std::this_thread::get_id();
+		auto& commands = *recordLists[job];
+		commands.ResetState();
+		record(recordFrame, job, jobCount, commands);
+		recordEnds[job] = Clock::now();
+		recordJobMilliseconds[job] = std::chrono::duration<double, std::milli>(recordEnds[job] - recordStarts[job]).count();
+	};
+
+	const auto submitJob = [&]()
+	{
+		const auto jobStart = Clock::now();
+		const auto replay = [&]()
+		{
+			for (const auto& commands : submitLists)
+				RecordingRenderDevice::Replay(commands->GetLastFrame(), device);
+		};
+
+		if (submit)
+			submit(submitFrame, replay);
+		else
+			replay();
+		frameStats.submitMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - jobStart).count();
+	};
+
+	// Job 0 is the submit, which Run keeps on this thread, the only one allowed to talk to the device. The update and
+	// The record jobs go to the workers.
+	const std::size_t updateJobs = updating ? 1 : 0;
+	const auto recordJobs = recording ? jobCount : 0;
+	workers.Run(1 + updateJobs + recordJobs, [&](std::size_t job)
+	{
+		if (job == 0)
+		{
+			if (submitting)
+				submitJob();
+		}
+		else if (job <= updateJobs)
+			updateJob();
+		else
+			recordJob(job - 1 - updateJobs);
+	});
+
+	if (updating)
+	{
+		frameStats.updateFrame = static_cast<std::int64_t>(updateFrame);
+		updatedFrames++;
+	}
+
+	if (recording)
+	{
+		// Starting a new frame on a list keeps what was recorded around for submitting
+		for (auto& commands : recordLists)
+		{
+			commands->BeginFrame();
+			frameStats.commands += commands->GetRecordingStats().commands;
+			frameStats.streamBytes += commands->GetRecordingStats().streamBytes;
+		}
+
+		for (const auto milliseconds : recordJobMilliseconds)
+			frameStats.recordMilliseconds += milliseconds;
+		frameStats.recordWallMilliseconds = std::chrono::duration<double, std::milli>(
+			*std::max_element(recordEnds.begin(), recordEnds.end()) - *std::min_element(recordStarts.begin(), recordStarts.end())).count();
+		frameStats.recordJobs = jobCount;
+		std::sort(recordThreads.begin(), recordThreads.end());
+		frameStats.recordThreads = static_cast<std::size_t>(std::unique(recordThreads.begin(), recordThreads.end()) - recordThreads.begin());
+		frameStats.recordFrame = static_cast<std::int64_t>(recordFrame);
+		recordedFrames++;
+	}
+
+	if (submitting)
+	{
+		frameStats.submitFrame = static_cast<std::int64_t>(submitFrame);
+		submittedFrames++;
+	}
+
+	frameStats.frameMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	stats = frameStats;
+}
+
+FramePipelineStats FramePipeline::GetStats() const
+{
+	return stats;
+}
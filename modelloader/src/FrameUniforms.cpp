@@ -0,0 +1,50 @@
+#include "FrameUniforms.hpp"
+
+#include "GLState.hpp"
+
+FrameUniforms& FrameUniforms::Global()
+{
+	static FrameUniforms frameUniforms{};
+	return frameUniforms;
+}
+
+FrameUniforms::FrameUniforms()
+	: cameraBuffer{ 0 }
+{
+}
+
+void FrameUniforms::CreateBuffer()
+{
+	glGenBuffers(1, &cameraBuffer);
+	GLState::Global().BindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraUniforms), nullptr, GL_DYNAMIC_DRAW);
+	GLState::Global().BindBufferBase(GL_UNIFORM_BUFFER, UniformBlocks::CameraBinding, cameraBuffer);
+	GLState::Global().BindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void FrameUniforms::BeginFrame(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition)
+{
+	if (cameraBuffer == 0)
+		CreateBuffer();
+
+	const auto uniformCounts = Shader::TakeUniformCounts();
+	stats.uniformUploads = uniformCounts.uploads;
+	stats.uniformUploadsSkipped = uniformCounts.skipped;
+	lastFrameStats = stats;
+	stats = FrameUniformStats{};
+
+	CameraUniforms camera{};
+	camera.view = view;
+	camera.projection = projection;
+	camera.viewProjection = projection * view;
+	camera.position = glm::vec4(cameraPosition, 1.0f);
+
+	GLState::Global().BindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(camera), &camera);
+	GLState::Global().BindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+FrameUniformStats FrameUniforms::GetStats() const
+{
+	return lastFrameStats;
+}
@@ -0,0 +1,34 @@
+#include "Frustum.hpp"
+
+Frustum Frustum::FromMatrix(const glm::mat4& viewProjection)
+{
+	// A point is inside the view volume when -w <= x, y, z <= w after transforming it by the matrix.
+	// Each of those six inequalities is a plane, made from the fourth row plus or minus one of the others.
+	// glm matrices are column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+	const auto row = [&](int i) {
+		return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	};
+
+	Frustum frustum{};
+	frustum.planes[0] = row(3) + row(0); // Left
+	frustum.planes[1] = row(3) - row(0); // Right
+	frustum.planes[2] = row(3) + row(1); // Bottom
+	frustum.planes[3] = row(3) - row(1); // Top
+	frustum.planes[4] = row(3) + row(2); // Near
+	frustum.planes[5] = row(3) - row(2); // Far
+
+	for (auto& plane : frustum.planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	return frustum;
+}
+
+bool Frustum::IntersectsSphere(const glm::vec3& center, float radius) const
+{
+	for (const auto& plane : planes)
+	{
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
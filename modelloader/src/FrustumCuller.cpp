@@ -0,0 +1,270 @@
+#include "FrustumCuller.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <limits>
+
+// SSE2 is part of every x64 processor, and the compiler's default for 32-bit x86 as well.
+// AVX has to be enabled for the build (/arch:AVX), as not every processor we run on has it.
+#if defined(__AVX__)
+#define FRUSTUM_CULLER_AVX
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FRUSTUM_CULLER_SSE
+#include <emmintrin.h>
+#endif
+
+const std::size_t FrustumCuller::ParallelThreshold;
+const std::size_t FrustumCuller::Padding;
+
+BoundingVolume BoundingVolume::FromBox(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& transform)
+{
+	// Each axis of the transformed box extends as far as the absolute values of the rotated and scaled axes add up to
+	const auto localCenter = (localMin + localMax) * 0.5f;
+	const auto localExtent = (localMax - localMin) * 0.5f;
+	const auto center = glm::vec3(transform * glm::vec4(localCenter, 1.0f));
+	const auto extent = glm::abs(glm::vec3(transform[0])) * localExtent.x
+		+ glm::abs(glm::vec3(transform[1])) * localExtent.y
+		+ glm::abs(glm::vec3(transform[2])) * localExtent.z;
+
+	BoundingVolume bounds{};
+	bounds.center = center;
+	bounds.radius = glm::length(extent);
+	bounds.min = center - extent;
+	bounds.max = center + extent;
+	return bounds;
+}
+
+FrustumCuller::FrustumCuller(ThreadPool& workers)
+	: count{ 0 }, workers{ workers }
+{
+}
+
+void FrustumCuller::Clear()
+{
+	count = 0;
+	for (auto array : { &centerX, &centerY, &centerZ, &radius, &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+		array->clear();
+	payloads.clear();
+}
+
+void FrustumCuller::Reserve(std::size_t objectCount)
+{
+	const auto padded = (objectCount + Padding - 1) / Padding * Padding;
+	for (auto array : { &centerX, &centerY, &centerZ, &radius, &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+		array->reserve(padded);
+	payloads.reserve(padded);
+}
+
+std::size_t FrustumCuller::Add(const BoundingVolume& bounds, std::uint32_t payload)
+{
+	// Padding objects have a radius no distance can beat, so they never pass the sphere test
+	if (count == payloads.size())
+	{
+		for (auto array : { &centerX, &centerY, &centerZ, &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+			array->resize(count + Padding, 0.0f);
+		radius.resize(count + Padding, -std::numeric_limits<float>::max());
+		payloads.resize(count + Padding, 0);
+	}
+
+	const auto index = count++;
+	payloads[index] = payload;
+	Set(index, bounds);
+	return index;
+}
+
+void FrustumCuller::Set(std::size_t index, const BoundingVolume& bounds)
+{
+	assert(index < count);
+
+	centerX[index] = bounds.center.x;
+	centerY[index] = bounds.center.y;
+	centerZ[index] = bounds.center.z;
+	radius[index] = bounds.radius;
+	minX[index] = bounds.min.x;
+	minY[index] = bounds.min.y;
+	minZ[index] = bounds.min.z;
+	maxX[index] = bounds.max.x;
+	maxY[index] = bounds.max.y;
+	maxZ[index] = bounds.max.z;
+}
+
+std::size_t FrustumCuller::GetCount() const
+{
+	return count;
+}
+
+// first and last have to be multiples of Padding
+void FrustumCuller::CullRange(const Frustum& frustum, std::size_t first, std::size_t last, std::vector<std::uint32_t>& visible) const
+{
+	// For each plane, the corner of a box furthest along its normal is the last one to leave the frustum.
+	// The normal is the same for every box, so which of min and max that corner is made of is too.
+	const float* cornerX[6];
+	const float* cornerY[6];
+	const float* cornerZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		cornerX[p] = frustum.planes[p].x > 0.0f ? maxX.data() : minX.data();
+		cornerY[p] = frustum.planes[p].y > 0.0f ? maxY.data() : minY.data();
+		cornerZ[p] = frustum.planes[p].z > 0.0f ? maxZ.data() : minZ.data();
+	}
+
+#if defined(FRUSTUM_CULLER_AVX)
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+
+	const auto zero = _mm256_setzero_ps();
+	for (auto i = first; i < last; i += 8)
+	{
+		const auto x = _mm256_loadu_ps(centerX.data() + i);
+		const auto y = _mm256_loadu_ps(centerY.data() + i);
+		const auto z = _mm256_loadu_ps(centerZ.data() + i);
+		const auto negativeRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(radius.data() + i));
+
+		auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			const auto sphereDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+				_mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+			const auto cornerDistance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(planeX[p], _mm256_loadu_ps(cornerX[p] + i)), _mm256_mul_ps(planeY[p], _mm256_loadu_ps(cornerY[p] + i))),
+				_mm256_add_ps(_mm256_mul_ps(planeZ[p], _mm256_loadu_ps(cornerZ[p] + i)), planeW[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(sphereDistance, negativeRadius, _CMP_GE_OQ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(cornerDistance, zero, _CMP_GE_OQ));
+
+			// Most objects are outside of the frustum, and most of those behind the first plane or two
+			if (_mm256_movemask_ps(inside) == 0)
+				break;
+		}
+
+		// Writes the payloads of the visible lanes one after the other
+		const auto mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; lane++)
+		{
+			if (mask & (1 << lane))
+				visible.push_back(payloads[i + lane]);
+		}
+	}
+#elif defined(FRUSTUM_CULLER_SSE)
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	const auto zero = _mm_setzero_ps();
+	for (auto i = first; i < last; i += 4)
+	{
+		const auto x = _mm_loadu_ps(centerX.data() + i);
+		const auto y = _mm_loadu_ps(centerY.data() + i);
+		const auto z = _mm_loadu_ps(centerZ.data() + i);
+		const auto negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(radius.data() + i));
+
+		auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			const auto sphereDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+			const auto cornerDistance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planeX[p], _mm_loadu_ps(cornerX[p] + i)), _mm_mul_ps(planeY[p], _mm_loadu_ps(cornerY[p] + i))),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], _mm_loadu_ps(cornerZ[p] + i)), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(sphereDistance, negativeRadius));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(cornerDistance, zero));
+
+			// Most objects are outside of the frustum, and most of those behind the first plane or two
+			if (_mm_movemask_ps(inside) == 0)
+				break;
+		}
+
+		// Writes the payloads of the visible lanes one after the other
+		const auto mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (mask & (1 << lane))
+				visible.push_back(payloads[i + lane]);
+		}
+	}
+#else
+	for (auto i = first; i < last; i++)
+	{
+		auto inside = true;
+		for (int p = 0; p < 6 && inside; p++)
+		{
+			const auto& plane = frustum.planes[p];
+			const auto sphereDistance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+			const auto cornerDistance = plane.x * cornerX[p][i] + plane.y * cornerY[p][i] + plane.z * cornerZ[p][i] + plane.w;
+			inside = sphereDistance >= -radius[i] && cornerDistance >= 0.0f;
+		}
+
+		if (inside)
+			visible.push_back(payloads[i]);
+	}
+#endif
+}
+
+void FrustumCuller::Cull(const Frustum& frustum, std::vector<std::uint32_t>& visible)
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+
+	stats = FrustumCullerStats{};
+	stats.objects = count;
+#if defined(FRUSTUM_CULLER_AVX)
+	stats.lanes = 8;
+#elif defined(FRUSTUM_CULLER_SSE)
+	stats.lanes = 4;
+#endif
+
+	visible.clear();
+	const auto padded = (count + Padding - 1) / Padding * Padding;
+
+	if (count < ParallelThreshold || workers.GetWorkerCount() == 0)
+	{
+		stats.jobs = 1;
+		CullRange(frustum, 0, padded, visible);
+	}
+	else
+	{
+		// One piece per worker, and one for us. Each writes its own list, so the order stays the same as with one thread.
+		// Pieces are rounded up to whole SIMD blocks, so together they always cover every object. The last ones can
+		// End up shorter, or even empty.
+		const auto jobCount = static_cast<std::size_t>(workers.GetWorkerCount()) + 1;
+		const auto jobSize = (padded + jobCount * Padding - 1) / (jobCount * Padding) * Padding;
+		jobVisible.resize(jobCount);
+
+		workers.Run(jobCount, [&](std::size_t job)
+		{
+			const auto first = std::min(job * jobSize, padded);
+			const auto last = std::min(first + jobSize, padded);
+			jobVisible[job].clear();
+			CullRange(frustum, first, last, jobVisible[job]);
+		});
+
+		std::size_t visibleCount = 0;
+		for (const auto& jobList : jobVisible)
+			visibleCount += jobList.size();
+		visible.reserve(visibleCount);
+		for (const auto& jobList : jobVisible)
+			visible.insert(visible.end(), jobList.begin(), jobList.end());
+
+		stats.jobs = jobCount;
+	}
+
+	stats.visible = visible.size();
+	stats.milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+FrustumCullerStats FrustumCuller::GetStats() const
+{
+	return stats;
+}
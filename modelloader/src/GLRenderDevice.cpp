@@ -0,0 +1,301 @@
+#include "GLRenderDevice.hpp"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_set>
+
+#include "GLState.hpp"
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+GLRenderDevice::GLRenderDevice()
+	: functionsLoaded{ false }, multiDrawElementsIndirect{ nullptr }, depthTest{ -1 }, viewport{ -1 }, clearColor{ -1.0f }
+{
+}
+
+void GLRenderDevice::LoadFunctions()
+{
+	functionsLoaded = true;
+
+	std::unordered_set<std::string> extensions{};
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount; i++)
+		extensions.insert(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
+
+	// Without base instances, every command would read the first transform
+	if (extensions.count("GL_ARB_multi_draw_indirect") == 0 || extensions.count("GL_ARB_base_instance") == 0)
+	{
+		OutputDebugStringA("Multi-draw indirect isn't supported, drawing one command at a time\n");
+		return;
+	}
+
+	multiDrawElementsIndirect = reinterpret_cast<MultiDrawElementsIndirectFunction>(wglGetProcAddress("glMultiDrawElementsIndirect"));
+	if (!multiDrawElementsIndirect)
+		OutputDebugStringA("Failed to load glMultiDrawElementsIndirect, drawing one command at a time\n");
+}
+
+bool GLRenderDevice::SupportsMultiDrawIndirect()
+{
+	if (!functionsLoaded)
+		LoadFunctions();
+	return multiDrawElementsIndirect != nullptr;
+}
+
+void GLRenderDevice::BeginFrame()
+{
+	// Bindings are filtered by GLState, which counts every binding in the program, not just ours
+	GLState::Global().BeginFrame();
+	const auto bindings = GLState::Global().GetStats();
+	stats.stateChanges += bindings.issued;
+	stats.stateChangesFiltered += bindings.filtered;
+
+	lastFrameStats = stats;
+	stats = RenderDeviceStats{};
+}
+
+GLenum GLRenderDevice::Target(BufferTarget target)
+{
+	switch (target)
+	{
+	case BufferTarget::Vertex:
+		return GL_ARRAY_BUFFER;
+	case BufferTarget::Index:
+		return GL_ELEMENT_ARRAY_BUFFER;
+	case BufferTarget::Uniform:
+		return GL_UNIFORM_BUFFER;
+	case BufferTarget::Indirect:
+		return GL_DRAW_INDIRECT_BUFFER;
+	default:
+		assert(false);
+		return GL_ARRAY_BUFFER;
+	}
+}
+
+std::uint32_t GLRenderDevice::CreateBuffer(BufferTarget /*target*/, std::size_t bytes, const void* data, BufferUsage usage)
+{
+	const auto glUsage = usage == BufferUsage::Static ? GL_STATIC_DRAW : usage == BufferUsage::Dynamic ? GL_DYNAMIC_DRAW : GL_STREAM_DRAW;
+
+	// OpenGL buffers can be bound to any target later, whatever they were created for, so the target goes unused
+	// Here. The copy target is used to fill them, since binding an index buffer would attach it to whichever vertex array is bound.
+	GLuint buffer = 0;
+	glGenBuffers(1, &buffer);
+	GLState::Global().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, bytes, data, glUsage);
+
+	if (data)
+		stats.bufferBytesUploaded += bytes;
+	return buffer;
+}
+
+void GLRenderDevice::UpdateBuffer(std::uint32_t buffer, std::size_t offset, std::size_t bytes, const void* data)
+{
+	GLState::Global().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+	stats.bufferBytesUploaded += bytes;
+}
+
+void GLRenderDevice::DeleteBuffer(std::uint32_t buffer)
+{
+	GLState::Global().DeleteBuffers(1, &buffer);
+}
+
+std::uint32_t GLRenderDevice::CreateTexture(int width, int height, int levelCount)
+{
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, texture);
+
+	// Every level is allocated up front, so the texture is complete before its contents arrive
+	for (int level = 0; level < levelCount; level++)
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, std::max(width >> level, 1), std::max(height >> level, 1), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	return texture;
+}
+
+void GLRenderDevice::UpdateTexture(std::uint32_t texture, int level, int x, int y, int width, int height, const void* pixels)
+{
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, texture);
+	glTexSubImage2D(GL_TEXTURE_2D, level, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	stats.textureBytesUploaded += static_cast<std::size_t>(width) * height * 4;
+}
+
+void GLRenderDevice::DeleteTexture(std::uint32_t texture)
+{
+	GLState::Global().DeleteTextures(1, &texture);
+}
+
+GLuint GLRenderDevice::CompileShader(GLenum type, const std::string& source)
+{
+	const auto code = source.c_str();
+	const auto shader = glCreateShader(type);
+	glShaderSource(shader, 1, &code, nullptr);
+	glCompileShader(shader);
+
+	// Print compile errors if any
+	int success = 0;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		char infoLog[512];
+		glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+		OutputDebugStringA(type == GL_VERTEX_SHADER ? "Failed to compile vertex shader\n" : "Failed to compile fragment shader\n");
+		OutputDebugStringA(infoLog);
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+std::uint32_t GLRenderDevice::CreateProgram(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	const auto vertex = CompileShader(GL_VERTEX_SHADER, vertexSource);
+	const auto fragment = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+	if (vertex == 0 || fragment == 0)
+	{
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		return 0;
+	}
+
+	auto program = glCreateProgram();
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	glLinkProgram(program);
+
+	// Print linking errors if any
+	int success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		char infoLog[512];
+		glGetProgramInfoLog(program, 512, nullptr, infoLog);
+		OutputDebugStringA("Failed to link shader program\n");
+		OutputDebugStringA(infoLog);
+		GLState::Global().DeleteProgram(program);
+		program = 0;
+	}
+
+	// Delete the shaders as they're linked into our program now and no longer necessary
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+
+	return program;
+}
+
+void GLRenderDevice::DeleteProgram(std::uint32_t program)
+{
+	GLState::Global().DeleteProgram(program);
+}
+
+void GLRenderDevice::UseProgram(std::uint32_t program)
+{
+	GLState::Global().UseProgram(program);
+}
+
+void GLRenderDevice::BindVertexArray(std::uint32_t vertexArray)
+{
+	GLState::Global().BindVertexArray(vertexArray);
+}
+
+void GLRenderDevice::BindBuffer(BufferTarget target, std::uint32_t buffer)
+{
+	GLState::Global().BindBuffer(Target(target), buffer);
+}
+
+void GLRenderDevice::BindUniformBuffer(std::uint32_t index, std::uint32_t buffer, std::size_t offset, std::size_t bytes)
+{
+	GLState::Global().BindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, bytes);
+}
+
+void GLRenderDevice::BindTexture(std::uint32_t unit, std::uint32_t texture)
+{
+	GLState::Global().BindTexture(unit, GL_TEXTURE_2D, texture);
+}
+
+void GLRenderDevice::SetVertexAttribute(std::uint32_t location, int components, std::size_t stride, std::uint32_t buffer, std::size_t offset)
+{
+	// The attribute remembers the buffer bound when it is set, so what stays bound to GL_ARRAY_BUFFER doesn't matter
+	GLState::Global().BindBuffer(GL_ARRAY_BUFFER, buffer);
+	glVertexAttribPointer(location, components, GL_FLOAT, false, static_cast<GLsizei>(stride), reinterpret_cast<const void*>(offset));
+	glEnableVertexAttribArray(location);
+	stats.stateChanges++;
+}
+
+void GLRenderDevice::SetViewport(int x, int y, int width, int height)
+{
+	const auto value = glm::ivec4(x, y, width, height);
+	if (viewport == value)
+	{
+		stats.stateChangesFiltered++;
+		return;
+	}
+
+	viewport = value;
+	glViewport(x, y, width, height);
+	stats.stateChanges++;
+}
+
+void GLRenderDevice::SetDepthTest(bool enabled)
+{
+	if (depthTest == static_cast<int>(enabled))
+	{
+		stats.stateChangesFiltered++;
+		return;
+	}
+
+	depthTest = enabled;
+	if (enabled)
+		glEnable(GL_DEPTH_TEST);
+	else
+		glDisable(GL_DEPTH_TEST);
+	stats.stateChanges++;
+}
+
+void GLRenderDevice::Clear(const glm::vec4& color)
+{
+	if (clearColor != color)
+	{
+		clearColor = color;
+		glClearColor(color.r, color.g, color.b, color.a);
+	}
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GLRenderDevice::DrawIndexed(std::uint32_t indexCount, std::uint32_t firstIndex, std::int32_t baseVertex, std::uint32_t instanceCount)
+{
+	const auto offset = reinterpret_cast<const void*>(firstIndex * sizeof(unsigned int));
+	if (instanceCount == 1)
+		glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(indexCount), GL_UNSIGNED_INT, offset, baseVertex);
+	else
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(indexCount), GL_UNSIGNED_INT, offset, static_cast<GLsizei>(instanceCount), baseVertex);
+
+	stats.drawCalls++;
+	stats.draws++;
+	stats.triangles += indexCount / 3 * instanceCount;
+}
+
+void GLRenderDevice::MultiDrawIndexedIndirect(std::uint32_t buffer, std::size_t offset, std::uint32_t drawCount)
+{
+	assert(SupportsMultiDrawIndirect());
+
+	GLState::Global().BindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+	multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(offset), static_cast<GLsizei>(drawCount), 0);
+
+	stats.drawCalls++;
+	stats.draws += drawCount;
+}
+
+RenderDeviceStats GLRenderDevice::GetStats() const
+{
+	return lastFrameStats;
+}
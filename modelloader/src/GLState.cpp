@@ -0,0 +1,307 @@
+#include "GLState.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+const int GLState::TextureUnitCount;
+const int GLState::UniformBufferBindingCount;
+const GLuint GLState::Unknown;
+
+GLState& GLState::Global()
+{
+	static GLState state{};
+	return state;
+}
+
+GLState::GLState()
+{
+	Invalidate();
+}
+
+void GLState::Invalidate()
+{
+	program = Unknown;
+	vertexArray = Unknown;
+	arrayBuffer = Unknown;
+	elementArrayBuffer = Unknown;
+	copyReadBuffer = Unknown;
+	copyWriteBuffer = Unknown;
+	pixelPackBuffer = Unknown;
+	pixelUnpackBuffer = Unknown;
+	uniformBuffer = Unknown;
+	drawIndirectBuffer = Unknown;
+	for (auto& range : uniformBufferRanges)
+		range = BufferRange{ Unknown, 0, 0 };
+	activeTextureUnit = Unknown;
+	std::fill(std::begin(textures), std::end(textures), Unknown);
+	drawFramebuffer = Unknown;
+	readFramebuffer = Unknown;
+	renderbuffer = Unknown;
+}
+
+void GLState::BeginFrame()
+{
+	lastFrameStats = stats;
+	stats = GLStateStats{};
+}
+
+// Returns true if the call can be skipped. Otherwise remembers the new value, and counts the call as issued.
+bool GLState::Filter(GLuint& current, GLuint value)
+{
+	if (current == value)
+	{
+		stats.filtered++;
+		return true;
+	}
+
+	current = value;
+	stats.issued++;
+	return false;
+}
+
+GLuint* GLState::BufferBinding(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:
+		return &arrayBuffer;
+	case GL_ELEMENT_ARRAY_BUFFER:
+		return &elementArrayBuffer;
+	case GL_COPY_READ_BUFFER:
+		return &copyReadBuffer;
+	case GL_COPY_WRITE_BUFFER:
+		return &copyWriteBuffer;
+	case GL_PIXEL_PACK_BUFFER:
+		return &pixelPackBuffer;
+	case GL_PIXEL_UNPACK_BUFFER:
+		return &pixelUnpackBuffer;
+	case GL_UNIFORM_BUFFER:
+		return &uniformBuffer;
+	case GL_DRAW_INDIRECT_BUFFER:
+		return &drawIndirectBuffer;
+	default:
+		return nullptr;
+	}
+}
+
+void GLState::UseProgram(GLuint program)
+{
+	if (!Filter(this->program, program))
+		glUseProgram(program);
+}
+
+void GLState::BindVertexArray(GLuint vertexArray)
+{
+	if (Filter(this->vertexArray, vertexArray))
+		return;
+
+	glBindVertexArray(vertexArray);
+	elementArrayBuffer = Unknown;
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer)
+{
+	const auto binding = BufferBinding(target);
+	if (!binding)
+	{
+		stats.issued++;
+		glBindBuffer(target, buffer);
+		return;
+	}
+
+	if (!Filter(*binding, buffer))
+		glBindBuffer(target, buffer);
+}
+
+void GLState::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	// Binding to an index binds to the general binding point of the target as well
+	if (const auto binding = BufferBinding(target))
+		*binding = buffer;
+
+	if (target == GL_UNIFORM_BUFFER && index < UniformBufferBindingCount)
+		uniformBufferRanges[index] = BufferRange{ Unknown, 0, 0 };
+
+	stats.issued++;
+	glBindBufferBase(target, index, buffer);
+}
+
+void GLState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	if (target != GL_UNIFORM_BUFFER || index >= UniformBufferBindingCount)
+	{
+		if (const auto binding = BufferBinding(target))
+			*binding = buffer;
+
+		stats.issued++;
+		glBindBufferRange(target, index, buffer, offset, size);
+		return;
+	}
+
+	auto& range = uniformBufferRanges[index];
+	if (range.buffer == buffer && range.offset == offset && range.size == size)
+	{
+		stats.filtered++;
+		return;
+	}
+
+	range = BufferRange{ buffer, offset, size };
+	uniformBuffer = buffer;
+	stats.issued++;
+	glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void GLState::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if (target != GL_TEXTURE_2D || unit >= TextureUnitCount)
+	{
+		if (!Filter(activeTextureUnit, unit))
+			glActiveTexture(GL_TEXTURE0 + unit);
+
+		// We don't know what this did to the 2D binding of the unit
+		if (unit < TextureUnitCount)
+			textures[unit] = Unknown;
+
+		stats.issued++;
+		glBindTexture(target, texture);
+		return;
+	}
+
+	// The unit is made active even when the texture is already bound to it, as callers go on to edit whatever is
+	// Bound to the active unit
+	if (!Filter(activeTextureUnit, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+
+	if (textures[unit] == texture)
+	{
+		stats.filtered++;
+		return;
+	}
+
+	textures[unit] = texture;
+	stats.issued++;
+	glBindTexture(target, texture);
+}
+
+void GLState::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	switch (target)
+	{
+	case GL_FRAMEBUFFER:
+		if (drawFramebuffer == framebuffer && readFramebuffer == framebuffer)
+		{
+			stats.filtered++;
+			return;
+		}
+		drawFramebuffer = framebuffer;
+		readFramebuffer = framebuffer;
+		stats.issued++;
+		glBindFramebuffer(target, framebuffer);
+		break;
+	case GL_DRAW_FRAMEBUFFER:
+		if (!Filter(drawFramebuffer, framebuffer))
+			glBindFramebuffer(target, framebuffer);
+		break;
+	case GL_READ_FRAMEBUFFER:
+		if (!Filter(readFramebuffer, framebuffer))
+			glBindFramebuffer(target, framebuffer);
+		break;
+	default:
+		stats.issued++;
+		glBindFramebuffer(target, framebuffer);
+		break;
+	}
+}
+
+void GLState::BindRenderbuffer(GLenum target, GLuint renderbuffer)
+{
+	if (!Filter(this->renderbuffer, renderbuffer))
+		glBindRenderbuffer(target, renderbuffer);
+}
+
+// OpenGL unbinds deleted objects, and the names can come back from the next glGen* call.
+// Whatever held a deleted name is forgotten, so binding the reused name is never skipped.
+void GLState::DeleteProgram(GLuint program)
+{
+	if (this->program == program)
+		this->program = Unknown;
+	glDeleteProgram(program);
+}
+
+void GLState::DeleteVertexArrays(GLsizei count, const GLuint* vertexArrays)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if (vertexArray == vertexArrays[i])
+		{
+			vertexArray = Unknown;
+			elementArrayBuffer = Unknown;
+		}
+	}
+	glDeleteVertexArrays(count, vertexArrays);
+}
+
+void GLState::DeleteBuffers(GLsizei count, const GLuint* buffers)
+{
+	GLuint* bindings[] = { &arrayBuffer, &elementArrayBuffer, &copyReadBuffer, &copyWriteBuffer, &pixelPackBuffer,
+		&pixelUnpackBuffer, &uniformBuffer, &drawIndirectBuffer };
+
+	for (GLsizei i = 0; i < count; i++)
+	{
+		for (auto binding : bindings)
+		{
+			if (*binding == buffers[i])
+				*binding = Unknown;
+		}
+		for (auto& range : uniformBufferRanges)
+		{
+			if (range.buffer == buffers[i])
+				range = BufferRange{ Unknown, 0, 0 };
+		}
+	}
+	glDeleteBuffers(count, buffers);
+}
+
+void GLState::DeleteTextures(GLsizei count, const GLuint* textures)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		for (auto& texture : this->textures)
+		{
+			if (texture == textures[i])
+				texture = Unknown;
+		}
+	}
+	glDeleteTextures(count, textures);
+}
+
+void GLState::DeleteFramebuffers(GLsizei count, const GLuint* framebuffers)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if (drawFramebuffer == framebuffers[i])
+			drawFramebuffer = Unknown;
+		if (readFramebuffer == framebuffers[i])
+			readFramebuffer = Unknown;
+	}
+	glDeleteFramebuffers(count, framebuffers);
+}
+
+void GLState::DeleteRenderbuffers(GLsizei count, const GLuint* renderbuffers)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if (renderbuffer == renderbuffers[i])
+			renderbuffer = Unknown;
+	}
+	glDeleteRenderbuffers(count, renderbuffers);
+}
+
+GLStateStats GLState::GetStats() const
+{
+	return lastFrameStats;
+}
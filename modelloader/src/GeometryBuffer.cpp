@@ -0,0 +1,230 @@
+#include "GeometryBuffer.hpp"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+
+#include "GLState.hpp"
+
+const GLuint GeometryBuffer::InstanceAttributeLocation;
+const std::uint32_t GeometryBuffer::InitialVertexCount;
+const std::uint32_t GeometryBuffer::InitialIndexCount;
+
+GeometryBuffer& GeometryBuffer::Global()
+{
+	static GeometryBuffer geometryBuffer{};
+	return geometryBuffer;
+}
+
+GeometryBuffer::GeometryBuffer()
+{
+}
+
+GeometryBuffer::~GeometryBuffer()
+{
+	for (auto& pool : pools)
+	{
+		if (pool.vertexArray == 0)
+			continue;
+
+		GLState::Global().DeleteVertexArrays(1, &pool.vertexArray);
+		GLState::Global().DeleteBuffers(1, &pool.vertexBuffer);
+		GLState::Global().DeleteBuffers(1, &pool.indexBuffer);
+	}
+}
+
+std::size_t GeometryBuffer::VertexStride(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::PositionTexCoord:
+		return sizeof(float) * 5;
+	default:
+		assert(false);
+		return 0;
+	}
+}
+
+GeometryBuffer::Pool& GeometryBuffer::GetPool(VertexFormat format)
+{
+	auto& pool = pools[static_cast<int>(format)];
+	if (pool.vertexArray == 0)
+		CreatePool(format, pool);
+	return pool;
+}
+
+void GeometryBuffer::CreatePool(VertexFormat format, Pool& pool)
+{
+	pool.vertices = std::make_unique<OffsetAllocator>(InitialVertexCount);
+	pool.indices = std::make_unique<OffsetAllocator>(InitialIndexCount);
+
+	// OpenGl Core REQUIRES us to use Vertex Array Objects (VAOs)
+	// VAOs are OpenGL objects which will save state related to these calls:
+	// -- Calls to glEnableVertexAttribArray or glDisableVertexAttribArray
+	// -- Vertex attribute configurations via glVertexAttribPointer
+	// -- Vertex buffer objects associated with vertex attributes by calls to glVertexAttribPointer
+	// Every mesh of this format shares the VAO, so it is set up once.
+	glGenVertexArrays(1, &pool.vertexArray);
+	GLState::Global().BindVertexArray(pool.vertexArray);
+
+	// Generate EBO
+	glGenBuffers(1, &pool.indexBuffer);
+	GLState::Global().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.indexBuffer);
+	// The storage is allocated here, but left empty. The data of each mesh is uploaded into its range
+	// Through the UploadScheduler, which splits large meshes into several smaller uploads spread over multiple frames.
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, InitialIndexCount * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+
+	// We generate an OpenGL buffer object
+	// OpenGL buffers can be used for many things. They are simply allocated memory which can be used
+	// to store whatever you want
+	glGenBuffers(1, &pool.vertexBuffer);
+
+	// Now we bind our generated buffer to the GL_ARRAY_BUFFER target. This essentially means that we will
+	// be using it is a vertex buffer object.
+	GLState::Global().BindBuffer(GL_ARRAY_BUFFER, pool.vertexBuffer);
+
+	// We hint to OpenGL that the data most likely won't change. This means that OpenGL can make some assumptions
+	// about the data which can be used to optimize it.
+	const auto stride = static_cast<GLsizei>(VertexStride(format));
+	glBufferData(GL_ARRAY_BUFFER, InitialVertexCount * VertexStride(format), nullptr, GL_STATIC_DRAW);
+
+	// In the vertex shader we specified that location 0 accepted a 3D vector as input
+	// OpenGL is very flexible when it comes to how to feed input into that location
+	// But that also means we have to describe how the buffer is structured
+	// So that OpenGL knows how to take the x, y and z number of each vertex described
+	// in our array
+	// Parameter 1: The index of the location we want to input to
+	// Parameter 2: The number of components per generic vertex attribute
+	// -- We have 3 components, since our input is a Vec3 in the vertex shader
+	// Parameter 3: The data type of each component.
+	// -- They are 32-bit floats
+	// Parameter 4: Should data be normalized. Should be FALSE for floats.
+	// Parameter 5: The byte offset between each consecutive generic vertex attribute.
+	// -- Our array is tightly packed, so 0 byte offset between them
+	// Parameter 6: The byte offset of the first component of the first generic vertex
+	// Attribute.
+	// -- This is 0 for us. It begins at the start of the array.
+	// NOTICE: glVertexAttribPointer reads the currently bound buffer in GL_ARRAY_BUFFER
+	// and stores it in the VAO, so unbinding the buffer in GL_ARRAY_BUFFER will not affect
+	// The currently bound VAO
+	// Meshes don't start at the beginning of the buffer, but that's taken care of by the base vertex of each draw.
+	switch (format)
+	{
+	case VertexFormat::PositionTexCoord:
+		// Position attribute
+		glVertexAttribPointer(0, 3, GL_FLOAT, false, stride, (void*)0);
+		glEnableVertexAttribArray(0);
+
+		// Texture UV attribute
+		glVertexAttribPointer(1, 2, GL_FLOAT, false, stride, (void*)(sizeof(float) * 3));
+		glEnableVertexAttribArray(1);
+		break;
+	default:
+		assert(false);
+		break;
+	}
+
+	// Instance transform attribute, for Mesh::DrawInstanced. It advances once per instance instead of once per vertex.
+	// Which buffer it reads from is only known when drawing, so it is enabled there.
+	for (GLuint column = 0; column < 4; column++)
+		glVertexAttribDivisor(InstanceAttributeLocation + column, 1);
+
+	// Cleanup
+	GLState::Global().BindVertexArray(0);
+	GLState::Global().BindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::Global().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void GeometryBuffer::GrowBuffer(GLuint buffer, std::size_t oldBytes, std::size_t newBytes)
+{
+	// Giving the buffer new storage would throw away its contents, so they are copied out and back in.
+	// The buffer object stays the same, so the vertex array and any pending uploads into it stay valid.
+	GLuint copy = 0;
+	glGenBuffers(1, &copy);
+	GLState::Global().BindBuffer(GL_COPY_WRITE_BUFFER, copy);
+	glBufferData(GL_COPY_WRITE_BUFFER, oldBytes, nullptr, GL_STREAM_COPY);
+	GLState::Global().BindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+
+	glBufferData(GL_COPY_READ_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+	glCopyBufferSubData(GL_COPY_WRITE_BUFFER, GL_COPY_READ_BUFFER, 0, 0, oldBytes);
+
+	GLState::Global().BindBuffer(GL_COPY_READ_BUFFER, 0);
+	GLState::Global().BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	GLState::Global().DeleteBuffers(1, &copy);
+}
+
+OffsetAllocation GeometryBuffer::AllocateGrowing(OffsetAllocator& allocator, std::uint32_t count, GLuint buffer, std::size_t elementBytes)
+{
+	auto allocation = allocator.Allocate(count);
+	if (allocation.IsValid())
+		return allocation;
+
+	// Doubling keeps the number of copies low. Adding the count on top makes sure it fits, even if the free space
+	// At the end of the buffer is split over several bins.
+	const auto oldSize = allocator.GetSize();
+	const auto newSize = static_cast<std::uint32_t>(std::min<std::uint64_t>(std::uint64_t{ oldSize } * 2 + count, 0xffffffffu));
+	GrowBuffer(buffer, oldSize * elementBytes, newSize * elementBytes);
+	allocator.Grow(newSize);
+
+	const auto message = "Geometry buffer grown to " + std::to_string(newSize) + " elements\n";
+	OutputDebugStringA(message.c_str());
+
+	allocation = allocator.Allocate(count);
+	assert(allocation.IsValid());
+	return allocation;
+}
+
+GeometryAllocation GeometryBuffer::Allocate(VertexFormat format, std::uint32_t vertexCount, std::uint32_t indexCount)
+{
+	auto& pool = GetPool(format);
+
+	GeometryAllocation allocation{};
+	allocation.format = format;
+	allocation.vertices = AllocateGrowing(*pool.vertices, vertexCount, pool.vertexBuffer, VertexStride(format));
+	allocation.indices = AllocateGrowing(*pool.indices, indexCount, pool.indexBuffer, sizeof(unsigned int));
+	allocation.baseVertex = static_cast<GLint>(allocation.vertices.offset);
+	allocation.firstIndex = allocation.indices.offset;
+	allocation.indexCount = static_cast<GLsizei>(indexCount);
+	return allocation;
+}
+
+void GeometryBuffer::Free(const GeometryAllocation& allocation)
+{
+	auto& pool = pools[static_cast<int>(allocation.format)];
+	if (pool.vertexArray == 0)
+		return;
+
+	pool.vertices->Free(allocation.vertices);
+	pool.indices->Free(allocation.indices);
+}
+
+GLuint GeometryBuffer::GetVertexArray(VertexFormat format)
+{
+	return GetPool(format).vertexArray;
+}
+
+GLuint GeometryBuffer::GetVertexBuffer(VertexFormat format)
+{
+	return GetPool(format).vertexBuffer;
+}
+
+GLuint GeometryBuffer::GetIndexBuffer(VertexFormat format)
+{
+	return GetPool(format).indexBuffer;
+}
+
+GeometryBufferStats GeometryBuffer::GetStats(VertexFormat format) const
+{
+	const auto& pool = pools[static_cast<int>(format)];
+
+	GeometryBufferStats stats{};
+	if (pool.vertexArray != 0)
+	{
+		stats.vertices = pool.vertices->GetStats();
+		stats.indices = pool.indices->GetStats();
+	}
+	return stats;
+}
@@ -0,0 +1,187 @@
+#include "ImageBatch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+
+#include "stb_image.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// Everything the jobs of one batch share. It lives until the last job is done with it.
+	struct BatchState
+	{
+		std::vector<ImageSource> sources;
+		ImageBatch::DecodedCallback onDecoded;
+		ImageBatch::FinishedCallback onFinished;
+		std::atomic<std::size_t> remaining{ 0 };
+		std::mutex statsMutex;
+		ImageBatchStats stats;
+		Clock::time_point start;
+	};
+}
+
+ImageSource ImageSource::FromFile(const std::string& filepath)
+{
+	ImageSource source{};
+	source.name = filepath;
+	source.filepath = filepath;
+
+	// Only the size is needed up front. The file is read by the worker decoding it.
+	std::ifstream file{ filepath, std::ios::binary | std::ios::ate };
+	if (file.is_open())
+		source.encodedBytes = static_cast<std::size_t>(file.tellg());
+
+	return source;
+}
+
+ImageSource ImageSource::FromMemory(const std::string& name, std::vector<unsigned char> bytes)
+{
+	ImageSource source{};
+	source.name = name;
+	source.encodedBytes = bytes.size();
+	source.bytes = std::make_shared<const std::vector<unsigned char>>(std::move(bytes));
+	return source;
+}
+
+std::size_t ImageBatch::Add(ImageSource source)
+{
+	sources.push_back(std::move(source));
+	return sources.size() - 1;
+}
+
+std::size_t ImageBatch::GetImageCount() const
+{
+	return sources.size();
+}
+
+bool ImageBatch::IsEmpty() const
+{
+	return sources.empty();
+}
+
+std::vector<DecodedImageResult> ImageBatch::DecodeAll(ThreadPool& pool, ImageBatchStats* stats)
+{
+	std::vector<DecodedImageResult> results(sources.size());
+	ImageBatchStats finalStats{};
+	bool finished = sources.empty();
+
+	std::mutex mutex;
+	std::condition_variable allDecoded;
+
+	// Each job writes only its own slot, so the results need no locking. The stats are the last thing written.
+	DecodeAsync(pool, [&results](std::size_t index, DecodedImageResult& result)
+	{
+		results[index] = std::move(result);
+	}, [&](const ImageBatchStats& batchStats)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		finalStats = batchStats;
+		finished = true;
+		allDecoded.notify_one();
+	});
+
+	std::unique_lock<std::mutex> lock{ mutex };
+	allDecoded.wait(lock, [&finished]() { return finished; });
+
+	if (stats)
+		*stats = finalStats;
+
+	return results;
+}
+
+void ImageBatch::DecodeAsync(ThreadPool& pool, DecodedCallback onDecoded, FinishedCallback onFinished)
+{
+	if (sources.empty())
+		return;
+
+	const auto state = std::make_shared<BatchState>();
+	state->sources = std::move(sources);
+	state->onDecoded = std::move(onDecoded);
+	state->onFinished = std::move(onFinished);
+	state->remaining = state->sources.size();
+	state->stats.imageCount = state->sources.size();
+	state->start = Clock::now();
+	sources.clear();
+
+	// Longest processing time first. Ties keep the order they were added in.
+	std::vector<std::size_t> order(state->sources.size());
+	std::iota(order.begin(), order.end(), std::size_t{ 0 });
+	std::stable_sort(order.begin(), order.end(), [&state](std::size_t a, std::size_t b)
+	{
+		return state->sources[a].encodedBytes > state->sources[b].encodedBytes;
+	});
+
+	for (const auto index : order)
+	{
+		pool.Submit([state, index]()
+		{
+			auto result = Decode(state->sources[index]);
+
+			{
+				std::lock_guard<std::mutex> lock{ state->statsMutex };
+				auto& stats = state->stats;
+				stats.encodedBytes += result.encodedBytes;
+				stats.decodedBytes += result.pixels.size();
+				stats.decodeMilliseconds += result.decodeMilliseconds;
+				stats.longestDecodeMilliseconds = std::max(stats.longestDecodeMilliseconds, result.decodeMilliseconds);
+				if (!result.pixels.data())
+					stats.failedCount++;
+			}
+
+			if (state->onDecoded)
+				state->onDecoded(index, result);
+
+			// Whoever decodes the last image reports on the whole batch
+			if (--state->remaining == 0 && state->onFinished)
+			{
+				ImageBatchStats stats{};
+				{
+					std::lock_guard<std::mutex> lock{ state->statsMutex };
+					state->stats.wallMilliseconds = MillisecondsSince(state->start);
+					stats = state->stats;
+				}
+
+				state->onFinished(stats);
+			}
+		});
+	}
+}
+
+DecodedImageResult ImageBatch::Decode(const ImageSource& source)
+{
+	DecodedImageResult result{};
+	result.name = source.name;
+	result.encodedBytes = source.encodedBytes;
+
+	const auto start = Clock::now();
+
+	int width, height, nrChannels;
+	const auto pixels = source.bytes
+		? stbi_load_from_memory(source.bytes->data(), static_cast<int>(source.bytes->size()), &width, &height, &nrChannels, 0)
+		: stbi_load(source.filepath.c_str(), &width, &height, &nrChannels, 0);
+
+	result.decodeMilliseconds = MillisecondsSince(start);
+
+	if (pixels)
+	{
+		// stb_image allocates from the DecodeBufferPool, so the result can own the pixels as they are
+		result.pixels = DecodeBuffer{ pixels, static_cast<std::size_t>(width) * height * nrChannels };
+		result.width = width;
+		result.height = height;
+		result.nrChannels = nrChannels;
+	}
+
+	return result;
+}
@@ -0,0 +1,92 @@
+#include "IndirectRenderer.hpp"
+
+#include <cassert>
+
+#include "GeometryBuffer.hpp"
+#include "VirtualTextureSystem.hpp"
+
+const int IndirectRenderer::FrameCount;
+
+IndirectRenderer& IndirectRenderer::Global()
+{
+	static IndirectRenderer renderer{};
+	return renderer;
+}
+
+bool IndirectRenderer::IsMultiDrawSupported()
+{
+	return RenderDevice::Global().SupportsMultiDrawIndirect();
+}
+
+namespace
+{
+	// Grows by half again as much as needed, so a list growing a little every frame doesn't replace the buffer every time
+	void ReserveBuffer(BufferTarget target, std::uint32_t& buffer, std::size_t& capacity, std::size_t bytes)
+	{
+		if (bytes <= capacity)
+			return;
+
+		auto& device = RenderDevice::Global();
+		if (buffer != 0)
+			device.DeleteBuffer(buffer);
+
+		capacity = bytes + bytes / 2;
+		buffer = device.CreateBuffer(target, capacity, nullptr, BufferUsage::Stream);
+	}
+}
+
+void IndirectRenderer::Reserve(std::uint64_t frame, const DrawList& list)
+{
+	// The buffers being replaced were last drawn from FrameCount frames ago. OpenGL keeps them around until the GPU is
+	// Done with them.
+	auto& buffers = frames[frame % FrameCount];
+	ReserveBuffer(BufferTarget::Indirect, buffers.commandBuffer, buffers.commandCapacity, list.GetCommands().size() * sizeof(DrawCommand));
+	ReserveBuffer(BufferTarget::Vertex, buffers.transformBuffer, buffers.transformCapacity, list.GetTransforms().size() * sizeof(glm::mat4));
+}
+
+std::size_t IndirectRenderer::Record(std::uint64_t frame, const DrawList& list, RenderDevice& commands, std::size_t firstBatch, std::size_t batchCount) const
+{
+	if (batchCount == 0)
+		return 0;
+
+	const auto& frameBuffers = frames[frame % FrameCount];
+	DrawListBuffers buffers{};
+	buffers.commandBuffer = frameBuffers.commandBuffer;
+	buffers.transformBuffer = frameBuffers.transformBuffer;
+	buffers.transformLocation = GeometryBuffer::InstanceAttributeLocation;
+
+	return list.Submit(commands, buffers, [&](const DrawState& state)
+	{
+		VirtualTextureSystem::Global().Bind(state.virtualTexture, commands);
+		if (!state.virtualTexture)
+			commands.BindTexture(0, state.texture);
+	}, firstBatch, batchCount);
+}
+
+void IndirectRenderer::Upload(std::uint64_t frame, const DrawList& list)
+{
+	lastFrameStats = stats;
+	stats = IndirectRendererStats{};
+	stats.multiDraw = IsMultiDrawSupported();
+
+	const auto& commands = list.GetCommands();
+	const auto& transforms = list.GetTransforms();
+	stats.draws = commands.size();
+	stats.drawCalls = stats.multiDraw ? list.GetBatches().size() : commands.size();
+	if (commands.empty())
+		return;
+
+	// Writing buffers the GPU may still be reading from an earlier frame is left to the driver to synchronize.
+	// With a set of buffers per frame in flight, that frame is long done by now.
+	const auto& buffers = frames[frame % FrameCount];
+	assert(buffers.commandCapacity >= commands.size() * sizeof(DrawCommand));
+	auto& device = RenderDevice::Global();
+	device.UpdateBuffer(buffers.commandBuffer, 0, commands.size() * sizeof(DrawCommand), commands.data());
+	device.UpdateBuffer(buffers.transformBuffer, 0, transforms.size() * sizeof(glm::mat4), transforms.data());
+	stats.bytesUploaded = commands.size() * sizeof(DrawCommand) + transforms.size() * sizeof(glm::mat4);
+}
+
+IndirectRendererStats IndirectRenderer::GetStats() const
+{
+	return lastFrameStats;
+}
@@ -0,0 +1,215 @@
+#include "LodSelector.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+// SSE2 is part of every x64 processor, and the compiler's default for 32-bit x86 as well
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define LOD_SELECTOR_SSE
+#include <emmintrin.h>
+#endif
+
+const int LodSelector::MaxLevels;
+const float LodSelector::PixelThreshold = 1.0f;
+const float LodSelector::Hysteresis = 0.2f;
+
+namespace
+{
+	// Cameras inside an object's bounds count as this close to it, which always picks the finest level
+	const float MinimumDistance = 1e-3f;
+	// The batch is always a multiple of this long, so Select never needs a scalar tail
+	const std::size_t BatchPadding = 4;
+}
+
+LodSelector::LodSelector()
+	: cameraPosition{ 0.0f }, projectionScale{ 1.0f }, qualityBias{ 1.0f }, batchCount{ 0 }
+{
+	static_assert(sizeof(stats.levelCounts) / sizeof(stats.levelCounts[0]) == MaxLevels, "Every level needs a count");
+}
+
+std::uint32_t LodSelector::Register(const float* levelErrors, int levelCount)
+{
+	assert(levelCount >= 1 && levelCount <= MaxLevels);
+
+	std::uint32_t object;
+	if (!freeObjects.empty())
+	{
+		object = freeObjects.back();
+		freeObjects.pop_back();
+	}
+	else
+	{
+		object = static_cast<std::uint32_t>(levels.size());
+		levels.push_back(0);
+		this->levelErrors.resize(this->levelErrors.size() + MaxLevels);
+	}
+
+	// Levels the object doesn't have get an error no distance can make small enough
+	for (int level = 0; level < MaxLevels; level++)
+		this->levelErrors[object * MaxLevels + level] = level < levelCount ? levelErrors[level] : std::numeric_limits<float>::max();
+	levels[object] = 0;
+	return object;
+}
+
+void LodSelector::Unregister(std::uint32_t object)
+{
+	assert(object < levels.size());
+	freeObjects.push_back(object);
+}
+
+void LodSelector::SetCamera(const glm::vec3& position, float fieldOfViewY, float viewportHeight)
+{
+	cameraPosition = position;
+	projectionScale = viewportHeight / (2.0f * std::tan(fieldOfViewY * 0.5f));
+}
+
+void LodSelector::SetQualityBias(float bias)
+{
+	assert(bias > 0.0f);
+	qualityBias = bias;
+}
+
+float LodSelector::GetQualityBias() const
+{
+	return qualityBias;
+}
+
+void LodSelector::Clear()
+{
+	batchCount = 0;
+}
+
+void LodSelector::Add(std::uint32_t object, const BoundingVolume& bounds)
+{
+	assert(object < levels.size());
+
+	if (batchObjects.size() <= batchCount)
+	{
+		const auto size = batchCount + BatchPadding;
+		batchObjects.resize(size);
+		for (auto array : { &batchX, &batchY, &batchZ, &batchRadius })
+			array->resize(size);
+		batchLevels.resize(size);
+		for (auto& errors : batchErrors)
+			errors.resize(size);
+	}
+
+	const auto index = batchCount++;
+	batchObjects[index] = object;
+	batchX[index] = bounds.center.x;
+	batchY[index] = bounds.center.y;
+	batchZ[index] = bounds.center.z;
+	batchRadius[index] = bounds.radius;
+	batchLevels[index] = levels[object];
+	for (int level = 0; level < MaxLevels; level++)
+		batchErrors[level][index] = levelErrors[object * MaxLevels + level];
+}
+
+// Fills the rest of the last group of 4 with objects that stay at the finest level
+void LodSelector::PadBatch()
+{
+	for (auto i = batchCount; i < batchObjects.size() && i % BatchPadding != 0; i++)
+	{
+		batchX[i] = cameraPosition.x;
+		batchY[i] = cameraPosition.y;
+		batchZ[i] = cameraPosition.z;
+		batchRadius[i] = 0.0f;
+		batchLevels[i] = 0;
+		for (auto& errors : batchErrors)
+			errors[i] = std::numeric_limits<float>::max();
+	}
+}
+
+void LodSelector::Select()
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+
+	stats = LodSelectorStats{};
+	stats.objects = batchCount;
+	PadBatch();
+
+	// A level of error e at distance d is e * projectionScale / d pixels off. Both sides are multiplied by d,
+	// So there's no division. Going coarser is held to the lower limit, staying at the current level or a
+	// Finer one to the upper one.
+	const auto threshold = PixelThreshold * qualityBias;
+	const auto lowerLimit = threshold * (1.0f - Hysteresis);
+	const auto upperLimit = threshold * (1.0f + Hysteresis);
+	const auto padded = (batchCount + BatchPadding - 1) / BatchPadding * BatchPadding;
+
+#if defined(LOD_SELECTOR_SSE)
+	const auto cameraX = _mm_set1_ps(cameraPosition.x);
+	const auto cameraY = _mm_set1_ps(cameraPosition.y);
+	const auto cameraZ = _mm_set1_ps(cameraPosition.z);
+	const auto scale = _mm_set1_ps(projectionScale);
+	const auto lower = _mm_set1_ps(lowerLimit);
+	const auto upper = _mm_set1_ps(upperLimit);
+	const auto minimumDistance = _mm_set1_ps(MinimumDistance);
+	for (std::size_t i = 0; i < padded; i += 4)
+	{
+		// Distance from the camera to the object's bounding sphere
+		const auto x = _mm_sub_ps(_mm_loadu_ps(batchX.data() + i), cameraX);
+		const auto y = _mm_sub_ps(_mm_loadu_ps(batchY.data() + i), cameraY);
+		const auto z = _mm_sub_ps(_mm_loadu_ps(batchZ.data() + i), cameraZ);
+		const auto centerDistance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+		const auto distance = _mm_max_ps(_mm_sub_ps(centerDistance, _mm_loadu_ps(batchRadius.data() + i)), minimumDistance);
+
+		// The errors increase with the level, so the levels which pass come first, and the level is how many of
+		// The coarser levels pass. Passing lanes are all ones, which is -1, so subtracting them counts them.
+		const auto current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(batchLevels.data() + i));
+		auto level = _mm_setzero_si128();
+		for (int candidate = 1; candidate < MaxLevels; candidate++)
+		{
+			const auto coarser = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(candidate), current));
+			const auto limit = _mm_or_ps(_mm_and_ps(coarser, lower), _mm_andnot_ps(coarser, upper));
+			const auto pixels = _mm_mul_ps(_mm_loadu_ps(batchErrors[candidate].data() + i), scale);
+			const auto passes = _mm_cmple_ps(pixels, _mm_mul_ps(limit, distance));
+			level = _mm_sub_epi32(level, _mm_castps_si128(passes));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(batchLevels.data() + i), level);
+	}
+#else
+	for (std::size_t i = 0; i < padded; i++)
+	{
+		const auto centerDistance = glm::length(glm::vec3(batchX[i], batchY[i], batchZ[i]) - cameraPosition);
+		const auto distance = std::max(centerDistance - batchRadius[i], MinimumDistance);
+
+		std::int32_t level = 0;
+		for (int candidate = 1; candidate < MaxLevels; candidate++)
+		{
+			const auto limit = candidate > batchLevels[i] ? lowerLimit : upperLimit;
+			if (batchErrors[candidate][i] * projectionScale <= limit * distance)
+				level++;
+		}
+
+		batchLevels[i] = level;
+	}
+#endif
+
+	for (std::size_t i = 0; i < batchCount; i++)
+	{
+		auto& level = levels[batchObjects[i]];
+		if (level != batchLevels[i])
+			stats.changes++;
+
+		level = batchLevels[i];
+		stats.levelCounts[level]++;
+	}
+
+	stats.milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int LodSelector::GetLevel(std::uint32_t object) const
+{
+	assert(object < levels.size());
+	return levels[object];
+}
+
+LodSelectorStats LodSelector::GetStats() const
+{
+	return stats;
+}
@@ -1,6 +1,7 @@
 #include "Mesh.hpp"
 
 Mesh::Mesh(std::string filepath)
+	: transform{ TransformStore::Global().Create() }, boundsRadius{ 0.0f }, boundsMin{ 0.0f }, boundsMax{ 0.0f }, vertexDataResident{ false }, indexDataResident{ false }, spatialIndex{ nullptr }, spatialHandle{ 0 }, lodSelector{ nullptr }, lodObject{ 0 }, instanceOffset{ 0 }, instanceCount{ 0 }, pos_x{ 0 }, pos_y{ 0 }, pos_z{ 0 }
 {
 	vertices = std::vector<float>{};
 	indices = std::vector<unsigned>{};
@@ -8,6 +9,38 @@ Mesh::Mesh(std::string filepath)
 	LoadMesh(filepath);
 	GenerateTexture();
 	UploadVertexData();
+	SetPosition(pos_x, pos_y, pos_z);
+}
+
+Mesh::~Mesh()
+{
+	// Pending uploads read from our vertices and write into our buffers, neither of which will exist much longer
+	UploadScheduler::Global().Cancel(this);
+	UploadScheduler::Global().Untrack(this);
+
+	if (spatialIndex)
+		spatialIndex->Remove(spatialHandle);
+	if (lodSelector)
+		lodSelector->Unregister(lodObject);
+	TransformStore::Global().Destroy(transform);
+
+	GeometryBuffer::Global().Free(geometry);
+}
+
+std::vector<std::unique_ptr<Mesh>> Mesh::LoadScene(const std::vector<std::string>& filepaths)
+{
+	// Each mesh asks the texture cache for its texture as usual, but nothing is decoded until every
+	// Mesh has been loaded. The cache then decodes all of them on its worker threads, largest image first.
+	TextureCache::Global().BeginBatch();
+
+	std::vector<std::unique_ptr<Mesh>> meshes;
+	meshes.reserve(filepaths.size());
+	for (const auto& filepath : filepaths)
+		meshes.push_back(std::make_unique<Mesh>(filepath));
+
+	TextureCache::Global().EndBatch();
+
+	return meshes;
 }
 
 std::string Mesh::GetTexturePath() const
@@ -27,32 +60,90 @@ std::vector<unsigned> Mesh::GetIndices() const
 
 unsigned Mesh::GetTextureObject() const
 {
-	return textureObject;
+	return texture ? texture->GetTextureObject() : 0;
 }
 
-float rotation = 0;
+void Mesh::Submit(DrawList& list)
+{
+	if (!vertexDataResident || !indexDataResident)
+		return;
+
+	TextureStreamer::Global().RequestFootprint(texture.get(), glm::vec3(pos_x, pos_y, pos_z), boundsRadius);
 
-void Mesh::Draw(Shader shader)
+	DrawState state{};
+	state.vertexArray = GeometryBuffer::Global().GetVertexArray(geometry.format);
+	state.virtualTexture = virtualTexture.get();
+	state.virtualTextureId = virtualTexture ? static_cast<std::uint32_t>(virtualTexture->GetId()) : 0;
+	state.texture = virtualTexture ? 0 : GetTextureObject();
+
+	const auto& lod = GetCurrentLod();
+	list.Add(state, static_cast<std::uint32_t>(lod.indexCount), static_cast<std::uint32_t>(geometry.firstIndex + lod.firstIndex), geometry.baseVertex, GetModelMatrix());
+}
+
+glm::mat4 Mesh::GetModelMatrix() const
 {
-	// Prepare texture
-	glBindTexture(GL_TEXTURE_2D, textureObject);
-	
-	// Prepare vertex data
-	glBindVertexArray(vao);
-
-	// Transform
-	modelMatrix = glm::mat4{ 1.0f };
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(pos_x, pos_y, pos_z));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation), glm::vec3(0.0f, 1.0f, 1.0f));
-	shader.setMatrix("model", modelMatrix);
-	
-	// Render
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, nullptr);
-
-	// Cleanup
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	return TransformStore::Global().GetWorldMatrix(transform);
+}
+
+std::size_t Mesh::SubmitInstances(const std::vector<glm::mat4>& transforms, const Frustum& frustum)
+{
+	visibleInstances.clear();
+	instanceCount = 0;
+
+	// The texture streamer only needs to know about the instance which is largest on screen,
+	// Which we guess to be the one closest to the near plane
+	const glm::mat4* closest = nullptr;
+	auto closestDistance = 0.0f;
+
+	for (const auto& transform : transforms)
+	{
+		// Our bounding sphere is centered on the origin, so it ends up around the translation of the transform.
+		// Scaling makes it larger by the largest scale of any axis.
+		const auto center = glm::vec3(transform[3]);
+		const auto scale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+		if (!frustum.IntersectsSphere(center, boundsRadius * scale))
+			continue;
+
+		visibleInstances.push_back(transform);
+
+		const auto nearDistance = glm::dot(glm::vec3(frustum.planes[4]), center) + frustum.planes[4].w;
+		if (!closest || nearDistance < closestDistance)
+		{
+			closest = &transform;
+			closestDistance = nearDistance;
+		}
+	}
+
+	if (visibleInstances.empty())
+		return 0;
+
+	if (closest)
+		TextureStreamer::Global().RequestFootprint(texture.get(), glm::vec3((*closest)[3]), boundsRadius);
+
+	instanceOffset = StreamingBuffer::Instances().Write(visibleInstances.data(), visibleInstances.size() * sizeof(glm::mat4));
+	instanceCount = visibleInstances.size();
+	return instanceCount;
+}
+
+void Mesh::DrawInstanced()
+{
+	if (!vertexDataResident || !indexDataResident || instanceCount == 0)
+		return;
+
+	auto& device = RenderDevice::Global();
+	VirtualTextureSystem::Global().Bind(virtualTexture.get(), device);
+	if (!virtualTexture)
+		device.BindTexture(0, GetTextureObject());
+
+	device.BindVertexArray(GeometryBuffer::Global().GetVertexArray(geometry.format));
+
+	// The stream moves this frame's data around if it has to grow, so where our instances are is only known now
+	const auto& instances = StreamingBuffer::Instances();
+	const auto offset = instances.GetFrameOffset() + instanceOffset;
+	for (std::uint32_t column = 0; column < 4; column++)
+		device.SetVertexAttribute(GeometryBuffer::InstanceAttributeLocation + column, 4, sizeof(glm::mat4), instances.GetBufferObject(), offset + column * sizeof(glm::vec4));
+
+	device.DrawIndexed(static_cast<std::uint32_t>(geometry.indexCount), static_cast<std::uint32_t>(geometry.firstIndex), geometry.baseVertex, static_cast<std::uint32_t>(instanceCount));
 }
 
 void Mesh::SetPosition(float x, float y, float z)
@@ -60,6 +151,16 @@ void Mesh::SetPosition(float x, float y, float z)
 	pos_x = x;
 	pos_y = y;
 	pos_z = z;
+	TransformStore::Global().SetPosition(transform, glm::vec3(pos_x, pos_y, pos_z));
+
+	// Pending uploads for our vertex data and our texture are prioritized by how close we are to the camera
+	const auto position = glm::vec3(pos_x, pos_y, pos_z);
+	UploadScheduler::Global().Track(this, this, position);
+	if (texture)
+		UploadScheduler::Global().Track(texture.get(), this, position);
+
+	if (spatialIndex)
+		spatialIndex->Move(spatialHandle, GetWorldBounds());
 }
 
 void Mesh::LoadMesh(const std::string filepath)
@@ -67,7 +168,9 @@ void Mesh::LoadMesh(const std::string filepath)
 	// ifstreams are streams used for reading from a file
 	// When you provide a file path in the constructor, the stream will be attach to that file
 	// The second parameter, the mode, is in this case specified as ios::in (the mode for reading a file)
-	std::ifstream assetFile{filepath, std::ios::in};
+	// The asset is read in binary mode, since embedded textures are stored as raw bytes which
+	// Must not go through any newline translation.
+	std::ifstream assetFile{filepath, std::ios::in | std::ios::binary};
 
 	if (!assetFile.good())
 		assert(false);
@@ -77,6 +180,10 @@ void Mesh::LoadMesh(const std::string filepath)
 	{
 		std::getline(assetFile, currentLine);
 
+		// Assets written in text mode on Windows end their lines with \r\n
+		if (!currentLine.empty() && currentLine.back() == '\r')
+			currentLine.pop_back();
+
 		if (currentLine.length() > 0)
 		{
 			const auto startSymbol = currentLine.front();
@@ -129,133 +236,193 @@ void Mesh::LoadMesh(const std::string filepath)
 			{
 				currentLine.erase(0, 2);
 				texturePath = std::string{ "shaders/" } + std::string{currentLine};
+			} else if (std::tolower(startSymbol) == 'm')
+			{
+				// The same texture, with every mip level stored separately so it can be streamed
+				currentLine.erase(0, 2);
+				mipPath = std::string{ "shaders/" } + std::string{currentLine};
+			} else if (std::tolower(startSymbol) == 's')
+			{
+				// The same texture again, supercompressed so it can be transcoded straight to a GPU block format
+				currentLine.erase(0, 2);
+				supercompressedPath = std::string{ "shaders/" } + std::string{currentLine};
+			} else if (std::tolower(startSymbol) == 'p')
+			{
+				// The same texture cut into pages (a virtual texture), for textures too large to ever be fully resident
+				currentLine.erase(0, 2);
+				virtualTexturePath = std::string{ "shaders/" } + std::string{currentLine};
+			} else if (std::tolower(startSymbol) == 'l')
+			{
+				// Level of detail: l:<first index>,<index count>,<geometric error>, finest level first
+				currentLine.erase(0, 2);
+
+				std::string currentValue{};
+				std::stringstream currentLineStream{ currentLine };
+				std::vector<std::string> values{};
+				while (std::getline(currentLineStream, currentValue, ','))
+				{
+					values.push_back(currentValue);
+				}
+
+				MeshLod lod{};
+				lod.firstIndex = std::stoul(values[0]);
+				lod.indexCount = std::stoul(values[1]);
+				lod.error = std::stof(values[2]);
+				lods.push_back(lod);
+			} else if (std::tolower(startSymbol) == 'e')
+			{
+				// Embedded texture: e:<format hint>,<byte count>
+				// The header line is followed by exactly <byte count> bytes of the compressed image file.
+				currentLine.erase(0, 2);
+
+				const auto separator = currentLine.find_last_of(',');
+				const auto byteCount = std::stoul(currentLine.substr(separator + 1));
+
+				embeddedTexture.resize(byteCount);
+				assetFile.read(reinterpret_cast<char*>(embeddedTexture.data()), byteCount);
+
+				if (assetFile.gcount() != static_cast<std::streamsize>(byteCount))
+				{
+					OutputDebugStringA("Embedded texture is truncated!");
+					assert(false);
+				}
+
+				// Skip the newline terminating the raw bytes
+				assetFile.ignore(1);
 			}
 		}
 	}
+
+	// Levels of detail may be listed before the faces they refer to, so they're checked once everything is read
+	if (lods.empty())
+		lods.push_back(MeshLod{ 0, indices.size(), 0.0f });
+
+	for (std::size_t i = 0; i < lods.size(); i++)
+	{
+		if (lods[i].firstIndex + lods[i].indexCount > indices.size() || (i > 0 && lods[i].error < lods[i - 1].error) || i >= static_cast<std::size_t>(LodSelector::MaxLevels))
+		{
+			OutputDebugStringA("Invalid level of detail!");
+			assert(false);
+		}
+	}
+
+	CalculateBounds();
+}
+
+void Mesh::CalculateBounds()
+{
+	// The mesh is rotated around its origin when drawn, so we use a bounding sphere centered on the origin.
+	// It stays valid no matter the rotation. Good enough for estimating our size on screen.
+	// For culling, we also keep the box around the vertices, which is transformed along with the mesh.
+	boundsRadius = 0.0f;
+	boundsMin = glm::vec3{ vertices.empty() ? 0.0f : std::numeric_limits<float>::max() };
+	boundsMax = glm::vec3{ vertices.empty() ? 0.0f : -std::numeric_limits<float>::max() };
+	for (std::size_t i = 0; i < vertices.size(); i += 5)
+	{
+		const glm::vec3 position{ vertices[i], vertices[i + 1], vertices[i + 2] };
+		boundsRadius = std::max(boundsRadius, glm::length(position));
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+}
+
+BoundingVolume Mesh::GetWorldBounds() const
+{
+	return BoundingVolume::FromBox(boundsMin, boundsMax, GetModelMatrix());
+}
+
+void Mesh::AddToIndex(SpatialIndex& index, std::uint32_t payload)
+{
+	assert(!spatialIndex);
+
+	spatialIndex = &index;
+	spatialHandle = index.Insert(GetWorldBounds(), payload);
+}
+
+void Mesh::AddToLodSelector(LodSelector& selector)
+{
+	assert(!lodSelector);
+
+	std::vector<float> errors{};
+	for (const auto& lod : lods)
+		errors.push_back(lod.error);
+
+	lodSelector = &selector;
+	lodObject = selector.Register(errors.data(), static_cast<int>(errors.size()));
+}
+
+void Mesh::RequestLod(const BoundingVolume& bounds)
+{
+	if (lodSelector)
+		lodSelector->Add(lodObject, bounds);
+}
+
+const MeshLod& Mesh::GetCurrentLod() const
+{
+	return lods[lodSelector ? lodSelector->GetLevel(lodObject) : 0];
+}
+
+void Mesh::SubmitOccluder(OcclusionCuller& culler)
+{
+	// The finest level, as coarser ones may not cover everything the mesh does
+	culler.AddOccluder(vertices.data(), 5, indices.data() + lods[0].firstIndex, lods[0].indexCount, GetModelMatrix());
 }
 
 void Mesh::GenerateTexture()
 {
-	// First step in loading a texture is to create a Texture Object.
-	// By this point it won't have any dimensionality or type.
-	glGenTextures(1, &textureObject);
-
-	// The dimensionality or type is determined the first time you bind the texture
-	// To a texture target using glBindTexture. Here, we bind it to the GL_TEXTURE_2D,
-	// Making it a 2D texture.
-	glBindTexture(GL_TEXTURE_2D, textureObject);
-
-	// Texture coordinates are given in the space of 0.0 to 1.0 on each axis.
-	// If the texture coordinates provided to OpenGL's built-in functions are somehow
-	// Outside of this range, they have to be brought back into the range. How this is done
-	// Can be controlled by the parameters GL_TEXTURE_WRAP_S and GL_TEXTURE_WRAP_T.
-	// When the mode is GL_CLAMP_TO_BORDER, an attempt to read outside the 0.0 to 1.0 range
-	// Will result in the constant border color for the texture to be used as a final value.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-	// GL_TEXTURE_MIN_FILTER controls how texels are constructed when the mipmap
-	// level is greater than zero. There are a total of six setting available for
-	// this parameter.
-	// Choosing GL_NEAREST or GL_LINEAR will disable mipmapping and will cause OpenGL
-	// to only use the base level (level 0).
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	int width, height, nrChannels;
-	const auto data = stbi_load(texturePath.c_str(), &width, &height, &nrChannels, 0);
-	if (data)
+	// Meshes very often share textures, so instead of decoding and uploading our own copy
+	// We ask the texture cache for a shared handle. It only loads the texture the first time it is requested.
+	// The handle is usable right away. Until the image has been decoded in the background it is
+	// A 1x1 placeholder texture, which is replaced once TextureCache::ProcessUploads picks it up.
+	// Embedded textures are decoded straight from the bytes read from the asset,
+	// Everything else is loaded from the texture file next to it.
+	// The embedded bytes are handed over to the decoder, as the mesh has no use for them afterwards.
+	// If the asset comes with a virtual texture, only the pages of it that are on screen are ever loaded.
+	// Otherwise, if it comes with a supercompressed texture, that is preferred, since it stays block compressed on the
+	// GPU. Like the mip file used without one, it is streamed one mip level at a time.
+	if (!virtualTexturePath.empty())
+		virtualTexture = VirtualTextureSystem::Global().Acquire(virtualTexturePath);
+
+	if (virtualTexture)
 	{
-		// After having created a texture object and specified its dimensionality,
-		// We need to specify storage and data for the texture.
-		// glTexImage2D is a MUTABLE texture image specification command.
-		// It is, however, best practice to declare texture storage as immutable (meaning
-		// they can't be resized or have their format changed, etc...).
-		// glTexImage2D can also (optionally) provide the initial data.
-		// InternalFormat = Specifies the format with which OpenGL should store the texels
-		// In the texture.
-		// The format of the initial texel data is given by the combination of FORMAT and TYPE.
-		// OpenGL will convert the specified data from this format into the internal format
-		// Specified by InternalFormat.
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-
-		// OpenGL provides a function to automatically generate all of the mipmaps for a texture.
-		// It's up to the OpenGL implementation to provide a mechanism to downsample the high
-		// resolution images to produce the lower resolution mipmaps.
-		glGenerateMipmap(GL_TEXTURE_2D);
+		embeddedTexture.clear();
+		return;
 	}
-	else
+
+	if (!supercompressedPath.empty())
+		texture = TextureCache::Global().AcquireSupercompressed(supercompressedPath);
+
+	if (!texture && !mipPath.empty())
+		texture = TextureCache::Global().AcquireStreamed(mipPath);
+
+	if (!texture)
 	{
-		OutputDebugStringA("Failed to load mesh texture!");
-		assert(false);
+		texture = embeddedTexture.empty()
+			? TextureCache::Global().AcquireFromFile(texturePath)
+			: TextureCache::Global().AcquireFromMemory(std::move(embeddedTexture));
 	}
 
-	// Clean Up
-	glBindTexture(GL_TEXTURE_2D, 0);
+	embeddedTexture.clear();
 }
 
 void Mesh::UploadVertexData()
 {
-	// OpenGl Core REQUIRES us to use Vertex Array Objects (VAOs)
-	// VAOs are OpenGL objects which will save state related to these calls:
-	// -- Calls to glEnableVertexAttribArray or glDisableVertexAttribArray
-	// -- Vertex attribute configurations via glVertexAttribPointer
-	// -- Vertex buffer objects associated with vertex attributes by calls to glVertexAttribPointer
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	// Generate EBO
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-	// We generate an OpenGL buffer object
-	// OpenGL buffers can be used for many things. They are simply allocated memory which can be used
-	// to store whatever you want
-	glGenBuffers(1, &vbo);
-
-	// Now we bind our generated buffer to the GL_ARRAY_BUFFER target. This essentially means that we will
-	// be using it is a vertex buffer object.
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-	// Now that we have bound our buffer object to a target, we can start to make OpenGL calls to functions
-	// That affect the state relevant for that object
-	// Here we copy our vertice data to the GPU, to our newly created buffer object.
-	// We also hint to OpenGL that the date most likely won't change. This means that OpenGL can make some assumptions
-	// about the data which can be used to optimize it.
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
-
-	// In the vertex shader we specified that location 0 accepted a 3D vector as input
-	// OpenGL is very flexible when it comes to how to feed input into that location
-	// But that also means we have to describe how the buffer is structured
-	// So that OpenGL knows how to take the x, y and z number of each vertex described
-	// in our array
-	// Parameter 1: The index of the location we want to input to
-	// Parameter 2: The number of components per generic vertex attribute
-	// -- We have 3 components, since our input is a Vec3 in the vertex shader
-	// Parameter 3: The data type of each component.
-	// -- They are 32-bit floats
-	// Parameter 4: Should data be normalized. Should be FALSE for floats.
-	// Parameter 5: The byte offset between each consecutive generic vertex attribute.
-	// -- Our array is tightly packed, so 0 byte offset between them
-	// Parameter 6: The byte offset of the first component of the first generic vertex
-	// Attribute.
-	// -- This is 0 for us. It begins at the start of the array.
-	// NOTICE: glVertexAttribPointer reads the currently bound buffer in GL_ARRAY_BUFFER
-	// and stores it in the VAO, so unbinding the buffer in GL_ARRAY_BUFFER will not affect
-	// The currently bound VAO
-
-	// Position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(float) * 5, (void*)0);
-	glEnableVertexAttribArray(0);
-
-	// Texture UV attribute
-	glVertexAttribPointer(1, 2, GL_FLOAT, false, sizeof(float) * 5, (void*)(sizeof(float) * 3));
-	glEnableVertexAttribArray(1);
-
-	// Cleanup
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glDisableVertexAttribArray(0);
+	// Our vertices and indices go into ranges of the buffers shared by every mesh with the same vertex format
+	const auto vertexCount = static_cast<std::uint32_t>(vertices.size() / 5);
+	auto& geometryBuffer = GeometryBuffer::Global();
+	geometry = geometryBuffer.Allocate(VertexFormat::PositionTexCoord, vertexCount, static_cast<std::uint32_t>(indices.size()));
+
+	// The vectors stay alive (and unchanged) for as long as the mesh does, and the mesh cancels
+	// Its pending uploads when it is destroyed, so the scheduler can read straight from them.
+	auto& scheduler = UploadScheduler::Global();
+	const auto vertexOffset = geometry.vertices.offset * GeometryBuffer::VertexStride(geometry.format);
+	scheduler.ScheduleBufferUpload(this, geometryBuffer.GetVertexBuffer(geometry.format), vertexOffset, vertices.data(), vertices.size() * sizeof(float), [this]()
+	{
+		vertexDataResident = true;
+	});
+	const auto indexOffset = geometry.indices.offset * sizeof(unsigned int);
+	scheduler.ScheduleBufferUpload(this, geometryBuffer.GetIndexBuffer(geometry.format), indexOffset, indices.data(), indices.size() * sizeof(unsigned int), [this]()
+	{
+		indexDataResident = true;
+	});
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "MipFile.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+
+namespace
+{
+	// Limits on the header, so a corrupt file is rejected instead of allocating absurd amounts of memory
+	const std::uint32_t MaxDimension = 16384;
+}
+
+bool MipFile::Open(const std::string& filepath)
+{
+	path = filepath;
+
+	std::ifstream file{ filepath, std::ios::in | std::ios::binary };
+	if (!file.good())
+		return false;
+
+	char magic[4];
+	std::uint32_t header[5];
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+
+	if (!file.good() || std::memcmp(magic, "BMIP", 4) != 0 || header[0] != 1)
+		return false;
+
+	if (header[1] == 0 || header[1] > MaxDimension || header[2] == 0 || header[2] > MaxDimension || header[3] == 0 || header[3] > 4)
+		return false;
+
+	width = static_cast<int>(header[1]);
+	height = static_cast<int>(header[2]);
+	nrChannels = static_cast<int>(header[3]);
+
+	// A texture can't have more levels than it takes to halve it down to a single texel
+	const auto levelCount = static_cast<int>(header[4]);
+	if (levelCount < 1 || levelCount > 32 || (levelCount > 1 && std::max(width >> (levelCount - 2), height >> (levelCount - 2)) <= 1))
+		return false;
+
+	file.seekg(0, std::ios::end);
+	const auto fileSize = static_cast<std::uint64_t>(file.tellg());
+	file.seekg(4 + sizeof(header));
+
+	// Levels are uploaded straight from what is read, so each has to be exactly as large as its size says
+	offsets.resize(levelCount);
+	sizes.resize(levelCount);
+	for (int level = 0; level < levelCount; level++)
+	{
+		file.read(reinterpret_cast<char*>(&offsets[level]), sizeof(std::uint64_t));
+		file.read(reinterpret_cast<char*>(&sizes[level]), sizeof(std::uint64_t));
+
+		const auto levelBytes = static_cast<std::uint64_t>(std::max(1, width >> level)) * std::max(1, height >> level) * nrChannels;
+		if (sizes[level] != levelBytes || offsets[level] > fileSize || sizes[level] > fileSize - offsets[level])
+			return false;
+	}
+
+	return file.good();
+}
+
+std::vector<unsigned char> MipFile::ReadLevel(int level) const
+{
+	if (level < 0 || level >= GetLevelCount())
+		return {};
+
+	std::ifstream file{ path, std::ios::in | std::ios::binary };
+
+	std::vector<unsigned char> pixels(static_cast<std::size_t>(sizes[level]));
+	file.seekg(static_cast<std::streamoff>(offsets[level]));
+	file.read(reinterpret_cast<char*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+
+	if (!file.good())
+		pixels.clear();
+
+	return pixels;
+}
+
+const std::string& MipFile::GetPath() const
+{
+	return path;
+}
+
+int MipFile::GetWidth() const
+{
+	return width;
+}
+
+int MipFile::GetHeight() const
+{
+	return height;
+}
+
+int MipFile::GetChannelCount() const
+{
+	return nrChannels;
+}
+
+int MipFile::GetLevelCount() const
+{
+	return static_cast<int>(offsets.size());
+}
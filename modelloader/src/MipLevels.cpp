@@ -0,0 +1,47 @@
+#include "MipLevels.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+int MipLevelSize(int size, int level)
+{
+	return std::max(1, size >> level);
+}
+
+int MipLevelCount(int width, int height)
+{
+	auto levelCount = 1;
+	while (MipLevelSize(width, levelCount - 1) > 1 || MipLevelSize(height, levelCount - 1) > 1)
+		levelCount++;
+
+	return levelCount;
+}
+
+void Downsample(const unsigned char* pixels, int width, int height, int nrChannels, unsigned char* next)
+{
+	const auto nextWidth = MipLevelSize(width, 1);
+	const auto nextHeight = MipLevelSize(height, 1);
+
+	for (int y = 0; y < nextHeight; y++)
+	{
+		const auto y0 = std::min(y * 2, height - 1);
+		const auto y1 = std::min(y * 2 + 1, height - 1);
+
+		for (int x = 0; x < nextWidth; x++)
+		{
+			const auto x0 = std::min(x * 2, width - 1);
+			const auto x1 = std::min(x * 2 + 1, width - 1);
+
+			for (int channel = 0; channel < nrChannels; channel++)
+			{
+				const auto sample = [&](int sx, int sy)
+				{
+					return pixels[(static_cast<std::size_t>(sy) * width + sx) * nrChannels + channel];
+				};
+
+				const auto sum = sample(x0, y0) + sample(x1, y0) + sample(x0, y1) + sample(x1, y1);
+				next[(static_cast<std::size_t>(y) * nextWidth + x) * nrChannels + channel] = static_cast<unsigned char>((sum + 2) / 4);
+			}
+		}
+	}
+}
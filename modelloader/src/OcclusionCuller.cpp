@@ -0,0 +1,349 @@
+#include "OcclusionCuller.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+// SSE2 is part of every x64 processor, and the compiler's default for 32-bit x86 as well
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define OCCLUSION_CULLER_SSE
+#include <emmintrin.h>
+#endif
+
+const int OcclusionCuller::Width;
+const int OcclusionCuller::Height;
+const int OcclusionCuller::TileWidth;
+const int OcclusionCuller::TileHeight;
+const int OcclusionCuller::TilesX;
+const int OcclusionCuller::TilesY;
+const std::size_t OcclusionCuller::ParallelThreshold;
+
+namespace
+{
+	// Vertices closer to the camera plane than this count as crossing the near plane
+	const float MinimumW = 1e-4f;
+	// Triangles reaching further off screen than this are left out, as the edge functions lose too much precision
+	const float MaximumScreenExtent = 16.0f * OcclusionCuller::Width;
+	const std::size_t TileSize = OcclusionCuller::TileWidth * OcclusionCuller::TileHeight;
+}
+
+OcclusionCuller::OcclusionCuller(ThreadPool& workers)
+	: viewProjection{ 1.0f }, tileTriangles(TilesX * TilesY), depth(Width * Height, 1.0f), tileNearest(TilesX * TilesY, 1.0f),
+	tileFurthest(TilesX * TilesY, 1.0f), workers{ workers }
+{
+	static_assert(Width % TileWidth == 0 && Height % TileHeight == 0, "The depth buffer has to be made of whole tiles");
+	static_assert(TileWidth % 4 == 0, "Tile rows are filled 4 pixels at a time");
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProjection)
+{
+	lastFrameStats = stats;
+	stats = OcclusionCullerStats{};
+
+	this->viewProjection = viewProjection;
+	occluders.clear();
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	std::fill(tileNearest.begin(), tileNearest.end(), 1.0f);
+	std::fill(tileFurthest.begin(), tileFurthest.end(), 1.0f);
+}
+
+void OcclusionCuller::AddOccluder(const float* vertices, std::size_t stride, const unsigned* indices, std::size_t indexCount, const glm::mat4& transform)
+{
+	assert(stride >= 3 && indexCount % 3 == 0);
+
+	occluders.push_back(Occluder{ vertices, stride, indices, indexCount, transform });
+	stats.occluders++;
+	stats.triangles += indexCount / 3;
+}
+
+// Transforms the triangles of every occluder to the screen, and sorts them into the tiles their bounds touch
+void OcclusionCuller::BinTriangles()
+{
+	triangles.clear();
+	for (auto& tile : tileTriangles)
+		tile.clear();
+
+	for (const auto& occluder : occluders)
+	{
+		const auto transform = viewProjection * occluder.transform;
+		for (std::size_t i = 0; i < occluder.indexCount; i += 3)
+		{
+			ScreenTriangle triangle{};
+			auto usable = true;
+			for (int v = 0; v < 3 && usable; v++)
+			{
+				const auto vertex = occluder.vertices + occluder.indices[i + v] * occluder.stride;
+				const auto clip = transform * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f);
+				if (clip.w < MinimumW)
+				{
+					usable = false;
+					break;
+				}
+
+				const auto ndc = glm::vec3(clip) / clip.w;
+				triangle.vertices[v] = glm::vec3((ndc.x * 0.5f + 0.5f) * Width, (ndc.y * 0.5f + 0.5f) * Height, ndc.z * 0.5f + 0.5f);
+				usable = std::abs(triangle.vertices[v].x) < MaximumScreenExtent && std::abs(triangle.vertices[v].y) < MaximumScreenExtent;
+			}
+
+			if (!usable)
+			{
+				stats.trianglesSkipped++;
+				continue;
+			}
+
+			auto& v0 = triangle.vertices[0];
+			auto& v1 = triangle.vertices[1];
+			auto& v2 = triangle.vertices[2];
+			const auto minimum = glm::min(v0, glm::min(v1, v2));
+			const auto maximum = glm::max(v0, glm::max(v1, v2));
+			if (maximum.x <= 0.0f || maximum.y <= 0.0f || minimum.x >= Width || minimum.y >= Height || minimum.z > 1.0f)
+				continue;
+
+			// Both sides of an occluder hide what's behind them. Back facing triangles are turned around, so the inside
+			// Of every triangle is where all three edge functions are positive.
+			const auto area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+			if (area == 0.0f)
+				continue;
+			if (area < 0.0f)
+				std::swap(v1, v2);
+
+			const auto index = static_cast<std::uint32_t>(triangles.size());
+			triangles.push_back(triangle);
+
+			const auto firstTileX = std::max(0, static_cast<int>(minimum.x) / TileWidth);
+			const auto lastTileX = std::min(TilesX - 1, static_cast<int>(maximum.x) / TileWidth);
+			const auto firstTileY = std::max(0, static_cast<int>(minimum.y) / TileHeight);
+			const auto lastTileY = std::min(TilesY - 1, static_cast<int>(maximum.y) / TileHeight);
+			for (auto tileY = firstTileY; tileY <= lastTileY; tileY++)
+			{
+				for (auto tileX = firstTileX; tileX <= lastTileX; tileX++)
+					tileTriangles[tileY * TilesX + tileX].push_back(index);
+			}
+		}
+	}
+
+	stats.trianglesRasterized = triangles.size();
+}
+
+void OcclusionCuller::Rasterize()
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+
+	BinTriangles();
+
+	// Each tile is only ever written by one job, so the jobs need no locking. Tiles are handed out
+	// Round robin, as the occluders tend to cover some parts of the screen much more than others.
+	const auto tileCount = static_cast<std::size_t>(TilesX * TilesY);
+	const auto jobCount = triangles.empty() ? 0 : std::min(tileCount, static_cast<std::size_t>(workers.GetWorkerCount()) + 1);
+	workers.Run(jobCount, [this, tileCount, jobCount](std::size_t job)
+	{
+		for (auto tile = job; tile < tileCount; tile += jobCount)
+			RasterizeTile(static_cast<int>(tile));
+	});
+
+	stats.jobs = jobCount;
+	stats.rasterizeMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void OcclusionCuller::RasterizeTile(int tile)
+{
+	for (const auto index : tileTriangles[tile])
+		RasterizeTriangle(triangles[index], tile);
+
+	const auto first = depth.begin() + tile * TileSize;
+	const auto bounds = std::minmax_element(first, first + TileSize);
+	tileNearest[tile] = *bounds.first;
+	tileFurthest[tile] = *bounds.second;
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle& triangle, int tile)
+{
+	const auto tileX = (tile % TilesX) * TileWidth;
+	const auto tileY = (tile / TilesX) * TileHeight;
+	const auto& v0 = triangle.vertices[0];
+	const auto& v1 = triangle.vertices[1];
+	const auto& v2 = triangle.vertices[2];
+
+	// The part of the tile covered by the triangle's bounds. Rows start on a multiple of 4 pixels, so they
+	// Can be filled 4 at a time without ever leaving the tile.
+	const auto minimum = glm::min(v0, glm::min(v1, v2));
+	const auto maximum = glm::max(v0, glm::max(v1, v2));
+	const auto firstX = std::max(tileX, static_cast<int>(std::floor(minimum.x))) & ~3;
+	const auto lastX = std::min(tileX + TileWidth, static_cast<int>(std::ceil(maximum.x)));
+	const auto firstY = std::max(tileY, static_cast<int>(std::floor(minimum.y)));
+	const auto lastY = std::min(tileY + TileHeight, static_cast<int>(std::ceil(maximum.y)));
+
+	// Each edge function is a*x + b*y + c, positive on the inside of the edge
+	const glm::vec3* edges[3][2] = { { &v1, &v2 }, { &v2, &v0 }, { &v0, &v1 } };
+	float a[3], b[3], c[3];
+	for (int e = 0; e < 3; e++)
+	{
+		const auto& from = *edges[e][0];
+		const auto& to = *edges[e][1];
+		a[e] = from.y - to.y;
+		b[e] = to.x - from.x;
+		c[e] = from.x * to.y - from.y * to.x;
+	}
+
+	// Depth is linear across the screen. Edge e weighs the vertex opposite of it.
+	const auto area = a[2] * v2.x + b[2] * v2.y + c[2];
+	const auto depthX = (a[0] * v0.z + a[1] * v1.z + a[2] * v2.z) / area;
+	const auto depthY = (b[0] * v0.z + b[1] * v1.z + b[2] * v2.z) / area;
+	const auto depthC = (c[0] * v0.z + c[1] * v1.z + c[2] * v2.z) / area;
+
+	auto tileDepth = depth.data() + tile * TileSize;
+
+#if defined(OCCLUSION_CULLER_SSE)
+	const auto laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const auto zero = _mm_setzero_ps();
+	for (auto y = firstY; y < lastY; y++)
+	{
+		const auto pixelY = y + 0.5f;
+		const auto row = tileDepth + (y - tileY) * TileWidth;
+		for (auto x = firstX; x < lastX; x += 4)
+		{
+			const auto pixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+			auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int e = 0; e < 3; e++)
+			{
+				const auto edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[e]), pixelX), _mm_set1_ps(b[e] * pixelY + c[e]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+			}
+
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			const auto pixelDepth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depthX), pixelX), _mm_set1_ps(depthY * pixelY + depthC));
+			const auto current = _mm_loadu_ps(row + x - tileX);
+			const auto nearest = _mm_min_ps(current, pixelDepth);
+			_mm_storeu_ps(row + x - tileX, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+		}
+	}
+#else
+	for (auto y = firstY; y < lastY; y++)
+	{
+		const auto pixelY = y + 0.5f;
+		const auto row = tileDepth + (y - tileY) * TileWidth;
+		for (auto x = firstX; x < lastX; x++)
+		{
+			const auto pixelX = x + 0.5f;
+			auto inside = true;
+			for (int e = 0; e < 3; e++)
+				inside = inside && a[e] * pixelX + b[e] * pixelY + c[e] >= 0.0f;
+
+			if (inside)
+				row[x - tileX] = std::min(row[x - tileX], depthX * pixelX + depthY * pixelY + depthC);
+		}
+	}
+#endif
+}
+
+bool OcclusionCuller::IsVisible(const BoundingVolume& bounds) const
+{
+	// The rectangle the box covers on the screen, and the depth of its nearest corner
+	glm::vec2 screenMin{ std::numeric_limits<float>::max() };
+	glm::vec2 screenMax{ -std::numeric_limits<float>::max() };
+	auto nearest = std::numeric_limits<float>::max();
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const glm::vec3 position{ corner & 1 ? bounds.max.x : bounds.min.x, corner & 2 ? bounds.max.y : bounds.min.y, corner & 4 ? bounds.max.z : bounds.min.z };
+		const auto clip = viewProjection * glm::vec4(position, 1.0f);
+		if (clip.w < MinimumW)
+			return true;
+
+		const auto ndc = glm::vec3(clip) / clip.w;
+		const auto screen = glm::vec2((ndc.x * 0.5f + 0.5f) * Width, (ndc.y * 0.5f + 0.5f) * Height);
+		screenMin = glm::min(screenMin, screen);
+		screenMax = glm::max(screenMax, screen);
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+
+	const auto firstX = std::max(0, static_cast<int>(std::floor(screenMin.x)));
+	const auto lastX = std::min(Width, static_cast<int>(std::ceil(screenMax.x)));
+	const auto firstY = std::max(0, static_cast<int>(std::floor(screenMin.y)));
+	const auto lastY = std::min(Height, static_cast<int>(std::ceil(screenMax.y)));
+	if (firstX >= lastX || firstY >= lastY || nearest <= 0.0f)
+		return true;
+
+	for (auto tileY = firstY / TileHeight; tileY <= (lastY - 1) / TileHeight; tileY++)
+	{
+		for (auto tileX = firstX / TileWidth; tileX <= (lastX - 1) / TileWidth; tileX++)
+		{
+			// Behind everything in the tile, or in front of everything in it
+			const auto tile = tileY * TilesX + tileX;
+			if (nearest > tileFurthest[tile])
+				continue;
+			if (nearest <= tileNearest[tile])
+				return true;
+
+			const auto left = tileX * TileWidth;
+			const auto top = tileY * TileHeight;
+			const auto fromX = std::max(firstX, left);
+			const auto toX = std::min(lastX, left + TileWidth);
+			const auto tileDepth = depth.data() + tile * TileSize;
+			for (auto y = std::max(firstY, top); y < std::min(lastY, top + TileHeight); y++)
+			{
+				const auto row = tileDepth + (y - top) * TileWidth;
+#if defined(OCCLUSION_CULLER_SSE)
+				// Lanes outside of the rectangle are masked off
+				const auto lane = _mm_setr_epi32(0, 1, 2, 3);
+				const auto objectDepth = _mm_set1_ps(nearest);
+				for (auto x = fromX & ~3; x < toX; x += 4)
+				{
+					const auto pixelX = _mm_add_epi32(_mm_set1_epi32(x), lane);
+					const auto inRectangle = _mm_andnot_si128(_mm_cmplt_epi32(pixelX, _mm_set1_epi32(fromX)), _mm_cmplt_epi32(pixelX, _mm_set1_epi32(toX)));
+					const auto notHidden = _mm_cmpge_ps(_mm_loadu_ps(row + x - left), objectDepth);
+					if (_mm_movemask_ps(_mm_and_ps(notHidden, _mm_castsi128_ps(inRectangle))) != 0)
+						return true;
+				}
+#else
+				for (auto x = fromX; x < toX; x++)
+				{
+					if (row[x - left] >= nearest)
+						return true;
+				}
+#endif
+			}
+		}
+	}
+
+	return false;
+}
+
+void OcclusionCuller::Cull(std::vector<std::uint32_t>& visible, const std::vector<BoundingVolume>& bounds)
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+
+	const auto count = visible.size();
+	testResults.resize(count);
+
+	const auto jobCount = count < ParallelThreshold ? 1 : static_cast<std::size_t>(workers.GetWorkerCount()) + 1;
+	const auto jobSize = (count + jobCount - 1) / jobCount;
+	workers.Run(jobCount, [&](std::size_t job)
+	{
+		const auto last = std::min(count, (job + 1) * jobSize);
+		for (auto i = job * jobSize; i < last; i++)
+			testResults[i] = IsVisible(bounds[visible[i]]);
+	});
+
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < count; i++)
+	{
+		if (testResults[i])
+			visible[kept++] = visible[i];
+	}
+	visible.resize(kept);
+
+	stats.tested += count;
+	stats.occluded += count - kept;
+	stats.testMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+OcclusionCullerStats OcclusionCuller::GetStats() const
+{
+	return lastFrameStats;
+}
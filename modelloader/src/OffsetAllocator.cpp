@@ -0,0 +1,292 @@
+#include "OffsetAllocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+const std::uint32_t OffsetAllocation::NoSpace;
+const std::uint32_t OffsetAllocator::SecondLevelBits;
+const std::uint32_t OffsetAllocator::BinsPerLevel;
+const std::uint32_t OffsetAllocator::LevelCount;
+const std::uint32_t OffsetAllocator::BinCount;
+const std::uint32_t OffsetAllocator::None;
+
+namespace
+{
+	// Index of the highest set bit. The value must not be 0.
+	std::uint32_t HighestBit(std::uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse(&index, value);
+		return index;
+#else
+		return 31 - __builtin_clz(value);
+#endif
+	}
+
+	// Index of the lowest set bit. The value must not be 0.
+	std::uint32_t LowestBit(std::uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return __builtin_ctz(value);
+#endif
+	}
+}
+
+OffsetAllocator::OffsetAllocator(std::uint32_t size)
+	: size{ 0 }, allocations{ 0 }, freeSpace{ 0 }, usedLevels{ 0 }, usedBins{}, lastNode{ None }
+{
+	std::fill(std::begin(binHeads), std::end(binHeads), None);
+	Grow(size);
+}
+
+// Sizes below BinsPerLevel each get a bin of their own. Above that, the highest bit picks the level, and the
+// SecondLevelBits bits below it the bin within the level. Bin indices grow with size across levels.
+std::uint32_t OffsetAllocator::BinRoundedDown(std::uint32_t size)
+{
+	if (size < BinsPerLevel)
+		return size;
+
+	const auto highestBit = HighestBit(size);
+	const auto level = highestBit - SecondLevelBits + 1;
+	const auto bin = (size >> (highestBit - SecondLevelBits)) & (BinsPerLevel - 1);
+	return level * BinsPerLevel + bin;
+}
+
+// The first bin in which every range is at least this large
+std::uint32_t OffsetAllocator::BinRoundedUp(std::uint32_t size)
+{
+	if (size < BinsPerLevel)
+		return size;
+
+	const auto droppedBits = size & ((1u << (HighestBit(size) - SecondLevelBits)) - 1);
+	return BinRoundedDown(size) + (droppedBits != 0 ? 1 : 0);
+}
+
+std::uint32_t OffsetAllocator::FindBin(std::uint32_t minimumBin) const
+{
+	if (minimumBin >= BinCount)
+		return None;
+
+	const auto level = minimumBin / BinsPerLevel;
+	const auto binsInLevel = usedBins[level] & (0xffu << (minimumBin % BinsPerLevel));
+	if (binsInLevel != 0)
+		return level * BinsPerLevel + LowestBit(binsInLevel);
+
+	if (level + 1 >= LevelCount)
+		return None;
+
+	const auto higherLevels = usedLevels & ~((2u << level) - 1);
+	if (higherLevels == 0)
+		return None;
+
+	const auto higherLevel = LowestBit(higherLevels);
+	return higherLevel * BinsPerLevel + LowestBit(usedBins[higherLevel]);
+}
+
+void OffsetAllocator::AddToBin(std::uint32_t node)
+{
+	const auto bin = BinRoundedDown(nodes[node].size);
+	const auto level = bin / BinsPerLevel;
+
+	nodes[node].binPrevious = None;
+	nodes[node].binNext = binHeads[bin];
+	if (binHeads[bin] != None)
+		nodes[binHeads[bin]].binPrevious = node;
+	binHeads[bin] = node;
+
+	usedBins[level] |= 1u << (bin % BinsPerLevel);
+	usedLevels |= 1u << level;
+}
+
+void OffsetAllocator::RemoveFromBin(std::uint32_t node)
+{
+	const auto& removed = nodes[node];
+	if (removed.binPrevious != None)
+	{
+		nodes[removed.binPrevious].binNext = removed.binNext;
+	}
+	else
+	{
+		const auto bin = BinRoundedDown(removed.size);
+		binHeads[bin] = removed.binNext;
+		if (binHeads[bin] == None)
+		{
+			const auto level = bin / BinsPerLevel;
+			usedBins[level] &= ~(1u << (bin % BinsPerLevel));
+			if (usedBins[level] == 0)
+				usedLevels &= ~(1u << level);
+		}
+	}
+
+	if (removed.binNext != None)
+		nodes[removed.binNext].binPrevious = removed.binPrevious;
+}
+
+std::uint32_t OffsetAllocator::NewNode(std::uint32_t offset, std::uint32_t size)
+{
+	std::uint32_t node;
+	if (!unusedNodes.empty())
+	{
+		node = unusedNodes.back();
+		unusedNodes.pop_back();
+	}
+	else
+	{
+		node = static_cast<std::uint32_t>(nodes.size());
+		nodes.emplace_back();
+	}
+
+	nodes[node] = Node{ offset, size, None, None, None, None, false };
+	return node;
+}
+
+void OffsetAllocator::ReleaseNode(std::uint32_t node)
+{
+	unusedNodes.push_back(node);
+}
+
+OffsetAllocation OffsetAllocator::Allocate(std::uint32_t size)
+{
+	size = std::max(size, 1u);
+
+	const auto bin = FindBin(BinRoundedUp(size));
+	if (bin == None)
+		return OffsetAllocation{};
+
+	const auto node = binHeads[bin];
+	RemoveFromBin(node);
+
+	// Whatever we don't need of the range goes back into a bin, right after the allocation
+	const auto remainder = nodes[node].size - size;
+	if (remainder > 0)
+	{
+		const auto rest = NewNode(nodes[node].offset + size, remainder);
+		nodes[rest].neighbourPrevious = node;
+		nodes[rest].neighbourNext = nodes[node].neighbourNext;
+		if (nodes[node].neighbourNext != None)
+			nodes[nodes[node].neighbourNext].neighbourPrevious = rest;
+		else
+			lastNode = rest;
+		nodes[node].neighbourNext = rest;
+		nodes[node].size = size;
+		AddToBin(rest);
+	}
+
+	nodes[node].used = true;
+	allocations++;
+	freeSpace -= size;
+
+	OffsetAllocation allocation{};
+	allocation.offset = nodes[node].offset;
+	allocation.node = node;
+	return allocation;
+}
+
+void OffsetAllocator::Free(OffsetAllocation allocation)
+{
+	if (!allocation.IsValid())
+		return;
+
+	const auto node = allocation.node;
+	assert(node < nodes.size() && nodes[node].used);
+
+	nodes[node].used = false;
+	allocations--;
+	freeSpace += nodes[node].size;
+
+	// Take over free neighbours, so free space never ends up in several ranges side by side
+	const auto previous = nodes[node].neighbourPrevious;
+	if (previous != None && !nodes[previous].used)
+	{
+		RemoveFromBin(previous);
+		nodes[node].offset = nodes[previous].offset;
+		nodes[node].size += nodes[previous].size;
+		nodes[node].neighbourPrevious = nodes[previous].neighbourPrevious;
+		if (nodes[node].neighbourPrevious != None)
+			nodes[nodes[node].neighbourPrevious].neighbourNext = node;
+		ReleaseNode(previous);
+	}
+
+	const auto next = nodes[node].neighbourNext;
+	if (next != None && !nodes[next].used)
+	{
+		RemoveFromBin(next);
+		nodes[node].size += nodes[next].size;
+		nodes[node].neighbourNext = nodes[next].neighbourNext;
+		if (nodes[node].neighbourNext != None)
+			nodes[nodes[node].neighbourNext].neighbourPrevious = node;
+		else
+			lastNode = node;
+		ReleaseNode(next);
+	}
+
+	AddToBin(node);
+}
+
+void OffsetAllocator::Grow(std::uint32_t newSize)
+{
+	if (newSize <= size)
+		return;
+
+	const auto added = newSize - size;
+	if (lastNode != None && !nodes[lastNode].used)
+	{
+		RemoveFromBin(lastNode);
+		nodes[lastNode].size += added;
+		AddToBin(lastNode);
+	}
+	else
+	{
+		const auto node = NewNode(size, added);
+		nodes[node].neighbourPrevious = lastNode;
+		if (lastNode != None)
+			nodes[lastNode].neighbourNext = node;
+		lastNode = node;
+		AddToBin(node);
+	}
+
+	size = newSize;
+	freeSpace += added;
+}
+
+std::uint32_t OffsetAllocator::GetSize() const
+{
+	return size;
+}
+
+std::uint32_t OffsetAllocator::AllocationSize(OffsetAllocation allocation) const
+{
+	return allocation.IsValid() ? nodes[allocation.node].size : 0;
+}
+
+OffsetAllocatorStats OffsetAllocator::GetStats() const
+{
+	OffsetAllocatorStats stats{};
+	stats.size = size;
+	stats.allocations = allocations;
+	stats.freeSpace = freeSpace;
+	stats.freeRegions = static_cast<std::uint32_t>(nodes.size() - unusedNodes.size()) - allocations;
+
+	// The largest free range is in the highest non-empty bin, though not necessarily at its head
+	if (usedLevels != 0)
+	{
+		const auto level = HighestBit(usedLevels);
+		const auto bin = level * BinsPerLevel + HighestBit(usedBins[level]);
+		for (auto node = binHeads[bin]; node != None; node = nodes[node].binNext)
+			stats.largestFreeRegion = std::max(stats.largestFreeRegion, nodes[node].size);
+	}
+
+	if (freeSpace > 0)
+		stats.fragmentation = 1.0f - static_cast<float>(stats.largestFreeRegion) / freeSpace;
+
+	return stats;
+}
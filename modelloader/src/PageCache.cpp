@@ -0,0 +1,136 @@
+#include "PageCache.hpp"
+
+const int PageId::MaxTextureId;
+const int PageId::MaxLevel;
+const int PageId::MaxCoordinate;
+
+std::uint32_t PageId::Pack() const
+{
+	// 4 bits of texture id, 4 bits of level, and 12 bits for each coordinate
+	return static_cast<std::uint32_t>(textureId) << 28 | static_cast<std::uint32_t>(level) << 24
+		| static_cast<std::uint32_t>(y) << 12 | static_cast<std::uint32_t>(x);
+}
+
+PageId PageId::Unpack(std::uint32_t packed)
+{
+	return PageId{ static_cast<int>(packed >> 28), static_cast<int>(packed >> 24 & 15), static_cast<int>(packed & 4095), static_cast<int>(packed >> 12 & 4095) };
+}
+
+PageId PageId::Parent() const
+{
+	return PageId{ textureId, level + 1, x / 2, y / 2 };
+}
+
+bool PageId::operator==(const PageId& other) const
+{
+	return Pack() == other.Pack();
+}
+
+bool PageId::operator!=(const PageId& other) const
+{
+	return !(*this == other);
+}
+
+PageCache::PageCache(int slotCount)
+	: slots(slotCount), frame{ 0 }
+{
+	// Handed out from the back, so slot 0 goes first
+	for (int slot = slotCount - 1; slot >= 0; slot--)
+		freeSlots.push_back(slot);
+}
+
+void PageCache::BeginFrame(std::uint64_t frame)
+{
+	this->frame = frame;
+}
+
+int PageCache::Find(PageId page) const
+{
+	const auto existing = slotOfPage.find(page.Pack());
+	return existing == slotOfPage.end() ? -1 : existing->second;
+}
+
+void PageCache::Touch(PageId page)
+{
+	const auto slotIndex = Find(page);
+	if (slotIndex == -1)
+		return;
+
+	auto& slot = slots[slotIndex];
+	slot.lastUsedFrame = frame;
+
+	// Most recently used pages go to the back of the list
+	if (!slot.pinned)
+		recency.splice(recency.end(), recency, slot.recencyPosition);
+}
+
+PageCache::Insertion PageCache::Insert(PageId page, bool pinned)
+{
+	Insertion insertion{};
+
+	const auto existing = Find(page);
+	if (existing != -1)
+	{
+		Touch(page);
+		insertion.slot = existing;
+		return insertion;
+	}
+
+	if (freeSlots.empty())
+	{
+		// The front of the list is the least recently used page. If even that one was used this frame,
+		// Every page in the cache is needed right now, and there is nothing we can evict.
+		if (recency.empty() || slots[recency.front()].lastUsedFrame >= frame)
+			return insertion;
+
+		const auto victim = recency.front();
+		insertion.evicted = true;
+		insertion.evictedPage = slots[victim].page;
+		Free(victim);
+	}
+
+	const auto slotIndex = freeSlots.back();
+	freeSlots.pop_back();
+
+	auto& slot = slots[slotIndex];
+	slot.page = page;
+	slot.occupied = true;
+	slot.pinned = pinned;
+	slot.lastUsedFrame = frame;
+	if (!pinned)
+		slot.recencyPosition = recency.insert(recency.end(), slotIndex);
+
+	slotOfPage[page.Pack()] = slotIndex;
+	insertion.slot = slotIndex;
+	return insertion;
+}
+
+void PageCache::RemoveTexture(int textureId)
+{
+	for (int slot = 0; slot < static_cast<int>(slots.size()); slot++)
+	{
+		if (slots[slot].occupied && slots[slot].page.textureId == textureId)
+			Free(slot);
+	}
+}
+
+int PageCache::GetSlotCount() const
+{
+	return static_cast<int>(slots.size());
+}
+
+int PageCache::GetResidentCount() const
+{
+	return static_cast<int>(slotOfPage.size());
+}
+
+void PageCache::Free(int slotIndex)
+{
+	auto& slot = slots[slotIndex];
+	if (!slot.pinned)
+		recency.erase(slot.recencyPosition);
+
+	slotOfPage.erase(slot.page.Pack());
+	slot = Slot{};
+	freeSlots.push_back(slotIndex);
+}
@@ -0,0 +1,181 @@
+#include "PageFeedback.hpp"
+
+#include <algorithm>
+
+bool PageFeedback::DecodePixel(const unsigned char* rgba, PageId& page)
+{
+	if (rgba[3] == 0)
+		return false;
+
+	page.textureId = rgba[3] >> 4;
+	page.level = rgba[3] & 15;
+	page.x = rgba[0] | (rgba[1] & 15) << 8;
+	page.y = rgba[1] >> 4 | rgba[2] << 4;
+	return true;
+}
+
+std::vector<PageRequest> PageFeedback::Analyze(const unsigned char* rgba, std::size_t pixelCount)
+{
+	// Neighbouring pixels almost always ask for the same page, so we only look the count up when the page changes
+	std::unordered_map<std::uint32_t, std::size_t> counts{};
+	std::uint32_t previous = 0;
+	std::size_t run = 0;
+
+	for (std::size_t i = 0; i < pixelCount; i++)
+	{
+		PageId page{};
+		if (!DecodePixel(rgba + i * 4, page))
+			continue;
+
+		const auto packed = page.Pack();
+		if (run > 0 && packed == previous)
+		{
+			run++;
+			continue;
+		}
+
+		if (run > 0)
+			counts[previous] += run;
+
+		previous = packed;
+		run = 1;
+	}
+
+	if (run > 0)
+		counts[previous] += run;
+
+	std::vector<PageRequest> requests{};
+	requests.reserve(counts.size());
+	for (const auto& count : counts)
+		requests.push_back(PageRequest{ PageId::Unpack(count.first), count.second });
+
+	return requests;
+}
+
+void PageRequestQueue::AddTexture(int textureId, const VirtualTextureLayout& layout)
+{
+	layouts[textureId] = layout;
+}
+
+void PageRequestQueue::RemoveTexture(int textureId)
+{
+	layouts.erase(textureId);
+
+	for (auto it = loading.begin(); it != loading.end();)
+	{
+		if (PageId::Unpack(*it).textureId == textureId)
+			it = loading.erase(it);
+		else
+			++it;
+	}
+
+	queue.erase(std::remove_if(queue.begin() + nextRequest, queue.end(), [textureId](const PageRequest& request)
+	{
+		return request.page.textureId == textureId;
+	}), queue.end());
+}
+
+void PageRequestQueue::Submit(const std::vector<PageRequest>& requests, PageCache& cache)
+{
+	std::unordered_map<std::uint32_t, std::size_t> pixelCounts{};
+
+	// Nothing on screen needs the coarsest pages, but everything falls back on them
+	for (const auto& layout : layouts)
+	{
+		const auto coarsest = PageId{ layout.first, layout.second.levelCount - 1, 0, 0 };
+		if (cache.Find(coarsest) == -1)
+			pixelCounts.emplace(coarsest.Pack(), 0);
+		else
+			cache.Touch(coarsest);
+	}
+
+	for (const auto& request : requests)
+	{
+		// The feedback is a frame or two old, so it may well mention textures which are gone by now
+		if (!IsValid(request.page))
+			continue;
+
+		// Walk from the requested page up to the coarsest level, keeping every resident page in use,
+		// And remembering the coarsest page which is missing
+		auto page = request.page;
+		auto missing = page;
+		auto isMissing = false;
+		while (true)
+		{
+			if (cache.Find(page) == -1)
+			{
+				missing = page;
+				isMissing = true;
+			}
+			else
+			{
+				cache.Touch(page);
+			}
+
+			if (IsCoarsestLevel(page))
+				break;
+
+			page = page.Parent();
+		}
+
+		if (isMissing)
+			pixelCounts[missing.Pack()] += request.pixelCount;
+	}
+
+	queue.clear();
+	nextRequest = 0;
+	for (const auto& count : pixelCounts)
+	{
+		if (loading.count(count.first) == 0)
+			queue.push_back(PageRequest{ PageId::Unpack(count.first), count.second });
+	}
+
+	std::sort(queue.begin(), queue.end(), [](const PageRequest& a, const PageRequest& b)
+	{
+		if (a.page.level != b.page.level)
+			return a.page.level > b.page.level;
+		if (a.pixelCount != b.pixelCount)
+			return a.pixelCount > b.pixelCount;
+		return a.page.Pack() < b.page.Pack();
+	});
+}
+
+bool PageRequestQueue::Pop(PageId& page)
+{
+	if (nextRequest >= queue.size())
+		return false;
+
+	page = queue[nextRequest++].page;
+	loading.insert(page.Pack());
+	return true;
+}
+
+void PageRequestQueue::Complete(PageId page)
+{
+	loading.erase(page.Pack());
+}
+
+bool PageRequestQueue::IsCoarsestLevel(PageId page) const
+{
+	const auto layout = layouts.find(page.textureId);
+	return layout == layouts.end() || page.level >= layout->second.levelCount - 1;
+}
+
+std::size_t PageRequestQueue::GetQueuedCount() const
+{
+	return queue.size() - nextRequest;
+}
+
+std::size_t PageRequestQueue::GetLoadingCount() const
+{
+	return loading.size();
+}
+
+bool PageRequestQueue::IsValid(PageId page) const
+{
+	const auto layout = layouts.find(page.textureId);
+	if (layout == layouts.end() || page.level >= layout->second.levelCount)
+		return false;
+
+	return page.x < layout->second.PagesWide(page.level) && page.y < layout->second.PagesHigh(page.level);
+}
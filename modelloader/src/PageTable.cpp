@@ -0,0 +1,118 @@
+#include "PageTable.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	int NextPowerOfTwo(int value)
+	{
+		auto power = 1;
+		while (power < value)
+			power *= 2;
+		return power;
+	}
+}
+
+PageTable::PageTable(const VirtualTextureLayout& layout)
+	: layout{ layout }, tableWidth{ NextPowerOfTwo(layout.PagesWide(0)) }, tableHeight{ NextPowerOfTwo(layout.PagesHigh(0)) },
+	dirtyLevel{ layout.levelCount - 1 }
+{
+	for (int level = 0; level < layout.levelCount; level++)
+	{
+		const auto pageCount = static_cast<std::size_t>(layout.PagesWide(level)) * layout.PagesHigh(level);
+		mappedSlots.emplace_back(pageCount, -1);
+		resolved.emplace_back(pageCount, Entry{ -1, layout.levelCount - 1 });
+	}
+}
+
+void PageTable::Map(int level, int x, int y, int slot)
+{
+	mappedSlots[level][static_cast<std::size_t>(y) * layout.PagesWide(level) + x] = slot;
+	dirtyLevel = std::max(dirtyLevel, level);
+}
+
+void PageTable::Unmap(int level, int x, int y)
+{
+	Map(level, x, y, -1);
+}
+
+bool PageTable::IsMapped(int level, int x, int y) const
+{
+	return mappedSlots[level][static_cast<std::size_t>(y) * layout.PagesWide(level) + x] != -1;
+}
+
+int PageTable::Update()
+{
+	const auto changedLevel = dirtyLevel;
+
+	// Coarse to fine, so every page's parent is resolved by the time we get to it
+	for (auto level = dirtyLevel; level >= 0; level--)
+	{
+		const auto pagesWide = layout.PagesWide(level);
+		const auto pagesHigh = layout.PagesHigh(level);
+		const auto isCoarsest = level == layout.levelCount - 1;
+
+		for (int y = 0; y < pagesHigh; y++)
+		{
+			for (int x = 0; x < pagesWide; x++)
+			{
+				const auto page = static_cast<std::size_t>(y) * pagesWide + x;
+				const auto slot = mappedSlots[level][page];
+
+				if (slot != -1)
+					resolved[level][page] = Entry{ slot, level };
+				else if (isCoarsest)
+					resolved[level][page] = Entry{ -1, level };
+				else
+					resolved[level][page] = Resolve(level + 1, x / 2, y / 2);
+			}
+		}
+	}
+
+	dirtyLevel = -1;
+	return changedLevel;
+}
+
+const PageTable::Entry& PageTable::Resolve(int level, int x, int y) const
+{
+	return resolved[level][static_cast<std::size_t>(y) * layout.PagesWide(level) + x];
+}
+
+int PageTable::GetTableWidth(int level) const
+{
+	return std::max(1, tableWidth >> level);
+}
+
+int PageTable::GetTableHeight(int level) const
+{
+	return std::max(1, tableHeight >> level);
+}
+
+void PageTable::WriteTexels(int level, int atlasSlotsPerRow, std::vector<unsigned char>& texels) const
+{
+	const auto texelsWide = GetTableWidth(level);
+	const auto texelsHigh = GetTableHeight(level);
+	texels.assign(static_cast<std::size_t>(texelsWide) * texelsHigh * 4, 0);
+
+	// The table can be larger than the page grid. Texels past the last page are never looked up.
+	for (int y = 0; y < layout.PagesHigh(level); y++)
+	{
+		for (int x = 0; x < layout.PagesWide(level); x++)
+		{
+			const auto& entry = Resolve(level, x, y);
+			if (entry.slot == -1)
+				continue;
+
+			const auto texel = texels.data() + (static_cast<std::size_t>(y) * texelsWide + x) * 4;
+			texel[0] = static_cast<unsigned char>(entry.slot % atlasSlotsPerRow);
+			texel[1] = static_cast<unsigned char>(entry.slot / atlasSlotsPerRow);
+			texel[2] = static_cast<unsigned char>(entry.level);
+			texel[3] = 255;
+		}
+	}
+}
+
+int PageTable::GetLevelCount() const
+{
+	return layout.levelCount;
+}
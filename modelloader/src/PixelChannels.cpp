@@ -0,0 +1,69 @@
+#include "PixelChannels.hpp"
+
+int MinimalChannelCount(const unsigned char* pixels, std::size_t pixelCount, int nrChannels)
+{
+	const auto hasAlphaChannel = nrChannels == 2 || nrChannels == 4;
+	const auto hasColorChannels = nrChannels >= 3;
+	const auto alphaOffset = nrChannels - 1;
+
+	auto alphaIsOpaque = true;
+	auto isGrey = true;
+
+	for (std::size_t i = 0; i < pixelCount && (alphaIsOpaque || isGrey); i++)
+	{
+		const auto pixel = pixels + i * nrChannels;
+
+		if (hasAlphaChannel && pixel[alphaOffset] != 255)
+			alphaIsOpaque = false;
+
+		if (hasColorChannels && (pixel[0] != pixel[1] || pixel[0] != pixel[2]))
+			isGrey = false;
+	}
+
+	const auto needsAlpha = hasAlphaChannel && !alphaIsOpaque;
+	const auto needsColor = hasColorChannels && !isGrey;
+
+	if (needsColor)
+		return needsAlpha ? 4 : 3;
+
+	return needsAlpha ? 2 : 1;
+}
+
+void ConvertChannels(const unsigned char* pixels, std::size_t pixelCount, int fromChannels, int toChannels, unsigned char* converted)
+{
+	const auto fromHasAlpha = fromChannels == 2 || fromChannels == 4;
+
+	for (std::size_t i = 0; i < pixelCount; i++)
+	{
+		const auto source = pixels + i * fromChannels;
+		const auto destination = converted + i * toChannels;
+
+		// Grey sources replicate their single channel into red, green and blue
+		const auto red = source[0];
+		const auto green = fromChannels >= 3 ? source[1] : source[0];
+		const auto blue = fromChannels >= 3 ? source[2] : source[0];
+		const auto alpha = fromHasAlpha ? source[fromChannels - 1] : static_cast<unsigned char>(255);
+
+		switch (toChannels)
+		{
+		case 1:
+			destination[0] = red;
+			break;
+		case 2:
+			destination[0] = red;
+			destination[1] = alpha;
+			break;
+		case 3:
+			destination[0] = red;
+			destination[1] = green;
+			destination[2] = blue;
+			break;
+		default:
+			destination[0] = red;
+			destination[1] = green;
+			destination[2] = blue;
+			destination[3] = alpha;
+			break;
+		}
+	}
+}
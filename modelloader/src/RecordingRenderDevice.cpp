@@ -0,0 +1,533 @@
+#include "RecordingRenderDevice.hpp"
+
+#include <cassert>
+#include <cstring>
+
+const std::uint32_t RecordingRenderDevice::Unknown;
+
+RecordingRenderDevice::RecordingRenderDevice(bool multiDrawIndirect, bool keepData)
+	: multiDrawIndirect{ multiDrawIndirect }, keepData{ keepData }, commandStart{ 0 }, nextHandle{ 1 }, program{ Unknown },
+	vertexArray{ Unknown }, viewport{ -1 }, depthTest{ -1 }
+{
+	for (auto& buffer : buffers)
+		buffer = Unknown;
+}
+
+void RecordingRenderDevice::BeginFrame()
+{
+	recordingStats.streamBytes = stream.size() * sizeof(std::uint32_t);
+	lastFrameStats = stats;
+	lastFrameRecordingStats = recordingStats;
+	stats = RenderDeviceStats{};
+	recordingStats = RecordingStats{};
+
+	// Swapping keeps both allocations around, so recording doesn't allocate once the streams are large enough
+	lastFrameStream.swap(stream);
+	stream.clear();
+}
+
+void RecordingRenderDevice::Begin(RecordedCommand command)
+{
+	commandStart = stream.size();
+	stream.push_back(static_cast<std::uint32_t>(command));
+
+	recordingStats.commands++;
+	recordingStats.commandCounts[static_cast<int>(command)]++;
+}
+
+void RecordingRenderDevice::End()
+{
+	const auto argumentCount = stream.size() - commandStart - 1;
+	assert(argumentCount < (1u << 24));
+	stream[commandStart] |= static_cast<std::uint32_t>(argumentCount) << 8;
+}
+
+void RecordingRenderDevice::Push(std::uint32_t word)
+{
+	stream.push_back(word);
+}
+
+void RecordingRenderDevice::PushSize(std::size_t value)
+{
+	const auto wide = static_cast<std::uint64_t>(value);
+	stream.push_back(static_cast<std::uint32_t>(wide));
+	stream.push_back(static_cast<std::uint32_t>(wide >> 32));
+}
+
+void RecordingRenderDevice::PushData(const void* data, std::size_t bytes)
+{
+	PushSize(bytes);
+	if (!keepData || !data || bytes == 0)
+		return;
+
+	const auto start = stream.size();
+	stream.resize(start + (bytes + sizeof(std::uint32_t) - 1) / sizeof(std::uint32_t), 0);
+	std::memcpy(stream.data() + start, data, bytes);
+}
+
+void RecordingRenderDevice::ResetState()
+{
+	program = Unknown;
+	vertexArray = Unknown;
+	for (auto& buffer : buffers)
+		buffer = Unknown;
+	uniformBuffers.clear();
+	textures.clear();
+	attributes.clear();
+	viewport = glm::ivec4{ -1 };
+	depthTest = -1;
+}
+
+std::size_t RecordingRenderDevice::ReadCommand(const std::vector<std::uint32_t>& stream, std::size_t position, RecordedCommand& command,
+	const std::uint32_t*& arguments, std::uint32_t& argumentCount)
+{
+	assert(position < stream.size());
+
+	const auto header = stream[position];
+	command = static_cast<RecordedCommand>(header & 0xff);
+	argumentCount = header >> 8;
+	arguments = stream.data() + position + 1;
+	return position + 1 + argumentCount;
+}
+
+namespace
+{
+	std::size_t ReadSize(const std::uint32_t* words)
+	{
+		return static_cast<std::size_t>(static_cast<std::uint64_t>(words[0]) | static_cast<std::uint64_t>(words[1]) << 32);
+	}
+
+	// Whether the data of an upload, whose size is at sizeWord, was kept in the stream after it
+	bool HasData(const std::uint32_t* arguments, std::uint32_t argumentCount, std::uint32_t sizeWord)
+	{
+		const auto dataWords = sizeWord + 2;
+		if (argumentCount < dataWords)
+			return false;
+
+		const auto bytes = ReadSize(arguments + sizeWord);
+		return (argumentCount - dataWords) * sizeof(std::uint32_t) >= bytes;
+	}
+}
+
+void RecordingRenderDevice::Replay(const std::vector<std::uint32_t>& stream, RenderDevice& device)
+{
+	std::size_t position = 0;
+	while (position < stream.size())
+	{
+		RecordedCommand command;
+		const std::uint32_t* arguments;
+		std::uint32_t argumentCount;
+		position = ReadCommand(stream, position, command, arguments, argumentCount);
+
+		switch (command)
+		{
+		case RecordedCommand::UpdateBuffer:
+			// The data follows the size, unless it wasn't kept. Uploads without it are skipped, rather than uploading
+			// Whatever commands come after.
+			if (!HasData(arguments, argumentCount, 3))
+			{
+				assert(false);
+				break;
+			}
+			device.UpdateBuffer(arguments[0], ReadSize(arguments + 1), ReadSize(arguments + 3), arguments + 5);
+			break;
+		case RecordedCommand::DeleteBuffer:
+			device.DeleteBuffer(arguments[0]);
+			break;
+		case RecordedCommand::UpdateTexture:
+			if (!HasData(arguments, argumentCount, 6))
+			{
+				assert(false);
+				break;
+			}
+			device.UpdateTexture(arguments[0], static_cast<int>(arguments[1]), static_cast<int>(arguments[2]), static_cast<int>(arguments[3]),
+				static_cast<int>(arguments[4]), static_cast<int>(arguments[5]), arguments + 8);
+			break;
+		case RecordedCommand::DeleteTexture:
+			device.DeleteTexture(arguments[0]);
+			break;
+		case RecordedCommand::DeleteProgram:
+			device.DeleteProgram(arguments[0]);
+			break;
+		case RecordedCommand::UseProgram:
+			device.UseProgram(arguments[0]);
+			break;
+		case RecordedCommand::BindVertexArray:
+			device.BindVertexArray(arguments[0]);
+			break;
+		case RecordedCommand::BindBuffer:
+			device.BindBuffer(static_cast<BufferTarget>(arguments[0]), arguments[1]);
+			break;
+		case RecordedCommand::BindUniformBuffer:
+			device.BindUniformBuffer(arguments[0], arguments[1], ReadSize(arguments + 2), ReadSize(arguments + 4));
+			break;
+		case RecordedCommand::BindTexture:
+			device.BindTexture(arguments[0], arguments[1]);
+			break;
+		case RecordedCommand::SetVertexAttribute:
+			device.SetVertexAttribute(arguments[0], static_cast<int>(arguments[1]), ReadSize(arguments + 2), arguments[4], ReadSize(arguments + 5));
+			break;
+		case RecordedCommand::SetViewport:
+			device.SetViewport(static_cast<int>(arguments[0]), static_cast<int>(arguments[1]), static_cast<int>(arguments[2]), static_cast<int>(arguments[3]));
+			break;
+		case RecordedCommand::SetDepthTest:
+			device.SetDepthTest(arguments[0] != 0);
+			break;
+		case RecordedCommand::Clear:
+		{
+			glm::vec4 color{};
+			std::memcpy(&color[0], arguments, sizeof(float) * 4);
+			device.Clear(color);
+			break;
+		}
+		case RecordedCommand::DrawIndexed:
+			device.DrawIndexed(arguments[0], arguments[1], static_cast<std::int32_t>(arguments[2]), arguments[3]);
+			break;
+		case RecordedCommand::MultiDrawIndexedIndirect:
+			device.MultiDrawIndexedIndirect(arguments[0], ReadSize(arguments + 1), arguments[3]);
+			break;
+		default:
+			// Objects have to be created on the device they're used with, or their handles mean nothing to it
+			assert(false);
+			break;
+		}
+	}
+}
+
+// Returns true if the call can be skipped. Otherwise remembers the new value, and counts the call as a state change.
+bool RecordingRenderDevice::Filter(std::uint32_t& current, std::uint32_t value)
+{
+	if (current == value)
+	{
+		stats.stateChangesFiltered++;
+		return true;
+	}
+
+	current = value;
+	stats.stateChanges++;
+	return false;
+}
+
+std::uint32_t RecordingRenderDevice::CreateBuffer(BufferTarget target, std::size_t bytes, const void* data, BufferUsage usage)
+{
+	const auto buffer = nextHandle++;
+	bufferSizes[buffer] = bytes;
+
+	Begin(RecordedCommand::CreateBuffer);
+	Push(buffer);
+	Push(static_cast<std::uint32_t>(target));
+	Push(static_cast<std::uint32_t>(usage));
+	PushSize(bytes);
+	PushData(data, data ? bytes : 0);
+	End();
+
+	if (data)
+		stats.bufferBytesUploaded += bytes;
+	return buffer;
+}
+
+void RecordingRenderDevice::UpdateBuffer(std::uint32_t buffer, std::size_t offset, std::size_t bytes, const void* data)
+{
+	assert(bufferSizes.count(buffer) != 0 && offset + bytes <= bufferSizes[buffer]);
+
+	Begin(RecordedCommand::UpdateBuffer);
+	Push(buffer);
+	PushSize(offset);
+	PushData(data, bytes);
+	End();
+
+	stats.bufferBytesUploaded += bytes;
+}
+
+void RecordingRenderDevice::DeleteBuffer(std::uint32_t buffer)
+{
+	bufferSizes.erase(buffer);
+
+	// Deleted objects are unbound, like OpenGL does
+	for (auto& binding : buffers)
+	{
+		if (binding == buffer)
+			binding = Unknown;
+	}
+	for (auto& range : uniformBuffers)
+	{
+		if (range.buffer == buffer)
+			range.buffer = Unknown;
+	}
+	for (auto& attribute : attributes)
+	{
+		if (attribute.buffer == buffer)
+			attribute.buffer = Unknown;
+	}
+
+	Begin(RecordedCommand::DeleteBuffer);
+	Push(buffer);
+	End();
+}
+
+std::uint32_t RecordingRenderDevice::CreateTexture(int width, int height, int levelCount)
+{
+	const auto texture = nextHandle++;
+	textureSizes[texture] = glm::ivec2(width, height);
+
+	Begin(RecordedCommand::CreateTexture);
+	Push(texture);
+	Push(static_cast<std::uint32_t>(width));
+	Push(static_cast<std::uint32_t>(height));
+	Push(static_cast<std::uint32_t>(levelCount));
+	End();
+
+	return texture;
+}
+
+void RecordingRenderDevice::UpdateTexture(std::uint32_t texture, int level, int x, int y, int width, int height, const void* pixels)
+{
+	assert(textureSizes.count(texture) != 0);
+
+	const auto bytes = static_cast<std::size_t>(width) * height * 4;
+
+	Begin(RecordedCommand::UpdateTexture);
+	Push(texture);
+	Push(static_cast<std::uint32_t>(level));
+	Push(static_cast<std::uint32_t>(x));
+	Push(static_cast<std::uint32_t>(y));
+	Push(static_cast<std::uint32_t>(width));
+	Push(static_cast<std::uint32_t>(height));
+	PushData(pixels, bytes);
+	End();
+
+	stats.textureBytesUploaded += bytes;
+}
+
+void RecordingRenderDevice::DeleteTexture(std::uint32_t texture)
+{
+	textureSizes.erase(texture);
+	for (auto& binding : textures)
+	{
+		if (binding == texture)
+			binding = Unknown;
+	}
+
+	Begin(RecordedCommand::DeleteTexture);
+	Push(texture);
+	End();
+}
+
+std::uint32_t RecordingRenderDevice::CreateProgram(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	const auto created = nextHandle++;
+
+	// The sources go in one after the other, each with its own size in front
+	Begin(RecordedCommand::CreateProgram);
+	Push(created);
+	PushData(vertexSource.data(), vertexSource.size());
+	PushData(fragmentSource.data(), fragmentSource.size());
+	End();
+
+	return created;
+}
+
+void RecordingRenderDevice::DeleteProgram(std::uint32_t program)
+{
+	if (this->program == program)
+		this->program = Unknown;
+
+	Begin(RecordedCommand::DeleteProgram);
+	Push(program);
+	End();
+}
+
+void RecordingRenderDevice::UseProgram(std::uint32_t program)
+{
+	if (Filter(this->program, program))
+		return;
+
+	Begin(RecordedCommand::UseProgram);
+	Push(program);
+	End();
+}
+
+void RecordingRenderDevice::BindVertexArray(std::uint32_t vertexArray)
+{
+	if (Filter(this->vertexArray, vertexArray))
+		return;
+
+	// The index buffer binding and the attributes belong to the vertex array
+	buffers[static_cast<int>(BufferTarget::Index)] = Unknown;
+	attributes.clear();
+
+	Begin(RecordedCommand::BindVertexArray);
+	Push(vertexArray);
+	End();
+}
+
+void RecordingRenderDevice::BindBuffer(BufferTarget target, std::uint32_t buffer)
+{
+	if (Filter(buffers[static_cast<int>(target)], buffer))
+		return;
+
+	Begin(RecordedCommand::BindBuffer);
+	Push(static_cast<std::uint32_t>(target));
+	Push(buffer);
+	End();
+}
+
+void RecordingRenderDevice::BindUniformBuffer(std::uint32_t index, std::uint32_t buffer, std::size_t offset, std::size_t bytes)
+{
+	if (uniformBuffers.size() <= index)
+		uniformBuffers.resize(index + 1, BufferRange{ Unknown, 0, 0 });
+
+	auto& range = uniformBuffers[index];
+	if (range.buffer == buffer && range.offset == offset && range.bytes == bytes)
+	{
+		stats.stateChangesFiltered++;
+		return;
+	}
+
+	range = BufferRange{ buffer, offset, bytes };
+	stats.stateChanges++;
+
+	Begin(RecordedCommand::BindUniformBuffer);
+	Push(index);
+	Push(buffer);
+	PushSize(offset);
+	PushSize(bytes);
+	End();
+}
+
+void RecordingRenderDevice::BindTexture(std::uint32_t unit, std::uint32_t texture)
+{
+	if (textures.size() <= unit)
+		textures.resize(unit + 1, Unknown);
+
+	if (Filter(textures[unit], texture))
+		return;
+
+	Begin(RecordedCommand::BindTexture);
+	Push(unit);
+	Push(texture);
+	End();
+}
+
+void RecordingRenderDevice::SetVertexAttribute(std::uint32_t location, int components, std::size_t stride, std::uint32_t buffer, std::size_t offset)
+{
+	if (attributes.size() <= location)
+		attributes.resize(location + 1, VertexAttribute{ 0, 0, Unknown, 0 });
+
+	auto& attribute = attributes[location];
+	if (attribute.components == components && attribute.stride == stride && attribute.buffer == buffer && attribute.offset == offset)
+	{
+		stats.stateChangesFiltered++;
+		return;
+	}
+
+	attribute = VertexAttribute{ components, stride, buffer, offset };
+	stats.stateChanges++;
+
+	Begin(RecordedCommand::SetVertexAttribute);
+	Push(location);
+	Push(static_cast<std::uint32_t>(components));
+	PushSize(stride);
+	Push(buffer);
+	PushSize(offset);
+	End();
+}
+
+void RecordingRenderDevice::SetViewport(int x, int y, int width, int height)
+{
+	const auto value = glm::ivec4(x, y, width, height);
+	if (viewport == value)
+	{
+		stats.stateChangesFiltered++;
+		return;
+	}
+
+	viewport = value;
+	stats.stateChanges++;
+
+	Begin(RecordedCommand::SetViewport);
+	Push(static_cast<std::uint32_t>(x));
+	Push(static_cast<std::uint32_t>(y));
+	Push(static_cast<std::uint32_t>(width));
+	Push(static_cast<std::uint32_t>(height));
+	End();
+}
+
+void RecordingRenderDevice::SetDepthTest(bool enabled)
+{
+	if (depthTest == static_cast<int>(enabled))
+	{
+		stats.stateChangesFiltered++;
+		return;
+	}
+
+	depthTest = enabled;
+	stats.stateChanges++;
+
+	Begin(RecordedCommand::SetDepthTest);
+	Push(enabled);
+	End();
+}
+
+void RecordingRenderDevice::Clear(const glm::vec4& color)
+{
+	Begin(RecordedCommand::Clear);
+	for (int i = 0; i < 4; i++)
+	{
+		std::uint32_t word = 0;
+		std::memcpy(&word, &color[i], sizeof(word));
+		Push(word);
+	}
+	End();
+}
+
+void RecordingRenderDevice::DrawIndexed(std::uint32_t indexCount, std::uint32_t firstIndex, std::int32_t baseVertex, std::uint32_t instanceCount)
+{
+	Begin(RecordedCommand::DrawIndexed);
+	Push(indexCount);
+	Push(firstIndex);
+	Push(static_cast<std::uint32_t>(baseVertex));
+	Push(instanceCount);
+	End();
+
+	stats.drawCalls++;
+	stats.draws++;
+	stats.triangles += indexCount / 3 * instanceCount;
+}
+
+void RecordingRenderDevice::MultiDrawIndexedIndirect(std::uint32_t buffer, std::size_t offset, std::uint32_t drawCount)
+{
+	assert(multiDrawIndirect);
+
+	// The GL device binds the indirect buffer as part of the call, so that's filtered the same way here
+	BindBuffer(BufferTarget::Indirect, buffer);
+
+	Begin(RecordedCommand::MultiDrawIndexedIndirect);
+	Push(buffer);
+	PushSize(offset);
+	Push(drawCount);
+	End();
+
+	stats.drawCalls++;
+	stats.draws += drawCount;
+}
+
+bool RecordingRenderDevice::SupportsMultiDrawIndirect()
+{
+	return multiDrawIndirect;
+}
+
+RenderDeviceStats RecordingRenderDevice::GetStats() const
+{
+	return lastFrameStats;
+}
+
+RecordingStats RecordingRenderDevice::GetRecordingStats() const
+{
+	return lastFrameRecordingStats;
+}
+
+const std::vector<std::uint32_t>& RecordingRenderDevice::GetLastFrame() const
+{
+	return lastFrameStream;
+}
@@ -0,0 +1,19 @@
+#include "RenderDevice.hpp"
+
+#include <cassert>
+
+namespace
+{
+	RenderDevice* globalDevice = nullptr;
+}
+
+RenderDevice& RenderDevice::Global()
+{
+	assert(globalDevice);
+	return *globalDevice;
+}
+
+void RenderDevice::SetGlobal(RenderDevice* device)
+{
+	globalDevice = device;
+}
@@ -0,0 +1,167 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+const int RenderKey::PassBits;
+const int RenderKey::ShaderBits;
+const int RenderKey::TextureBits;
+const int RenderKey::VertexArrayBits;
+const int RenderKey::DepthBits;
+const int RenderKey::DepthShift;
+const int RenderKey::VertexArrayShift;
+const int RenderKey::TextureShift;
+const int RenderKey::ShaderShift;
+const int RenderKey::PassShift;
+
+namespace
+{
+	std::uint64_t FieldMask(int bits)
+	{
+		return (std::uint64_t{ 1 } << bits) - 1;
+	}
+
+	// Counts the changed fields other than depth, which isn't state
+	std::size_t CountStateChanges(std::uint64_t a, std::uint64_t b)
+	{
+		const auto changed = RenderKey::ChangedFields(a, b) & ~RenderKey::Depth;
+		std::size_t count = 0;
+		for (auto fields = changed; fields != 0; fields &= fields - 1)
+			count++;
+		return count;
+	}
+}
+
+std::uint64_t RenderKey::Pack(std::uint32_t pass, std::uint32_t shader, std::uint32_t texture, std::uint32_t vertexArray, std::uint32_t depth)
+{
+	assert(pass <= FieldMask(PassBits));
+	assert(shader <= FieldMask(ShaderBits));
+	assert(texture <= FieldMask(TextureBits));
+	assert(vertexArray <= FieldMask(VertexArrayBits));
+	assert(depth <= FieldMask(DepthBits));
+
+	return (std::uint64_t{ pass } << PassShift)
+		| (std::uint64_t{ shader } << ShaderShift)
+		| (std::uint64_t{ texture } << TextureShift)
+		| (std::uint64_t{ vertexArray } << VertexArrayShift)
+		| (std::uint64_t{ depth } << DepthShift);
+}
+
+std::uint32_t RenderKey::Get(std::uint64_t key, Field field)
+{
+	switch (field)
+	{
+	case Pass:
+		return static_cast<std::uint32_t>((key >> PassShift) & FieldMask(PassBits));
+	case Shader:
+		return static_cast<std::uint32_t>((key >> ShaderShift) & FieldMask(ShaderBits));
+	case Texture:
+		return static_cast<std::uint32_t>((key >> TextureShift) & FieldMask(TextureBits));
+	case VertexArray:
+		return static_cast<std::uint32_t>((key >> VertexArrayShift) & FieldMask(VertexArrayBits));
+	case Depth:
+		return static_cast<std::uint32_t>((key >> DepthShift) & FieldMask(DepthBits));
+	default:
+		assert(false);
+		return 0;
+	}
+}
+
+std::uint32_t RenderKey::ChangedFields(std::uint64_t a, std::uint64_t b)
+{
+	const auto different = a ^ b;
+	std::uint32_t changed = 0;
+	if ((different >> PassShift) & FieldMask(PassBits))
+		changed |= Pass;
+	if ((different >> ShaderShift) & FieldMask(ShaderBits))
+		changed |= Shader;
+	if ((different >> TextureShift) & FieldMask(TextureBits))
+		changed |= Texture;
+	if ((different >> VertexArrayShift) & FieldMask(VertexArrayBits))
+		changed |= VertexArray;
+	if ((different >> DepthShift) & FieldMask(DepthBits))
+		changed |= Depth;
+	return changed;
+}
+
+std::uint32_t RenderKey::DepthBucket(float viewDepth, float nearPlane, float farPlane)
+{
+	const auto clamped = std::min(std::max(viewDepth, nearPlane), farPlane);
+	const auto fraction = std::log(clamped / nearPlane) / std::log(farPlane / nearPlane);
+	return static_cast<std::uint32_t>(fraction * FieldMask(DepthBits));
+}
+
+void RenderQueue::Clear()
+{
+	entries.clear();
+	submittedStateChanges = 0;
+}
+
+void RenderQueue::Reserve(std::size_t count)
+{
+	entries.reserve(count);
+	scratch.reserve(count);
+}
+
+void RenderQueue::Submit(std::uint64_t key, std::uint32_t payload)
+{
+	if (!entries.empty())
+		submittedStateChanges += CountStateChanges(entries.back().key, key);
+
+	entries.push_back(RenderQueueEntry{ key, payload });
+}
+
+void RenderQueue::Sort()
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+
+	// The histograms of all eight bytes are counted in a single read of the keys
+	std::size_t counts[8][256] = {};
+	for (const auto& entry : entries)
+	{
+		for (int digit = 0; digit < 8; digit++)
+			counts[digit][(entry.key >> (digit * 8)) & 0xff]++;
+	}
+
+	scratch.resize(entries.size());
+	for (int digit = 0; digit < 8; digit++)
+	{
+		// If every key has the same byte here, this pass wouldn't move anything
+		const auto byte = (entries.empty() ? 0 : (entries.front().key >> (digit * 8)) & 0xff);
+		if (counts[digit][byte] == entries.size())
+			continue;
+
+		std::size_t offsets[256];
+		std::size_t offset = 0;
+		for (int value = 0; value < 256; value++)
+		{
+			offsets[value] = offset;
+			offset += counts[digit][value];
+		}
+
+		for (const auto& entry : entries)
+			scratch[offsets[(entry.key >> (digit * 8)) & 0xff]++] = entry;
+
+		entries.swap(scratch);
+	}
+
+	stats = RenderQueueStats{};
+	stats.entries = entries.size();
+	for (std::size_t i = 1; i < entries.size(); i++)
+		stats.stateChanges += CountStateChanges(entries[i - 1].key, entries[i].key);
+	stats.stateChangesAvoided = submittedStateChanges - std::min(submittedStateChanges, stats.stateChanges);
+	stats.sortMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+const std::vector<RenderQueueEntry>& RenderQueue::GetEntries() const
+{
+	return entries;
+}
+
+RenderQueueStats RenderQueue::GetStats() const
+{
+	return stats;
+}
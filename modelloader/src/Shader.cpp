@@ -1,5 +1,14 @@
 ﻿#include <Shader.h>
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iterator>
+
+#include "RenderDevice.hpp"
+
+UniformCounts Shader::uniformCounts{};
+
 Shader::Shader(std::string vertexPath, std::string fragmentPath)
 {
 	// 1. Retrieve the vertex/fragment source code
@@ -38,87 +47,206 @@ Shader::Shader(std::string vertexPath, std::string fragmentPath)
 		std::cout << "Failed to read shader files!" << std::endl;
 	}
 
-	const char* vShaderCode = vertexCode.c_str();
-	const char* fShaderCode = fragmentCode.c_str();
+	// 2. Compile and link them. The program is 0 if either failed, the device has already said why.
+	programId = RenderDevice::Global().CreateProgram(vertexCode, fragmentCode);
+	if (programId == 0)
+		return;
+
+	reflectUniforms();
+	bindUniformBlocks();
+}
+
+Shader::~Shader()
+{
+	RenderDevice::Global().DeleteProgram(programId);
+}
+
+void Shader::activate()
+{
+	RenderDevice::Global().UseProgram(programId);
+}
 
-	// 2. compile shaders
-	unsigned int vertex;
-	unsigned int fragment;
+void Shader::reflectUniforms()
+{
+	uniforms.clear();
 
-	int success = 0;
-	char infoLog[512];
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(programId, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
 
-	// Vertex Shader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, nullptr);
-	glCompileShader(vertex);
+	std::vector<char> nameBuffer(static_cast<std::size_t>(std::max(maxNameLength, 1)));
 
-	// Print compile errors if any
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
-		std::cout << "Failed to compile vertex shader \n" << infoLog << std::endl;
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLsizei nameLength = 0;
+		GLint arraySize = 0;
+		GLenum type = GL_NONE;
+		glGetActiveUniform(programId, static_cast<GLuint>(i), static_cast<GLsizei>(nameBuffer.size()), &nameLength, &arraySize, &type, nameBuffer.data());
+
+		std::string name(nameBuffer.data(), static_cast<std::size_t>(nameLength));
+
+		// Arrays are reported as "name[0]", but set through their plain name
+		const std::size_t arraySuffix = name.find("[0]");
+		if (arraySuffix != std::string::npos && arraySuffix + 3 == name.size())
+			name.erase(arraySuffix);
+
+		Uniform uniform{};
+		uniform.hash = UniformName::Hash(name.c_str());
+		uniform.location = glGetUniformLocation(programId, name.c_str());
+		uniform.type = type;
+		uniform.hasValue = false;
+		uniform.name = std::move(name);
+
+		// Uniforms in uniform blocks have no location, and can't be set through the table
+		if (uniform.location == -1)
+			continue;
+
+		uniforms.push_back(std::move(uniform));
 	}
 
-	// Fragment Shader
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, nullptr);
-	glCompileShader(fragment);
+	std::sort(uniforms.begin(), uniforms.end(), [](const Uniform& a, const Uniform& b) { return a.hash < b.hash; });
 
-	// Print compile errors if any
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-	if (!success)
+	for (std::size_t i = 1; i < uniforms.size(); i++)
 	{
-		glGetShaderInfoLog(fragment, 512, nullptr, infoLog);
-		std::cout << "Failed to compile fragment shader \n" << infoLog << std::endl;
+		if (uniforms[i - 1].hash == uniforms[i].hash)
+		{
+			std::cout << "Uniforms " << uniforms[i - 1].name << " and " << uniforms[i].name << " have the same hash!" << std::endl;
+			assert(false);
+		}
 	}
+}
+
+void Shader::bindUniformBlocks()
+{
+	struct BlockBinding
+	{
+		const char* name;
+		GLuint binding;
+	};
+	const BlockBinding bindings[] = {
+		{ "Camera", UniformBlocks::CameraBinding },
+		{ "VirtualTexture", UniformBlocks::VirtualTextureBinding },
+	};
+
+	GLint blockCount = 0;
+	glGetProgramiv(programId, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+
+	for (GLint i = 0; i < blockCount; i++)
+	{
+		char name[64];
+		glGetActiveUniformBlockName(programId, static_cast<GLuint>(i), sizeof(name), nullptr, name);
+
+		const auto binding = std::find_if(std::begin(bindings), std::end(bindings),
+			[&](const BlockBinding& block) { return std::strcmp(block.name, name) == 0; });
+
+		if (binding == std::end(bindings))
+		{
+			std::cout << "Uniform block " << name << " has no binding point!" << std::endl;
+			assert(false);
+			continue;
+		}
 
-	// Shader Program
-	programId = glCreateProgram();
-	glAttachShader(programId, vertex);
-	glAttachShader(programId, fragment);
-	glLinkProgram(programId);
+		glUniformBlockBinding(programId, static_cast<GLuint>(i), binding->binding);
+	}
+}
+
+UniformHandle Shader::findUniform(UniformName name) const
+{
+	const auto found = std::lower_bound(uniforms.begin(), uniforms.end(), name.GetHash(),
+		[](const Uniform& uniform, std::uint32_t hash) { return uniform.hash < hash; });
+
+	UniformHandle handle;
+	if (found != uniforms.end() && found->hash == name.GetHash())
+		handle.index = static_cast<int>(found - uniforms.begin());
+	return handle;
+}
 
-	// Print linking errors if any
-	glGetProgramiv(programId, GL_LINK_STATUS, &success);
+Shader::Uniform* Shader::changedUniform(UniformHandle handle, const void* value, std::size_t size)
+{
+	if (!handle.IsValid())
+		return nullptr;
 
-	if (!success)
+	Uniform& uniform = uniforms[static_cast<std::size_t>(handle.index)];
+	if (uniform.hasValue && std::memcmp(uniform.value, value, size) == 0)
 	{
-		glGetProgramInfoLog(programId, 512, nullptr, infoLog);
-		std::cout << "Failed to link shader program!" << std::endl;
-		std::cout << infoLog << std::endl;
+		uniformCounts.skipped++;
+		return nullptr;
 	}
 
-	// Delete the shaders as they're linked into our program now and no longer necessary
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+	uniformCounts.uploads++;
+
+	std::memcpy(uniform.value, value, size);
+	uniform.hasValue = true;
+	return &uniform;
 }
 
-void Shader::activate()
+void Shader::setBool(UniformName name, bool value)
+{
+	setBool(findUniform(name), value);
+}
+
+void Shader::setInt(UniformName name, int value)
+{
+	setInt(findUniform(name), value);
+}
+
+void Shader::setFloat(UniformName name, float value)
 {
-	glUseProgram(programId);
+	setFloat(findUniform(name), value);
 }
 
-void Shader::setBool(const std::string& name, bool value) const
+void Shader::setVector(UniformName name, const glm::vec2& value)
 {
-	glUniform1i(glGetUniformLocation(programId, name.c_str()), (int)value);
+	setVector(findUniform(name), value);
 }
 
-void Shader::setInt(const std::string& name, int value) const
+void Shader::setMatrix(UniformName name, const glm::mat4& matrix)
 {
-	glUniform1i(glGetUniformLocation(programId, name.c_str()), value);
+	setMatrix(findUniform(name), matrix);
 }
 
-void Shader::setFloat(const std::string& name, float value) const
+void Shader::setBool(UniformHandle handle, bool value)
 {
-	glUniform1f(glGetUniformLocation(programId, name.c_str()), value);
+	setInt(handle, value ? 1 : 0);
+}
+
+void Shader::setInt(UniformHandle handle, int value)
+{
+	if (const Uniform* uniform = changedUniform(handle, &value, sizeof(value)))
+		glUniform1i(uniform->location, value);
+}
+
+void Shader::setFloat(UniformHandle handle, float value)
+{
+	if (const Uniform* uniform = changedUniform(handle, &value, sizeof(value)))
+	{
+		assert(uniform->type == GL_FLOAT);
+		glUniform1f(uniform->location, value);
+	}
+}
+
+void Shader::setVector(UniformHandle handle, const glm::vec2& value)
+{
+	if (const Uniform* uniform = changedUniform(handle, glm::value_ptr(value), sizeof(value)))
+	{
+		assert(uniform->type == GL_FLOAT_VEC2);
+		glUniform2f(uniform->location, value.x, value.y);
+	}
+}
+
+void Shader::setMatrix(UniformHandle handle, const glm::mat4& matrix)
+{
+	if (const Uniform* uniform = changedUniform(handle, glm::value_ptr(matrix), sizeof(matrix)))
+	{
+		assert(uniform->type == GL_FLOAT_MAT4);
+		glUniformMatrix4fv(uniform->location, 1, GL_FALSE, glm::value_ptr(matrix));
+	}
 }
 
-void Shader::setMatrix(const std::string& name, glm::mat4 value) const
+UniformCounts Shader::TakeUniformCounts()
 {
-	glUniformMatrix4fv(
-		glGetUniformLocation(programId, name.c_str()),
-		1,
-		GL_FALSE,
-		glm::value_ptr(value));
+	const auto counts = uniformCounts;
+	uniformCounts = UniformCounts{};
+	return counts;
 }
\ No newline at end of file
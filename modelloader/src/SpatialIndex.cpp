@@ -0,0 +1,468 @@
+#include "SpatialIndex.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <limits>
+
+const float SpatialIndex::FatFraction = 0.1f;
+const float SpatialIndex::RebuildCostGrowth = 1.5f;
+const float SpatialIndex::RebuildMoveFraction = 0.25f;
+const std::int32_t SpatialIndex::None;
+
+SpatialIndex::SpatialIndex()
+	: root{ None }, freeList{ None }, objectCount{ 0 }, internalArea{ 0.0 }, costAtRebuild{ 0.0f }
+{
+}
+
+float SpatialIndex::Area(const glm::vec3& min, const glm::vec3& max)
+{
+	const auto size = max - min;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+std::int32_t SpatialIndex::AllocateNode()
+{
+	std::int32_t node;
+	if (freeList != None)
+	{
+		node = freeList;
+		freeList = nodes[node].parent;
+	}
+	else
+	{
+		node = static_cast<std::int32_t>(nodes.size());
+		nodes.emplace_back();
+	}
+
+	auto& created = nodes[node];
+	created.min = glm::vec3{ 0.0f };
+	created.max = glm::vec3{ 0.0f };
+	created.parent = None;
+	created.children[0] = None;
+	created.children[1] = None;
+	created.payload = 0;
+	created.moved = false;
+	return node;
+}
+
+// Free nodes are chained through their parent
+void SpatialIndex::FreeNode(std::int32_t node)
+{
+	auto& freed = nodes[node];
+	if (!freed.IsLeaf())
+		internalArea -= Area(freed.min, freed.max);
+
+	freed.children[0] = None;
+	freed.children[1] = None;
+	freed.parent = freeList;
+	freeList = node;
+}
+
+void SpatialIndex::SetBox(std::int32_t node, const glm::vec3& min, const glm::vec3& max)
+{
+	auto& changed = nodes[node];
+	if (!changed.IsLeaf())
+		internalArea += Area(min, max) - Area(changed.min, changed.max);
+
+	changed.min = min;
+	changed.max = max;
+}
+
+std::uint32_t SpatialIndex::Insert(const BoundingVolume& bounds, std::uint32_t payload)
+{
+	const auto leaf = AllocateNode();
+	const auto margin = (bounds.max - bounds.min) * FatFraction;
+	nodes[leaf].payload = payload;
+	SetBox(leaf, bounds.min - margin, bounds.max + margin);
+
+	InsertLeaf(leaf);
+	objectCount++;
+	return static_cast<std::uint32_t>(leaf);
+}
+
+void SpatialIndex::Move(std::uint32_t handle, const BoundingVolume& bounds)
+{
+	const auto leaf = static_cast<std::int32_t>(handle);
+	assert(leaf < static_cast<std::int32_t>(nodes.size()) && nodes[leaf].IsLeaf());
+
+	stats.moves++;
+	auto& node = nodes[leaf];
+	if (glm::all(glm::greaterThanEqual(bounds.min, node.min)) && glm::all(glm::lessThanEqual(bounds.max, node.max)))
+	{
+		stats.movesAbsorbed++;
+		return;
+	}
+
+	// The boxes above are left alone until Update, which decides between refitting them and rebuilding
+	const auto margin = (bounds.max - bounds.min) * FatFraction;
+	SetBox(leaf, bounds.min - margin, bounds.max + margin);
+	if (!node.moved)
+	{
+		node.moved = true;
+		movedLeaves.push_back(leaf);
+	}
+}
+
+void SpatialIndex::Remove(std::uint32_t handle)
+{
+	const auto leaf = static_cast<std::int32_t>(handle);
+	assert(leaf < static_cast<std::int32_t>(nodes.size()) && nodes[leaf].IsLeaf());
+
+	if (nodes[leaf].moved)
+		movedLeaves.erase(std::find(movedLeaves.begin(), movedLeaves.end(), leaf));
+
+	RemoveLeaf(leaf);
+	FreeNode(leaf);
+	objectCount--;
+}
+
+void SpatialIndex::InsertLeaf(std::int32_t leaf)
+{
+	if (root == None)
+	{
+		root = leaf;
+		nodes[leaf].parent = None;
+		return;
+	}
+
+	// Walk down towards the sibling which grows the tree's surface area the least.
+	// Every node on the way has to grow to take in the leaf, which is what inheritedCost is.
+	const auto leafMin = nodes[leaf].min;
+	const auto leafMax = nodes[leaf].max;
+	auto index = root;
+	while (!nodes[index].IsLeaf())
+	{
+		const auto& node = nodes[index];
+		const auto area = Area(node.min, node.max);
+		const auto combinedArea = Area(glm::min(node.min, leafMin), glm::max(node.max, leafMax));
+
+		// Making a new parent for this node and the leaf
+		const auto cost = 2.0f * combinedArea;
+		const auto inheritedCost = 2.0f * (combinedArea - area);
+
+		// Descending into one of the children
+		float childCost[2];
+		for (int i = 0; i < 2; i++)
+		{
+			const auto& child = nodes[node.children[i]];
+			const auto childArea = Area(glm::min(child.min, leafMin), glm::max(child.max, leafMax));
+			childCost[i] = (child.IsLeaf() ? childArea : childArea - Area(child.min, child.max)) + inheritedCost;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1])
+			break;
+
+		index = childCost[0] < childCost[1] ? node.children[0] : node.children[1];
+	}
+
+	const auto sibling = index;
+	const auto oldParent = nodes[sibling].parent;
+	const auto newParent = AllocateNode();
+
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].children[0] = sibling;
+	nodes[newParent].children[1] = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	SetBox(newParent, glm::min(nodes[sibling].min, leafMin), glm::max(nodes[sibling].max, leafMax));
+
+	if (oldParent == None)
+	{
+		root = newParent;
+		return;
+	}
+
+	auto& parent = nodes[oldParent];
+	parent.children[parent.children[0] == sibling ? 0 : 1] = newParent;
+	Refit(oldParent);
+}
+
+void SpatialIndex::RemoveLeaf(std::int32_t leaf)
+{
+	if (leaf == root)
+	{
+		root = None;
+		return;
+	}
+
+	// The parent goes away, and the leaf's sibling takes its place
+	const auto parent = nodes[leaf].parent;
+	const auto grandParent = nodes[parent].parent;
+	const auto sibling = nodes[parent].children[0] == leaf ? nodes[parent].children[1] : nodes[parent].children[0];
+
+	if (grandParent == None)
+	{
+		root = sibling;
+		nodes[sibling].parent = None;
+		FreeNode(parent);
+	}
+	else
+	{
+		auto& grand = nodes[grandParent];
+		grand.children[grand.children[0] == parent ? 0 : 1] = sibling;
+		nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+		Refit(grandParent);
+	}
+
+	nodes[leaf].parent = None;
+}
+
+// Recomputes the boxes from node up to the root. Stops early where a box comes out the same, as nothing above changes then.
+void SpatialIndex::Refit(std::int32_t node)
+{
+	while (node != None)
+	{
+		const auto& first = nodes[nodes[node].children[0]];
+		const auto& second = nodes[nodes[node].children[1]];
+		const auto min = glm::min(first.min, second.min);
+		const auto max = glm::max(first.max, second.max);
+		if (min == nodes[node].min && max == nodes[node].max)
+			return;
+
+		SetBox(node, min, max);
+		node = nodes[node].parent;
+	}
+}
+
+void SpatialIndex::Update()
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+
+	lastFrameStats = stats;
+	stats = SpatialIndexStats{};
+
+	if (static_cast<float>(movedLeaves.size()) > RebuildMoveFraction * objectCount)
+	{
+		Rebuild();
+	}
+	else
+	{
+		stats.refits = movedLeaves.size();
+		for (const auto leaf : movedLeaves)
+		{
+			nodes[leaf].moved = false;
+			Refit(nodes[leaf].parent);
+		}
+		movedLeaves.clear();
+
+		// The tree made by inserting is the baseline until the first rebuild
+		const auto rootArea = root == None ? 0.0f : Area(nodes[root].min, nodes[root].max);
+		const auto cost = rootArea > 0.0f ? static_cast<float>(internalArea / rootArea) : 0.0f;
+		if (costAtRebuild == 0.0f)
+			costAtRebuild = cost;
+		else if (cost > costAtRebuild * RebuildCostGrowth)
+			Rebuild();
+	}
+
+	const auto rootArea = root == None ? 0.0f : Area(nodes[root].min, nodes[root].max);
+	stats.cost = rootArea > 0.0f ? static_cast<float>(internalArea / rootArea) : 0.0f;
+	stats.objects = objectCount;
+	stats.nodes = objectCount == 0 ? 0 : objectCount * 2 - 1;
+	stats.updateMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void SpatialIndex::Rebuild()
+{
+	for (const auto leaf : movedLeaves)
+		nodes[leaf].moved = false;
+	movedLeaves.clear();
+
+	if (root == None)
+		return;
+
+	// The leaves stay, so handles stay valid. Every internal node is thrown away and built again.
+	buildLeaves.clear();
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		const auto node = stack.back();
+		stack.pop_back();
+
+		if (nodes[node].IsLeaf())
+		{
+			buildLeaves.push_back(node);
+			continue;
+		}
+
+		stack.push_back(nodes[node].children[0]);
+		stack.push_back(nodes[node].children[1]);
+		FreeNode(node);
+	}
+
+	root = Build(buildLeaves.data(), buildLeaves.size());
+	nodes[root].parent = None;
+
+	const auto rootArea = Area(nodes[root].min, nodes[root].max);
+	costAtRebuild = rootArea > 0.0f ? static_cast<float>(internalArea / rootArea) : 0.0f;
+	stats.rebuilds++;
+}
+
+// Splits the leaves in half along the axis their centers are spread out the most on
+std::int32_t SpatialIndex::Build(std::int32_t* leaves, std::size_t count)
+{
+	if (count == 1)
+		return leaves[0];
+
+	glm::vec3 centerMin{ std::numeric_limits<float>::max() };
+	glm::vec3 centerMax{ -std::numeric_limits<float>::max() };
+	for (std::size_t i = 0; i < count; i++)
+	{
+		const auto center = nodes[leaves[i]].min + nodes[leaves[i]].max;
+		centerMin = glm::min(centerMin, center);
+		centerMax = glm::max(centerMax, center);
+	}
+
+	const auto spread = centerMax - centerMin;
+	const auto axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+	const auto half = count / 2;
+	std::nth_element(leaves, leaves + half, leaves + count, [this, axis](std::int32_t a, std::int32_t b)
+	{
+		return nodes[a].min[axis] + nodes[a].max[axis] < nodes[b].min[axis] + nodes[b].max[axis];
+	});
+
+	const auto first = Build(leaves, half);
+	const auto second = Build(leaves + half, count - half);
+
+	const auto node = AllocateNode();
+	nodes[node].children[0] = first;
+	nodes[node].children[1] = second;
+	nodes[first].parent = node;
+	nodes[second].parent = node;
+	SetBox(node, glm::min(nodes[first].min, nodes[second].min), glm::max(nodes[first].max, nodes[second].max));
+	return node;
+}
+
+void SpatialIndex::CollectLeaves(std::int32_t node, std::vector<std::uint32_t>& payloads)
+{
+	collectStack.clear();
+	collectStack.push_back(node);
+	while (!collectStack.empty())
+	{
+		const auto& current = nodes[collectStack.back()];
+		collectStack.pop_back();
+
+		if (current.IsLeaf())
+		{
+			payloads.push_back(current.payload);
+			continue;
+		}
+
+		collectStack.push_back(current.children[0]);
+		collectStack.push_back(current.children[1]);
+	}
+}
+
+void SpatialIndex::QueryFrustum(const Frustum& frustum, std::vector<std::uint32_t>& visible)
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+	stats.queries++;
+
+	if (root != None)
+	{
+		stack.clear();
+		stack.push_back(root);
+	}
+
+	while (!stack.empty())
+	{
+		const auto nodeIndex = stack.back();
+		stack.pop_back();
+		const auto& node = nodes[nodeIndex];
+		stats.nodesVisited++;
+
+		// The corner furthest along a plane's normal decides whether the box is outside of it,
+		// The one furthest against it whether the box is completely inside
+		auto outside = false;
+		auto inside = true;
+		for (const auto& plane : frustum.planes)
+		{
+			const auto normal = glm::vec3(plane);
+			const auto positive = glm::vec3(plane.x > 0.0f ? node.max.x : node.min.x, plane.y > 0.0f ? node.max.y : node.min.y, plane.z > 0.0f ? node.max.z : node.min.z);
+			if (glm::dot(normal, positive) + plane.w < 0.0f)
+			{
+				outside = true;
+				break;
+			}
+
+			const auto negative = glm::vec3(plane.x > 0.0f ? node.min.x : node.max.x, plane.y > 0.0f ? node.min.y : node.max.y, plane.z > 0.0f ? node.min.z : node.max.z);
+			if (glm::dot(normal, negative) + plane.w < 0.0f)
+				inside = false;
+		}
+
+		if (outside)
+			continue;
+
+		if (inside)
+			CollectLeaves(nodeIndex, visible);
+		else if (node.IsLeaf())
+			visible.push_back(node.payload);
+		else
+		{
+			stack.push_back(node.children[0]);
+			stack.push_back(node.children[1]);
+		}
+	}
+
+	stats.queryMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void SpatialIndex::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<SpatialRayHit>& hits)
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+	stats.queries++;
+
+	hits.clear();
+	if (root != None)
+	{
+		stack.clear();
+		stack.push_back(root);
+	}
+
+	// Axes the ray runs parallel to divide to infinity, which the slab test handles as it should
+	const auto inverseDirection = 1.0f / direction;
+	while (!stack.empty())
+	{
+		const auto& node = nodes[stack.back()];
+		stack.pop_back();
+		stats.nodesVisited++;
+
+		// Where the ray enters and leaves the slab between the two planes of each axis
+		const auto t0 = (node.min - origin) * inverseDirection;
+		const auto t1 = (node.max - origin) * inverseDirection;
+		const auto entries = glm::min(t0, t1);
+		const auto exits = glm::max(t0, t1);
+		const auto enter = std::max({ entries.x, entries.y, entries.z, 0.0f });
+		const auto leave = std::min({ exits.x, exits.y, exits.z, maxDistance });
+		if (enter > leave)
+			continue;
+
+		if (node.IsLeaf())
+		{
+			hits.push_back(SpatialRayHit{ node.payload, enter });
+			continue;
+		}
+
+		stack.push_back(node.children[0]);
+		stack.push_back(node.children[1]);
+	}
+
+	std::sort(hits.begin(), hits.end(), [](const SpatialRayHit& a, const SpatialRayHit& b) { return a.distance < b.distance; });
+
+	stats.queryMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+std::size_t SpatialIndex::GetCount() const
+{
+	return objectCount;
+}
+
+SpatialIndexStats SpatialIndex::GetStats() const
+{
+	return lastFrameStats;
+}
@@ -0,0 +1,137 @@
+#include "StreamingBuffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "GLState.hpp"
+
+const int StreamingBuffer::FramesInFlight;
+const std::size_t StreamingBuffer::Alignment;
+
+StreamingBuffer& StreamingBuffer::Instances()
+{
+	// Room for a few thousand instance matrices per frame before it has to grow
+	static StreamingBuffer instances{ 256 * 1024 };
+	return instances;
+}
+
+StreamingBuffer::StreamingBuffer(std::size_t segmentBytes)
+	: buffer{ 0 }, segmentBytes{ segmentBytes }, segment{ 0 }, segmentUsed{ 0 }, fences{}
+{
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+	for (auto& fence : fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+	}
+	GLState::Global().DeleteBuffers(1, &buffer);
+}
+
+void StreamingBuffer::BeginFrame()
+{
+	lastFrameStats = stats;
+	lastFrameStats.capacity = segmentBytes * FramesInFlight;
+	stats = StreamingBufferStats{};
+
+	if (buffer == 0)
+		return;
+
+	// Everything drawn with last frame's segment has been submitted by now
+	if (fences[segment])
+		glDeleteSync(fences[segment]);
+	fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	segment = (segment + 1) % FramesInFlight;
+	segmentUsed = 0;
+
+	if (!fences[segment])
+		return;
+
+	// The GPU is usually several segments behind at most, so this rarely has to wait
+	auto result = glClientWaitSync(fences[segment], 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		stats.stalls++;
+		do
+		{
+			result = glClientWaitSync(fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+
+	glDeleteSync(fences[segment]);
+	fences[segment] = nullptr;
+}
+
+std::size_t StreamingBuffer::Write(const void* data, std::size_t bytes)
+{
+	const auto offset = (segmentUsed + Alignment - 1) / Alignment * Alignment;
+	if (buffer == 0 || offset + bytes > segmentBytes)
+		Grow(offset + bytes);
+
+	GLState::Global().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	void* destination = glMapBufferRange(GL_COPY_WRITE_BUFFER, GetFrameOffset() + offset, bytes,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	assert(destination);
+	std::memcpy(destination, data, bytes);
+	glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	GLState::Global().BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	segmentUsed = offset + bytes;
+	stats.bytesWritten += bytes;
+	return offset;
+}
+
+void StreamingBuffer::Grow(std::size_t minimumSegmentBytes)
+{
+	const auto oldSegmentBytes = segmentBytes;
+	segmentBytes = std::max(buffer != 0 ? segmentBytes * 2 : segmentBytes, minimumSegmentBytes);
+
+	GLuint grown = 0;
+	glGenBuffers(1, &grown);
+	GLState::Global().BindBuffer(GL_COPY_WRITE_BUFFER, grown);
+	glBufferData(GL_COPY_WRITE_BUFFER, segmentBytes * FramesInFlight, nullptr, GL_STREAM_DRAW);
+
+	if (buffer != 0)
+	{
+		// Keep what was written this frame. It has offsets relative to the segment, so it goes to the start
+		// Of the same segment in the new buffer. Draws with the old buffer keep reading from it until they are
+		// Done, as OpenGL only deletes a buffer once nothing uses it anymore.
+		if (segmentUsed > 0)
+		{
+			GLState::Global().BindBuffer(GL_COPY_READ_BUFFER, buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, segment * oldSegmentBytes, segment * segmentBytes, segmentUsed);
+			GLState::Global().BindBuffer(GL_COPY_READ_BUFFER, 0);
+		}
+		GLState::Global().DeleteBuffers(1, &buffer);
+
+		// Nothing has used the new buffer yet
+		for (auto& fence : fences)
+		{
+			if (fence)
+				glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	GLState::Global().BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	buffer = grown;
+}
+
+GLuint StreamingBuffer::GetBufferObject() const
+{
+	return buffer;
+}
+
+std::size_t StreamingBuffer::GetFrameOffset() const
+{
+	return segment * segmentBytes;
+}
+
+StreamingBufferStats StreamingBuffer::GetStats() const
+{
+	return lastFrameStats;
+}
@@ -0,0 +1,652 @@
+#include "SupercompressedTexture.hpp"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+namespace
+{
+	// Has to match the importer
+	const int MaxCodeLength = 12;
+	const std::size_t MaxRecentSelectors = 255;
+	// Limits on the header, so a corrupt file is rejected instead of allocating absurd amounts of memory
+	const std::uint32_t MaxDimension = 16384;
+	const std::uint32_t MaxSliceCount = 2048;
+
+	enum StreamMode : unsigned char
+	{
+		RawStream = 0,
+		HuffmanStream = 1
+	};
+
+	// One 4x4 block, as stored
+	struct Block
+	{
+		std::uint16_t color0;
+		std::uint16_t color1;
+		std::uint32_t selectors;
+		unsigned char alpha0;
+		unsigned char alpha1;
+		std::uint64_t alphaSelectors;
+	};
+
+	// Reads the little endian values the image data is made of, and remembers if it ever ran past the end
+	class ByteReader
+	{
+	public:
+		ByteReader(const unsigned char* data, std::size_t size)
+			: position{ data }, end{ data + size }, failed{ false }
+		{
+		}
+
+		const unsigned char* Take(std::size_t count)
+		{
+			if (failed || static_cast<std::size_t>(end - position) < count)
+			{
+				failed = true;
+				return nullptr;
+			}
+
+			const auto taken = position;
+			position += count;
+			return taken;
+		}
+
+		std::uint32_t ReadUint32()
+		{
+			const auto bytes = Take(4);
+			return bytes ? bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<std::uint32_t>(bytes[3]) << 24) : 0;
+		}
+
+		unsigned char ReadByte()
+		{
+			const auto byte = Take(1);
+			return byte ? *byte : 0;
+		}
+
+		bool Failed() const
+		{
+			return failed;
+		}
+	private:
+		const unsigned char* position;
+		const unsigned char* end;
+		bool failed;
+	};
+
+	// Canonical Huffman codes, written least significant bit first (like deflate), so decoding is a single
+	// Table lookup on the next MaxCodeLength bits.
+	bool DecodeHuffman(const unsigned char* codeLengths, const unsigned char* bits, std::size_t byteCount, std::vector<unsigned char>& symbols)
+	{
+		struct TableEntry
+		{
+			unsigned char symbol;
+			unsigned char length;
+		};
+
+		std::array<int, MaxCodeLength + 1> lengthCounts{};
+		std::array<unsigned char, 256> lengths{};
+		for (int symbol = 0; symbol < 256; symbol++)
+		{
+			lengths[symbol] = (codeLengths[symbol / 2] >> ((symbol % 2) * 4)) & 15;
+			if (lengths[symbol] > MaxCodeLength)
+				return false;
+			lengthCounts[lengths[symbol]]++;
+		}
+		lengthCounts[0] = 0;
+
+		// Codes which don't fit in the table would overwrite each other
+		int available = 1;
+		std::array<int, MaxCodeLength + 1> nextCode{};
+		int code = 0;
+		for (int length = 1; length <= MaxCodeLength; length++)
+		{
+			available = available * 2 - lengthCounts[length];
+			if (available < 0)
+				return false;
+
+			code = (code + lengthCounts[length - 1]) << 1;
+			nextCode[length] = code;
+		}
+
+		std::vector<TableEntry> table(std::size_t{ 1 } << MaxCodeLength, TableEntry{ 0, 0 });
+		for (int symbol = 0; symbol < 256; symbol++)
+		{
+			const int length = lengths[symbol];
+			if (length == 0)
+				continue;
+
+			// Reverse the code, since the bits are read least significant first
+			const auto canonical = nextCode[length]++;
+			int reversed = 0;
+			for (int bit = 0; bit < length; bit++)
+				reversed |= ((canonical >> bit) & 1) << (length - 1 - bit);
+
+			for (int entry = reversed; entry < (1 << MaxCodeLength); entry += 1 << length)
+				table[entry] = TableEntry{ static_cast<unsigned char>(symbol), static_cast<unsigned char>(length) };
+		}
+
+		std::uint64_t buffer = 0;
+		int bufferedBits = 0;
+		std::size_t nextByte = 0;
+		std::size_t consumedBits = 0;
+		for (auto& symbol : symbols)
+		{
+			// Past the end of the data we shift in zeros, and check afterwards that we didn't actually use them
+			while (bufferedBits <= 56)
+			{
+				buffer |= static_cast<std::uint64_t>(nextByte < byteCount ? bits[nextByte] : 0) << bufferedBits;
+				nextByte++;
+				bufferedBits += 8;
+			}
+
+			const auto entry = table[buffer & ((1u << MaxCodeLength) - 1)];
+			if (entry.length == 0)
+				return false;
+
+			symbol = entry.symbol;
+			buffer >>= entry.length;
+			bufferedBits -= entry.length;
+			consumedBits += entry.length;
+		}
+
+		return consumedBits <= byteCount * 8;
+	}
+
+	bool ReadStream(ByteReader& reader, std::vector<unsigned char>& symbols)
+	{
+		const auto symbolCount = reader.ReadUint32();
+		const auto mode = reader.ReadByte();
+		if (reader.Failed())
+			return false;
+
+		if (mode == RawStream)
+		{
+			const auto bytes = reader.Take(symbolCount);
+			if (!bytes)
+				return false;
+
+			symbols.assign(bytes, bytes + symbolCount);
+			return true;
+		}
+
+		if (mode != HuffmanStream)
+			return false;
+
+		const auto codeLengths = reader.Take(128);
+		const auto byteCount = reader.ReadUint32();
+		const auto bits = reader.Take(byteCount);
+
+		// Every symbol takes at least one bit
+		if (!codeLengths || !bits || symbolCount / 8 > byteCount)
+			return false;
+
+		symbols.resize(symbolCount);
+		return DecodeHuffman(codeLengths, bits, byteCount, symbols);
+	}
+
+	// Turns the reference stream back into selector patterns. Reusing a pattern moves it to the front of the list.
+	template <typename Selectors>
+	bool ResolveSelectors(const std::vector<unsigned char>& references, const std::vector<unsigned char>& literals, int literalBytes, std::vector<Selectors>& selectors)
+	{
+		std::vector<Selectors> recent{};
+		std::size_t nextLiteral = 0;
+
+		selectors.resize(references.size());
+		for (std::size_t i = 0; i < references.size(); i++)
+		{
+			Selectors pattern = 0;
+
+			if (references[i] == 0)
+			{
+				if (nextLiteral + literalBytes > literals.size())
+					return false;
+
+				for (int byte = 0; byte < literalBytes; byte++)
+					pattern |= static_cast<Selectors>(literals[nextLiteral++]) << (byte * 8);
+
+				recent.insert(recent.begin(), pattern);
+				if (recent.size() > MaxRecentSelectors)
+					recent.pop_back();
+			}
+			else
+			{
+				const std::size_t position = references[i] - 1;
+				if (position >= recent.size())
+					return false;
+
+				pattern = recent[position];
+				recent.erase(recent.begin() + position);
+				recent.insert(recent.begin(), pattern);
+			}
+
+			selectors[i] = pattern;
+		}
+
+		return nextLiteral == literals.size();
+	}
+
+	bool DecodeBlocks(const std::vector<unsigned char>& image, std::size_t blockCount, bool hasAlpha, std::vector<Block>& blocks)
+	{
+		ByteReader reader{ image.data(), image.size() };
+
+		const std::size_t streamCount = reader.ReadByte();
+		if (streamCount != (hasAlpha ? 6u : 3u))
+			return false;
+
+		std::vector<std::vector<unsigned char>> streams(streamCount);
+		for (auto& stream : streams)
+		{
+			if (!ReadStream(reader, stream))
+				return false;
+		}
+
+		const auto& colorEndpoints = streams[0];
+		if (colorEndpoints.size() != blockCount * 6 || streams[1].size() != blockCount)
+			return false;
+
+		std::vector<std::uint32_t> selectors{};
+		if (!ResolveSelectors(streams[1], streams[2], 4, selectors))
+			return false;
+
+		std::vector<std::uint64_t> alphaSelectors{};
+		if (hasAlpha)
+		{
+			if (streams[3].size() != blockCount * 2 || streams[4].size() != blockCount)
+				return false;
+
+			if (!ResolveSelectors(streams[4], streams[5], 6, alphaSelectors))
+				return false;
+		}
+
+		// Endpoint channels are differences to the previous block, wrapping around at the channel's bit depth
+		const int channelMasks[6] = { 31, 63, 31, 31, 63, 31 };
+		int channels[6] = {};
+		int alpha[2] = {};
+
+		blocks.resize(blockCount);
+		for (std::size_t i = 0; i < blockCount; i++)
+		{
+			for (int channel = 0; channel < 6; channel++)
+				channels[channel] = (channels[channel] + colorEndpoints[i * 6 + channel]) & channelMasks[channel];
+
+			auto& block = blocks[i];
+			block.color0 = static_cast<std::uint16_t>((channels[0] << 11) | (channels[1] << 5) | channels[2]);
+			block.color1 = static_cast<std::uint16_t>((channels[3] << 11) | (channels[4] << 5) | channels[5]);
+			block.selectors = selectors[i];
+
+			if (hasAlpha)
+			{
+				alpha[0] = (alpha[0] + streams[3][i * 2]) & 255;
+				alpha[1] = (alpha[1] + streams[3][i * 2 + 1]) & 255;
+				block.alpha0 = static_cast<unsigned char>(alpha[0]);
+				block.alpha1 = static_cast<unsigned char>(alpha[1]);
+				block.alphaSelectors = alphaSelectors[i];
+			}
+			else
+			{
+				block.alpha0 = 255;
+				block.alpha1 = 255;
+				block.alphaSelectors = 0;
+			}
+		}
+
+		return true;
+	}
+
+	// The colors a Bc1 block interpolates between, expanded to 8 bits per channel
+	void ColorPalette(const Block& block, unsigned char palette[4][3])
+	{
+		const auto expand = [](std::uint16_t color, unsigned char rgb[3])
+		{
+			const auto red = (color >> 11) & 31;
+			const auto green = (color >> 5) & 63;
+			const auto blue = color & 31;
+			rgb[0] = static_cast<unsigned char>((red << 3) | (red >> 2));
+			rgb[1] = static_cast<unsigned char>((green << 2) | (green >> 4));
+			rgb[2] = static_cast<unsigned char>((blue << 3) | (blue >> 2));
+		};
+
+		expand(block.color0, palette[0]);
+		expand(block.color1, palette[1]);
+
+		for (int channel = 0; channel < 3; channel++)
+		{
+			const int first = palette[0][channel];
+			const int second = palette[1][channel];
+
+			// The importer always writes four color blocks, but a three color block (color0 <= color1) is still valid Bc1
+			if (block.color0 > block.color1)
+			{
+				palette[2][channel] = static_cast<unsigned char>((2 * first + second) / 3);
+				palette[3][channel] = static_cast<unsigned char>((first + 2 * second) / 3);
+			}
+			else
+			{
+				palette[2][channel] = static_cast<unsigned char>((first + second) / 2);
+				palette[3][channel] = 0;
+			}
+		}
+	}
+
+	// The alpha values a Bc3 (Bc4) alpha block interpolates between
+	void AlphaPalette(const Block& block, unsigned char palette[8])
+	{
+		const int first = block.alpha0;
+		const int second = block.alpha1;
+		palette[0] = block.alpha0;
+		palette[1] = block.alpha1;
+
+		if (first > second)
+		{
+			for (int i = 2; i < 8; i++)
+				palette[i] = static_cast<unsigned char>(((8 - i) * first + (i - 1) * second) / 7);
+		}
+		else
+		{
+			for (int i = 2; i < 6; i++)
+				palette[i] = static_cast<unsigned char>(((6 - i) * first + (i - 1) * second) / 5);
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	void WriteUint16(unsigned char* destination, std::uint16_t value)
+	{
+		destination[0] = static_cast<unsigned char>(value);
+		destination[1] = static_cast<unsigned char>(value >> 8);
+	}
+
+	void WriteBc1(const Block& block, unsigned char* destination)
+	{
+		WriteUint16(destination, block.color0);
+		WriteUint16(destination + 2, block.color1);
+		for (int byte = 0; byte < 4; byte++)
+			destination[4 + byte] = static_cast<unsigned char>(block.selectors >> (byte * 8));
+	}
+
+	void WriteBc3(const Block& block, unsigned char* destination)
+	{
+		destination[0] = block.alpha0;
+		destination[1] = block.alpha1;
+		for (int byte = 0; byte < 6; byte++)
+			destination[2 + byte] = static_cast<unsigned char>(block.alphaSelectors >> (byte * 8));
+
+		WriteBc1(block, destination + 8);
+	}
+
+	// Bc7 mode 5: 7-bit RGB endpoints, 8-bit alpha endpoints, and separate 2-bit indices for color and alpha.
+	// Bc7's 2-bit weights (0, 21, 43, 64 out of 64) are within half a percent of Bc1's thirds,
+	// So the color indices carry over directly. Alpha gets its own endpoints from the block's actual range.
+	void WriteBc7(const Block& block, unsigned char* destination)
+	{
+		unsigned char colors[4][3];
+		unsigned char alphas[8];
+		ColorPalette(block, colors);
+		AlphaPalette(block, alphas);
+
+		// Bc1 orders its colors endpoint, endpoint, 1/3, 2/3. Bc7 orders them by weight.
+		const int colorIndexFromSelector[4] = { 0, 3, 1, 2 };
+		int colorEndpoints[2][3];
+		int colorIndices[16];
+		for (int channel = 0; channel < 3; channel++)
+		{
+			colorEndpoints[0][channel] = colors[0][channel] >> 1;
+			colorEndpoints[1][channel] = colors[1][channel] >> 1;
+		}
+		for (int pixel = 0; pixel < 16; pixel++)
+			colorIndices[pixel] = colorIndexFromSelector[(block.selectors >> (pixel * 2)) & 3];
+
+		int pixelAlphas[16];
+		int lowestAlpha = 255, highestAlpha = 0;
+		for (int pixel = 0; pixel < 16; pixel++)
+		{
+			pixelAlphas[pixel] = alphas[(block.alphaSelectors >> (pixel * 3)) & 7];
+			lowestAlpha = std::min(lowestAlpha, pixelAlphas[pixel]);
+			highestAlpha = std::max(highestAlpha, pixelAlphas[pixel]);
+		}
+
+		const int weights[4] = { 0, 21, 43, 64 };
+		int alphaEndpoints[2] = { lowestAlpha, highestAlpha };
+		int alphaIndices[16];
+		for (int pixel = 0; pixel < 16; pixel++)
+		{
+			int bestIndex = 0, bestError = 256;
+			for (int index = 0; index < 4; index++)
+			{
+				const auto level = ((64 - weights[index]) * lowestAlpha + weights[index] * highestAlpha + 32) >> 6;
+				const auto error = std::abs(level - pixelAlphas[pixel]);
+				if (error < bestError)
+				{
+					bestError = error;
+					bestIndex = index;
+				}
+			}
+			alphaIndices[pixel] = bestIndex;
+		}
+
+		// The first pixel's index is stored with its top bit left out, so it must be 0 or 1.
+		// Swapping the endpoints and mirroring the indices describes the same colors.
+		if (colorIndices[0] & 2)
+		{
+			std::swap(colorEndpoints[0], colorEndpoints[1]);
+			for (auto& index : colorIndices)
+				index = 3 - index;
+		}
+		if (alphaIndices[0] & 2)
+		{
+			std::swap(alphaEndpoints[0], alphaEndpoints[1]);
+			for (auto& index : alphaIndices)
+				index = 3 - index;
+		}
+
+		std::memset(destination, 0, 16);
+		int bitPosition = 0;
+		const auto write = [destination, &bitPosition](int value, int bitCount)
+		{
+			for (int bit = 0; bit < bitCount; bit++, bitPosition++)
+				destination[bitPosition / 8] |= static_cast<unsigned char>(((value >> bit) & 1) << (bitPosition % 8));
+		};
+
+		// Mode 5 is five zero bits followed by a one, then no rotation
+		write(1 << 5, 6);
+		write(0, 2);
+		for (int channel = 0; channel < 3; channel++)
+		{
+			write(colorEndpoints[0][channel], 7);
+			write(colorEndpoints[1][channel], 7);
+		}
+		write(alphaEndpoints[0], 8);
+		write(alphaEndpoints[1], 8);
+		for (int pixel = 0; pixel < 16; pixel++)
+			write(colorIndices[pixel], pixel == 0 ? 1 : 2);
+		for (int pixel = 0; pixel < 16; pixel++)
+			write(alphaIndices[pixel], pixel == 0 ? 1 : 2);
+	}
+
+	void WriteRgba8(const Block& block, unsigned char* pixels, int width, int height, int blockX, int blockY)
+	{
+		unsigned char colors[4][3];
+		unsigned char alphas[8];
+		ColorPalette(block, colors);
+		AlphaPalette(block, alphas);
+
+		for (int y = 0; y < 4 && blockY * 4 + y < height; y++)
+		{
+			for (int x = 0; x < 4 && blockX * 4 + x < width; x++)
+			{
+				const auto pixel = y * 4 + x;
+				const auto color = colors[(block.selectors >> (pixel * 2)) & 3];
+				const auto destination = pixels + (static_cast<std::size_t>(blockY * 4 + y) * width + blockX * 4 + x) * 4;
+				destination[0] = color[0];
+				destination[1] = color[1];
+				destination[2] = color[2];
+				destination[3] = alphas[(block.alphaSelectors >> (pixel * 3)) & 7];
+			}
+		}
+	}
+}
+
+const char* TranscodeTargetName(TranscodeTarget target)
+{
+	switch (target)
+	{
+	case TranscodeTarget::Bc1: return "BC1";
+	case TranscodeTarget::Bc3: return "BC3";
+	case TranscodeTarget::Bc7: return "BC7";
+	default: return "RGBA8";
+	}
+}
+
+std::size_t TranscodedSize(int width, int height, TranscodeTarget target)
+{
+	const auto blockCount = static_cast<std::size_t>((width + 3) / 4) * ((height + 3) / 4);
+
+	switch (target)
+	{
+	case TranscodeTarget::Bc1: return blockCount * 8;
+	case TranscodeTarget::Bc3: return blockCount * 16;
+	case TranscodeTarget::Bc7: return blockCount * 16;
+	default: return static_cast<std::size_t>(width) * height * 4;
+	}
+}
+
+bool SupercompressedFile::Open(const std::string& filepath)
+{
+	path = filepath;
+
+	std::ifstream file{ filepath, std::ios::in | std::ios::binary };
+	if (!file.good())
+		return false;
+
+	char magic[4];
+	std::uint32_t header[6];
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+
+	if (!file.good() || std::memcmp(magic, "BTEX", 4) != 0 || header[0] != 1)
+		return false;
+
+	if (header[1] == 0 || header[1] > MaxDimension || header[2] == 0 || header[2] > MaxDimension || header[4] == 0 || header[4] > MaxSliceCount)
+		return false;
+
+	width = static_cast<int>(header[1]);
+	height = static_cast<int>(header[2]);
+	levelCount = static_cast<int>(header[3]);
+	sliceCount = static_cast<int>(header[4]);
+	hasAlpha = (header[5] & 1) != 0;
+
+	// A texture can't have more levels than it takes to halve it down to a single texel
+	if (levelCount < 1 || levelCount > 32 || (levelCount > 1 && GetLevelWidth(levelCount - 2) == 1 && GetLevelHeight(levelCount - 2) == 1))
+		return false;
+
+	file.seekg(0, std::ios::end);
+	const auto fileSize = static_cast<std::uint64_t>(file.tellg());
+	file.seekg(4 + sizeof(header));
+
+	const auto imageCount = static_cast<std::size_t>(levelCount) * sliceCount;
+	offsets.resize(imageCount);
+	sizes.resize(imageCount);
+	for (std::size_t image = 0; image < imageCount; image++)
+	{
+		file.read(reinterpret_cast<char*>(&offsets[image]), sizeof(std::uint64_t));
+		file.read(reinterpret_cast<char*>(&sizes[image]), sizeof(std::uint64_t));
+
+		if (offsets[image] > fileSize || sizes[image] > fileSize - offsets[image])
+			return false;
+	}
+
+	return file.good();
+}
+
+std::vector<unsigned char> SupercompressedFile::ReadImage(int level, int slice) const
+{
+	if (level < 0 || level >= levelCount || slice < 0 || slice >= sliceCount)
+		return {};
+
+	std::ifstream file{ path, std::ios::in | std::ios::binary };
+
+	const auto image = static_cast<std::size_t>(level) * sliceCount + slice;
+	std::vector<unsigned char> data(static_cast<std::size_t>(sizes[image]));
+	file.seekg(static_cast<std::streamoff>(offsets[image]));
+	file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+	if (!file.good())
+		data.clear();
+
+	return data;
+}
+
+const std::string& SupercompressedFile::GetPath() const
+{
+	return path;
+}
+
+int SupercompressedFile::GetWidth() const
+{
+	return width;
+}
+
+int SupercompressedFile::GetHeight() const
+{
+	return height;
+}
+
+int SupercompressedFile::GetLevelCount() const
+{
+	return levelCount;
+}
+
+int SupercompressedFile::GetSliceCount() const
+{
+	return sliceCount;
+}
+
+bool SupercompressedFile::HasAlpha() const
+{
+	return hasAlpha;
+}
+
+int SupercompressedFile::GetLevelWidth(int level) const
+{
+	return std::max(1, width >> level);
+}
+
+int SupercompressedFile::GetLevelHeight(int level) const
+{
+	return std::max(1, height >> level);
+}
+
+DecodeBuffer TranscodeImage(const std::vector<unsigned char>& image, int width, int height, bool hasAlpha, TranscodeTarget target)
+{
+	const auto blocksWide = (width + 3) / 4;
+	const auto blocksHigh = (height + 3) / 4;
+
+	std::vector<Block> blocks{};
+	if (!DecodeBlocks(image, static_cast<std::size_t>(blocksWide) * blocksHigh, hasAlpha, blocks))
+		return DecodeBuffer{};
+
+	auto transcoded = DecodeBuffer::Allocate(TranscodedSize(width, height, target));
+	const auto destination = transcoded.data();
+
+	for (int blockY = 0; blockY < blocksHigh; blockY++)
+	{
+		for (int blockX = 0; blockX < blocksWide; blockX++)
+		{
+			const auto blockIndex = static_cast<std::size_t>(blockY) * blocksWide + blockX;
+			const auto& block = blocks[blockIndex];
+
+			switch (target)
+			{
+			case TranscodeTarget::Bc1: WriteBc1(block, destination + blockIndex * 8); break;
+			case TranscodeTarget::Bc3: WriteBc3(block, destination + blockIndex * 16); break;
+			case TranscodeTarget::Bc7: WriteBc7(block, destination + blockIndex * 16); break;
+			default: WriteRgba8(block, destination, width, height, blockX, blockY); break;
+			}
+		}
+	}
+
+	return transcoded;
+}
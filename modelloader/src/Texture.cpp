@@ -0,0 +1,287 @@
+#include "Texture.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "UploadScheduler.hpp"
+#include "GLState.hpp"
+#include "MipLevels.hpp"
+
+MipChain MipChain::Build(DecodeBuffer pixels, int width, int height, int nrChannels)
+{
+	MipChain chain{};
+	chain.width = width;
+	chain.height = height;
+	chain.nrChannels = nrChannels;
+	chain.format = TextureFormat::ForChannelCount(nrChannels);
+
+	chain.levels.push_back(std::move(pixels));
+
+	// Made the same way as the levels the importer writes to its files, see MipLevels.hpp
+	const auto levelCount = MipLevelCount(width, height);
+	for (int level = 1; level < levelCount; level++)
+	{
+		auto current = DecodeBuffer::Allocate(static_cast<std::size_t>(LevelWidth(width, level)) * LevelHeight(height, level) * nrChannels);
+		Downsample(chain.levels.back().data(), LevelWidth(width, level - 1), LevelHeight(height, level - 1), nrChannels, current.data());
+		chain.levels.push_back(std::move(current));
+	}
+
+	return chain;
+}
+
+int MipChain::LevelWidth(int width, int level)
+{
+	return MipLevelSize(width, level);
+}
+
+int MipChain::LevelHeight(int height, int level)
+{
+	return MipLevelSize(height, level);
+}
+
+Texture::Texture()
+	: textureObject{ 0 }, width{ 1 }, height{ 1 }, format{ TextureFormat::ForChannelCount(4) }, levelCount{ 1 }, baseLevel{ 0 }, placeholder{ true }, loaded{ false }
+{
+	// First step in loading a texture is to create a Texture Object.
+	// By this point it won't have any dimensionality or type.
+	glGenTextures(1, &textureObject);
+
+	// The dimensionality or type is determined the first time you bind the texture
+	// To a texture target using glBindTexture. Here, we bind it to the GL_TEXTURE_2D,
+	// Making it a 2D texture.
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, textureObject);
+
+	// Texture coordinates are given in the space of 0.0 to 1.0 on each axis.
+	// If the texture coordinates provided to OpenGL's built-in functions are somehow
+	// Outside of this range, they have to be brought back into the range. How this is done
+	// Can be controlled by the parameters GL_TEXTURE_WRAP_S and GL_TEXTURE_WRAP_T.
+	// When the mode is GL_CLAMP_TO_BORDER, an attempt to read outside the 0.0 to 1.0 range
+	// Will result in the constant border color for the texture to be used as a final value.
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+	// GL_TEXTURE_MIN_FILTER controls how texels are constructed when the mipmap
+	// level is greater than zero. There are a total of six setting available for
+	// this parameter.
+	// Choosing GL_NEAREST or GL_LINEAR will disable mipmapping and will cause OpenGL
+	// to only use the base level (level 0).
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// Until the real image has been decoded, the texture is a single white texel.
+	const unsigned char placeholderTexel[] = { 255, 255, 255, 255 };
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholderTexel);
+
+	// Clean Up
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+Texture::~Texture()
+{
+	// Pending uploads would otherwise write into a deleted texture object
+	UploadScheduler::Global().Cancel(this);
+
+	GLState::Global().DeleteTextures(1, &textureObject);
+}
+
+void Texture::Upload(std::shared_ptr<const MipChain> image)
+{
+	// Uploading a whole texture at once can take several milliseconds for large images,
+	// So it is split into chunks the UploadScheduler spreads over several frames.
+	// The coarsest mip levels go first. They are tiny, so the texture very quickly looks roughly right,
+	// And the finer levels sharpen it over the following frames.
+	SetImageSize(image->width, image->height, image->format, static_cast<int>(image->levels.size()));
+
+	std::vector<UploadChunk> chunks{};
+	for (int level = levelCount - 1; level >= 0; level--)
+		AppendLevelChunks(chunks, level, image, image->levels[level].data(), nullptr);
+
+	UploadScheduler::Global().Schedule(this, std::move(chunks), [this]()
+	{
+		loaded = true;
+	});
+}
+
+void Texture::SetImageSize(int width, int height, const TextureFormat& format, int levelCount)
+{
+	this->width = width;
+	this->height = height;
+	this->format = format;
+	this->levelCount = levelCount;
+}
+
+void Texture::UploadLevel(int level, std::shared_ptr<const void> owner, const unsigned char* pixels, std::function<void()> onResident)
+{
+	std::vector<UploadChunk> chunks{};
+	AppendLevelChunks(chunks, level, std::move(owner), pixels, std::move(onResident));
+
+	UploadScheduler::Global().Schedule(this, std::move(chunks), nullptr);
+}
+
+void Texture::EvictLevel(int level)
+{
+	// Only the finest resident level can be evicted, otherwise there would be a hole in the mip chain
+	assert(level == baseLevel && level < levelCount - 1);
+
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, textureObject);
+
+	// Sampling never looks at levels below the base level, so they don't have to be complete.
+	// Respecifying the level with a size of 0x0 releases its storage.
+	baseLevel = level + 1;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, baseLevel);
+	if (format.IsCompressed())
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, format.internalFormat, 0, 0, 0, 0, nullptr);
+	else
+		glTexImage2D(GL_TEXTURE_2D, level, format.internalFormat, 0, 0, 0, format.pixelFormat, GL_UNSIGNED_BYTE, nullptr);
+
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, 0);
+
+	loaded = false;
+}
+
+void Texture::AppendLevelChunks(std::vector<UploadChunk>& chunks, int level, std::shared_ptr<const void> owner, const unsigned char* pixels, std::function<void()> onResident)
+{
+	// Mip levels larger than UploadScheduler::MaxChunkBytes are split further into bands of rows.
+	// Compressed formats can only be split between rows of blocks, which are 4 texels high.
+	const auto levelWidth = MipChain::LevelWidth(width, level);
+	const auto levelHeight = MipChain::LevelHeight(height, level);
+	const auto rowsPerBand = format.IsCompressed() ? 4 : 1;
+	const auto bandBytes = format.LevelBytes(levelWidth, rowsPerBand);
+	const auto rowsPerChunk = std::max<int>(1, static_cast<int>(UploadScheduler::MaxChunkBytes / bandBytes)) * rowsPerBand;
+
+	for (int row = 0; row < levelHeight; row += rowsPerChunk)
+	{
+		const auto rowCount = std::min(rowsPerChunk, levelHeight - row);
+		const auto chunkBytes = format.LevelBytes(levelWidth, rowCount);
+		const auto chunkPixels = pixels + bandBytes * (row / rowsPerBand);
+		const auto isFirstChunkOfLevel = row == 0;
+		const auto isLastChunkOfLevel = row + rowCount >= levelHeight;
+		const auto onLevelResident = isLastChunkOfLevel ? onResident : nullptr;
+
+		chunks.push_back(UploadChunk{ chunkBytes, [this, owner, chunkPixels, chunkBytes, level, levelWidth, row, rowCount, isFirstChunkOfLevel, isLastChunkOfLevel, onLevelResident]()
+		{
+			GLState::Global().BindTexture(0, GL_TEXTURE_2D, textureObject);
+
+			if (isFirstChunkOfLevel)
+				AllocateLevel(level);
+
+			if (format.IsCompressed())
+			{
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, row, levelWidth, rowCount, format.internalFormat, static_cast<GLsizei>(chunkBytes), chunkPixels);
+			}
+			else
+			{
+				// Rows of RGB and single channel images are generally not 4 byte aligned,
+				// Which is what OpenGL expects by default.
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+				glTexSubImage2D(GL_TEXTURE_2D, level, 0, row, levelWidth, rowCount, format.pixelFormat, GL_UNSIGNED_BYTE, chunkPixels);
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			}
+
+			if (isLastChunkOfLevel)
+			{
+				// GL_TEXTURE_BASE_LEVEL and GL_TEXTURE_MAX_LEVEL limit which mip levels are used for sampling.
+				// Levels outside of that range don't have to be complete. Levels are always uploaded from
+				// Coarse to fine, so each time a level is done, we lower the base level to it.
+				baseLevel = level;
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, baseLevel);
+			}
+
+			// Clean Up
+			GLState::Global().BindTexture(0, GL_TEXTURE_2D, 0);
+
+			if (onLevelResident)
+				onLevelResident();
+		} });
+	}
+}
+
+void Texture::AllocateLevel(int level)
+{
+	// The very first level replaces the placeholder, which lives in level 0.
+	if (placeholder)
+	{
+		placeholder = false;
+
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+		// Now that we have mipmaps, we can use trilinear filtering
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+		// Textures with fewer than four channels would otherwise sample as (red, 0, 0, 1) or (red, green, 0, 1).
+		// The swizzle mask tells OpenGL which stored channel to return for each channel the shader sees.
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, format.swizzle);
+	}
+
+	// After having created a texture object and specified its dimensionality,
+	// We need to specify storage and data for the texture.
+	// glTexImage2D is a MUTABLE texture image specification command.
+	// It is, however, best practice to declare texture storage as immutable (meaning
+	// they can't be resized or have their format changed, etc...).
+	// We rely on it being mutable here though, since levels are allocated one at a time as
+	// They arrive, and released again when they are evicted.
+	// glTexImage2D can also (optionally) provide the initial data. We don't, as the level
+	// Is filled in chunk by chunk with glTexSubImage2D.
+	// InternalFormat = Specifies the format with which OpenGL should store the texels
+	// In the texture. We pick it from the channels the image actually needs, see TextureFormat.
+	// The format of the initial texel data is given by the combination of FORMAT and TYPE.
+	// OpenGL will convert the specified data from this format into the internal format
+	// Specified by InternalFormat.
+	// Compressed formats have their own version, which takes the size of the level in bytes.
+	const auto levelWidth = MipChain::LevelWidth(width, level);
+	const auto levelHeight = MipChain::LevelHeight(height, level);
+	if (format.IsCompressed())
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, format.internalFormat, levelWidth, levelHeight, 0, static_cast<GLsizei>(format.LevelBytes(levelWidth, levelHeight)), nullptr);
+	else
+		glTexImage2D(GL_TEXTURE_2D, level, format.internalFormat, levelWidth, levelHeight, 0, format.pixelFormat, GL_UNSIGNED_BYTE, nullptr);
+}
+
+unsigned Texture::GetTextureObject() const
+{
+	return textureObject;
+}
+
+int Texture::GetWidth() const
+{
+	return width;
+}
+
+int Texture::GetHeight() const
+{
+	return height;
+}
+
+bool Texture::IsLoaded() const
+{
+	return loaded;
+}
+
+int Texture::GetLevelCount() const
+{
+	return levelCount;
+}
+
+int Texture::GetBaseLevel() const
+{
+	return baseLevel;
+}
+
+std::size_t Texture::GetLevelBytes(int level) const
+{
+	return format.StoredLevelBytes(MipChain::LevelWidth(width, level), MipChain::LevelHeight(height, level));
+}
+
+std::size_t Texture::GetBytes() const
+{
+	std::size_t bytes = 0;
+	for (int level = 0; level < levelCount; level++)
+		bytes += GetLevelBytes(level);
+
+	return bytes;
+}
+
+const TextureFormat& Texture::GetFormat() const
+{
+	return format;
+}
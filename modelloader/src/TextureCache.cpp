@@ -0,0 +1,341 @@
+#include "TextureCache.hpp"
+
+#include <Windows.h>
+
+#include <cassert>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+#include "PixelChannels.hpp"
+#include "TextureStreamer.hpp"
+#include "UploadScheduler.hpp"
+
+TextureCache& TextureCache::Global()
+{
+	// Function local statics are initialized the first time control passes through
+	// Their declaration, and the initialization is guaranteed to be thread safe.
+	static TextureCache cache{};
+	return cache;
+}
+
+TextureCache::TextureCache()
+	: pendingTextureCount{ 0 }, bytesSaved{ 0 }, decodeBuffersToTrim{ false }, batchDepth{ 0 }, decoders{ ThreadPool::Global() }
+{
+}
+
+TextureCache::~TextureCache()
+{
+	decoders.Wait();
+}
+
+std::shared_ptr<Texture> TextureCache::AcquireFromFile(const std::string& filepath)
+{
+	return Acquire("file:" + CanonicalPath(filepath), ImageSource::FromFile(filepath));
+}
+
+std::shared_ptr<Texture> TextureCache::AcquireFromMemory(std::vector<unsigned char> bytes)
+{
+	// The bytes are moved into the decode job, since the job may well outlive the caller's copy
+	const auto key = ContentHash(bytes);
+	return Acquire(key, ImageSource::FromMemory("embedded texture", std::move(bytes)));
+}
+
+std::shared_ptr<Texture> TextureCache::AcquireStreamed(const std::string& mipFilepath)
+{
+	const auto key = "mips:" + CanonicalPath(mipFilepath);
+
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto texture = FindLiveTexture(key);
+		if (texture)
+			return texture;
+	}
+
+	// Only the header is read here, which is tiny, and without holding up other threads acquiring textures.
+	// The levels themselves are read by the streamer's worker threads.
+	MipFile mipFile{};
+	if (!mipFile.Open(mipFilepath))
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock{ mutex };
+
+	// Another thread may have opened the same file meanwhile
+	auto texture = FindLiveTexture(key);
+	if (texture)
+		return texture;
+
+	texture = std::make_shared<Texture>();
+	textures[key] = texture;
+	TextureStreamer::Global().Register(texture, std::move(mipFile));
+	ReportBytesSaved(mipFilepath, "streamed", *texture);
+
+	return texture;
+}
+
+std::shared_ptr<Texture> TextureCache::AcquireSupercompressed(const std::string& filepath)
+{
+	const auto key = "btex:" + CanonicalPath(filepath);
+
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto texture = FindLiveTexture(key);
+		if (texture)
+			return texture;
+	}
+
+	// As in AcquireStreamed, only the header is read here, outside the lock. The levels are read and transcoded by the
+	// Streamer's worker threads.
+	SupercompressedFile file{};
+	if (!file.Open(filepath))
+		return nullptr;
+
+	// Choosing the target asks OpenGL which formats it supports, so this has to happen here on the OpenGL thread
+	const auto target = ChooseTranscodeTarget(file.HasAlpha());
+
+	std::lock_guard<std::mutex> lock{ mutex };
+
+	// Another thread may have opened the same file meanwhile
+	auto texture = FindLiveTexture(key);
+	if (texture)
+		return texture;
+
+	texture = std::make_shared<Texture>();
+	textures[key] = texture;
+	TextureStreamer::Global().Register(texture, std::move(file), target);
+	ReportBytesSaved(filepath, "streamed", *texture);
+
+	return texture;
+}
+
+void TextureCache::BeginBatch()
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+	batchDepth++;
+}
+
+void TextureCache::EndBatch()
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+	assert(batchDepth > 0);
+
+	if (--batchDepth == 0)
+		SubmitBatch();
+}
+
+void TextureCache::ProcessUploads()
+{
+	// The pooled decode buffers are of no further use once everything has been decoded, and the UploadScheduler is done
+	// With the mip chains it was handed. Its stats are those of the last frame, which ran after every upload handed on
+	// So far, so this has to happen before handing on any new ones.
+	if (decodeBuffersToTrim && pendingTextureCount == 0 && UploadScheduler::Global().GetStats().pendingChunks == 0)
+	{
+		DecodeBufferPool::Global().Trim();
+		decodeBuffersToTrim = false;
+
+		const auto memory = DecodeBufferPool::Global().GetStats();
+		const auto memoryMessage = "Decode buffers: " + std::to_string(memory.liveBytes) + " bytes live, "
+			+ std::to_string(memory.peakLiveBytes) + " bytes peak, " + std::to_string(memory.poolHits) + " of "
+			+ std::to_string(memory.allocations) + " allocations served from the pool\n";
+		OutputDebugStringA(memoryMessage.c_str());
+	}
+
+	DecodedImage decoded;
+	while (decodedImages.TryPop(decoded))
+	{
+		pendingTextureCount--;
+		decodeBuffersToTrim = true;
+
+		// If every mesh using the texture went away while it was being decoded, there is nothing to upload
+		const auto texture = decoded.texture.lock();
+
+		if (!decoded.image)
+		{
+			const auto errorMessage = "Failed to load texture: " + decoded.name + "\n";
+			OutputDebugStringA(errorMessage.c_str());
+			assert(false);
+		}
+		else if (texture)
+		{
+			texture->Upload(decoded.image);
+			ReportBytesSaved(decoded.name, std::to_string(decoded.sourceChannels) + " decoded channel(s)", *texture);
+		}
+
+		decoded = DecodedImage{};
+	}
+}
+
+std::size_t TextureCache::GetLiveTextureCount()
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+
+	return std::count_if(textures.begin(), textures.end(), [](const auto& entry)
+	{
+		return !entry.second.expired();
+	});
+}
+
+std::size_t TextureCache::GetBytesSaved() const
+{
+	return bytesSaved;
+}
+
+std::size_t TextureCache::GetPendingTextureCount() const
+{
+	return pendingTextureCount;
+}
+
+std::shared_ptr<Texture> TextureCache::Acquire(const std::string& key, ImageSource source)
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+
+	auto texture = FindLiveTexture(key);
+	if (texture)
+		return texture;
+
+	// Creating the placeholder talks to OpenGL, so Acquire must be called from the OpenGL thread
+	texture = std::make_shared<Texture>();
+	textures[key] = texture;
+
+	pendingTextureCount++;
+	batch.Add(std::move(source));
+	batchTextures.push_back(texture);
+
+	// Outside of a batch, every texture is a batch of its own
+	if (batchDepth == 0)
+		SubmitBatch();
+
+	return texture;
+}
+
+void TextureCache::SubmitBatch()
+{
+	if (batch.IsEmpty())
+		return;
+
+	const auto targets = std::make_shared<std::vector<std::weak_ptr<Texture>>>(std::move(batchTextures));
+	batchTextures.clear();
+
+	batch.DecodeAsync(decoders, [this, targets](std::size_t index, DecodedImageResult& result)
+	{
+		decodedImages.Push(PrepareUpload((*targets)[index], result));
+	}, [](const ImageBatchStats& stats)
+	{
+		if (stats.imageCount < 2)
+			return;
+
+		// With the workers kept busy, the wall time should be close to the decode time divided by the worker count
+		const auto batchMessage = "Decoded a batch of " + std::to_string(stats.imageCount) + " textures ("
+			+ std::to_string(stats.failedCount) + " failed) in " + std::to_string(stats.wallMilliseconds) + " ms, "
+			+ std::to_string(stats.decodeMilliseconds) + " ms of decoding, longest image "
+			+ std::to_string(stats.longestDecodeMilliseconds) + " ms\n";
+		OutputDebugStringA(batchMessage.c_str());
+	});
+}
+
+TextureCache::DecodedImage TextureCache::PrepareUpload(std::weak_ptr<Texture> texture, DecodedImageResult& result)
+{
+	DecodedImage image{};
+	image.texture = std::move(texture);
+	image.name = result.name;
+
+	if (!result.pixels.data())
+		return image;
+
+	// Opaque textures don't need an alpha channel, and grey ones don't need three color channels.
+	// Dropping the channels the image doesn't use saves both upload time and GPU memory.
+	const auto pixelCount = static_cast<std::size_t>(result.width) * result.height;
+	const auto channelsNeeded = MinimalChannelCount(result.pixels.data(), pixelCount, result.nrChannels);
+
+	// The mip chain adopts the decoded pixels without a copy.
+	// They go back to the pool as soon as the upload scheduler is done with them.
+	auto pixels = std::move(result.pixels);
+
+	if (channelsNeeded != result.nrChannels)
+	{
+		auto converted = DecodeBuffer::Allocate(pixelCount * channelsNeeded);
+		ConvertChannels(pixels.data(), pixelCount, result.nrChannels, channelsNeeded, converted.data());
+		pixels = std::move(converted);
+	}
+
+	image.image = std::make_shared<const MipChain>(MipChain::Build(std::move(pixels), result.width, result.height, channelsNeeded));
+	image.sourceChannels = result.nrChannels;
+	return image;
+}
+
+void TextureCache::ReportBytesSaved(const std::string& name, const std::string& source, const Texture& texture)
+{
+	// How much smaller the texture is than the RGBA8 it used to always be stored as, once all its levels are resident.
+	// Both are counted as the GPU stores them, so RGB8 saves nothing.
+	const auto rgbaFormat = TextureFormat::ForChannelCount(4);
+	std::size_t rgbaBytes = 0;
+	for (int level = 0; level < texture.GetLevelCount(); level++)
+		rgbaBytes += rgbaFormat.StoredLevelBytes(MipChain::LevelWidth(texture.GetWidth(), level), MipChain::LevelHeight(texture.GetHeight(), level));
+
+	const auto savedBytes = rgbaBytes - texture.GetBytes();
+	bytesSaved += savedBytes;
+
+	const auto formatMessage = "Texture " + name + ": " + source + ", stored as " + texture.GetFormat().Name() + ", "
+		+ std::to_string(savedBytes) + " bytes saved\n";
+	OutputDebugStringA(formatMessage.c_str());
+}
+
+TranscodeTarget TextureCache::ChooseTranscodeTarget(bool hasAlpha)
+{
+	// Bc1 is half the size of the others, but has no alpha of its own.
+	// Bc3 is a straight copy of the stored blocks, so it is preferred over Bc7 for textures with alpha.
+	if (!hasAlpha && TextureFormat::Bc1().IsSupported())
+		return TranscodeTarget::Bc1;
+
+	if (hasAlpha && TextureFormat::Bc3().IsSupported())
+		return TranscodeTarget::Bc3;
+
+	if (TextureFormat::Bc7().IsSupported())
+		return TranscodeTarget::Bc7;
+
+	return TranscodeTarget::Rgba8;
+}
+
+std::shared_ptr<Texture> TextureCache::FindLiveTexture(const std::string& key)
+{
+	// Already requested, and at least one mesh is still holding on to it.
+	// This is also the case while the texture is still being decoded, so concurrent
+	// Requests for the same texture all share the one in flight.
+	const auto existing = textures.find(key);
+	if (existing == textures.end())
+		return nullptr;
+
+	return existing->second.lock();
+}
+
+std::string TextureCache::CanonicalPath(const std::string& filepath)
+{
+	// _fullpath resolves relative paths and "." / ".." segments against the current working directory.
+	// Windows paths are case insensitive, and accept both kinds of slashes, so we normalize those as well.
+	char absolutePath[_MAX_PATH];
+	std::string canonical = _fullpath(absolutePath, filepath.c_str(), _MAX_PATH) != nullptr
+		? std::string{ absolutePath }
+		: filepath;
+
+	std::transform(canonical.begin(), canonical.end(), canonical.begin(), [](char character)
+	{
+		return character == '\\' ? '/' : static_cast<char>(std::tolower(static_cast<unsigned char>(character)));
+	});
+
+	return canonical;
+}
+
+std::string TextureCache::ContentHash(const std::vector<unsigned char>& bytes)
+{
+	// 64-bit FNV-1a. It is not cryptographic, but for telling apart a handful of embedded images it's plenty,
+	// And the byte count is part of the key as well.
+	std::uint64_t hash = 14695981039346656037ull;
+	for (const auto byte : bytes)
+	{
+		hash ^= byte;
+		hash *= 1099511628211ull;
+	}
+
+	return "memory:" + std::to_string(bytes.size()) + ":" + std::to_string(hash);
+}
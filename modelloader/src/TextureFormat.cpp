@@ -0,0 +1,94 @@
+#include "TextureFormat.hpp"
+
+#include <string>
+#include <unordered_set>
+
+TextureFormat TextureFormat::ForChannelCount(int nrChannels)
+{
+	// The internal formats are sized, so the driver doesn't have to guess how many bits we want per channel.
+	// The pixel (upload) format must match the layout of the data we hand to glTexSubImage2D.
+	switch (nrChannels)
+	{
+	case 1: return TextureFormat{ 1, GL_R8, GL_RED, { GL_RED, GL_RED, GL_RED, GL_ONE }, 0 };
+	case 2: return TextureFormat{ 2, GL_RG8, GL_RG, { GL_RED, GL_RED, GL_RED, GL_GREEN }, 0 };
+	case 3: return TextureFormat{ 3, GL_RGB8, GL_RGB, { GL_RED, GL_GREEN, GL_BLUE, GL_ONE }, 0 };
+	default: return TextureFormat{ 4, GL_RGBA8, GL_RGBA, { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA }, 0 };
+	}
+}
+
+TextureFormat TextureFormat::Bc1()
+{
+	return TextureFormat{ 3, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_RGB, { GL_RED, GL_GREEN, GL_BLUE, GL_ONE }, 8 };
+}
+
+TextureFormat TextureFormat::Bc3()
+{
+	return TextureFormat{ 4, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_RGBA, { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA }, 16 };
+}
+
+TextureFormat TextureFormat::Bc7()
+{
+	return TextureFormat{ 4, GL_COMPRESSED_RGBA_BPTC_UNORM, GL_RGBA, { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA }, 16 };
+}
+
+bool TextureFormat::IsCompressed() const
+{
+	return blockBytes != 0;
+}
+
+bool TextureFormat::IsSupported() const
+{
+	// The extension list doesn't change while the program runs, so it is only read once
+	static const auto extensions = []()
+	{
+		std::unordered_set<std::string> names{};
+
+		GLint extensionCount = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+		for (GLint i = 0; i < extensionCount; i++)
+			names.insert(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
+
+		return names;
+	}();
+
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return extensions.count("GL_EXT_texture_compression_s3tc") != 0;
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		return extensions.count("GL_ARB_texture_compression_bptc") != 0;
+	default:
+		return true;
+	}
+}
+
+std::size_t TextureFormat::LevelBytes(int width, int height) const
+{
+	if (IsCompressed())
+		return static_cast<std::size_t>((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+
+	return static_cast<std::size_t>(width) * height * nrChannels;
+}
+
+std::size_t TextureFormat::StoredLevelBytes(int width, int height) const
+{
+	if (internalFormat == GL_RGB8)
+		return ForChannelCount(4).LevelBytes(width, height);
+
+	return LevelBytes(width, height);
+}
+
+const char* TextureFormat::Name() const
+{
+	switch (internalFormat)
+	{
+	case GL_R8: return "R8";
+	case GL_RG8: return "RG8";
+	case GL_RGB8: return "RGB8";
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "BC3";
+	case GL_COMPRESSED_RGBA_BPTC_UNORM: return "BC7";
+	default: return "RGBA8";
+	}
+}
@@ -0,0 +1,336 @@
+#include "TextureStreamer.hpp"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+const int TextureStreamer::CoarseLevelSize;
+const std::uint64_t TextureStreamer::IdleFramesBeforeEviction;
+
+namespace
+{
+	TextureFormat TranscodedFormat(TranscodeTarget target)
+	{
+		switch (target)
+		{
+		case TranscodeTarget::Bc1: return TextureFormat::Bc1();
+		case TranscodeTarget::Bc3: return TextureFormat::Bc3();
+		case TranscodeTarget::Bc7: return TextureFormat::Bc7();
+		default: return TextureFormat::ForChannelCount(4);
+		}
+	}
+}
+
+TextureStreamer& TextureStreamer::Global()
+{
+	static TextureStreamer streamer{};
+	return streamer;
+}
+
+TextureStreamer::TextureStreamer()
+	: cameraPosition{ 0.0f }, fieldOfViewY{ glm::radians(45.0f) }, viewportHeight{ 600.0f },
+	budgetBytes{ 256 * 1024 * 1024 }, residentBytes{ 0 }, frame{ 0 }, readers{ ThreadPool::Global() }
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	readers.Wait();
+}
+
+void TextureStreamer::SetMemoryBudget(std::size_t bytes)
+{
+	budgetBytes = bytes;
+}
+
+void TextureStreamer::SetCamera(const glm::vec3& position, float fieldOfViewY, float viewportHeight)
+{
+	cameraPosition = position;
+	this->fieldOfViewY = fieldOfViewY;
+	this->viewportHeight = viewportHeight;
+}
+
+void TextureStreamer::Register(const std::shared_ptr<Texture>& texture, MipFile mipFile)
+{
+	const auto file = std::make_shared<const MipFile>(std::move(mipFile));
+	Register(texture, file->GetPath(), file->GetWidth(), file->GetHeight(), TextureFormat::ForChannelCount(file->GetChannelCount()),
+		file->GetLevelCount(), [file](int level, LoadedLevel& loaded)
+	{
+		const auto pixels = std::make_shared<const std::vector<unsigned char>>(file->ReadLevel(level));
+		if (!pixels->empty())
+		{
+			loaded.pixels = pixels->data();
+			loaded.owner = pixels;
+		}
+	});
+}
+
+void TextureStreamer::Register(const std::shared_ptr<Texture>& texture, SupercompressedFile file, TranscodeTarget target)
+{
+	// Only the first slice is used, as textures are plain 2D textures
+	const auto shared = std::make_shared<const SupercompressedFile>(std::move(file));
+	Register(texture, shared->GetPath(), shared->GetWidth(), shared->GetHeight(), TranscodedFormat(target), shared->GetLevelCount(),
+		[shared, target](int level, LoadedLevel& loaded)
+	{
+		const auto transcoded = std::make_shared<const DecodeBuffer>(TranscodeImage(shared->ReadImage(level, 0), shared->GetLevelWidth(level),
+			shared->GetLevelHeight(level), shared->HasAlpha(), target));
+		if (transcoded->data())
+		{
+			loaded.pixels = transcoded->data();
+			loaded.owner = transcoded;
+		}
+	});
+}
+
+void TextureStreamer::Register(const std::shared_ptr<Texture>& texture, const std::string& path, int width, int height, const TextureFormat& format,
+	int levelCount, LevelReader readLevel)
+{
+	texture->SetImageSize(width, height, format, levelCount);
+
+	// The finest level that is still at most CoarseLevelSize texels across
+	auto coarseLevel = levelCount - 1;
+	while (coarseLevel > 0 && std::max(MipChain::LevelWidth(width, coarseLevel - 1), MipChain::LevelHeight(height, coarseLevel - 1)) <= CoarseLevelSize)
+		coarseLevel--;
+
+	StreamedTexture streamed{};
+	streamed.texture = texture;
+	streamed.readLevel = std::move(readLevel);
+	streamed.path = path;
+	streamed.width = width;
+	streamed.height = height;
+	streamed.levelCount = levelCount;
+	streamed.coarseLevel = coarseLevel;
+	streamed.residentLevel = levelCount;
+	streamed.desiredLevel = levelCount - 1;
+	streamed.loadingLevel = -1;
+	streamed.lastUsedFrame = frame;
+	streamed.residentBytes = 0;
+
+	// A new texture may well end up at the address of one which died since the last update
+	const auto previous = textures.find(texture.get());
+	if (previous != textures.end())
+		residentBytes -= previous->second.residentBytes;
+
+	auto& entry = textures[texture.get()] = streamed;
+	LoadLevels(texture.get(), entry, coarseLevel);
+}
+
+void TextureStreamer::RequestFootprint(const Texture* texture, const glm::vec3& center, float radius)
+{
+	const auto streamed = textures.find(texture);
+	if (streamed == textures.end())
+		return;
+
+	streamed->second.desiredLevel = std::min(streamed->second.desiredLevel, DesiredLevel(streamed->second, center, radius));
+	streamed->second.lastUsedFrame = frame;
+}
+
+void TextureStreamer::Update()
+{
+	StreamingStats stats{};
+
+	// Hand the levels read since last frame to the upload scheduler
+	LoadedLevel loaded;
+	while (loadedLevels.TryPop(loaded))
+	{
+		const auto streamed = textures.find(loaded.key);
+		if (streamed == textures.end())
+			continue;
+
+		// The texture this level was read for might have died, and another taken its place
+		const auto texture = streamed->second.texture.lock();
+		if (!texture || texture != loaded.texture.lock())
+			continue;
+
+		if (!loaded.pixels)
+		{
+			const auto errorMessage = "Failed to read mip level from " + streamed->second.path + "\n";
+			OutputDebugStringA(errorMessage.c_str());
+			assert(false);
+			streamed->second.loadingLevel = -1;
+			continue;
+		}
+
+		const auto key = loaded.key;
+		const auto level = loaded.level;
+		texture->UploadLevel(level, std::move(loaded.owner), loaded.pixels, [this, key, level]()
+		{
+			OnLevelResident(key, level);
+		});
+	}
+
+	// Forget about textures whose last user went away. The texture object is already deleted.
+	for (auto it = textures.begin(); it != textures.end();)
+	{
+		if (!it->second.texture.expired())
+		{
+			++it;
+			continue;
+		}
+
+		residentBytes -= it->second.residentBytes;
+		it = textures.erase(it);
+	}
+
+	for (auto& entry : textures)
+	{
+		auto& streamed = entry.second;
+		const auto texture = streamed.texture.lock();
+
+		// Textures nobody has drawn for a while drop back to their coarse levels, one level per frame
+		const auto isIdle = frame - streamed.lastUsedFrame > IdleFramesBeforeEviction;
+		if (isIdle && streamed.loadingLevel == -1 && streamed.residentLevel < streamed.coarseLevel)
+		{
+			EvictLevel(streamed, *texture);
+			stats.levelsEvictedThisFrame++;
+		}
+
+		// Stream in the next finer level, if the object is large enough on screen to need it.
+		// Only textures drawn since the last update get new levels. If there's no room in the budget,
+		// We make room by evicting levels of textures which weren't drawn since the last update.
+		const auto isVisible = streamed.lastUsedFrame == frame;
+		const auto wantsFinerLevel = streamed.desiredLevel < streamed.residentLevel;
+		if (isVisible && wantsFinerLevel && streamed.loadingLevel == -1 && streamed.residentLevel <= streamed.coarseLevel)
+		{
+			const auto nextLevel = streamed.residentLevel - 1;
+			const auto levelBytes = texture->GetLevelBytes(nextLevel);
+
+			while (residentBytes + levelBytes > budgetBytes && EvictLeastRecentlyUsed(frame))
+				stats.levelsEvictedThisFrame++;
+
+			if (residentBytes + levelBytes <= budgetBytes)
+			{
+				LoadLevels(entry.first, streamed, nextLevel);
+				stats.loadsStartedThisFrame++;
+			}
+		}
+
+		// Requests are collected anew every frame
+		streamed.desiredLevel = texture->GetLevelCount() - 1;
+
+		if (streamed.loadingLevel != -1)
+			stats.pendingLoads++;
+	}
+
+	// Even without anything new to load, we might be over budget because the budget was lowered
+	while (residentBytes > budgetBytes && EvictLeastRecentlyUsed(frame))
+		stats.levelsEvictedThisFrame++;
+
+	stats.streamedTextures = textures.size();
+	stats.residentBytes = residentBytes;
+	stats.budgetBytes = budgetBytes;
+	lastFrameStats = stats;
+
+	frame++;
+}
+
+StreamingStats TextureStreamer::GetStats() const
+{
+	return lastFrameStats;
+}
+
+void TextureStreamer::LoadLevels(const Texture* key, StreamedTexture& streamed, int finestLevel)
+{
+	// Reads every level from the currently resident one (exclusive) down to finestLevel.
+	// They are pushed coarsest first, which is the order they have to be uploaded in.
+	const auto firstLevel = std::min(streamed.residentLevel, streamed.levelCount) - 1;
+	streamed.loadingLevel = finestLevel;
+
+	const auto readLevel = streamed.readLevel;
+	const auto texture = streamed.texture;
+	readers.Submit([this, key, texture, readLevel, firstLevel, finestLevel]()
+	{
+		for (auto level = firstLevel; level >= finestLevel; level--)
+		{
+			LoadedLevel loaded{};
+			loaded.key = key;
+			loaded.texture = texture;
+			loaded.level = level;
+			readLevel(level, loaded);
+			loadedLevels.Push(std::move(loaded));
+		}
+	});
+}
+
+void TextureStreamer::OnLevelResident(const Texture* key, int level)
+{
+	auto& streamed = textures.at(key);
+	const auto texture = streamed.texture.lock();
+
+	const auto levelBytes = texture->GetLevelBytes(level);
+	streamed.residentLevel = level;
+	streamed.residentBytes += levelBytes;
+	residentBytes += levelBytes;
+
+	if (streamed.loadingLevel == level)
+		streamed.loadingLevel = -1;
+}
+
+bool TextureStreamer::EvictLeastRecentlyUsed(std::uint64_t usedBefore)
+{
+	// Out of all textures not used since usedBefore which have levels finer than their coarse levels resident,
+	// Pick the one used the longest time ago. Ties go to the texture with the largest resident level.
+	StreamedTexture* victim = nullptr;
+	std::shared_ptr<Texture> victimTexture{};
+
+	for (auto& entry : textures)
+	{
+		auto& streamed = entry.second;
+		if (streamed.lastUsedFrame >= usedBefore || streamed.loadingLevel != -1 || streamed.residentLevel >= streamed.coarseLevel)
+			continue;
+
+		const auto texture = streamed.texture.lock();
+		if (!texture)
+			continue;
+
+		const auto isOlder = victim == nullptr || streamed.lastUsedFrame < victim->lastUsedFrame;
+		const auto isLarger = victim != nullptr && streamed.lastUsedFrame == victim->lastUsedFrame
+			&& texture->GetLevelBytes(streamed.residentLevel) > victimTexture->GetLevelBytes(victim->residentLevel);
+
+		if (isOlder || isLarger)
+		{
+			victim = &streamed;
+			victimTexture = texture;
+		}
+	}
+
+	if (victim == nullptr)
+		return false;
+
+	EvictLevel(*victim, *victimTexture);
+
+	return true;
+}
+
+void TextureStreamer::EvictLevel(StreamedTexture& streamed, Texture& texture)
+{
+	const auto levelBytes = texture.GetLevelBytes(streamed.residentLevel);
+	streamed.residentBytes -= levelBytes;
+	residentBytes -= levelBytes;
+
+	texture.EvictLevel(streamed.residentLevel);
+	streamed.residentLevel++;
+}
+
+int TextureStreamer::DesiredLevel(const StreamedTexture& streamed, const glm::vec3& center, float radius) const
+{
+	// With a perspective projection, an object of diameter d at distance z covers about
+	// d / (2 * z * tan(fov / 2)) of the viewport height.
+	// If the camera is inside the bounding sphere, the object could cover the whole screen.
+	const auto distance = glm::distance(cameraPosition, center) - radius;
+	if (distance <= 0.0f)
+		return 0;
+
+	const auto projectedPixels = (2.0f * radius) / (2.0f * distance * std::tan(fieldOfViewY * 0.5f)) * viewportHeight;
+	const auto textureSize = static_cast<float>(std::max(streamed.width, streamed.height));
+
+	// Each mip level halves the size, so the level whose size matches the footprint is log2 of the ratio
+	if (projectedPixels <= 0.0f)
+		return streamed.levelCount - 1;
+
+	const auto level = static_cast<int>(std::floor(std::log2(textureSize / projectedPixels)));
+	return std::max(0, std::min(level, streamed.levelCount - 1));
+}
@@ -0,0 +1,146 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace
+{
+	// The state of one call to Run. The helpers it submits can outlive the call, when the calling thread took all the
+	// Jobs before they started, so they share it instead of referring to the caller's stack.
+	struct RunBatch
+	{
+		const std::function<void(std::size_t)>* job;
+		std::size_t jobCount;
+		std::atomic<std::size_t> nextJob;
+		std::mutex mutex;
+		std::condition_variable jobsDone;
+		std::size_t jobsRemaining;
+	};
+
+	// Runs jobs until none are left to take. job is only looked at after taking one, while the caller is still waiting.
+	void RunUntaken(RunBatch& batch)
+	{
+		std::size_t index;
+		while ((index = batch.nextJob++) < batch.jobCount)
+		{
+			(*batch.job)(index);
+
+			std::lock_guard<std::mutex> lock{ batch.mutex };
+			if (--batch.jobsRemaining == 0)
+				batch.jobsDone.notify_one();
+		}
+	}
+}
+
+ThreadPool& ThreadPool::Global()
+{
+	static ThreadPool pool{};
+	return pool;
+}
+
+ThreadPool::ThreadPool(unsigned workerCount)
+	: busyWorkers{ 0 }, stopping{ false }
+{
+	workers.reserve(workerCount);
+	for (unsigned i = 0; i < workerCount; i++)
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		stopping = true;
+	}
+
+	jobAvailable.notify_all();
+
+	// Workers finish the jobs still in the queue before they exit
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		jobs.push(std::move(job));
+	}
+
+	jobAvailable.notify_one();
+}
+
+void ThreadPool::Run(std::size_t jobCount, const std::function<void(std::size_t)>& job)
+{
+	if (jobCount == 0)
+		return;
+
+	const auto batch = std::make_shared<RunBatch>();
+	batch->job = &job;
+	batch->jobCount = jobCount;
+	batch->nextJob = 1;
+	batch->jobsRemaining = jobCount - 1;
+
+	// A helper per worker at most, each taking jobs until there are none left. Waiting only on jobs which have
+	// Started means a job calling Run never waits on one stuck behind it in the queue.
+	const auto helperCount = std::min(jobCount - 1, static_cast<std::size_t>(workers.size()));
+	for (std::size_t helper = 0; helper < helperCount; helper++)
+		Submit([batch]() { RunUntaken(*batch); });
+
+	job(0);
+	RunUntaken(*batch);
+
+	std::unique_lock<std::mutex> lock{ batch->mutex };
+	batch->jobsDone.wait(lock, [&batch]() { return batch->jobsRemaining == 0; });
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock{ mutex };
+	idle.wait(lock, [this]() { return jobs.empty() && busyWorkers == 0; });
+}
+
+unsigned ThreadPool::GetWorkerCount() const
+{
+	return static_cast<unsigned>(workers.size());
+}
+
+unsigned ThreadPool::DefaultWorkerCount()
+{
+	// hardware_concurrency may return 0 if the value is not well defined.
+	// We leave one core for the main (render) thread.
+	const auto coreCount = std::thread::hardware_concurrency();
+	return std::max(1u, coreCount > 1 ? coreCount - 1 : 1u);
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+			if (jobs.empty())
+				return;
+
+			job = std::move(jobs.front());
+			jobs.pop();
+			busyWorkers++;
+		}
+
+		job();
+		// Whatever the job holds on to goes away before Wait can return
+		job = nullptr;
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			busyWorkers--;
+			if (jobs.empty() && busyWorkers == 0)
+				idle.notify_all();
+		}
+	}
+}
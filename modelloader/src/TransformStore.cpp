@@ -0,0 +1,315 @@
+#include "TransformStore.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// SSE2 is part of every x64 processor, and the compiler's default for 32-bit x86 as well
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define TRANSFORM_STORE_SSE
+#include <emmintrin.h>
+#endif
+
+const std::uint32_t TransformStore::None;
+const std::size_t TransformStore::ParallelThreshold;
+
+TransformStore& TransformStore::Global()
+{
+	static TransformStore transformStore{};
+	return transformStore;
+}
+
+TransformStore::TransformStore(ThreadPool& workers)
+	: orderChanged{ false }, workers{ workers }
+{
+}
+
+std::uint32_t TransformStore::Create(std::uint32_t parent)
+{
+	assert(parent == None || (parent < alive.size() && alive[parent]));
+
+	std::uint32_t transform;
+	if (!freeTransforms.empty())
+	{
+		transform = freeTransforms.back();
+		freeTransforms.pop_back();
+	}
+	else
+	{
+		transform = static_cast<std::uint32_t>(alive.size());
+		for (auto array : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &rotationW, &scaleX, &scaleY, &scaleZ })
+			array->push_back(0.0f);
+		parents.push_back(None);
+		depths.push_back(0);
+		dirty.push_back(0);
+		alive.push_back(0);
+		worldMatrices.emplace_back(1.0f);
+	}
+
+	positionX[transform] = positionY[transform] = positionZ[transform] = 0.0f;
+	rotationX[transform] = rotationY[transform] = rotationZ[transform] = 0.0f;
+	rotationW[transform] = 1.0f;
+	scaleX[transform] = scaleY[transform] = scaleZ[transform] = 1.0f;
+	parents[transform] = parent;
+	depths[transform] = parent == None ? 0 : depths[parent] + 1;
+	dirty[transform] = 1;
+	alive[transform] = 1;
+
+	orderChanged = true;
+	return transform;
+}
+
+void TransformStore::Destroy(std::uint32_t transform)
+{
+	assert(transform < alive.size() && alive[transform]);
+
+	alive[transform] = 0;
+	dirty[transform] = 0;
+	freeTransforms.push_back(transform);
+	orderChanged = true;
+}
+
+void TransformStore::SetPosition(std::uint32_t transform, const glm::vec3& position)
+{
+	assert(transform < alive.size() && alive[transform]);
+
+	positionX[transform] = position.x;
+	positionY[transform] = position.y;
+	positionZ[transform] = position.z;
+	dirty[transform] = 1;
+}
+
+void TransformStore::SetRotation(std::uint32_t transform, const glm::quat& rotation)
+{
+	assert(transform < alive.size() && alive[transform]);
+
+	rotationX[transform] = rotation.x;
+	rotationY[transform] = rotation.y;
+	rotationZ[transform] = rotation.z;
+	rotationW[transform] = rotation.w;
+	dirty[transform] = 1;
+}
+
+void TransformStore::SetScale(std::uint32_t transform, const glm::vec3& scale)
+{
+	assert(transform < alive.size() && alive[transform]);
+
+	scaleX[transform] = scale.x;
+	scaleY[transform] = scale.y;
+	scaleZ[transform] = scale.z;
+	dirty[transform] = 1;
+}
+
+glm::vec3 TransformStore::GetPosition(std::uint32_t transform) const
+{
+	return glm::vec3(positionX[transform], positionY[transform], positionZ[transform]);
+}
+
+// Counting sort by depth, which puts every parent before its children
+void TransformStore::SortByDepth()
+{
+	std::uint32_t maxDepth = 0;
+	for (std::size_t transform = 0; transform < alive.size(); transform++)
+	{
+		if (alive[transform])
+			maxDepth = std::max(maxDepth, depths[transform]);
+	}
+
+	levelStarts.assign(maxDepth + 2, 0);
+	for (std::size_t transform = 0; transform < alive.size(); transform++)
+	{
+		if (alive[transform])
+			levelStarts[depths[transform] + 1]++;
+	}
+	for (std::size_t level = 1; level < levelStarts.size(); level++)
+		levelStarts[level] += levelStarts[level - 1];
+
+	order.resize(levelStarts.back());
+	auto next = levelStarts;
+	for (std::size_t transform = 0; transform < alive.size(); transform++)
+	{
+		if (alive[transform])
+			order[next[depths[transform]]++] = static_cast<std::uint32_t>(transform);
+	}
+}
+
+void TransformStore::Update()
+{
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+
+	stats = TransformStoreStats{};
+
+	if (orderChanged)
+	{
+		SortByDepth();
+		orderChanged = false;
+	}
+
+	// A child whose parent changed has to be composed again too. Parents are looked at before their children,
+	// And keep their flag until the end, so it trickles all the way down.
+	updated.clear();
+	updatedLevelStarts.clear();
+	const auto levelCount = levelStarts.empty() ? 0 : levelStarts.size() - 1;
+	for (std::size_t level = 0; level < levelCount; level++)
+	{
+		updatedLevelStarts.push_back(updated.size());
+		for (auto i = levelStarts[level]; i < levelStarts[level + 1]; i++)
+		{
+			const auto transform = order[i];
+			if (level > 0 && dirty[parents[transform]])
+				dirty[transform] = 1;
+			if (dirty[transform])
+				updated.push_back(transform);
+		}
+	}
+	updatedLevelStarts.push_back(updated.size());
+
+	for (std::size_t level = 0; level < levelCount; level++)
+	{
+		const auto first = updated.data() + updatedLevelStarts[level];
+		const auto count = updatedLevelStarts[level + 1] - updatedLevelStarts[level];
+		if (count < ParallelThreshold || workers.GetWorkerCount() == 0)
+		{
+			ComposeRange(first, count);
+			stats.jobs = std::max<std::size_t>(stats.jobs, count > 0 ? 1 : 0);
+			continue;
+		}
+
+		// Pieces are a multiple of 4 long, so only the last one has a partial group of 4
+		const auto jobCount = static_cast<std::size_t>(workers.GetWorkerCount()) + 1;
+		const auto jobSize = ((count + jobCount - 1) / jobCount + 3) / 4 * 4;
+		workers.Run(jobCount, [this, first, count, jobSize](std::size_t job)
+		{
+			const auto begin = std::min(job * jobSize, count);
+			const auto end = std::min(begin + jobSize, count);
+			ComposeRange(first + begin, end - begin);
+		});
+		stats.jobs = std::max(stats.jobs, jobCount);
+	}
+
+	for (const auto transform : updated)
+		dirty[transform] = 0;
+
+	stats.transforms = order.size();
+	stats.updated = updated.size();
+	stats.depth = levelCount;
+	stats.milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+glm::mat4 TransformStore::ComposeLocal(std::uint32_t transform) const
+{
+	const glm::quat rotation{ rotationW[transform], rotationX[transform], rotationY[transform], rotationZ[transform] };
+	return glm::translate(glm::mat4{ 1.0f }, GetPosition(transform))
+		* glm::mat4_cast(rotation)
+		* glm::scale(glm::mat4{ 1.0f }, glm::vec3(scaleX[transform], scaleY[transform], scaleZ[transform]));
+}
+
+void TransformStore::ComposeRange(const std::uint32_t* transforms, std::size_t count)
+{
+	std::size_t i = 0;
+
+#if defined(TRANSFORM_STORE_SSE)
+	const auto zero = _mm_setzero_ps();
+	const auto one = _mm_set1_ps(1.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		const auto t = transforms + i;
+		const auto gather = [t](const std::vector<float>& values) { return _mm_setr_ps(values[t[0]], values[t[1]], values[t[2]], values[t[3]]); };
+
+		// The rotation matrix of a unit quaternion, the same one glm::mat4_cast makes
+		const auto x = gather(rotationX);
+		const auto y = gather(rotationY);
+		const auto z = gather(rotationZ);
+		const auto w = gather(rotationW);
+		const auto x2 = _mm_add_ps(x, x);
+		const auto y2 = _mm_add_ps(y, y);
+		const auto z2 = _mm_add_ps(z, z);
+		const auto xx = _mm_mul_ps(x, x2);
+		const auto yy = _mm_mul_ps(y, y2);
+		const auto zz = _mm_mul_ps(z, z2);
+		const auto xy = _mm_mul_ps(x, y2);
+		const auto xz = _mm_mul_ps(x, z2);
+		const auto yz = _mm_mul_ps(y, z2);
+		const auto wx = _mm_mul_ps(w, x2);
+		const auto wy = _mm_mul_ps(w, y2);
+		const auto wz = _mm_mul_ps(w, z2);
+
+		// Each column is the rotated axis times its scale, and the last one is the position.
+		// columns[c][r] holds row r of column c, for each of the 4 transforms.
+		const auto scaleXs = gather(scaleX);
+		const auto scaleYs = gather(scaleY);
+		const auto scaleZs = gather(scaleZ);
+		__m128 columns[4][4] =
+		{
+			{ _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), scaleXs), _mm_mul_ps(_mm_add_ps(xy, wz), scaleXs), _mm_mul_ps(_mm_sub_ps(xz, wy), scaleXs), zero },
+			{ _mm_mul_ps(_mm_sub_ps(xy, wz), scaleYs), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), scaleYs), _mm_mul_ps(_mm_add_ps(yz, wx), scaleYs), zero },
+			{ _mm_mul_ps(_mm_add_ps(xz, wy), scaleZs), _mm_mul_ps(_mm_sub_ps(yz, wx), scaleZs), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), scaleZs), zero },
+			{ gather(positionX), gather(positionY), gather(positionZ), one }
+		};
+
+		// Transposed, columns[c][lane] is column c of that lane's matrix
+		for (auto& column : columns)
+			_MM_TRANSPOSE4_PS(column[0], column[1], column[2], column[3]);
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			const auto transform = t[lane];
+			auto world = &worldMatrices[transform][0][0];
+			if (parents[transform] == None)
+			{
+				for (int c = 0; c < 4; c++)
+					_mm_storeu_ps(world + c * 4, columns[c][lane]);
+				continue;
+			}
+
+			// Each column of parent * local is the parent's columns weighed by the local column
+			const auto parent = &worldMatrices[parents[transform]][0][0];
+			const __m128 parentColumns[4] = { _mm_loadu_ps(parent), _mm_loadu_ps(parent + 4), _mm_loadu_ps(parent + 8), _mm_loadu_ps(parent + 12) };
+			for (int c = 0; c < 4; c++)
+			{
+				const auto local = columns[c][lane];
+				auto result = _mm_mul_ps(parentColumns[0], _mm_shuffle_ps(local, local, _MM_SHUFFLE(0, 0, 0, 0)));
+				result = _mm_add_ps(result, _mm_mul_ps(parentColumns[1], _mm_shuffle_ps(local, local, _MM_SHUFFLE(1, 1, 1, 1))));
+				result = _mm_add_ps(result, _mm_mul_ps(parentColumns[2], _mm_shuffle_ps(local, local, _MM_SHUFFLE(2, 2, 2, 2))));
+				result = _mm_add_ps(result, _mm_mul_ps(parentColumns[3], _mm_shuffle_ps(local, local, _MM_SHUFFLE(3, 3, 3, 3))));
+				_mm_storeu_ps(world + c * 4, result);
+			}
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		const auto transform = transforms[i];
+		const auto local = ComposeLocal(transform);
+		worldMatrices[transform] = parents[transform] == None ? local : worldMatrices[parents[transform]] * local;
+	}
+}
+
+glm::mat4 TransformStore::GetWorldMatrix(std::uint32_t transform) const
+{
+	assert(transform < alive.size() && alive[transform]);
+
+	auto stale = false;
+	for (auto ancestor = transform; ancestor != None && !stale; ancestor = parents[ancestor])
+		stale = dirty[ancestor] != 0;
+
+	if (!stale)
+		return worldMatrices[transform];
+
+	const auto local = ComposeLocal(transform);
+	return parents[transform] == None ? local : GetWorldMatrix(parents[transform]) * local;
+}
+
+const std::vector<glm::mat4>& TransformStore::GetWorldMatrices() const
+{
+	return worldMatrices;
+}
+
+TransformStoreStats TransformStore::GetStats() const
+{
+	return stats;
+}
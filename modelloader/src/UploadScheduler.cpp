@@ -0,0 +1,194 @@
+#include "UploadScheduler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "GLState.hpp"
+
+const std::size_t UploadScheduler::MaxChunkBytes;
+
+UploadScheduler& UploadScheduler::Global()
+{
+	static UploadScheduler scheduler{};
+	return scheduler;
+}
+
+UploadScheduler::UploadScheduler()
+	: cameraPosition{ 0.0f }, byteBudget{ 8 * 1024 * 1024 }, millisecondBudget{ 2.0 }
+{
+}
+
+void UploadScheduler::SetBudget(std::size_t bytesPerFrame, double millisecondsPerFrame)
+{
+	byteBudget = bytesPerFrame;
+	millisecondBudget = millisecondsPerFrame;
+}
+
+void UploadScheduler::SetCameraPosition(const glm::vec3& position)
+{
+	cameraPosition = position;
+}
+
+void UploadScheduler::Track(const void* resource, const void* user, const glm::vec3& position)
+{
+	userPositions[resource][user] = position;
+}
+
+void UploadScheduler::Untrack(const void* user)
+{
+	for (auto it = userPositions.begin(); it != userPositions.end();)
+	{
+		it->second.erase(user);
+		it = it->second.empty() ? userPositions.erase(it) : std::next(it);
+	}
+}
+
+void UploadScheduler::Schedule(const void* resource, std::vector<UploadChunk> chunks, std::function<void()> onComplete)
+{
+	// Nothing to upload, so there's nothing to wait for either
+	if (chunks.empty())
+	{
+		if (onComplete)
+			onComplete();
+		return;
+	}
+
+	UploadJob job{};
+	job.resource = resource;
+	job.chunks.assign(std::make_move_iterator(chunks.begin()), std::make_move_iterator(chunks.end()));
+	job.onComplete = std::move(onComplete);
+	job.distance = 0.0f;
+
+	jobs.push_back(std::move(job));
+}
+
+void UploadScheduler::ScheduleBufferUpload(const void* resource, GLuint buffer, std::size_t bufferOffset, const void* data, std::size_t size, std::function<void()> onComplete)
+{
+	// The buffer storage has to be allocated already (glBufferData with a null pointer), since each
+	// Chunk only fills in a sub-range of it with glBufferSubData.
+	// We bind to GL_COPY_WRITE_BUFFER, which doesn't affect any state used for drawing.
+	// Binding to GL_ELEMENT_ARRAY_BUFFER for instance would change the currently bound VAO.
+	std::vector<UploadChunk> chunks{};
+
+	const auto bytes = static_cast<const unsigned char*>(data);
+	for (std::size_t offset = 0; offset < size; offset += MaxChunkBytes)
+	{
+		const auto chunkSize = std::min(MaxChunkBytes, size - offset);
+		chunks.push_back(UploadChunk{ chunkSize, [buffer, bufferOffset, bytes, offset, chunkSize]()
+		{
+			GLState::Global().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, bufferOffset + offset, chunkSize, bytes + offset);
+			GLState::Global().BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		} });
+	}
+
+	Schedule(resource, std::move(chunks), std::move(onComplete));
+}
+
+void UploadScheduler::Cancel(const void* resource)
+{
+	jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [resource](const UploadJob& job)
+	{
+		return job.resource == resource;
+	}), jobs.end());
+
+	userPositions.erase(resource);
+}
+
+void UploadScheduler::ProcessFrame()
+{
+	using Clock = std::chrono::steady_clock;
+	const auto frameStart = Clock::now();
+
+	UploadStats stats{};
+	stats.byteBudget = byteBudget;
+	stats.millisecondBudget = millisecondBudget;
+
+	// Closest resources first. A stable sort keeps submission order for equal distances.
+	for (auto& job : jobs)
+		job.distance = DistanceToCamera(job.resource);
+
+	std::stable_sort(jobs.begin(), jobs.end(), [](const UploadJob& a, const UploadJob& b)
+	{
+		return a.distance < b.distance;
+	});
+
+	const auto elapsedMilliseconds = [frameStart]()
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+	};
+
+	while (!jobs.empty())
+	{
+		auto& job = jobs.front();
+		if (job.chunks.empty())
+		{
+			auto onComplete = std::move(job.onComplete);
+			jobs.pop_front();
+
+			if (onComplete)
+				onComplete();
+			continue;
+		}
+
+		auto& chunk = job.chunks.front();
+
+		// We always upload at least one chunk per frame, even if it is larger than the budget on its own.
+		// Otherwise a too small budget would stall uploads forever.
+		const auto isFirstChunk = stats.chunksUploadedThisFrame == 0;
+		const auto exceedsBytes = stats.bytesUploadedThisFrame + chunk.bytes > byteBudget;
+		const auto exceedsTime = elapsedMilliseconds() >= millisecondBudget;
+		if (!isFirstChunk && (exceedsBytes || exceedsTime))
+			break;
+
+		chunk.upload();
+		stats.bytesUploadedThisFrame += chunk.bytes;
+		stats.chunksUploadedThisFrame++;
+		job.chunks.pop_front();
+
+		if (job.chunks.empty())
+		{
+			// The completion callback may schedule new uploads, so take the job out first
+			auto onComplete = std::move(job.onComplete);
+			jobs.pop_front();
+
+			if (onComplete)
+				onComplete();
+		}
+	}
+
+	stats.millisecondsThisFrame = elapsedMilliseconds();
+	stats.pendingUploads = jobs.size();
+	for (const auto& job : jobs)
+	{
+		stats.pendingChunks += job.chunks.size();
+		for (const auto& chunk : job.chunks)
+			stats.pendingBytes += chunk.bytes;
+	}
+
+	const auto byteFraction = byteBudget > 0 ? static_cast<float>(stats.bytesUploadedThisFrame) / byteBudget : 0.0f;
+	const auto timeFraction = millisecondBudget > 0.0 ? static_cast<float>(stats.millisecondsThisFrame / millisecondBudget) : 0.0f;
+	stats.budgetUsed = std::max(byteFraction, timeFraction);
+
+	lastFrameStats = stats;
+}
+
+UploadStats UploadScheduler::GetStats() const
+{
+	return lastFrameStats;
+}
+
+float UploadScheduler::DistanceToCamera(const void* resource) const
+{
+	// A resource nobody has reported a position for yet goes to the back of the queue
+	const auto users = userPositions.find(resource);
+	if (users == userPositions.end())
+		return std::numeric_limits<float>::max();
+
+	auto closest = std::numeric_limits<float>::max();
+	for (const auto& user : users->second)
+		closest = std::min(closest, glm::distance(cameraPosition, user.second));
+
+	return closest;
+}
@@ -0,0 +1,72 @@
+#include "VirtualTexture.hpp"
+
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "GLState.hpp"
+
+VirtualTexture::VirtualTexture(int id, VirtualTextureFile file)
+	: id{ id }, file{ std::make_shared<const VirtualTextureFile>(std::move(file)) }, pageTable{ this->file->GetLayout() }, pageTableObject{ 0 }
+{
+	// The page table has a level for every level of the virtual texture, each half the size of the one before.
+	// Entries are looked up with texelFetch, so filtering never blends two of them together.
+	glGenTextures(1, &pageTableObject);
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, pageTableObject);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pageTable.GetLevelCount() - 1);
+
+	for (int level = 0; level < pageTable.GetLevelCount(); level++)
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, pageTable.GetTableWidth(level), pageTable.GetTableHeight(level), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+VirtualTexture::~VirtualTexture()
+{
+	GLState::Global().DeleteTextures(1, &pageTableObject);
+}
+
+int VirtualTexture::GetId() const
+{
+	return id;
+}
+
+const std::shared_ptr<const VirtualTextureFile>& VirtualTexture::GetFile() const
+{
+	return file;
+}
+
+const VirtualTextureLayout& VirtualTexture::GetLayout() const
+{
+	return file->GetLayout();
+}
+
+PageTable& VirtualTexture::GetPageTable()
+{
+	return pageTable;
+}
+
+unsigned VirtualTexture::GetPageTableObject() const
+{
+	return pageTableObject;
+}
+
+void VirtualTexture::UpdatePageTable(int atlasSlotsPerRow)
+{
+	const auto changedLevel = pageTable.Update();
+	if (changedLevel == -1)
+		return;
+
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, pageTableObject);
+
+	std::vector<unsigned char> texels{};
+	for (auto level = changedLevel; level >= 0; level--)
+	{
+		pageTable.WriteTexels(level, atlasSlotsPerRow, texels);
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, pageTable.GetTableWidth(level), pageTable.GetTableHeight(level), GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+	}
+
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,122 @@
+#include "VirtualTextureFile.hpp"
+
+#include <fstream>
+#include <cstring>
+
+const int VirtualTextureLayout::PageContentSize;
+const int VirtualTextureLayout::PageBorderSize;
+const int VirtualTextureLayout::PageSize;
+const std::size_t VirtualTextureFile::PageBytes;
+const std::size_t VirtualTextureFile::HeaderBytes;
+
+namespace
+{
+	// Page coordinates and levels have to fit in a PageId
+	const int MaxPagesAcross = 4096;
+	const int MaxLevelCount = 16;
+}
+
+int VirtualTextureLayout::LevelWidth(int level) const
+{
+	return paddedWidth >> level;
+}
+
+int VirtualTextureLayout::LevelHeight(int level) const
+{
+	return paddedHeight >> level;
+}
+
+int VirtualTextureLayout::PagesWide(int level) const
+{
+	return (LevelWidth(level) + PageContentSize - 1) / PageContentSize;
+}
+
+int VirtualTextureLayout::PagesHigh(int level) const
+{
+	return (LevelHeight(level) + PageContentSize - 1) / PageContentSize;
+}
+
+std::size_t VirtualTextureLayout::PageIndex(int level, int x, int y) const
+{
+	std::size_t index = 0;
+	for (int finerLevel = 0; finerLevel < level; finerLevel++)
+		index += static_cast<std::size_t>(PagesWide(finerLevel)) * PagesHigh(finerLevel);
+
+	return index + static_cast<std::size_t>(y) * PagesWide(level) + x;
+}
+
+std::size_t VirtualTextureLayout::PageCount() const
+{
+	return PageIndex(levelCount, 0, 0);
+}
+
+bool VirtualTextureFile::Open(const std::string& filepath)
+{
+	path = filepath;
+
+	std::ifstream file{ filepath, std::ios::in | std::ios::binary | std::ios::ate };
+	if (!file.good())
+		return false;
+
+	const auto fileSize = static_cast<std::uint64_t>(file.tellg());
+	file.seekg(0);
+
+	char magic[4];
+	std::uint32_t header[8];
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+
+	if (!file.good() || std::memcmp(magic, "BVTX", 4) != 0 || header[0] != 1)
+		return false;
+
+	// The page size is baked into the shaders and the atlas, so a file cut into different pages can't be used
+	if (header[6] != VirtualTextureLayout::PageContentSize || header[7] != VirtualTextureLayout::PageBorderSize)
+		return false;
+
+	if (header[5] == 0 || header[5] > MaxLevelCount || header[1] == 0 || header[2] == 0
+		|| header[3] < header[1] || header[4] < header[2] || header[3] > MaxPagesAcross * VirtualTextureLayout::PageContentSize
+		|| header[4] > MaxPagesAcross * VirtualTextureLayout::PageContentSize)
+		return false;
+
+	layout.width = static_cast<int>(header[1]);
+	layout.height = static_cast<int>(header[2]);
+	layout.paddedWidth = static_cast<int>(header[3]);
+	layout.paddedHeight = static_cast<int>(header[4]);
+	layout.levelCount = static_cast<int>(header[5]);
+
+	// The padded size has to halve evenly down to the last level, which is the first to fit in a single page
+	const auto lastLevel = layout.levelCount - 1;
+	const auto levelDivisor = 1 << lastLevel;
+	if (layout.paddedWidth % levelDivisor != 0 || layout.paddedHeight % levelDivisor != 0)
+		return false;
+
+	if (layout.PagesWide(lastLevel) != 1 || layout.PagesHigh(lastLevel) != 1
+		|| (lastLevel > 0 && layout.PagesWide(lastLevel - 1) == 1 && layout.PagesHigh(lastLevel - 1) == 1))
+		return false;
+
+	return fileSize >= HeaderBytes + layout.PageCount() * PageBytes;
+}
+
+std::vector<unsigned char> VirtualTextureFile::ReadPage(int level, int x, int y) const
+{
+	std::ifstream file{ path, std::ios::in | std::ios::binary };
+
+	std::vector<unsigned char> texels(PageBytes);
+	file.seekg(static_cast<std::streamoff>(HeaderBytes + layout.PageIndex(level, x, y) * PageBytes));
+	file.read(reinterpret_cast<char*>(texels.data()), static_cast<std::streamsize>(texels.size()));
+
+	if (!file.good())
+		texels.clear();
+
+	return texels;
+}
+
+const std::string& VirtualTextureFile::GetPath() const
+{
+	return path;
+}
+
+const VirtualTextureLayout& VirtualTextureFile::GetLayout() const
+{
+	return layout;
+}
@@ -0,0 +1,398 @@
+#include "VirtualTextureSystem.hpp"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "GLState.hpp"
+#include "RenderDevice.hpp"
+
+const int VirtualTextureSystem::AtlasSlotsPerRow;
+const int VirtualTextureSystem::FeedbackDivisor;
+const int VirtualTextureSystem::MaxPageUploadsPerFrame;
+const std::size_t VirtualTextureSystem::MaxPagesLoading;
+
+VirtualTextureSystem& VirtualTextureSystem::Global()
+{
+	static VirtualTextureSystem system{};
+	return system;
+}
+
+VirtualTextureSystem::VirtualTextureSystem()
+	: textures(PageId::MaxTextureId + 1), cache{ AtlasSlotsPerRow * AtlasSlotsPerRow }, atlasObject{ 0 },
+	uniformBuffer{ 0 }, uniformStride{ 0 }, feedbackFramebuffer{ 0 }, feedbackColor{ 0 }, feedbackDepth{ 0 }, feedbackPixelBuffers{ 0, 0 }, feedbackPixelBufferWritten{ false, false },
+	feedbackWriteIndex{ 0 }, feedbackWidth{ 0 }, feedbackHeight{ 0 }, viewportWidth{ 0 }, viewportHeight{ 0 },
+	frame{ 0 }, readers{ ThreadPool::Global() }
+{
+}
+
+VirtualTextureSystem::~VirtualTextureSystem()
+{
+	readers.Wait();
+}
+
+std::shared_ptr<VirtualTexture> VirtualTextureSystem::Acquire(const std::string& filepath)
+{
+	const auto existing = texturesByPath.find(filepath);
+	if (existing != texturesByPath.end())
+	{
+		auto texture = existing->second.lock();
+		if (texture)
+			return texture;
+	}
+
+	VirtualTextureFile file{};
+	if (!file.Open(filepath))
+		return nullptr;
+
+	// Ids of textures which died are only handed out again once Update has cleaned up after them
+	auto id = 1;
+	while (id <= PageId::MaxTextureId && !textures[id].expired())
+		id++;
+
+	if (id > PageId::MaxTextureId)
+	{
+		const auto errorMessage = "Too many virtual textures, loading " + filepath + " as a regular texture\n";
+		OutputDebugStringA(errorMessage.c_str());
+		return nullptr;
+	}
+
+	RemoveTexture(id);
+
+	if (atlasObject == 0)
+		CreateAtlas();
+	if (uniformBuffer == 0)
+		CreateUniformBuffer();
+
+	const auto texture = std::make_shared<VirtualTexture>(id, std::move(file));
+	textures[id] = texture;
+	texturesByPath[filepath] = texture;
+	WriteUniforms(id, texture.get());
+	requests.AddTexture(id, texture->GetLayout());
+
+	return texture;
+}
+
+void VirtualTextureSystem::PrepareShader(Shader& shader)
+{
+	if (uniformBuffer == 0)
+		CreateUniformBuffer();
+
+	shader.setInt(Uniforms::OurTexture, 0);
+	shader.setInt(Uniforms::PageTable, 1);
+	shader.setFloat(Uniforms::PageContentSize, static_cast<float>(VirtualTextureLayout::PageContentSize));
+	shader.setFloat(Uniforms::PageBorderSize, static_cast<float>(VirtualTextureLayout::PageBorderSize));
+	shader.setFloat(Uniforms::AtlasSize, static_cast<float>(AtlasSlotsPerRow * VirtualTextureLayout::PageSize));
+
+	// The feedback buffer is FeedbackDivisor times smaller, so texture coordinates change that many times faster
+	// From one of its pixels to the next. Without correcting for that, it would ask for pages that are too coarse.
+	shader.setFloat(Uniforms::FeedbackLevelBias, -std::log2(static_cast<float>(FeedbackDivisor)));
+}
+
+void VirtualTextureSystem::Bind(const VirtualTexture* texture, RenderDevice& device) const
+{
+	assert(uniformBuffer != 0);
+
+	const auto id = texture ? texture->GetId() : 0;
+	device.BindUniformBuffer(UniformBlocks::VirtualTextureBinding, uniformBuffer, id * uniformStride, sizeof(VirtualTextureUniforms));
+	if (!texture)
+		return;
+
+	// The atlas takes the place of the regular texture on unit 0, and the page table goes on unit 1
+	device.BindTexture(1, texture->GetPageTableObject());
+	device.BindTexture(0, atlasObject);
+}
+
+bool VirtualTextureSystem::BeginFeedback(int viewportWidth, int viewportHeight)
+{
+	const auto hasVirtualTextures = std::any_of(textures.begin(), textures.end(), [](const std::weak_ptr<VirtualTexture>& texture)
+	{
+		return !texture.expired();
+	});
+
+	if (!hasVirtualTextures)
+		return false;
+
+	const auto width = std::max(1, viewportWidth / FeedbackDivisor);
+	const auto height = std::max(1, viewportHeight / FeedbackDivisor);
+	if (width != feedbackWidth || height != feedbackHeight)
+		CreateFeedbackBuffer(width, height);
+
+	this->viewportWidth = viewportWidth;
+	this->viewportHeight = viewportHeight;
+
+	// Pixels nothing is drawn to stay all zeroes, which reads back as no request at all
+	GLState::Global().BindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+	RenderDevice::Global().SetViewport(0, 0, feedbackWidth, feedbackHeight);
+	RenderDevice::Global().Clear(glm::vec4(0.0f));
+
+	return true;
+}
+
+void VirtualTextureSystem::EndFeedback()
+{
+	// With a pixel pack buffer bound, glReadPixels only starts the copy, and returns without waiting for
+	// The GPU to finish drawing. The pixels are mapped a couple of frames later, by which time they're there.
+	GLState::Global().BindBuffer(GL_PIXEL_PACK_BUFFER, feedbackPixelBuffers[feedbackWriteIndex]);
+	glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	GLState::Global().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	feedbackPixelBufferWritten[feedbackWriteIndex] = true;
+	feedbackWriteIndex = 1 - feedbackWriteIndex;
+
+	GLState::Global().BindFramebuffer(GL_FRAMEBUFFER, 0);
+	RenderDevice::Global().SetViewport(0, 0, viewportWidth, viewportHeight);
+}
+
+void VirtualTextureSystem::Update()
+{
+	VirtualTextureStats stats{};
+
+	frame++;
+	cache.BeginFrame(frame);
+
+	// Forget about virtual textures whose last user went away, and free up their slots in the atlas
+	for (int id = 1; id <= PageId::MaxTextureId; id++)
+	{
+		if (textures[id].expired())
+			RemoveTexture(id);
+	}
+
+	// Copy pages read since last frame into the atlas. Any left over wait for the next frame.
+	LoadedPage loaded{};
+	while (stats.pagesUploadedThisFrame < MaxPageUploadsPerFrame && loadedPages.TryPop(loaded))
+	{
+		requests.Complete(loaded.page);
+
+		// The texture this page was read for might have died, and another taken its id
+		const auto texture = loaded.texture.lock();
+		if (!texture || texture != textures[loaded.page.textureId].lock())
+			continue;
+
+		if (loaded.texels.empty())
+		{
+			const auto errorMessage = "Failed to read virtual texture page from " + texture->GetFile()->GetPath() + "\n";
+			OutputDebugStringA(errorMessage.c_str());
+			assert(false);
+			continue;
+		}
+
+		UploadPage(loaded, *texture, stats);
+	}
+
+	// Decide what to load next from the latest feedback. Without new feedback, we keep working through the last one.
+	std::vector<PageRequest> feedback{};
+	if (ReadFeedback(feedback))
+	{
+		requests.Submit(feedback, cache);
+		stats.requestedPages = feedback.size();
+	}
+
+	PageId page{};
+	while (requests.GetLoadingCount() < MaxPagesLoading && requests.Pop(page))
+	{
+		// The page may have been loaded since the feedback asked for it
+		if (cache.Find(page) != -1)
+		{
+			requests.Complete(page);
+			continue;
+		}
+
+		const auto texture = textures[page.textureId];
+		const auto owner = texture.lock();
+		if (!owner)
+		{
+			requests.Complete(page);
+			continue;
+		}
+
+		const auto file = owner->GetFile();
+		readers.Submit([this, page, texture, file]()
+		{
+			LoadedPage loaded{};
+			loaded.page = page;
+			loaded.texture = texture;
+			loaded.texels = file->ReadPage(page.level, page.x, page.y);
+			loadedPages.Push(std::move(loaded));
+		});
+	}
+
+	for (int id = 1; id <= PageId::MaxTextureId; id++)
+	{
+		const auto texture = textures[id].lock();
+		if (!texture)
+			continue;
+
+		texture->UpdatePageTable(AtlasSlotsPerRow);
+		stats.virtualTextures++;
+	}
+
+	stats.residentPages = cache.GetResidentCount();
+	stats.atlasSlots = cache.GetSlotCount();
+	stats.queuedPages = requests.GetQueuedCount();
+	stats.loadingPages = requests.GetLoadingCount();
+	lastFrameStats = stats;
+}
+
+VirtualTextureStats VirtualTextureSystem::GetStats() const
+{
+	return lastFrameStats;
+}
+
+void VirtualTextureSystem::CreateUniformBuffer()
+{
+	// Each id's parameters start on a multiple of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, as binding ranges requires
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	alignment = std::max(alignment, 1);
+	uniformStride = (sizeof(VirtualTextureUniforms) + alignment - 1) / alignment * alignment;
+
+	// All zeroes, which is what id 0 keeps: no virtual texture
+	const std::vector<unsigned char> zeroes(uniformStride * (PageId::MaxTextureId + 1), 0);
+	uniformBuffer = RenderDevice::Global().CreateBuffer(BufferTarget::Uniform, zeroes.size(), zeroes.data(), BufferUsage::Dynamic);
+}
+
+void VirtualTextureSystem::WriteUniforms(int id, const VirtualTexture* texture)
+{
+	const auto& layout = texture->GetLayout();
+
+	VirtualTextureUniforms uniforms{};
+	uniforms.size = glm::vec2(layout.width, layout.height);
+	uniforms.levelCount = static_cast<float>(layout.levelCount);
+	uniforms.id = id;
+	uniforms.virtualTextured = 1;
+	RenderDevice::Global().UpdateBuffer(uniformBuffer, id * uniformStride, sizeof(uniforms), &uniforms);
+}
+
+void VirtualTextureSystem::CreateAtlas()
+{
+	// The atlas has no mip levels. The page table picks which level's pages to sample,
+	// And the border around each page keeps bilinear filtering from bleeding into the next slot.
+	const auto atlasSize = AtlasSlotsPerRow * VirtualTextureLayout::PageSize;
+
+	glGenTextures(1, &atlasObject);
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, atlasObject);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+void VirtualTextureSystem::CreateFeedbackBuffer(int width, int height)
+{
+	DeleteFeedbackBuffer();
+
+	feedbackWidth = width;
+	feedbackHeight = height;
+
+	// The feedback pass needs its own depth buffer, so only the pages of the surfaces actually visible are requested
+	glGenTextures(1, &feedbackColor);
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, feedbackColor);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &feedbackDepth);
+	GLState::Global().BindRenderbuffer(GL_RENDERBUFFER, feedbackDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	GLState::Global().BindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &feedbackFramebuffer);
+	GLState::Global().BindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedbackColor, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		OutputDebugStringA("Virtual texture feedback framebuffer is incomplete!\n");
+		assert(false);
+	}
+
+	GLState::Global().BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenBuffers(2, feedbackPixelBuffers);
+	for (const auto pixelBuffer : feedbackPixelBuffers)
+	{
+		GLState::Global().BindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(width) * height * 4, nullptr, GL_STREAM_READ);
+	}
+	GLState::Global().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void VirtualTextureSystem::DeleteFeedbackBuffer()
+{
+	// Deleting objects named 0 is silently ignored, so this is fine before anything was created
+	GLState::Global().DeleteFramebuffers(1, &feedbackFramebuffer);
+	GLState::Global().DeleteTextures(1, &feedbackColor);
+	GLState::Global().DeleteRenderbuffers(1, &feedbackDepth);
+	GLState::Global().DeleteBuffers(2, feedbackPixelBuffers);
+
+	feedbackPixelBufferWritten[0] = false;
+	feedbackPixelBufferWritten[1] = false;
+}
+
+bool VirtualTextureSystem::ReadFeedback(std::vector<PageRequest>& feedback)
+{
+	// The buffer about to be written again is the one written longest ago
+	const auto readIndex = feedbackWriteIndex;
+	if (!feedbackPixelBufferWritten[readIndex])
+		return false;
+
+	const auto byteCount = static_cast<std::size_t>(feedbackWidth) * feedbackHeight * 4;
+
+	GLState::Global().BindBuffer(GL_PIXEL_PACK_BUFFER, feedbackPixelBuffers[readIndex]);
+	const auto pixels = static_cast<const unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(byteCount), GL_MAP_READ_BIT));
+	if (pixels)
+	{
+		feedback = PageFeedback::Analyze(pixels, byteCount / 4);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	GLState::Global().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	feedbackPixelBufferWritten[readIndex] = false;
+	return pixels != nullptr;
+}
+
+void VirtualTextureSystem::UploadPage(const LoadedPage& loaded, VirtualTexture& texture, VirtualTextureStats& stats)
+{
+	const auto& page = loaded.page;
+	const auto insertion = cache.Insert(page, requests.IsCoarsestLevel(page));
+
+	// Every slot holds a page that is on screen right now. The page will be asked for again once there's room.
+	if (insertion.slot == -1)
+		return;
+
+	if (insertion.evicted)
+	{
+		const auto& evicted = insertion.evictedPage;
+		const auto owner = textures[evicted.textureId].lock();
+		if (owner)
+			owner->GetPageTable().Unmap(evicted.level, evicted.x, evicted.y);
+
+		stats.pagesEvictedThisFrame++;
+	}
+
+	const auto slotX = insertion.slot % AtlasSlotsPerRow;
+	const auto slotY = insertion.slot / AtlasSlotsPerRow;
+
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, atlasObject);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, slotX * VirtualTextureLayout::PageSize, slotY * VirtualTextureLayout::PageSize,
+		VirtualTextureLayout::PageSize, VirtualTextureLayout::PageSize, GL_RGBA, GL_UNSIGNED_BYTE, loaded.texels.data());
+	GLState::Global().BindTexture(0, GL_TEXTURE_2D, 0);
+
+	texture.GetPageTable().Map(page.level, page.x, page.y, insertion.slot);
+	stats.pagesUploadedThisFrame++;
+}
+
+void VirtualTextureSystem::RemoveTexture(int id)
+{
+	textures[id].reset();
+	cache.RemoveTexture(id);
+	requests.RemoveTexture(id);
+}
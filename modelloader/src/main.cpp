@@ -9,6 +9,13 @@
 #define UNICODE
 #endif
 
+// Route every allocation stb_image makes through our pool of decode buffers.
+// This has to be defined in the same translation unit as the implementation.
+#include "DecodeBufferPool.hpp"
+#define STBI_MALLOC(size) DecodeBufferPool::Global().Allocate(size)
+#define STBI_REALLOC(pointer, newSize) DecodeBufferPool::Global().Reallocate(pointer, newSize)
+#define STBI_FREE(pointer) DecodeBufferPool::Global().Free(pointer)
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -26,6 +33,9 @@
 #include <assimp/postprocess.h> // Post processing flags
 
 #include "Mesh.hpp"
+#include "IndirectRenderer.hpp"
+#include "GLRenderDevice.hpp"
+#include "FramePipeline.hpp"
 
 // Cube Vertex Data
 float verticesCube[] = {
@@ -72,6 +82,17 @@ float verticesCube[] = {
 	-0.5f,  0.5f, -0.5f, 1.0f, 1.0f, 0.5f
 };
 
+// What the update stage of a frame leaves for its record and submit stages. Those run a frame or two later, while the
+// Next frames are being updated, so there's one of these for every frame in flight.
+struct FrameState
+{
+	glm::mat4 view{ 1.0f };
+	glm::mat4 projection{ 1.0f };
+	glm::vec3 cameraPosition{ 0.0f };
+	Frustum frustum{};
+	DrawList drawList{};
+};
+
 // The wWinMain entry point is used with the WINDOWS subsystem.
 // https://docs.microsoft.com/en-us/windows/win32/learnwin32/winmain--the-application-entry-point
 // This is the entry point we have to use when we want to create windowed applications
@@ -91,11 +112,37 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 
 	OutputDebugStringA(openGlVersion.c_str());
 
-	Mesh myAwesomeMesh{ "shaders/export.beagleasset" };
+	// Everything is drawn through the render device. This one talks to the OpenGL context of our window.
+	GLRenderDevice device{};
+	RenderDevice::SetGlobal(&device);
+
+	// Meshes take themselves out of the index and the level of detail selector when they're destroyed,
+	// So both have to be declared before them
+	SpatialIndex sceneIndex{};
+	LodSelector lodSelector{};
+
+	// The meshes are loaded together, so their textures are decoded as one batch
+	const auto scene = Mesh::LoadScene({ "shaders/export.beagleasset", "shaders/cylinder.beagleasset" });
+
+	auto& myAwesomeMesh = *scene[0];
 	myAwesomeMesh.SetPosition(3, 0, 0);
 
-	Mesh myAwesomeMesh2{ "shaders/cylinder.beagleasset" };
+	auto& myAwesomeMesh2 = *scene[1];
 	myAwesomeMesh2.SetPosition(0, 0, 0);
+
+	// The meshes of the scene are kept in a bounding volume hierarchy, and each frame only the ones inside the view frustum are drawn.
+	// SetPosition keeps the hierarchy up to date from here on.
+	for (std::size_t i = 0; i < scene.size(); i++)
+		scene[i]->AddToIndex(sceneIndex, static_cast<std::uint32_t>(i));
+	std::vector<std::uint32_t> visibleMeshes;
+
+	// Of the meshes inside the frustum, the ones hidden behind the occluders aren't drawn either
+	OcclusionCuller occlusionCuller{};
+	std::vector<BoundingVolume> sceneBounds(scene.size());
+
+	// The visible meshes are drawn with the coarsest level of detail that looks the same at their distance
+	for (const auto& mesh : scene)
+		mesh->AddToLodSelector(lodSelector);
 	
 	// The Z-buffer of OpenGL allows OpenGL to decide when to draw over a pixel
 	// and when not to, based on depth testing.
@@ -103,46 +150,150 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 	// GLFW automatically creates such a buffer for you.
 	// However, we have to explicitly enable depth testing.
 	// We do that here.
-	glEnable(GL_DEPTH_TEST);
+	device.SetDepthTest(true);
 
 	// Vertex programming
-	Shader myShader("./shaders/transvertex.glsl", "./shaders/fragment.glsl");
+	// Both the draw list and instanced draws give every draw its transform through a per-instance vertex attribute
+	Shader myShader("./shaders/instancedvertex.glsl", "./shaders/fragment.glsl");
 	myShader.activate();
+	VirtualTextureSystem::Global().PrepareShader(myShader);
+
+	// Used to find out which pages of virtual textures are on screen
+	Shader feedbackShader("./shaders/instancedvertex.glsl", "./shaders/feedback.glsl");
+	feedbackShader.activate();
+	VirtualTextureSystem::Global().PrepareShader(feedbackShader);
+	myShader.activate();
+
+	// A ring of cylinders around the scene, drawn as instances of the second mesh.
+	// The ones behind the camera are culled before their transforms are uploaded.
+	std::vector<glm::mat4> ringTransforms;
+	for (int i = 0; i < 32; i++)
+	{
+		const auto angle = glm::radians(360.0f / 32 * i);
+		ringTransforms.push_back(glm::translate(glm::mat4{ 1.0f }, glm::vec3(sin(angle) * 12.0f, -2.0f, cos(angle) * 12.0f)));
+	}
 	
-	float radius = 7.0f;
-	
-	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	const float radius = 7.0f;
+
+	// The camera circles the scene a little further every frame
+	const auto cameraAt = [radius](std::uint64_t frame)
+	{
+		const auto aliveCounter = frame * 0.011f;
+		return glm::vec3(sin(aliveCounter) * radius, 6.0f, cos(aliveCounter) * radius);
+	};
+
+	const auto frameCount = static_cast<std::uint64_t>(FramePipeline::Latency + 1);
+	FrameState frames[FramePipeline::Latency + 1];
 
-	float aliveCounter = 0.0f;
+	// Runs on a worker. Decides what frame is drawn, and collects it into the frame's draw list.
+	// Only the meshes inside the view frustum, and not behind the occluders, are drawn, each with the coarsest level
+	// Of detail that looks the same at its distance.
+	const auto updateStage = [&](std::uint64_t frame)
+	{
+		auto& state = frames[frame % frameCount];
+		state.cameraPosition = cameraAt(frame);
+		state.view = glm::lookAt(state.cameraPosition, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		state.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 1000000.0f);
+		state.frustum = Frustum::FromMatrix(state.projection * state.view);
+
+		// Meshes may have moved since last frame. Their matrices are composed again, and the index takes in their
+		// Moves before it's queried.
+		TransformStore::Global().Update();
+		sceneIndex.Update();
+		visibleMeshes.clear();
+		sceneIndex.QueryFrustum(state.frustum, visibleMeshes);
+
+		occlusionCuller.BeginFrame(state.projection * state.view);
+		myAwesomeMesh.SubmitOccluder(occlusionCuller);
+		occlusionCuller.Rasterize();
+		for (const auto index : visibleMeshes)
+			sceneBounds[index] = scene[index]->GetWorldBounds();
+		occlusionCuller.Cull(visibleMeshes, sceneBounds);
+
+		lodSelector.SetCamera(state.cameraPosition, glm::radians(45.0f), 600.0f);
+		lodSelector.Clear();
+		for (const auto index : visibleMeshes)
+			scene[index]->RequestLod(sceneBounds[index]);
+		lodSelector.Select();
+
+		state.drawList.Clear();
+		state.drawList.SetView(state.view, 0.1f, 1000000.0f);
+		for (const auto index : visibleMeshes)
+			scene[index]->Submit(state.drawList);
+		state.drawList.Build();
+	};
+
+	// Runs on the workers, each recording the draws of its share of the draw list's batches. No shader is recorded,
+	// So the same lists can be replayed for the feedback pass and for the frame itself.
+	const auto recordStage = [&](std::uint64_t frame, std::size_t job, std::size_t jobCount, RenderDevice& commands)
+	{
+		const auto& drawList = frames[frame % frameCount].drawList;
+		const auto batchCount = drawList.GetBatches().size();
+		const auto firstBatch = batchCount * job / jobCount;
+		const auto lastBatch = batchCount * (job + 1) / jobCount;
+		IndirectRenderer::Global().Record(frame, drawList, commands, firstBatch, lastBatch - firstBatch);
+	};
+
+	// Runs on this thread, the only one which can talk to OpenGL, while the workers update and record later frames
+	const auto submitStage = [&](std::uint64_t frame, const std::function<void()>& replay)
+	{
+		const auto& state = frames[frame % frameCount];
+		FrameUniforms::Global().BeginFrame(state.view, state.projection, state.cameraPosition);
+		IndirectRenderer::Global().Upload(frame, state.drawList);
+
+		// Virtual textures only load the pages which are actually sampled. To find out which those are,
+		// The scene is first drawn at a low resolution, writing the page each pixel needs instead of its color.
+		if (VirtualTextureSystem::Global().BeginFeedback(800, 600))
+		{
+			feedbackShader.activate();
+			replay();
+			myAwesomeMesh2.DrawInstanced();
+
+			VirtualTextureSystem::Global().EndFeedback();
+			myShader.activate();
+		}
+
+		replay();
+		myAwesomeMesh2.DrawInstanced();
+	};
+
+	FramePipeline pipeline{ device, updateStage, recordStage, submitStage };
 	
 	// Game Loop
 	MSG msg = {};
+	std::uint64_t frame = 0;
 	while (true)
 	{	
+		// Draws and state changes are counted per frame, see RenderDevice::GetStats for last frame's
+		device.BeginFrame();
+
 		// Besides clearing the color buffer, we also want to clear the
 		// depth buffer, otherwise depth information from the previous frame stays in the buffer.
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		device.Clear(glm::vec4(1.0f));
 
-		// Our view matrix
-		float camX = sin(aliveCounter) * radius;
-		float camZ = cos(aliveCounter) * radius;
-		
-		glm::mat4 view = glm::mat4(1.0f);
-		view = glm::lookAt(
-			glm::vec3(camX, 6.0f, camZ),
-			glm::vec3(0.0f, 0.0f, 0.0f),
-			glm::vec3(0.0f, 1.0f, 0.0f)
-		);
-
-		// Our projection matrix
-		glm::mat4 projection = glm::mat4(1.0f);
-		projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 1000000.0f);
-		
-		myShader.setMatrix("view", view);
-		myShader.setMatrix("projection", projection);
+		// Textures are decoded on worker threads, but only this thread can talk to OpenGL.
+		// Hand whatever finished decoding since last frame to the upload scheduler, which then
+		// Uploads as much pending data as fits in this frame's budget, closest to the camera first.
+		// The texture streamer decides which mip levels to load and evict, based on how large
+		// Things were on screen last frame.
+		// None of this may happen while the pipeline runs, as its update stage reads what these write.
+		const auto cameraPosition = cameraAt(frame);
+		TextureCache::Global().ProcessUploads();
+		TextureStreamer::Global().SetCamera(cameraPosition, glm::radians(45.0f), 600.0f);
+		TextureStreamer::Global().Update();
+		UploadScheduler::Global().SetCameraPosition(cameraPosition);
+		UploadScheduler::Global().ProcessFrame();
+		VirtualTextureSystem::Global().Update();
+
+		// This run of the pipeline updates this frame, records the one before and submits the one before that.
+		// The buffers the recorded draws read from may have to grow, which has to happen before they're recorded.
+		StreamingBuffer::Instances().BeginFrame();
+		if (frame >= 1)
+			IndirectRenderer::Global().Reserve(frame - 1, frames[(frame - 1) % frameCount].drawList);
+		if (frame >= FramePipeline::Latency)
+			myAwesomeMesh2.SubmitInstances(ringTransforms, frames[(frame - FramePipeline::Latency) % frameCount].frustum);
 
-		myAwesomeMesh.Draw(myShader);
-		myAwesomeMesh2.Draw(myShader);
+		pipeline.RunFrame();
 		
 		// When doing realtime applications, it's important to use PeekMessage to look for
 		// and remove potential messages, instead of GetMessage, as GetMessage is blocking.
@@ -175,7 +326,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 
 		mainWindow.SwapFrontAndBackBuffers();
 
-		aliveCounter += 0.011f;
+		frame++;
 	}
 	
 	return 0;
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdio>
+
+// CHECK is like assert, except it stays on in release builds, and a failed check is reported without
+// Stopping the checks after it. main returns CheckResult(), which is non-zero if any check failed.
+inline int& CheckFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+inline void CheckFailed(const char* condition, const char* file, int line)
+{
+	std::printf("%s(%d): check failed: %s\n", file, line, condition);
+	CheckFailures()++;
+}
+
+inline int CheckResult()
+{
+	if (CheckFailures() == 0)
+	{
+		std::printf("All checks passed\n");
+		return 0;
+	}
+
+	std::printf("%d check(s) failed\n", CheckFailures());
+	return 1;
+}
+
+#define CHECK(condition) ((condition) ? (void)0 : CheckFailed(#condition, __FILE__, __LINE__))
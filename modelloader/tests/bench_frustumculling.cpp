@@ -0,0 +1,64 @@
+// Measures FrustumCuller::Cull on a million objects spread around the camera, for a range of worker counts.
+// Usage: bench_frustumculling [object count] [repeats]
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "FrustumCuller.hpp"
+
+int main(int argc, char** argv)
+{
+	const auto objectCount = argc > 1 ? static_cast<std::size_t>(std::atol(argv[1])) : 1000000;
+	const auto repeats = argc > 2 ? std::atoi(argv[2]) : 20;
+
+	const auto projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+	const auto view = glm::lookAt(glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+	const auto frustum = Frustum::FromMatrix(projection * view);
+
+	std::mt19937 random{ 3 };
+	std::uniform_real_distribution<float> position{ -500.0f, 500.0f };
+	std::vector<BoundingVolume> bounds;
+	bounds.reserve(objectCount);
+	for (std::size_t i = 0; i < objectCount; i++)
+	{
+		auto transform = glm::translate(glm::mat4{ 1.0f }, glm::vec3{ position(random), position(random), position(random) });
+		transform = glm::rotate(transform, position(random), glm::vec3{ 1.0f, 1.0f, 0.0f });
+		bounds.push_back(BoundingVolume::FromBox(glm::vec3{ -1.0f }, glm::vec3{ 1.0f }, transform));
+	}
+
+	std::printf("%zu objects, %u hardware threads\n", objectCount, std::thread::hardware_concurrency());
+
+	const unsigned workerCounts[] = { 0, 1, 3, 7, 15 };
+	for (const auto workerCount : workerCounts)
+	{
+		ThreadPool workers{ workerCount };
+		FrustumCuller culler{ workers };
+		culler.Reserve(objectCount);
+		for (std::size_t i = 0; i < objectCount; i++)
+			culler.Add(bounds[i], static_cast<std::uint32_t>(i));
+
+		std::vector<std::uint32_t> visible;
+		culler.Cull(frustum, visible);
+
+		auto best = 1e9;
+		auto total = 0.0;
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			culler.Cull(frustum, visible);
+			const auto milliseconds = culler.GetStats().milliseconds;
+			best = std::min(best, milliseconds);
+			total += milliseconds;
+		}
+
+		const auto stats = culler.GetStats();
+		std::printf("%2u workers, %2zu jobs, %d lanes: %zu visible, %.3f ms average, %.3f ms best, %.1f ns per object\n", workerCount,
+			stats.jobs, stats.lanes, stats.visible, total / repeats, best, best * 1e6 / objectCount);
+	}
+
+	return 0;
+}
@@ -0,0 +1,89 @@
+// Measures the OcclusionCuller on a wall and a few thousand small occluder triangles in front of a crowd of objects:
+// How many of them it hides, and how long rasterizing the occluders and testing the objects take.
+// Usage: bench_occlusion [object count] [frames]
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "OcclusionCuller.hpp"
+
+int main(int argc, char** argv)
+{
+	const auto objectCount = argc > 1 ? static_cast<std::size_t>(std::atol(argv[1])) : 200000;
+	const auto frameCount = argc > 2 ? std::atoi(argv[2]) : 20;
+
+	const auto projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 1000.0f);
+	const auto view = glm::lookAt(glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+	const auto viewProjection = projection * view;
+
+	const std::vector<float> wall{ -6.0f, -6.0f, -10.0f, 6.0f, -6.0f, -10.0f, 6.0f, 6.0f, -10.0f, -6.0f, 6.0f, -10.0f };
+	const std::vector<unsigned> wallIndices{ 0, 1, 2, 0, 2, 3 };
+
+	std::mt19937 random{ 5 };
+	std::uniform_real_distribution<float> spread{ -20.0f, 20.0f };
+	std::uniform_real_distribution<float> depth{ -60.0f, -5.0f };
+	std::uniform_real_distribution<float> size{ 0.2f, 3.0f };
+
+	// Small triangles scattered through the scene, like the foliage and clutter of a real one
+	std::vector<float> clutter;
+	std::vector<unsigned> clutterIndices;
+	for (int triangle = 0; triangle < 2000; triangle++)
+	{
+		const glm::vec3 center{ spread(random), spread(random) * 0.5f, depth(random) };
+		for (int corner = 0; corner < 3; corner++)
+		{
+			clutter.push_back(center.x + spread(random) * 0.2f);
+			clutter.push_back(center.y + spread(random) * 0.2f);
+			clutter.push_back(center.z + spread(random) * 0.05f);
+			clutterIndices.push_back(static_cast<unsigned>(clutterIndices.size()));
+		}
+	}
+
+	std::vector<BoundingVolume> bounds;
+	for (std::size_t i = 0; i < objectCount; i++)
+	{
+		const glm::vec3 center{ spread(random), spread(random) * 0.5f, depth(random) - 10.0f };
+		bounds.push_back(BoundingVolume::FromBox(glm::vec3{ -size(random) }, glm::vec3{ size(random) }, glm::translate(glm::mat4{ 1.0f }, center)));
+	}
+
+	std::printf("%zu objects, %zu occluder triangles, %d frames\n", objectCount, wallIndices.size() / 3 + clutterIndices.size() / 3, frameCount);
+
+	std::vector<std::uint32_t> visible;
+	const unsigned workerCounts[] = { 0, 1, 3, 7 };
+	for (const auto workerCount : workerCounts)
+	{
+		ThreadPool workers{ workerCount };
+		OcclusionCuller culler{ workers };
+		double rasterizeMilliseconds = 0.0;
+		double testMilliseconds = 0.0;
+		OcclusionCullerStats stats{};
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			culler.BeginFrame(viewProjection);
+			culler.AddOccluder(wall.data(), 3, wallIndices.data(), wallIndices.size(), glm::mat4{ 1.0f });
+			culler.AddOccluder(clutter.data(), 3, clutterIndices.data(), clutterIndices.size(), glm::mat4{ 1.0f });
+			culler.Rasterize();
+
+			visible.resize(objectCount);
+			for (std::size_t i = 0; i < objectCount; i++)
+				visible[i] = static_cast<std::uint32_t>(i);
+			culler.Cull(visible, bounds);
+
+			// The stats of a frame are only complete once the next one begins
+			culler.BeginFrame(viewProjection);
+			stats = culler.GetStats();
+			rasterizeMilliseconds += stats.rasterizeMilliseconds;
+			testMilliseconds += stats.testMilliseconds;
+		}
+
+		std::printf("%u workers: %zu of %zu occluded (%.1f%%), %zu triangles rasterized, %zu skipped, rasterize %.3f ms, test %.3f ms\n",
+			workerCount, stats.occluded, stats.tested, 100.0 * stats.occluded / stats.tested, stats.trianglesRasterized, stats.trianglesSkipped,
+			rasterizeMilliseconds / frameCount, testMilliseconds / frameCount);
+	}
+
+	return 0;
+}
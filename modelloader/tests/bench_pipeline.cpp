@@ -0,0 +1,137 @@
+// Measures how a whole frame scales with the worker count: the FramePipeline updating transforms and culling on the
+// Shared pool, recording the draw list in one job per worker, and replaying the lists on this thread.
+// The recording device stands in for OpenGL, so only the time spent in our own code is measured.
+// Usage: bench_pipeline [object count] [frames]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "DrawList.hpp"
+#include "FramePipeline.hpp"
+#include "FrustumCuller.hpp"
+#include "RecordingRenderDevice.hpp"
+#include "TransformStore.hpp"
+
+int main(int argc, char** argv)
+{
+	const auto objectCount = argc > 1 ? static_cast<std::size_t>(std::atol(argv[1])) : 200000;
+	const auto frameCount = argc > 2 ? std::atoi(argv[2]) : 30;
+
+	const auto projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+
+	std::printf("%zu objects, %d frames, %u hardware threads\n", objectCount, frameCount, std::thread::hardware_concurrency());
+
+	const unsigned workerCounts[] = { 0, 1, 3, 7, 15 };
+	double baseline = 0.0;
+	for (const auto workerCount : workerCounts)
+	{
+		std::mt19937 random{ 4 };
+		std::uniform_real_distribution<float> position{ -300.0f, 300.0f };
+		std::uniform_real_distribution<float> step{ -1.0f, 1.0f };
+
+		ThreadPool workers{ workerCount };
+		TransformStore store{ workers };
+		FrustumCuller culler{ workers };
+		std::vector<std::uint32_t> transforms(objectCount);
+		std::vector<DrawState> states(objectCount);
+		for (std::size_t i = 0; i < objectCount; i++)
+		{
+			transforms[i] = store.Create();
+			store.SetPosition(transforms[i], glm::vec3{ position(random), position(random), position(random) });
+			states[i].vertexArray = 1 + random() % 4;
+			states[i].texture = 1 + random() % 64;
+		}
+
+		RecordingRenderDevice device{ true };
+		DrawListBuffers buffers{};
+		buffers.commandBuffer = device.CreateBuffer(BufferTarget::Indirect, objectCount * sizeof(DrawCommand), nullptr, BufferUsage::Stream);
+		buffers.transformBuffer = device.CreateBuffer(BufferTarget::Vertex, objectCount * sizeof(glm::mat4), nullptr, BufferUsage::Stream);
+		buffers.transformLocation = 3;
+
+		DrawList drawLists[FramePipeline::Latency + 1];
+		std::vector<std::uint32_t> visible;
+
+		// A hundredth of the objects move every frame, the camera turns around the scene
+		const auto update = [&](std::uint64_t frame)
+		{
+			for (std::size_t i = 0; i < objectCount / 100; i++)
+			{
+				const auto transform = transforms[random() % objectCount];
+				store.SetPosition(transform, store.GetPosition(transform) + glm::vec3{ step(random), step(random), step(random) });
+			}
+			store.Update();
+
+			const auto angle = frame * 0.05f;
+			const auto view = glm::lookAt(glm::vec3{ 0.0f }, glm::vec3{ std::sin(angle), 0.0f, -std::cos(angle) }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+			const auto& matrices = store.GetWorldMatrices();
+			culler.Clear();
+			for (std::size_t i = 0; i < objectCount; i++)
+				culler.Add(BoundingVolume::FromBox(glm::vec3{ -1.0f }, glm::vec3{ 1.0f }, matrices[transforms[i]]), static_cast<std::uint32_t>(i));
+			culler.Cull(Frustum::FromMatrix(projection * view), visible);
+
+			auto& drawList = drawLists[frame % (FramePipeline::Latency + 1)];
+			drawList.Clear();
+			drawList.SetView(view, 0.1f, 1000.0f);
+			for (const auto i : visible)
+				drawList.Add(states[i], 36, 0, 0, matrices[transforms[i]]);
+			drawList.Build();
+		};
+
+		const auto record = [&](std::uint64_t frame, std::size_t job, std::size_t jobCount, RenderDevice& commands)
+		{
+			const auto& drawList = drawLists[frame % (FramePipeline::Latency + 1)];
+			const auto batchCount = drawList.GetBatches().size();
+			const auto firstBatch = batchCount * job / jobCount;
+			const auto lastBatch = batchCount * (job + 1) / jobCount;
+			drawList.Submit(commands, buffers, nullptr, firstBatch, lastBatch - firstBatch);
+		};
+
+		const auto submit = [&](std::uint64_t frame, const std::function<void()>& replay)
+		{
+			const auto& drawList = drawLists[frame % (FramePipeline::Latency + 1)];
+			device.BeginFrame();
+			device.UpdateBuffer(buffers.commandBuffer, 0, drawList.GetCommands().size() * sizeof(DrawCommand), drawList.GetCommands().data());
+			device.UpdateBuffer(buffers.transformBuffer, 0, drawList.GetTransforms().size() * sizeof(glm::mat4), drawList.GetTransforms().data());
+			replay();
+		};
+
+		FramePipeline pipeline{ device, update, record, submit, workers };
+
+		// Until the pipeline is full, some stages have nothing to do
+		for (int frame = 0; frame < FramePipeline::Latency; frame++)
+			pipeline.RunFrame();
+
+		FramePipelineStats total{};
+		std::size_t recordThreads = 0;
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			pipeline.RunFrame();
+			const auto stats = pipeline.GetStats();
+			total.frameMilliseconds += stats.frameMilliseconds;
+			total.updateMilliseconds += stats.updateMilliseconds;
+			total.recordMilliseconds += stats.recordMilliseconds;
+			total.recordWallMilliseconds += stats.recordWallMilliseconds;
+			total.submitMilliseconds += stats.submitMilliseconds;
+			total.recordJobs = stats.recordJobs;
+			recordThreads = std::max(recordThreads, stats.recordThreads);
+		}
+		pipeline.Flush();
+
+		const auto frameMilliseconds = total.frameMilliseconds / frameCount;
+		if (workerCount == 0)
+			baseline = frameMilliseconds;
+		std::printf("%2u workers: %.3f ms per frame (%.2fx), update %.3f ms, record %.3f ms over %zu jobs on up to %zu threads "
+			"(%.3f ms wall), submit %.3f ms, %zu visible\n", workerCount, frameMilliseconds, baseline / frameMilliseconds,
+			total.updateMilliseconds / frameCount, total.recordMilliseconds / frameCount, total.recordJobs, recordThreads,
+			total.recordWallMilliseconds / frameCount, total.submitMilliseconds / frameCount, visible.size());
+	}
+
+	return 0;
+}
@@ -0,0 +1,113 @@
+// Compares the bounding volume hierarchy with the flat path, as the number of objects grows.
+// Every frame, 2% of the objects move a little. The flat path copies every object's bounds into the FrustumCuller
+// And tests them all, the tree takes the moves and only visits the parts of the scene near the frustum.
+// Usage: bench_spatialindex [frames]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SpatialIndex.hpp"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	BoundingVolume BoxAt(const glm::vec3& position)
+	{
+		return BoundingVolume::FromBox(glm::vec3{ -1.0f }, glm::vec3{ 1.0f }, glm::translate(glm::mat4{ 1.0f }, position));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const auto frameCount = argc > 1 ? std::atoi(argv[1]) : 20;
+
+	const auto projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+	const auto view = glm::lookAt(glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+	const auto frustum = Frustum::FromMatrix(projection * view);
+
+	std::printf("%d frames, 2%% of the objects moving each frame, times per frame\n", frameCount);
+	std::printf("%8s | %12s %12s %12s | %12s %12s | %8s\n", "objects", "tree update", "tree query", "nodes", "flat update", "flat cull", "visible");
+
+	const std::size_t objectCounts[] = { 1000, 10000, 100000, 1000000 };
+	for (const auto objectCount : objectCounts)
+	{
+		std::mt19937 random{ 3 };
+		std::uniform_real_distribution<float> position{ -500.0f, 500.0f };
+		std::uniform_real_distribution<float> step{ -3.0f, 3.0f };
+
+		SpatialIndex index{};
+		ThreadPool noWorkers{ 0 };
+		FrustumCuller flat{ noWorkers };
+		flat.Reserve(objectCount);
+		std::vector<glm::vec3> positions(objectCount);
+		std::vector<BoundingVolume> bounds(objectCount);
+		std::vector<std::uint32_t> handles(objectCount);
+		for (std::size_t i = 0; i < objectCount; i++)
+		{
+			positions[i] = glm::vec3{ position(random), position(random), position(random) };
+			bounds[i] = BoxAt(positions[i]);
+			handles[i] = index.Insert(bounds[i], static_cast<std::uint32_t>(i));
+			flat.Add(bounds[i], static_cast<std::uint32_t>(i));
+		}
+		index.Rebuild();
+		index.Update();
+
+		double treeUpdate = 0.0;
+		double treeQuery = 0.0;
+		double flatUpdate = 0.0;
+		double flatCull = 0.0;
+		std::size_t nodesVisited = 0;
+		std::vector<std::uint32_t> visible;
+		std::vector<std::uint32_t> flatVisible;
+		std::vector<std::size_t> moved;
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			moved.clear();
+			for (std::size_t move = 0; move < objectCount / 50; move++)
+			{
+				const auto i = random() % objectCount;
+				positions[i] += glm::vec3{ step(random), step(random), step(random) };
+				bounds[i] = BoxAt(positions[i]);
+				moved.push_back(i);
+			}
+
+			// The moves themselves count towards the tree's update, as that's when it decides whether to refit
+			auto start = Clock::now();
+			for (const auto i : moved)
+				index.Move(handles[i], bounds[i]);
+			index.Update();
+			treeUpdate += MillisecondsSince(start);
+
+			start = Clock::now();
+			visible.clear();
+			index.QueryFrustum(frustum, visible);
+			treeQuery += MillisecondsSince(start);
+
+			start = Clock::now();
+			for (std::size_t i = 0; i < objectCount; i++)
+				flat.Set(i, bounds[i]);
+			flatUpdate += MillisecondsSince(start);
+
+			flat.Cull(frustum, flatVisible);
+			flatCull += flat.GetStats().milliseconds;
+		}
+
+		index.Update();
+		nodesVisited = index.GetStats().nodesVisited;
+		std::printf("%8zu | %9.3f ms %9.3f ms %12zu | %9.3f ms %9.3f ms | %8zu\n", objectCount, treeUpdate / frameCount,
+			treeQuery / frameCount, nodesVisited, flatUpdate / frameCount, flatCull / frameCount, visible.size());
+	}
+
+	return 0;
+}
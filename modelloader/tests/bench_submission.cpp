@@ -0,0 +1,99 @@
+// Measures the CPU side of submitting a frame: building the draw list (sorting its keys included), and issuing the
+// Batches through a RenderDevice, whose state filter drops the calls that wouldn't change anything.
+// The recording device stands in for OpenGL, so only the time spent in our own code is measured.
+// Usage: bench_submission [draw count] [frames]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "DrawList.hpp"
+#include "RecordingRenderDevice.hpp"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const auto drawCount = argc > 1 ? std::atoi(argv[1]) : 100000;
+	const auto frameCount = argc > 2 ? std::atoi(argv[2]) : 20;
+
+	// A few hundred meshes over a handful of shared geometry buffers, with their textures spread evenly
+	std::mt19937 random{ 1 };
+	std::vector<DrawState> states(drawCount);
+	std::vector<glm::mat4> transforms(drawCount, glm::mat4{ 1.0f });
+	for (int i = 0; i < drawCount; i++)
+	{
+		states[i].vertexArray = 1 + random() % 4;
+		states[i].texture = 1 + random() % 64;
+		transforms[i][3] = glm::vec4{ 0.0f, 0.0f, -1.0f - static_cast<float>(random() % 1000), 1.0f };
+	}
+
+	std::printf("%d draws, %d frames\n", drawCount, frameCount);
+
+	for (const auto multiDraw : { true, false })
+	{
+		RecordingRenderDevice device{ multiDraw };
+		DrawList list{};
+		DrawListBuffers buffers{};
+		buffers.commandBuffer = device.CreateBuffer(BufferTarget::Indirect, drawCount * sizeof(DrawCommand), nullptr, BufferUsage::Stream);
+		buffers.transformBuffer = device.CreateBuffer(BufferTarget::Vertex, drawCount * sizeof(glm::mat4), nullptr, BufferUsage::Stream);
+		buffers.transformLocation = 3;
+
+		double addMilliseconds = 0.0;
+		double buildMilliseconds = 0.0;
+		double sortMilliseconds = 0.0;
+		double submitMilliseconds = 0.0;
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			device.BeginFrame();
+
+			auto start = Clock::now();
+			list.Clear();
+			list.SetView(glm::mat4{ 1.0f }, 0.1f, 1000.0f);
+			for (int i = 0; i < drawCount; i++)
+				list.Add(states[i], 36, 0, 0, transforms[i]);
+			addMilliseconds += MillisecondsSince(start);
+
+			list.Build();
+			buildMilliseconds += list.GetStats().buildMilliseconds;
+
+			start = Clock::now();
+			list.Submit(device, buffers, nullptr);
+			submitMilliseconds += MillisecondsSince(start);
+		}
+		device.BeginFrame();
+
+		// DrawList doesn't hand out its queue, so the sort on its own is timed on the same keys here
+		RenderQueue queue{};
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			queue.Clear();
+			random.seed(1);
+			for (int i = 0; i < drawCount; i++)
+				queue.Submit(RenderKey::Pack(0, 0, states[i].texture, states[i].vertexArray, random() % (1 << RenderKey::DepthBits)), i);
+			queue.Sort();
+			sortMilliseconds += queue.GetStats().sortMilliseconds;
+		}
+
+		const auto listStats = list.GetStats();
+		const auto deviceStats = device.GetStats();
+		std::printf("%s\n", multiDraw ? "Multi-draw indirect" : "One call per draw");
+		std::printf("  add %.3f ms, build %.3f ms (radix sort alone %.3f ms), submit %.3f ms per frame\n", addMilliseconds / frameCount,
+			buildMilliseconds / frameCount, sortMilliseconds / frameCount, submitMilliseconds / frameCount);
+		std::printf("  %zu batches, %zu state changes, %zu avoided by sorting\n", listStats.batches, listStats.stateChanges,
+			listStats.stateChangesAvoided);
+		std::printf("  %zu draw calls, %zu state calls issued, %zu filtered, %zu stream bytes\n", deviceStats.drawCalls,
+			deviceStats.stateChanges, deviceStats.stateChangesFiltered, device.GetRecordingStats().streamBytes);
+	}
+
+	return 0;
+}
@@ -0,0 +1,106 @@
+// Measures TransformStore::Update on a scene of a few hundred thousand transforms, a third of them children of
+// Another one. Compared with composing every matrix with glm each frame, as meshes did before the store.
+// Usage: bench_transforms [transform count] [frames]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "TransformStore.hpp"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const auto transformCount = argc > 1 ? std::atoi(argv[1]) : 200000;
+	const auto frameCount = argc > 2 ? std::atoi(argv[2]) : 20;
+
+	std::printf("%d transforms, %d frames, %u hardware threads\n", transformCount, frameCount, std::thread::hardware_concurrency());
+
+	// Composing every matrix from scratch every frame, parents first
+	{
+		std::mt19937 random{ 2 };
+		std::uniform_real_distribution<float> value{ -10.0f, 10.0f };
+		std::vector<std::uint32_t> parents(transformCount);
+		std::vector<glm::vec3> positions(transformCount);
+		std::vector<glm::quat> rotations(transformCount);
+		std::vector<glm::mat4> matrices(transformCount);
+		for (int i = 0; i < transformCount; i++)
+		{
+			parents[i] = i > 10 && random() % 3 == 0 ? random() % i : TransformStore::None;
+			positions[i] = glm::vec3{ value(random), value(random), value(random) };
+			rotations[i] = glm::normalize(glm::quat{ value(random), value(random), value(random), value(random) });
+		}
+
+		const auto start = Clock::now();
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			for (int i = 0; i < transformCount; i++)
+			{
+				const auto local = glm::translate(glm::mat4{ 1.0f }, positions[i]) * glm::mat4_cast(rotations[i]);
+				matrices[i] = parents[i] == TransformStore::None ? local : matrices[parents[i]] * local;
+			}
+		}
+		std::printf("glm, every transform every frame: %.3f ms per frame\n", MillisecondsSince(start) / frameCount);
+	}
+
+	const unsigned workerCounts[] = { 0, 1, 3, 7 };
+	for (const auto workerCount : workerCounts)
+	{
+		std::mt19937 random{ 2 };
+		std::uniform_real_distribution<float> value{ -10.0f, 10.0f };
+
+		ThreadPool workers{ workerCount };
+		TransformStore store{ workers };
+		std::vector<std::uint32_t> transforms;
+		for (int i = 0; i < transformCount; i++)
+		{
+			const auto parent = i > 10 && random() % 3 == 0 ? transforms[random() % transforms.size()] : TransformStore::None;
+			const auto transform = store.Create(parent);
+			store.SetPosition(transform, glm::vec3{ value(random), value(random), value(random) });
+			store.SetRotation(transform, glm::normalize(glm::quat{ value(random), value(random), value(random), value(random) }));
+			transforms.push_back(transform);
+		}
+
+		store.Update();
+		auto stats = store.GetStats();
+		std::printf("%u workers: first update %.3f ms, %zu levels deep\n", workerCount, stats.milliseconds, stats.depth);
+
+		// Every transform changed, then 1% of them, then none
+		const int movedPercentages[] = { 100, 1, 0 };
+		for (const auto movedPercentage : movedPercentages)
+		{
+			double milliseconds = 0.0;
+			for (int frame = 0; frame < frameCount; frame++)
+			{
+				for (int i = 0; i < transformCount * movedPercentage / 100; i++)
+				{
+					const auto transform = movedPercentage == 100 ? transforms[i] : transforms[random() % transforms.size()];
+					store.SetPosition(transform, glm::vec3{ value(random), value(random), value(random) });
+				}
+
+				store.Update();
+				milliseconds += store.GetStats().milliseconds;
+			}
+
+			stats = store.GetStats();
+			std::printf("  %3d%% moved: %zu updated, %zu jobs, %.3f ms per frame\n", movedPercentage, stats.updated, stats.jobs,
+				milliseconds / frameCount);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+#include "Check.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "FramePipeline.hpp"
+#include "RecordingRenderDevice.hpp"
+
+namespace
+{
+	// Every frame goes through update, record and submit in that order, one stage per RunFrame, and its lists are
+	// Replayed whole. The update spreads work over the same pool the pipeline runs on.
+	void CheckFrames(unsigned workerCount, std::size_t recordJobCount)
+	{
+		const std::uint64_t frameCount = 12;
+		const auto slotCount = static_cast<std::uint64_t>(FramePipeline::Latency + 1);
+
+		ThreadPool workers{ workerCount };
+		RecordingRenderDevice device{ true };
+		std::vector<std::uint64_t> updated(slotCount, 0);
+		std::vector<std::uint64_t> submitted;
+		std::atomic<int> outOfOrder{ 0 };
+		std::atomic<int> wrongSums{ 0 };
+
+		const auto update = [&](std::uint64_t frame)
+		{
+			std::vector<std::uint64_t> parts(16, 0);
+			workers.Run(parts.size(), [&](std::size_t part) { parts[part] = frame + part; });
+
+			std::uint64_t sum = 0;
+			for (const auto value : parts)
+				sum += value;
+			if (sum != frame * parts.size() + parts.size() * (parts.size() - 1) / 2)
+				wrongSums++;
+
+			updated[frame % slotCount] = frame;
+		};
+
+		const auto record = [&](std::uint64_t frame, std::size_t job, std::size_t, RenderDevice& commands)
+		{
+			if (updated[frame % slotCount] != frame)
+				outOfOrder++;
+			commands.DrawIndexed(static_cast<std::uint32_t>(job + 1), static_cast<std::uint32_t>(frame), 0, 1);
+		};
+
+		std::size_t wrongDrawCounts = 0;
+		const auto submit = [&](std::uint64_t frame, const std::function<void()>& replay)
+		{
+			submitted.push_back(frame);
+			// The device counts the calls of the frame it last finished
+			device.BeginFrame();
+			replay();
+			device.BeginFrame();
+			if (device.GetStats().drawCalls != recordJobCount)
+				wrongDrawCounts++;
+		};
+
+		FramePipeline pipeline{ device, update, record, submit, workers, recordJobCount };
+		for (std::uint64_t frame = 0; frame < frameCount; frame++)
+		{
+			pipeline.RunFrame();
+			const auto stats = pipeline.GetStats();
+			CHECK(stats.updateFrame == static_cast<std::int64_t>(frame));
+			CHECK(stats.submitFrame == (frame >= FramePipeline::Latency ? static_cast<std::int64_t>(frame) - FramePipeline::Latency : -1));
+			CHECK(stats.recordJobs == (frame >= 1 ? recordJobCount : 0));
+		}
+		pipeline.Flush();
+
+		CHECK(submitted.size() == frameCount);
+		for (std::size_t i = 0; i < submitted.size(); i++)
+			CHECK(submitted[i] == i);
+		CHECK(outOfOrder == 0);
+		CHECK(wrongSums == 0);
+		CHECK(wrongDrawCounts == 0);
+	}
+}
+
+int main()
+{
+	CheckFrames(0, 1);
+	CheckFrames(0, 3);
+	CheckFrames(1, 1);
+	CheckFrames(3, 4);
+	CheckFrames(7, 7);
+
+	return CheckResult();
+}
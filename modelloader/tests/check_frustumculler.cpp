@@ -0,0 +1,86 @@
+#include "Check.hpp"
+
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "FrustumCuller.hpp"
+
+namespace
+{
+	// The same tests as the culler, one object and one plane at a time
+	bool IsVisible(const Frustum& frustum, const BoundingVolume& bounds)
+	{
+		for (const auto& plane : frustum.planes)
+		{
+			const glm::vec3 normal{ plane };
+			if (glm::dot(normal, bounds.center) + plane.w < -bounds.radius)
+				return false;
+
+			// The corner of the box furthest along the plane's normal
+			const glm::vec3 corner{ plane.x > 0.0f ? bounds.max.x : bounds.min.x, plane.y > 0.0f ? bounds.max.y : bounds.min.y,
+				plane.z > 0.0f ? bounds.max.z : bounds.min.z };
+			if (glm::dot(normal, corner) + plane.w < 0.0f)
+				return false;
+		}
+
+		return true;
+	}
+
+	// Culls objects spread evenly around the camera, so about a tenth of them are visible, including the last ones
+	void CheckAgainstReference(std::size_t objectCount, unsigned workerCount)
+	{
+		const auto projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+		const auto view = glm::lookAt(glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+		const auto frustum = Frustum::FromMatrix(projection * view);
+
+		std::mt19937 random{ 3 };
+		std::uniform_real_distribution<float> position{ -500.0f, 500.0f };
+
+		ThreadPool workers{ workerCount };
+		FrustumCuller culler{ workers };
+		culler.Reserve(objectCount);
+		std::vector<std::uint32_t> expected;
+		for (std::size_t i = 0; i < objectCount; i++)
+		{
+			auto transform = glm::translate(glm::mat4{ 1.0f }, glm::vec3{ position(random), position(random), position(random) });
+			transform = glm::rotate(transform, position(random), glm::vec3{ 1.0f, 1.0f, 0.0f });
+			const auto bounds = BoundingVolume::FromBox(glm::vec3{ -1.0f }, glm::vec3{ 1.0f }, transform);
+			culler.Add(bounds, static_cast<std::uint32_t>(i));
+			if (IsVisible(frustum, bounds))
+				expected.push_back(static_cast<std::uint32_t>(i));
+		}
+
+		// Make sure the end of the array is tested, whichever piece it falls in
+		const auto last = static_cast<std::uint32_t>(objectCount - 1);
+		culler.Set(last, BoundingVolume::FromBox(glm::vec3{ -1.0f }, glm::vec3{ 1.0f }, glm::translate(glm::mat4{ 1.0f }, glm::vec3{ 0.0f, 0.0f, -10.0f })));
+		if (expected.empty() || expected.back() != last)
+			expected.push_back(last);
+
+		std::vector<std::uint32_t> visible;
+		culler.Cull(frustum, visible);
+		CHECK(visible == expected);
+		CHECK(culler.GetStats().visible == expected.size());
+
+		if (visible != expected)
+			std::printf("  %zu objects on %u workers: %zu visible, expected %zu\n", objectCount, workerCount, visible.size(), expected.size());
+	}
+}
+
+int main()
+{
+	// Just above the threshold, counts which aren't a multiple of the padding or the pieces, and more pieces than
+	// There are blocks to go round
+	const std::size_t objectCounts[] = { FrustumCuller::ParallelThreshold - 1, FrustumCuller::ParallelThreshold + 8,
+		FrustumCuller::ParallelThreshold + 13, 100003 };
+	const unsigned workerCounts[] = { 0, 1, 3, 7, 15, 31 };
+
+	for (const auto objectCount : objectCounts)
+	{
+		for (const auto workerCount : workerCounts)
+			CheckAgainstReference(objectCount, workerCount);
+	}
+
+	return CheckResult();
+}
@@ -0,0 +1,119 @@
+#include "Check.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "LodSelector.hpp"
+
+namespace
+{
+	const float Errors[] = { 0.0f, 0.01f, 0.05f, 0.2f };
+
+	BoundingVolume Sphere(const glm::vec3& center, float radius)
+	{
+		BoundingVolume bounds{};
+		bounds.center = center;
+		bounds.radius = radius;
+		return bounds;
+	}
+
+	// The rule Select applies, one object at a time
+	int ReferenceLevel(int current, int levelCount, float distance, float projectionScale, float bias)
+	{
+		const auto threshold = LodSelector::PixelThreshold * bias;
+		auto level = 0;
+		for (int candidate = 1; candidate < levelCount; candidate++)
+		{
+			const auto limit = threshold * (candidate > current ? 1.0f - LodSelector::Hysteresis : 1.0f + LodSelector::Hysteresis);
+			if (Errors[candidate] * projectionScale <= limit * distance)
+				level++;
+		}
+
+		return level;
+	}
+
+	// An object with two levels walking away from the camera and back. It goes coarser past about 90 units, and only
+	// Goes back to the finer level closer than about 60.
+	void CheckHysteresis()
+	{
+		LodSelector selector{};
+		const float errors[] = { 0.0f, 0.1f };
+		const auto object = selector.Register(errors, 2);
+		selector.SetCamera(glm::vec3{ 0.0f }, glm::radians(45.0f), 600.0f);
+
+		const float distances[] = { 50.0f, 70.0f, 80.0f, 95.0f, 80.0f, 65.0f, 55.0f };
+		const int expected[] = { 0, 0, 0, 1, 1, 1, 0 };
+		for (int step = 0; step < 7; step++)
+		{
+			selector.Clear();
+			selector.Add(object, Sphere(glm::vec3{ 0.0f, 0.0f, -distances[step] - 1.0f }, 1.0f));
+			selector.Select();
+			CHECK(selector.GetLevel(object) == expected[step]);
+		}
+	}
+
+	// A batch which doesn't fill the last SIMD block, over a few frames as the camera moves, against the reference
+	void CheckAgainstReference(float bias)
+	{
+		const auto fieldOfView = glm::radians(45.0f);
+		const auto viewportHeight = 600.0f;
+		const auto projectionScale = viewportHeight / (2.0f * std::tan(fieldOfView * 0.5f));
+
+		std::mt19937 random{ 1 };
+		std::uniform_real_distribution<float> position{ -300.0f, 300.0f };
+
+		LodSelector selector{};
+		selector.SetQualityBias(bias);
+		const int objectCount = 10003;
+		std::vector<std::uint32_t> objects;
+		std::vector<int> levelCounts;
+		std::vector<BoundingVolume> bounds;
+		std::vector<int> levels(objectCount, 0);
+		for (int i = 0; i < objectCount; i++)
+		{
+			levelCounts.push_back(1 + i % 4);
+			objects.push_back(selector.Register(Errors, levelCounts.back()));
+			bounds.push_back(Sphere(glm::vec3{ position(random), position(random), position(random) }, 1.0f));
+		}
+
+		auto mismatches = 0;
+		for (int frame = 0; frame < 4; frame++)
+		{
+			const glm::vec3 camera{ frame * 20.0f, 0.0f, 0.0f };
+			selector.SetCamera(camera, fieldOfView, viewportHeight);
+			selector.Clear();
+			for (int i = 0; i < objectCount; i++)
+				selector.Add(objects[i], bounds[i]);
+			selector.Select();
+
+			std::size_t changes = 0;
+			for (int i = 0; i < objectCount; i++)
+			{
+				const auto distance = std::max(glm::length(bounds[i].center - camera) - bounds[i].radius, 0.001f);
+				const auto level = ReferenceLevel(levels[i], levelCounts[i], distance, projectionScale, bias);
+				if (level != levels[i])
+					changes++;
+				levels[i] = level;
+
+				if (selector.GetLevel(objects[i]) != level)
+					mismatches++;
+			}
+
+			CHECK(selector.GetStats().changes == changes);
+			CHECK(selector.GetStats().objects == static_cast<std::size_t>(objectCount));
+		}
+
+		CHECK(mismatches == 0);
+	}
+}
+
+int main()
+{
+	CheckHysteresis();
+	CheckAgainstReference(1.0f);
+	CheckAgainstReference(4.0f);
+
+	return CheckResult();
+}
@@ -0,0 +1,100 @@
+#include "Check.hpp"
+
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "OcclusionCuller.hpp"
+
+namespace
+{
+	// A 12 x 12 wall facing the camera, 10 units in front of it
+	const float WallVertices[] = {
+		-6.0f, -6.0f, -10.0f,
+		 6.0f, -6.0f, -10.0f,
+		 6.0f,  6.0f, -10.0f,
+		-6.0f,  6.0f, -10.0f,
+	};
+	const unsigned WallIndices[] = { 0, 1, 2, 0, 2, 3 };
+
+	glm::mat4 ViewProjection()
+	{
+		const auto projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 1000.0f);
+		const auto view = glm::lookAt(glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+		return projection * view;
+	}
+
+	BoundingVolume Box(const glm::vec3& center, float halfSize)
+	{
+		return BoundingVolume::FromBox(glm::vec3{ -halfSize }, glm::vec3{ halfSize }, glm::translate(glm::mat4{ 1.0f }, center));
+	}
+
+	void CheckWall()
+	{
+		ThreadPool noWorkers{ 0 };
+		OcclusionCuller culler{ noWorkers };
+		culler.BeginFrame(ViewProjection());
+		culler.AddOccluder(WallVertices, 3, WallIndices, 6, glm::mat4{ 1.0f });
+		culler.Rasterize();
+
+		CHECK(!culler.IsVisible(Box(glm::vec3{ 0.0f, 0.0f, -20.0f }, 1.0f)));
+		// In front of the wall, poking through it, beside it, and around the camera
+		CHECK(culler.IsVisible(Box(glm::vec3{ 0.0f, 0.0f, -5.0f }, 1.0f)));
+		CHECK(culler.IsVisible(Box(glm::vec3{ 0.0f, 0.0f, -9.5f }, 1.0f)));
+		CHECK(culler.IsVisible(Box(glm::vec3{ 30.0f, 0.0f, -20.0f }, 1.0f)));
+		CHECK(culler.IsVisible(Box(glm::vec3{ 0.0f }, 1.0f)));
+	}
+
+	// However the work is split, Cull hides the same objects as testing them one by one, and keeps the order
+	void CheckCull(unsigned workerCount)
+	{
+		std::mt19937 random{ 5 };
+		std::uniform_real_distribution<float> spread{ -20.0f, 20.0f };
+		std::uniform_real_distribution<float> depth{ -60.0f, -5.0f };
+		std::uniform_real_distribution<float> size{ 0.2f, 3.0f };
+
+		std::vector<BoundingVolume> bounds;
+		std::vector<std::uint32_t> visible;
+		for (std::uint32_t i = 0; i < 20000; i++)
+		{
+			bounds.push_back(Box(glm::vec3{ spread(random), spread(random) * 0.5f, depth(random) - 10.0f }, size(random)));
+			// Every other object, so the payloads aren't just 0 to n
+			if (i % 2 == 0)
+				visible.push_back(i);
+		}
+
+		ThreadPool workers{ workerCount };
+		OcclusionCuller culler{ workers };
+		culler.BeginFrame(ViewProjection());
+		culler.AddOccluder(WallVertices, 3, WallIndices, 6, glm::mat4{ 1.0f });
+		culler.Rasterize();
+
+		std::vector<std::uint32_t> expected;
+		for (const auto payload : visible)
+		{
+			if (culler.IsVisible(bounds[payload]))
+				expected.push_back(payload);
+		}
+
+		const auto tested = visible.size();
+		culler.Cull(visible, bounds);
+		CHECK(visible == expected);
+		CHECK(expected.size() < tested);
+
+		culler.BeginFrame(ViewProjection());
+		const auto stats = culler.GetStats();
+		CHECK(stats.tested == tested);
+		CHECK(stats.occluded == tested - expected.size());
+		CHECK(stats.trianglesRasterized == 2);
+	}
+}
+
+int main()
+{
+	CheckWall();
+	CheckCull(0);
+	CheckCull(3);
+
+	return CheckResult();
+}
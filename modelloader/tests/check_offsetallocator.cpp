@@ -0,0 +1,100 @@
+#include "Check.hpp"
+
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "OffsetAllocator.hpp"
+
+namespace
+{
+	void CheckExactFit()
+	{
+		OffsetAllocator allocator{ 0 };
+		allocator.Grow(10);
+
+		const auto first = allocator.Allocate(10);
+		CHECK(first.IsValid());
+		CHECK(first.offset == 0);
+		CHECK(!allocator.Allocate(1).IsValid());
+
+		// Growing adds the new space after the allocations already made
+		allocator.Grow(20);
+		const auto second = allocator.Allocate(10);
+		CHECK(second.offset == 10);
+
+		// Freed neighbours merge back into a single region
+		allocator.Free(first);
+		allocator.Free(second);
+		const auto stats = allocator.GetStats();
+		CHECK(stats.allocations == 0);
+		CHECK(stats.freeRegions == 1);
+		CHECK(stats.largestFreeRegion == 20);
+	}
+
+	// Random allocations and frees, checked against a map of the ranges handed out
+	void CheckAgainstReference()
+	{
+		OffsetAllocator allocator{ 1 << 20 };
+		std::mt19937 random{ 1 };
+		std::vector<OffsetAllocation> live;
+		std::map<std::uint32_t, std::uint32_t> ranges;
+		auto overlaps = 0;
+
+		for (int step = 0; step < 200000; step++)
+		{
+			if (step == 100000)
+				allocator.Grow(1 << 21);
+
+			if (live.empty() || random() % 3 != 0)
+			{
+				// Mostly small ranges, with the occasional large one to fragment the space
+				const auto size = 1 + random() % (random() % 10 != 0 ? 100 : 20000);
+				const auto allocation = allocator.Allocate(size);
+				if (!allocation.IsValid())
+					continue;
+
+				CHECK(allocator.AllocationSize(allocation) == size);
+				CHECK(allocation.offset + size <= allocator.GetSize());
+
+				auto next = ranges.lower_bound(allocation.offset);
+				if (next != ranges.end() && next->first < allocation.offset + size)
+					overlaps++;
+				if (next != ranges.begin() && std::prev(next)->first + std::prev(next)->second > allocation.offset)
+					overlaps++;
+
+				ranges[allocation.offset] = size;
+				live.push_back(allocation);
+			}
+			else
+			{
+				const auto index = random() % live.size();
+				allocator.Free(live[index]);
+				ranges.erase(live[index].offset);
+				live[index] = live.back();
+				live.pop_back();
+			}
+		}
+
+		CHECK(overlaps == 0);
+		CHECK(allocator.GetStats().allocations == live.size());
+
+		for (const auto& allocation : live)
+			allocator.Free(allocation);
+
+		const auto stats = allocator.GetStats();
+		CHECK(stats.freeRegions == 1);
+		CHECK(stats.freeSpace == 1u << 21);
+		CHECK(stats.largestFreeRegion == 1u << 21);
+		CHECK(stats.fragmentation == 0.0f);
+	}
+}
+
+int main()
+{
+	CheckExactFit();
+	CheckAgainstReference();
+
+	return CheckResult();
+}
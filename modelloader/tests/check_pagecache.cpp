@@ -0,0 +1,114 @@
+#include "Check.hpp"
+
+#include "PageCache.hpp"
+#include "PageTable.hpp"
+
+namespace
+{
+	void CheckPageId()
+	{
+		const PageId page{ PageId::MaxTextureId, PageId::MaxLevel - 1, PageId::MaxCoordinate, 17 };
+		CHECK(PageId::Unpack(page.Pack()) == page);
+		CHECK(PageId::Unpack(PageId{ 0, 0, 0, 0 }.Pack()) == (PageId{ 0, 0, 0, 0 }));
+
+		const auto parent = PageId{ 3, 1, 7, 4 }.Parent();
+		CHECK(parent == (PageId{ 3, 2, 3, 2 }));
+	}
+
+	void CheckEviction()
+	{
+		const PageId pinned{ 1, 2, 0, 0 };
+		const PageId first{ 1, 0, 0, 0 };
+		const PageId second{ 1, 0, 1, 0 };
+		const PageId third{ 1, 0, 2, 0 };
+
+		PageCache cache{ 3 };
+		cache.BeginFrame(1);
+		CHECK(cache.Insert(pinned, true).slot == 0);
+		CHECK(cache.Insert(first, false).slot == 1);
+		CHECK(cache.Insert(second, false).slot == 2);
+		CHECK(cache.GetResidentCount() == 3);
+
+		// Inserting a page which is already resident hands back its slot
+		CHECK(cache.Insert(first, false).slot == 1);
+
+		// Every page was used this frame, and the pinned one can't go at all
+		CHECK(cache.Insert(third, false).slot == -1);
+
+		// The least recently used page goes first, and touching a page makes it the most recently used
+		cache.BeginFrame(2);
+		cache.Touch(first);
+		const auto insertion = cache.Insert(third, false);
+		CHECK(insertion.slot == 2);
+		CHECK(insertion.evicted);
+		CHECK(insertion.evictedPage == second);
+		CHECK(cache.Find(second) == -1);
+		CHECK(cache.Find(first) == 1);
+
+		// Only unpinned pages are ever evicted
+		cache.BeginFrame(3);
+		CHECK(cache.Insert(second, false).slot == 1);
+		cache.BeginFrame(4);
+		CHECK(cache.Insert(first, false).slot == 2);
+		CHECK(cache.Find(pinned) == 0);
+
+		// Removing a texture frees its pinned pages as well
+		cache.RemoveTexture(1);
+		CHECK(cache.GetResidentCount() == 0);
+		CHECK(cache.Find(pinned) == -1);
+		CHECK(cache.Insert(pinned, true).slot != -1);
+	}
+
+	void CheckPageTable()
+	{
+		// Four by four pages at level 0, two by two at level 1, and a single page at level 2
+		VirtualTextureLayout layout{};
+		layout.width = layout.paddedWidth = 4 * VirtualTextureLayout::PageContentSize;
+		layout.height = layout.paddedHeight = 4 * VirtualTextureLayout::PageContentSize;
+		layout.levelCount = 3;
+
+		PageTable table{ layout };
+		CHECK(table.GetTableWidth(0) == 4);
+		CHECK(table.GetTableWidth(2) == 1);
+
+		// Nothing is resident yet, so every level is uploaded once, and nothing resolves
+		CHECK(table.Update() == 2);
+		CHECK(table.Resolve(0, 3, 3).slot == -1);
+
+		// With the coarsest page in, every page falls back on it
+		table.Map(2, 0, 0, 5);
+		CHECK(table.Update() == 2);
+		CHECK(table.Resolve(0, 3, 3).slot == 5);
+		CHECK(table.Resolve(0, 3, 3).level == 2);
+
+		// A finer page only takes over the pages it covers
+		table.Map(1, 1, 1, 7);
+		CHECK(table.Update() == 1);
+		CHECK(table.Resolve(0, 3, 3).slot == 7);
+		CHECK(table.Resolve(0, 3, 3).level == 1);
+		CHECK(table.Resolve(0, 1, 1).slot == 5);
+
+		// Nothing changed, so nothing has to be uploaded
+		CHECK(table.Update() == -1);
+
+		table.Unmap(1, 1, 1);
+		CHECK(table.Update() == 1);
+		CHECK(table.Resolve(0, 3, 3).slot == 5);
+		CHECK(!table.IsMapped(1, 1, 1));
+
+		// Slot 5 is in the second column and the second row of an atlas four slots across
+		std::vector<unsigned char> texels;
+		table.WriteTexels(0, 4, texels);
+		CHECK(texels.size() == 4 * 4 * 4);
+		CHECK(texels[0] == 1 && texels[1] == 1 && texels[2] == 2 && texels[3] == 255);
+	}
+}
+
+int main()
+{
+	CheckPageId();
+	CheckEviction();
+	CheckPageTable();
+
+	return CheckResult();
+}
@@ -0,0 +1,120 @@
+#include "Check.hpp"
+
+#include <vector>
+
+#include "DrawList.hpp"
+#include "RecordingRenderDevice.hpp"
+
+namespace
+{
+	std::vector<RecordedCommand> Commands(const std::vector<std::uint32_t>& stream)
+	{
+		std::vector<RecordedCommand> commands;
+		std::size_t position = 0;
+		while (position < stream.size())
+		{
+			RecordedCommand command;
+			const std::uint32_t* arguments;
+			std::uint32_t argumentCount;
+			position = RecordingRenderDevice::ReadCommand(stream, position, command, arguments, argumentCount);
+			commands.push_back(command);
+		}
+
+		return commands;
+	}
+
+	void CheckStream()
+	{
+		RecordingRenderDevice device{ true, true };
+		device.BeginFrame();
+
+		const unsigned char bytes[6] = { 1, 2, 3, 4, 5, 6 };
+		const auto buffer = device.CreateBuffer(BufferTarget::Vertex, sizeof(bytes), bytes, BufferUsage::Static);
+		CHECK(buffer != 0);
+		CHECK(device.CreateBuffer(BufferTarget::Index, 4, nullptr, BufferUsage::Static) != buffer);
+
+		// Binding what is already bound never reaches the stream
+		device.BindTexture(0, 7);
+		device.BindTexture(0, 7);
+		device.BindTexture(1, 7);
+		device.DrawIndexed(36, 6, -2, 1);
+		device.BeginFrame();
+
+		const auto stats = device.GetStats();
+		CHECK(stats.stateChanges == 2);
+		CHECK(stats.stateChangesFiltered == 1);
+		CHECK(stats.drawCalls == 1);
+		CHECK(stats.bufferBytesUploaded == sizeof(bytes));
+
+		const auto& stream = device.GetLastFrame();
+		const std::vector<RecordedCommand> expected{ RecordedCommand::CreateBuffer, RecordedCommand::CreateBuffer,
+			RecordedCommand::BindTexture, RecordedCommand::BindTexture, RecordedCommand::DrawIndexed };
+		CHECK(Commands(stream) == expected);
+		CHECK(device.GetRecordingStats().commands == expected.size());
+		CHECK(device.GetRecordingStats().streamBytes == stream.size() * sizeof(std::uint32_t));
+
+		// Handle, target, usage and size, then the kept data: its size, and the bytes padded to two words
+		RecordedCommand command;
+		const std::uint32_t* arguments;
+		std::uint32_t argumentCount;
+		RecordingRenderDevice::ReadCommand(stream, 0, command, arguments, argumentCount);
+		CHECK(argumentCount == 9);
+		CHECK(arguments[0] == buffer);
+		CHECK(arguments[7] == 0x04030201);
+		CHECK(arguments[8] == 0x0605);
+
+		// The draw is the last command. A negative base vertex survives the trip through an unsigned word.
+		std::size_t position = 0;
+		for (std::size_t i = 0; i < expected.size(); i++)
+			position = RecordingRenderDevice::ReadCommand(stream, position, command, arguments, argumentCount);
+		CHECK(position == stream.size());
+		CHECK(argumentCount == 4);
+		CHECK(arguments[0] == 36 && arguments[1] == 6 && static_cast<std::int32_t>(arguments[2]) == -2 && arguments[3] == 1);
+	}
+
+	// Six draws over two vertex arrays make two batches
+	void CheckDrawList(bool multiDraw)
+	{
+		RecordingRenderDevice device{ multiDraw };
+		device.BeginFrame();
+
+		DrawList list{};
+		list.SetView(glm::mat4{ 1.0f }, 0.1f, 100.0f);
+		for (int i = 0; i < 6; i++)
+		{
+			DrawState state{};
+			state.vertexArray = 1 + i % 2;
+			state.texture = 3;
+			auto transform = glm::mat4{ 1.0f };
+			transform[3] = glm::vec4{ 0.0f, 0.0f, -1.0f - i, 1.0f };
+			list.Add(state, 36, 0, 0, transform);
+		}
+		list.Build();
+		CHECK(list.GetBatches().size() == 2);
+		CHECK(list.GetCommands().size() == 6);
+
+		DrawListBuffers buffers{};
+		buffers.commandBuffer = device.CreateBuffer(BufferTarget::Indirect, 6 * sizeof(DrawCommand), nullptr, BufferUsage::Stream);
+		buffers.transformBuffer = device.CreateBuffer(BufferTarget::Vertex, 6 * sizeof(glm::mat4), nullptr, BufferUsage::Stream);
+		buffers.transformLocation = 3;
+		const auto drawCalls = list.Submit(device, buffers, nullptr);
+		device.BeginFrame();
+
+		const auto stats = device.GetStats();
+		CHECK(stats.draws == 6);
+		CHECK(stats.drawCalls == drawCalls);
+		CHECK(drawCalls == (multiDraw ? 2u : 6u));
+
+		// The texture is only bound once, as both batches share it
+		CHECK(device.GetRecordingStats().commandCounts[static_cast<int>(RecordedCommand::BindTexture)] == 1);
+	}
+}
+
+int main()
+{
+	CheckStream();
+	CheckDrawList(true);
+	CheckDrawList(false);
+
+	return CheckResult();
+}
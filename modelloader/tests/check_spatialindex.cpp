@@ -0,0 +1,135 @@
+#include "Check.hpp"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SpatialIndex.hpp"
+
+namespace
+{
+	bool BoxIntersects(const Frustum& frustum, const BoundingVolume& bounds)
+	{
+		for (const auto& plane : frustum.planes)
+		{
+			const glm::vec3 corner{ plane.x > 0.0f ? bounds.max.x : bounds.min.x, plane.y > 0.0f ? bounds.max.y : bounds.min.y,
+				plane.z > 0.0f ? bounds.max.z : bounds.min.z };
+			if (glm::dot(glm::vec3{ plane }, corner) + plane.w < 0.0f)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool RayHits(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const BoundingVolume& bounds)
+	{
+		const auto inverse = 1.0f / direction;
+		const auto a = (bounds.min - origin) * inverse;
+		const auto b = (bounds.max - origin) * inverse;
+		const auto entry = glm::min(a, b);
+		const auto exit = glm::max(a, b);
+		return std::max({ entry.x, entry.y, entry.z, 0.0f }) <= std::min({ exit.x, exit.y, exit.z, maxDistance });
+	}
+
+	BoundingVolume BoxAt(const glm::vec3& position)
+	{
+		return BoundingVolume::FromBox(glm::vec3{ -1.0f }, glm::vec3{ 1.0f }, glm::translate(glm::mat4{ 1.0f }, position));
+	}
+}
+
+int main()
+{
+	const std::size_t objectCount = 20000;
+	const auto projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+	const auto view = glm::lookAt(glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+	const auto frustum = Frustum::FromMatrix(projection * view);
+
+	std::mt19937 random{ 3 };
+	std::uniform_real_distribution<float> position{ -500.0f, 500.0f };
+	std::uniform_real_distribution<float> step{ -3.0f, 3.0f };
+	std::uniform_real_distribution<float> jump{ -50.0f, 50.0f };
+
+	SpatialIndex index{};
+	std::vector<glm::vec3> positions(objectCount);
+	std::vector<BoundingVolume> bounds(objectCount);
+	std::vector<std::uint32_t> handles(objectCount);
+	for (std::size_t i = 0; i < objectCount; i++)
+	{
+		positions[i] = glm::vec3{ position(random), position(random), position(random) };
+		bounds[i] = BoxAt(positions[i]);
+		handles[i] = index.Insert(bounds[i], static_cast<std::uint32_t>(i));
+	}
+	CHECK(index.GetCount() == objectCount);
+
+	// Small moves are mostly absorbed or refit, and the frame where most objects jump far forces a rebuild.
+	// Every frame, the query has to return every object whose box is in the frustum, each of them once.
+	std::vector<std::uint32_t> visible;
+	std::size_t rebuilds = 0;
+	for (int frame = 0; frame < 10; frame++)
+	{
+		const auto moveCount = frame == 5 ? objectCount : objectCount / 50;
+		for (std::size_t move = 0; move < moveCount; move++)
+		{
+			const auto i = random() % objectCount;
+			positions[i] += frame == 5 ? glm::vec3{ jump(random), jump(random), jump(random) } : glm::vec3{ step(random), step(random), step(random) };
+			bounds[i] = BoxAt(positions[i]);
+			index.Move(handles[i], bounds[i]);
+		}
+
+		index.Update();
+		rebuilds += index.GetStats().rebuilds;
+		visible.clear();
+		index.QueryFrustum(frustum, visible);
+
+		const std::set<std::uint32_t> found(visible.begin(), visible.end());
+		CHECK(found.size() == visible.size());
+
+		auto missed = 0;
+		for (std::size_t i = 0; i < objectCount; i++)
+		{
+			if (BoxIntersects(frustum, bounds[i]) && found.count(static_cast<std::uint32_t>(i)) == 0)
+				missed++;
+		}
+		CHECK(missed == 0);
+	}
+
+	// The stats are those of the frame which just finished
+	index.Update();
+	rebuilds += index.GetStats().rebuilds;
+	CHECK(rebuilds >= 1);
+	CHECK(index.GetStats().objects == objectCount);
+
+	// The ray finds every box it passes through, closest first. The enlarged boxes can add a few more.
+	const glm::vec3 origin{ 0.0f };
+	const auto direction = glm::normalize(glm::vec3{ 0.3f, 0.1f, -1.0f });
+	std::vector<SpatialRayHit> hits;
+	index.Raycast(origin, direction, 1000.0f, hits);
+
+	std::set<std::uint32_t> hitPayloads;
+	for (std::size_t i = 0; i < hits.size(); i++)
+	{
+		hitPayloads.insert(hits[i].payload);
+		if (i > 0)
+			CHECK(hits[i].distance >= hits[i - 1].distance);
+	}
+	for (std::size_t i = 0; i < objectCount; i++)
+	{
+		if (RayHits(origin, direction, 1000.0f, bounds[i]))
+			CHECK(hitPayloads.count(static_cast<std::uint32_t>(i)) != 0);
+	}
+
+	// Removed objects are never returned again
+	for (std::size_t i = 0; i < objectCount; i += 2)
+		index.Remove(handles[i]);
+	index.Update();
+	CHECK(index.GetCount() == objectCount / 2);
+
+	visible.clear();
+	index.QueryFrustum(frustum, visible);
+	CHECK(std::none_of(visible.begin(), visible.end(), [](std::uint32_t payload) { return payload % 2 == 0; }));
+
+	return CheckResult();
+}
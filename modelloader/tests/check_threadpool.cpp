@@ -0,0 +1,92 @@
+#include "Check.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace
+{
+	// Every job runs exactly once, and job 0 on the calling thread
+	void CheckRun(unsigned workerCount, std::size_t jobCount)
+	{
+		ThreadPool pool{ workerCount };
+		std::vector<std::atomic<int>> runs(jobCount);
+		for (auto& count : runs)
+			count = 0;
+
+		std::thread::id firstJobThread;
+		pool.Run(jobCount, [&](std::size_t job)
+		{
+			if (job == 0)
+				firstJobThread = std::this_thread::get_id();
+			runs[job]++;
+		});
+
+		auto wrongCounts = 0;
+		for (const auto& count : runs)
+		{
+			if (count != 1)
+				wrongCounts++;
+		}
+		CHECK(wrongCounts == 0);
+		CHECK(jobCount == 0 || firstJobThread == std::this_thread::get_id());
+	}
+
+	// Jobs which call Run themselves, on a pool too small to give each of them a worker, while the workers are also
+	// Kept busy with jobs submitted before. None of them waits on a job stuck in the queue.
+	void CheckNestedRun()
+	{
+		ThreadPool pool{ 2 };
+		for (int i = 0; i < 8; i++)
+			pool.Submit([]() { std::this_thread::sleep_for(std::chrono::milliseconds{ 1 }); });
+
+		std::atomic<int> innerRuns{ 0 };
+		pool.Run(6, [&](std::size_t)
+		{
+			pool.Run(5, [&](std::size_t)
+			{
+				pool.Run(3, [&](std::size_t) { innerRuns++; });
+			});
+		});
+
+		CHECK(innerRuns == 6 * 5 * 3);
+	}
+
+	// Wait only returns once the jobs submitted before it have finished
+	void CheckWait()
+	{
+		ThreadPool pool{ 3 };
+		std::atomic<int> finished{ 0 };
+		for (int i = 0; i < 20; i++)
+		{
+			pool.Submit([&finished]()
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+				finished++;
+			});
+		}
+
+		pool.Wait();
+		CHECK(finished == 20);
+
+		// And returns right away with nothing to wait for
+		pool.Wait();
+	}
+}
+
+int main()
+{
+	CheckRun(0, 0);
+	CheckRun(0, 7);
+	CheckRun(1, 1);
+	CheckRun(3, 2);
+	CheckRun(3, 1000);
+	CheckRun(7, 5);
+	CheckNestedRun();
+	CheckWait();
+
+	return CheckResult();
+}